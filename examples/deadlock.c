@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/bamboo.h"
+
+// Programs where every task ends up waiting on a channel, along with a piece
+// of what the error message should say about them.
+static const char *deadlocks[][2] = {
+	{ "(channel-recv (make-channel))", "main receives from" },
+	{ "(channel-send (make-channel) 1)", "main sends to" },
+	{ "((lambda (c d) "
+		"(spawn (lambda () (channel-send d 1))) "
+		"(spawn (lambda () (channel-recv d) (channel-recv c))) "
+		"(channel-recv c)) (make-channel) (make-channel))",
+		"task 2 receives from" },
+	{ NULL, NULL }
+};
+
+// Programs that finish just fine.
+static const char *fine[] = {
+	"((lambda (c) (spawn (lambda () (channel-send c 1))) (channel-recv c)) "
+		"(make-channel))",
+	"((lambda (c) (channel-send c 1) (channel-recv c)) (make-channel 1))",
+	NULL
+};
+
+/**
+ * Evaluates a program and returns the error it ended with.
+ */
+bamboo_error_t run(env_t env, const char *expr) {
+	bamboo_error_t err;
+	const char *end;
+	atom_t atom;
+	atom_t result;
+
+	err = bamboo_parse_expr(expr, &end, &atom);
+	if (err == BAMBOO_OK)
+		err = bamboo_eval_expr(atom, env, &result);
+
+	return err;
+}
+
+int main(void) {
+	bamboo_error_t err;
+	env_t env;
+	size_t failed;
+	size_t total;
+	size_t i;
+
+	// Initialize the interpreter.
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		return err;
+
+	// Deadlocks have to be reported as such.
+	failed = 0;
+	total = 0;
+	for (i = 0; deadlocks[i][0] != NULL; i++, total++) {
+		err = run(env, deadlocks[i][0]);
+		if (err != BAMBOO_ERROR_DEADLOCK) {
+			printf("%s: returned error %d instead of a deadlock\n",
+				deadlocks[i][0], (int)err);
+			failed++;
+		} else if (strstr(bamboo_error_detail(), deadlocks[i][1]) == NULL) {
+			printf("%s: \"%s\" doesn't mention \"%s\"\n", deadlocks[i][0],
+				bamboo_error_detail(), deadlocks[i][1]);
+			failed++;
+		}
+	}
+
+	// And nothing else should be.
+	for (i = 0; fine[i] != NULL; i++, total++) {
+		err = run(env, fine[i]);
+		if (err != BAMBOO_OK) {
+			printf("%s: returned error %d\n", fine[i], (int)err);
+			failed++;
+		}
+	}
+
+	printf("%lu of %lu cases failed\n", (unsigned long)failed,
+		(unsigned long)total);
+	bamboo_destroy(&env);
+
+	return (failed > 0) ? 1 : 0;
+}
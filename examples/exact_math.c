@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/bamboo.h"
+
+// Expressions and what they should print as.
+static const char *cases[][2] = {
+	{ "(sqrt 16)", "4" },
+	{ "(integer? (sqrt 9223372036854775807))", "#f" },
+	{ "(integer? (sqrt 18446744073709551615))", "#f" },
+	{ "(sqrt 18446744073709551616)", "4294967296" },
+	{ "(integer? (sqrt 18446744073709551617))", "#f" },
+	{ "(sqrt 18446744082299486209)", "4294967297" },
+	{ "(sqrt 340282366920938463463374607431768211456)",
+		"18446744073709551616" },
+	{ "(sqrt (* 12345678901234567891 12345678901234567891))",
+		"12345678901234567891" },
+	{ "(integer? (sqrt (- (* 12345678901234567891 12345678901234567891) "
+		"1)))", "#f" },
+	{ "(sqrt (expt 10 42))", "1000000000000000000000" },
+	{ "(expt 2 64)", "18446744073709551616" },
+	{ "(expt -3 3)", "-27" },
+	{ "(expt 2 0)", "1" },
+	{ "(expt 2 -1)", "0.5" },
+	{ "(mod -7 2)", "-1" },
+	{ "(mod 7 -2)", "1" },
+	{ "(remainder -7 2)", "-1" },
+	{ "(modulo -7 2)", "1" },
+	{ "(modulo 7 -2)", "-1" },
+	{ "(mod -7.5 2)", "-1.5" },
+	{ NULL, NULL }
+};
+
+/**
+ * Evaluates an expression and checks how it gets printed.
+ */
+bool check_case(env_t env, const char *expr, const char *expected) {
+	bamboo_error_t err;
+	const char *end;
+	atom_t atom;
+	atom_t result;
+	char *printed;
+	bool ok;
+
+	err = bamboo_parse_expr(expr, &end, &atom);
+	if (err == BAMBOO_OK)
+		err = bamboo_eval_expr(atom, env, &result);
+	if (err != BAMBOO_OK) {
+		printf("%s: failed to evaluate\n", expr);
+		return false;
+	}
+
+	bamboo_expr_str(&printed, result);
+	ok = strcmp(printed, expected) == 0;
+	if (!ok)
+		printf("%s: got %s instead of %s\n", expr, printed, expected);
+	free(printed);
+
+	return ok;
+}
+
+int main(void) {
+	bamboo_error_t err;
+	env_t env;
+	size_t failed;
+	size_t total;
+
+	// Initialize the interpreter.
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		return err;
+
+	// Go through every case.
+	failed = 0;
+	for (total = 0; cases[total][0] != NULL; total++) {
+		if (!check_case(env, cases[total][0], cases[total][1]))
+			failed++;
+	}
+
+	printf("%lu of %lu cases failed\n", (unsigned long)failed,
+		(unsigned long)total);
+	bamboo_destroy(&env);
+
+	return (failed > 0) ? 1 : 0;
+}
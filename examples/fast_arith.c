@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/bamboo.h"
+
+// Expressions evaluated in order and what they should print as. Later ones
+// depend on the definitions made by the earlier ones.
+static const char *cases[][2] = {
+	{ "(+ 5 3)", "8" },
+	{ "(define (f + a b) (+ a b))", "F" },
+	{ "(f - 5 3)", "2" },
+	{ "(+ 5 3)", "8" },
+	{ NULL, NULL }
+};
+
+// Same thing, but starting from a fresh interpreter that only ever redefines
+// the built-ins in the root environment.
+static const char *root_cases[][2] = {
+	{ "(< 1 2)", "#t" },
+	{ "(define old< <)", "OLD<" },
+	{ "(define < >)", "<" },
+	{ "(< 1 2)", "#f" },
+	{ "(define < old<)", "<" },
+	{ "(< 1 2)", "#t" },
+	{ NULL, NULL }
+};
+
+/**
+ * Evaluates an expression and checks how it gets printed.
+ */
+bool check_case(env_t env, const char *expr, const char *expected) {
+	bamboo_error_t err;
+	const char *end;
+	atom_t atom;
+	atom_t result;
+	char *printed;
+	bool ok;
+
+	err = bamboo_parse_expr(expr, &end, &atom);
+	if (err == BAMBOO_OK)
+		err = bamboo_eval_expr(atom, env, &result);
+	if (err != BAMBOO_OK) {
+		printf("%s: failed to evaluate\n", expr);
+		return false;
+	}
+
+	bamboo_expr_str(&printed, result);
+	ok = strcmp(printed, expected) == 0;
+	if (!ok)
+		printf("%s: got %s instead of %s\n", expr, printed, expected);
+	free(printed);
+
+	return ok;
+}
+
+/**
+ * Goes through a list of cases in a brand new interpreter.
+ */
+size_t run_cases(const char *list[][2], size_t *total) {
+	bamboo_error_t err;
+	env_t env;
+	size_t failed;
+	size_t i;
+
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		exit(err);
+
+	failed = 0;
+	for (i = 0; list[i][0] != NULL; i++) {
+		if (!check_case(env, list[i][0], list[i][1]))
+			failed++;
+	}
+	*total += i;
+
+	bamboo_destroy(&env);
+	return failed;
+}
+
+/**
+ * Checks that a fork redefining a built-in doesn't change it for the base.
+ */
+size_t run_fork_cases(size_t *total) {
+	bamboo_error_t err;
+	env_t env;
+	env_t fork;
+	size_t failed;
+
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		exit(err);
+
+	failed = 0;
+	if (!check_case(env, "(* 5 3)", "15"))
+		failed++;
+	err = bamboo_env_fork(env, &fork);
+	IF_BAMBOO_ERROR(err)
+		exit(err);
+	if (!check_case(fork, "(define * +)", "*"))
+		failed++;
+	if (!check_case(fork, "(* 5 3)", "8"))
+		failed++;
+	bamboo_env_discard(fork);
+	if (!check_case(env, "(* 5 3)", "15"))
+		failed++;
+	*total += 4;
+
+	bamboo_destroy(&env);
+	return failed;
+}
+
+/**
+ * Checks that closures shadowing a built-in keep doing so after going through
+ * a heap image.
+ */
+size_t run_image_cases(size_t *total) {
+	bamboo_error_t err;
+	env_t env;
+	size_t failed;
+	char path[] = "fast_arith.img";
+
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		exit(err);
+
+	failed = 0;
+	if (!check_case(env, "(define (make-op +) (lambda (a b) (+ a b)))",
+			"MAKE-OP")) {
+		failed++;
+	}
+	if (!check_case(env, "(define g (make-op -))", "G"))
+		failed++;
+	err = bamboo_image_save(env, path);
+	IF_BAMBOO_ERROR(err)
+		exit(err);
+	bamboo_destroy(&env);
+
+	// Start over from the image.
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		exit(err);
+	err = bamboo_image_load(&env, path);
+	IF_BAMBOO_ERROR(err)
+		exit(err);
+	remove(path);
+	if (!check_case(env, "(g 5 3)", "2"))
+		failed++;
+	if (!check_case(env, "(+ 5 3)", "8"))
+		failed++;
+	*total += 4;
+
+	bamboo_destroy(&env);
+	return failed;
+}
+
+/**
+ * Checks that closures shadowing a built-in keep doing so in the pmap workers.
+ */
+size_t run_pmap_cases(size_t *total) {
+	bamboo_error_t err;
+	env_t env;
+	size_t failed;
+
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		exit(err);
+
+	failed = 0;
+	if (!check_case(env, "(define (make-add +) (lambda (x) (+ x 3)))",
+			"MAKE-ADD")) {
+		failed++;
+	}
+	if (!check_case(env, "(define h (make-add -))", "H"))
+		failed++;
+	if (!check_case(env, "(pmap h '(7 8 9 10) 2)", "(4 5 6 7)"))
+		failed++;
+	if (!check_case(env, "(pmap (lambda (x) ((make-add -) x)) '(7 8 9 10) 2)",
+			"(4 5 6 7)")) {
+		failed++;
+	}
+	if (!check_case(env, "(pmap (lambda (x) (+ x 3)) '(7 8 9 10) 2)",
+			"(10 11 12 13)")) {
+		failed++;
+	}
+	*total += 5;
+
+	bamboo_destroy(&env);
+	return failed;
+}
+
+int main(void) {
+	size_t failed;
+	size_t total;
+
+	// Go through every case.
+	total = 0;
+	failed = run_cases(cases, &total);
+	failed += run_cases(root_cases, &total);
+	failed += run_fork_cases(&total);
+	failed += run_image_cases(&total);
+	failed += run_pmap_cases(&total);
+
+	printf("%lu of %lu cases failed\n", (unsigned long)failed,
+		(unsigned long)total);
+
+	return (failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/bamboo.h"
+
+// Longest literal in the corpus.
+#define LINE_MAX_LEN 128
+
+/**
+ * Converts a float literal the slow but trusted way.
+ */
+bamboo_float_t libc_float(const char *str) {
+#ifdef BAMBOO_USE_DOUBLE
+	return strtod(str, NULL);
+#else
+	return strtold(str, NULL);
+#endif  // BAMBOO_USE_DOUBLE
+}
+
+/**
+ * Checks if a string of digits times a power of ten reads back as a float.
+ */
+bool reads_back(const char *digits, int exp10, bamboo_float_t num) {
+	char buf[LINE_MAX_LEN];
+
+	snprintf(buf, LINE_MAX_LEN, "%se%d", digits, exp10);
+	return libc_float(buf) == num;
+}
+
+/**
+ * Adds or subtracts one from the last of a string of digits that has a
+ * leading zero to hold any carry.
+ */
+void nudge_digits(char *digits, int dir) {
+	size_t i;
+
+	for (i = strlen(digits) - 1; i > 0; i--) {
+		if ((dir > 0) && (digits[i] == '9')) {
+			digits[i] = '0';
+		} else if ((dir < 0) && (digits[i] == '0')) {
+			digits[i] = '9';
+		} else {
+			digits[i] += dir;
+			return;
+		}
+	}
+	digits[0] += dir;
+}
+
+/**
+ * Gets the least number of significant digits that still reads back as the
+ * exact same float. The shortest digits aren't always the correctly rounded
+ * ones, so the neighbours of the last digit are also tried.
+ */
+int shortest_digits(bamboo_float_t num) {
+	char buf[LINE_MAX_LEN];
+	char digits[LINE_MAX_LEN];
+	char *tmp;
+	size_t len;
+	int exp10;
+	int prec;
+	int dir;
+
+	if (num == 0)
+		return 1;
+	if (num < 0)
+		num = -num;
+
+	for (prec = 1; prec < 40; prec++) {
+#ifdef BAMBOO_USE_DOUBLE
+		snprintf(buf, LINE_MAX_LEN, "%.*e", prec - 1, num);
+#else
+		snprintf(buf, LINE_MAX_LEN, "%.*Le", prec - 1, num);
+#endif  // BAMBOO_USE_DOUBLE
+
+		// Split the digits from the exponent.
+		digits[0] = '0';
+		len = 1;
+		for (tmp = buf; *tmp != 'e'; tmp++) {
+			if (*tmp != '.')
+				digits[len++] = *tmp;
+		}
+		digits[len] = '\0';
+		exp10 = atoi(tmp + 1) - (prec - 1);
+
+		// Try the correctly rounded digits and their neighbours.
+		for (dir = -1; dir <= 1; dir++) {
+			char cand[LINE_MAX_LEN];
+
+			strcpy(cand, digits);
+			if (dir != 0)
+				nudge_digits(cand, dir);
+			if (reads_back(cand, exp10, num))
+				return prec;
+		}
+	}
+
+	return prec;
+}
+
+/**
+ * Counts the significant digits of a printed float.
+ */
+int count_digits(const char *str) {
+	const char *start;
+	const char *end;
+	int count;
+
+	// Skip the sign and leading zeros, and stop at the exponent.
+	for (start = str; (*start == '-') || (*start == '0') || (*start == '.');
+			start++);
+	for (end = start; (*end != '\0') && (*end != 'e'); end++);
+
+	// Trailing zeros aren't significant.
+	while ((end > start) && ((end[-1] == '0') || (end[-1] == '.')))
+		end--;
+
+	for (count = 0; start < end; start++) {
+		if (*start != '.')
+			count++;
+	}
+
+	return (count > 0) ? count : 1;
+}
+
+/**
+ * Parses a float literal, complaining if it doesn't come out as a float.
+ */
+bool parse_float(const char *str, bamboo_float_t *num) {
+	bamboo_error_t err;
+	const char *end;
+	atom_t atom;
+
+	err = bamboo_parse_expr(str, &end, &atom);
+	IF_BAMBOO_ERROR(err)
+		return false;
+	if (atom.type != ATOM_TYPE_FLOAT)
+		return false;
+
+	*num = atom.value.dfloat;
+	return true;
+}
+
+/**
+ * Checks a single literal from the corpus.
+ */
+bool check_literal(const char *literal) {
+	bamboo_float_t num;
+	bamboo_float_t back;
+	char *printed;
+	bool ok;
+
+	// Parse it and compare with the C library.
+	if (!parse_float(literal, &num)) {
+		printf("%s: didn't parse as a float\n", literal);
+		return false;
+	}
+	if (num != libc_float(literal)) {
+		printf("%s: parsed to the wrong float\n", literal);
+		return false;
+	}
+
+	// Print it and read it back.
+	bamboo_expr_str(&printed, bamboo_float(num));
+	ok = false;
+	if ((strchr(printed, '.') == NULL) && (strchr(printed, 'e') == NULL)) {
+		printf("%s: printed as %s, which isn't a float\n", literal, printed);
+	} else if (!parse_float(printed, &back) || (back != num) ||
+			((num == 0) && ((1 / back) != (1 / num)))) {
+		printf("%s: printed as %s, which doesn't read back\n", literal,
+			printed);
+	} else if (count_digits(printed) != shortest_digits(num)) {
+		printf("%s: printed as %s, which isn't the shortest form\n", literal,
+			printed);
+	} else {
+		ok = true;
+	}
+
+	free(printed);
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	char line[LINE_MAX_LEN];
+	bamboo_error_t err;
+	env_t env;
+	FILE *fh;
+	size_t failed;
+	size_t total;
+	size_t len;
+
+	// Open the corpus.
+	fh = fopen((argc > 1) ? argv[1] : "float_corpus.txt", "r");
+	if (fh == NULL) {
+		perror("Can't open the corpus");
+		return 1;
+	}
+
+	// Initialize the interpreter.
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		return err;
+
+	// Go through every literal in the corpus.
+	failed = 0;
+	total = 0;
+	while (fgets(line, LINE_MAX_LEN, fh) != NULL) {
+		len = strlen(line);
+		while ((len > 0) && ((line[len - 1] == '\n') ||
+				(line[len - 1] == '\r'))) {
+			line[--len] = '\0';
+		}
+		if ((len == 0) || (line[0] == ';'))
+			continue;
+
+		total++;
+		if (!check_literal(line))
+			failed++;
+	}
+	fclose(fh);
+
+	printf("%lu of %lu literals failed\n", (unsigned long)failed,
+		(unsigned long)total);
+	bamboo_destroy(&env);
+
+	return (failed > 0) ? 1 : 0;
+}
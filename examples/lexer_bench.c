@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../src/bamboo.h"
+
+// Number of times each pass is run, keeping the best time.
+#define RUNS 8
+
+/**
+ * Gets the current wall clock time in seconds.
+ */
+double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/**
+ * Reads a whole file into a terminated buffer.
+ */
+char *read_file(const char *path, size_t *len) {
+	FILE *fh;
+	char *buf;
+
+	fh = fopen(path, "rb");
+	if (fh == NULL) {
+		perror("Can't open the corpus");
+		exit(1);
+	}
+
+	fseek(fh, 0, SEEK_END);
+	*len = (size_t)ftell(fh);
+	fseek(fh, 0, SEEK_SET);
+	buf = (char *)malloc(*len + 1);
+	if ((buf == NULL) || (fread(buf, 1, *len, fh) != *len)) {
+		perror("Can't read the corpus");
+		exit(1);
+	}
+	buf[*len] = '\0';
+	fclose(fh);
+
+	return buf;
+}
+
+/**
+ * Finds the boundaries of every form in the corpus without building them,
+ * which is mostly the work of the lexer.
+ */
+size_t scan_all(const char *corpus) {
+	bamboo_error_t err;
+	const char *start;
+	const char *end;
+	atom_t name;
+	size_t forms;
+
+	forms = 0;
+	for (end = corpus; ; forms++) {
+		err = bamboo_scan_form(end, &start, &end, &name);
+		if (err == BAMBOO_EMPTY_LINE)
+			return forms;
+		IF_BAMBOO_ERROR(err) {
+			bamboo_print_error(err);
+			fprintf(stderr, "\n");
+			exit(err);
+		}
+	}
+}
+
+/**
+ * Parses every form in the corpus.
+ */
+size_t parse_all(const char *corpus) {
+	bamboo_error_t err;
+	const char *end;
+	atom_t expr;
+	size_t forms;
+
+	forms = 0;
+	for (end = corpus; ; forms++) {
+		err = bamboo_parse_expr(end, &end, &expr);
+		if (err == BAMBOO_EMPTY_LINE)
+			return forms;
+		if (err == BAMBOO_COMMENT)
+			forms--;
+		IF_BAMBOO_ERROR(err) {
+			bamboo_print_error(err);
+			fprintf(stderr, "\n");
+			exit(err);
+		}
+	}
+}
+
+/**
+ * Runs a pass over the corpus a few times and gets its best time. The
+ * interpreter is started from scratch for each run so that the parsed forms
+ * don't pile up.
+ */
+double bench(size_t (*pass)(const char *), const char *corpus, size_t *forms) {
+	bamboo_error_t err;
+	env_t env;
+	double best;
+	double elapsed;
+	int i;
+
+	best = 0;
+	for (i = 0; i < RUNS; i++) {
+		err = bamboo_init(&env);
+		IF_BAMBOO_ERROR(err)
+			exit(err);
+
+		elapsed = now();
+		*forms = pass(corpus);
+		elapsed = now() - elapsed;
+		if ((i == 0) || (elapsed < best))
+			best = elapsed;
+
+		bamboo_destroy(&env);
+	}
+
+	return best;
+}
+
+int main(int argc, char **argv) {
+	char *corpus;
+	double scan;
+	double parse;
+	double mb;
+	size_t scan_forms;
+	size_t parse_forms;
+	size_t len;
+
+	// Load the corpus generated by lexer_corpus.
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s corpus\n", argv[0]);
+		return 1;
+	}
+	corpus = read_file(argv[1], &len);
+	mb = len / (1024.0 * 1024.0);
+
+	// Time each pass.
+	scan = bench(scan_all, corpus, &scan_forms);
+	parse = bench(parse_all, corpus, &parse_forms);
+
+	printf("pass\tforms\tseconds\tMB/s\n");
+	printf("scan\t%lu\t%.3f\t%.1f\n", (unsigned long)scan_forms, scan,
+		mb / scan);
+	printf("parse\t%lu\t%.3f\t%.1f\n", (unsigned long)parse_forms, parse,
+		mb / parse);
+
+	free(corpus);
+	return 0;
+}
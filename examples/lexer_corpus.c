@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// Deepest nesting of the generated expressions.
+#define MAX_DEPTH 6
+
+// Names used for symbols.
+static const char *names[] = {
+	"define", "lambda", "if", "car", "cdr", "cons", "quote", "counter",
+	"string-append", "vector-ref", "fold-left", "acc", "x", "y", "node",
+	"make-channel", "stats-summary", "list->vector", "+", "-", "*", "<="
+};
+#define NAMES_LEN (sizeof(names) / sizeof(names[0]))
+
+// Words used inside strings and comments.
+static const char *words[] = {
+	"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "lorem",
+	"ipsum", "dolor", "sit", "amet", "bamboo", "parser", "throughput"
+};
+#define WORDS_LEN (sizeof(words) / sizeof(words[0]))
+
+// State of the pseudo-random number generator.
+static uint64_t seed = 0x2545F4914F6CDD1DULL;
+
+/**
+ * Gets a pseudo-random number below a limit. Always gives the same sequence so
+ * that the corpus can be reproduced.
+ */
+unsigned int rnd(unsigned int limit) {
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+
+	return (unsigned int)(seed % limit);
+}
+
+/**
+ * Writes a few random words.
+ */
+size_t put_words(unsigned int count) {
+	size_t len = 0;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (i > 0)
+			len += printf(" ");
+		len += printf("%s", words[rnd(WORDS_LEN)]);
+	}
+
+	return len;
+}
+
+/**
+ * Writes a random atom.
+ */
+size_t put_atom(void) {
+	size_t len;
+
+	switch (rnd(6)) {
+	case 0:
+		return printf("%d", (int)rnd(2000000) - 1000000);
+	case 1:
+		return printf("%u.%03u", rnd(10000), rnd(1000));
+	case 2:
+		// Strings, some of them with escapes.
+		len = printf("\"");
+		len += put_words(1 + rnd(8));
+		if (rnd(4) == 0)
+			len += printf("\\n\\\"%s\\\"", words[rnd(WORDS_LEN)]);
+		return len + printf("\"");
+	default:
+		return printf("%s", names[rnd(NAMES_LEN)]);
+	}
+}
+
+/**
+ * Writes a random expression, indenting nested lists on new lines.
+ */
+size_t put_expr(unsigned int depth) {
+	unsigned int count;
+	unsigned int i;
+	size_t len;
+
+	// Atoms get more likely the deeper we go.
+	if ((depth >= MAX_DEPTH) || (rnd(MAX_DEPTH) < depth))
+		return put_atom();
+
+	// Lists, sometimes quoted.
+	len = (rnd(8) == 0) ? printf("'(") : printf("(");
+	count = 1 + rnd(5);
+	for (i = 0; i < count; i++) {
+		if (i > 0) {
+			if (rnd(3) == 0) {
+				len += printf("\n%*s", (int)(2 * (depth + 1)), "");
+			} else {
+				len += printf(" ");
+			}
+		}
+		len += put_expr(depth + 1);
+	}
+
+	return len + printf(")");
+}
+
+int main(int argc, char **argv) {
+	size_t target;
+	size_t len;
+
+	// Get the size of the corpus in megabytes.
+	target = ((argc > 1) ? (size_t)atoi(argv[1]) : 20) * 1024 * 1024;
+
+	// Write top-level definitions with comments between them.
+	len = 0;
+	while (len < target) {
+		if (rnd(3) == 0) {
+			len += printf(";; ");
+			len += put_words(4 + rnd(10));
+			len += printf("\n");
+		}
+
+		len += printf("(define def-%s-%u\n  ", names[rnd(NAMES_LEN)],
+			rnd(100000));
+		len += put_expr(1);
+		len += printf(")\n\n");
+	}
+
+	return 0;
+}
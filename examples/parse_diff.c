@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/bamboo.h"
+
+// Inputs that should read the same way through both parsers.
+static const char *inputs[] = {
+	"(a b c)",
+	"(a . b)",
+	"(a b . c)",
+	"(a . (b c))",
+	"'(a . b)",
+	"'(a ... (b c))",
+	"'(a ... b)",
+	"(... a)",
+	"(a .. b)",
+	"(a .b)",
+	"(a . .b)",
+	"(.5 .25)",
+	"(a . 1.5)",
+	"'(a '. b)",
+	"`(a ,b ,@c)",
+	"#f64(1 2 3)",
+	"(\"a\\tb\" . \"c\")",
+	"((a . b) (c . d))",
+	"(. a)",
+	"(a . )",
+	"(a . b c)",
+	"(a . . b)",
+	"(a . b . c)",
+	NULL
+};
+
+/**
+ * Grabs the single form delivered by the push parser.
+ */
+bamboo_error_t grab_form(atom_t form, void *arg) {
+	atom_t *atom = (atom_t *)arg;
+
+	*atom = form;
+	return BAMBOO_OK;
+}
+
+/**
+ * Reads an input through bamboo_parse_expr.
+ */
+bamboo_error_t read_expr(const char *input, atom_t *atom) {
+	const char *end;
+
+	return bamboo_parse_expr(input, &end, atom);
+}
+
+/**
+ * Reads an input through the push parser in a single chunk.
+ */
+bamboo_error_t read_push(const char *input, atom_t *atom) {
+	bamboo_parser_t *parser;
+	bamboo_error_t err;
+
+	err = bamboo_parser_new(&parser);
+	IF_BAMBOO_ERROR(err)
+		return err;
+
+	*atom = bamboo_symbol("NO-FORM");
+	err = bamboo_parser_feed(parser, input, NULL, grab_form, atom);
+	if (err == BAMBOO_OK)
+		err = bamboo_parser_finish(parser, grab_form, atom);
+	bamboo_parser_free(parser);
+
+	return err;
+}
+
+/**
+ * Checks that both parsers agree on a single input.
+ */
+bool check_input(const char *input) {
+	bamboo_error_t err_expr;
+	bamboo_error_t err_push;
+	atom_t expr;
+	atom_t push;
+	char *str_expr;
+	char *str_push;
+	bool ok;
+
+	err_expr = read_expr(input, &expr);
+	err_push = read_push(input, &push);
+
+	// Both have to fail or both have to succeed.
+	if ((err_expr != BAMBOO_OK) || (err_push != BAMBOO_OK)) {
+		if ((err_expr != BAMBOO_OK) && (err_push != BAMBOO_OK))
+			return true;
+
+		printf("%s: only the %s parser failed\n", input,
+			(err_expr != BAMBOO_OK) ? "expression" : "push");
+		return false;
+	}
+
+	// Compare what they read.
+	bamboo_expr_str(&str_expr, expr);
+	bamboo_expr_str(&str_push, push);
+	ok = strcmp(str_expr, str_push) == 0;
+	if (!ok) {
+		printf("%s: expression parser read %s, push parser read %s\n", input,
+			str_expr, str_push);
+	}
+
+	free(str_expr);
+	free(str_push);
+	return ok;
+}
+
+int main(void) {
+	bamboo_error_t err;
+	env_t env;
+	size_t failed;
+	size_t total;
+
+	// Initialize the interpreter.
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		return err;
+
+	// Go through every input.
+	failed = 0;
+	for (total = 0; inputs[total] != NULL; total++) {
+		if (!check_input(inputs[total]))
+			failed++;
+	}
+
+	printf("%lu of %lu inputs read differently\n", (unsigned long)failed,
+		(unsigned long)total);
+	bamboo_destroy(&env);
+
+	return (failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../src/bamboo.h"
+
+// Number of times the closure gets applied.
+#define JOBS 64
+
+// Library code available to every worker.
+static const char *library =
+	"(define fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))";
+
+/**
+ * Gets the current wall clock time in seconds.
+ */
+double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/**
+ * Evaluates an expression from a string, bailing out if anything goes wrong.
+ */
+atom_t eval_str(env_t env, const char *str) {
+	bamboo_error_t err;
+	const char *end;
+	atom_t expr;
+	atom_t result;
+
+	err = bamboo_parse_expr(str, &end, &expr);
+	IF_BAMBOO_ERROR(err)
+		goto failed;
+	err = bamboo_eval_expr(expr, env, &result);
+	IF_BAMBOO_ERROR(err)
+		goto failed;
+
+	return result;
+
+failed:
+	bamboo_print_error(err);
+	fprintf(stderr, "\n");
+	exit(err);
+}
+
+int main(int argc, char **argv) {
+	bamboo_error_t err;
+	env_t env;
+	atom_t func;
+	atom_t list;
+	atom_t result;
+	double base;
+	double elapsed;
+	size_t max_workers;
+	size_t workers;
+	int i;
+
+	// Get the maximum number of workers to try.
+	max_workers = (argc > 1) ? (size_t)atoi(argv[1]) : 8;
+
+	// Initialize the interpreter with our library.
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		return err;
+	eval_str(env, library);
+
+	// Build the list of arguments and the CPU-bound closure.
+	list = nil;
+	for (i = 0; i < JOBS; i++)
+		list = cons(bamboo_int(18), list);
+	func = eval_str(env, "(lambda (n) (fib n))");
+
+	// Time each number of workers.
+	base = 0;
+	printf("workers\tseconds\tspeedup\n");
+	for (workers = 1; workers <= max_workers; workers *= 2) {
+		elapsed = now();
+		err = bamboo_pmap(func, list, workers, &result);
+		elapsed = now() - elapsed;
+		IF_BAMBOO_ERROR(err) {
+			bamboo_print_error(err);
+			fprintf(stderr, "\n");
+			return err;
+		}
+
+		if (workers == 1)
+			base = elapsed;
+		printf("%lu\t%.3f\t%.2fx\n", (unsigned long)workers, elapsed,
+			base / elapsed);
+	}
+
+	return bamboo_destroy(&env);
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/bamboo.h"
+
+// How deep the nested list built by the deep case goes.
+#define DEEP_LEVELS 200000
+
+// Expressions evaluated in order and what they should print as.
+static const char *cases[][2] = {
+	{ "'(1 2 3)", "(1 2 3)" },
+	{ "'(1 . 2)", "(1 . 2)" },
+	{ "'(1 2 . 3)", "(1 2 . 3)" },
+	{ "'((1 . 2) (3 (4)) . 5)", "((1 . 2) (3 (4)) . 5)" },
+	{ "'(\"a\" (\"b\"))", "(\"a\" (\"b\"))" },
+	{ "(lambda (x) (+ x 1))", "#<FUNCTION:(X) ((+ X 1))>" },
+	{ "(lambda () 1)", "#<FUNCTION: (1)>" },
+	{ "(lambda (f) (lambda (x) (f x)))",
+		"#<FUNCTION:(F) ((LAMBDA (X) (F X)))>" },
+	{ "(display \"a\" 1 '(b \"c\"))", "\"a1(B c)\"" },
+	{ "(define (mk n acc) (if (= n 0) acc (mk (- n 1) (cons n acc))))",
+		"MK" },
+	{ NULL, NULL }
+};
+
+/**
+ * Evaluates an expression and checks how it gets printed.
+ */
+bool check_case(env_t env, const char *expr, const char *expected) {
+	bamboo_error_t err;
+	const char *end;
+	atom_t atom;
+	atom_t result;
+	char *printed;
+	bool ok;
+
+	err = bamboo_parse_expr(expr, &end, &atom);
+	if (err == BAMBOO_OK)
+		err = bamboo_eval_expr(atom, env, &result);
+	if (err != BAMBOO_OK) {
+		printf("%s: failed to evaluate\n", expr);
+		return false;
+	}
+
+	bamboo_expr_str(&printed, result);
+	ok = strcmp(printed, expected) == 0;
+	if (!ok)
+		printf("%s: got %s instead of %s\n", expr, printed, expected);
+	free(printed);
+
+	return ok;
+}
+
+/**
+ * Checks that a deeply nested list gets printed whole.
+ */
+bool check_deep(atom_t deep) {
+	char *printed;
+	size_t len;
+	size_t i;
+	bool ok;
+
+	bamboo_expr_str(&printed, deep);
+	len = strlen(printed);
+	ok = len == ((DEEP_LEVELS * 2) + 1);
+	for (i = 0; ok && (i < DEEP_LEVELS); i++) {
+		ok = (printed[i] == '(') &&
+			(printed[len - i - 1] == ')');
+	}
+	ok = ok && (printed[DEEP_LEVELS] == '1');
+	if (!ok)
+		printf("%d levels deep list printed wrong\n", DEEP_LEVELS);
+	free(printed);
+
+	return ok;
+}
+
+int main(void) {
+	bamboo_error_t err;
+	env_t env;
+	atom_t deep;
+	size_t failed;
+	size_t total;
+	size_t i;
+
+	// Initialize the interpreter.
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		return err;
+
+	// Go through every case.
+	failed = 0;
+	for (total = 0; cases[total][0] != NULL; total++) {
+		if (!check_case(env, cases[total][0], cases[total][1]))
+			failed++;
+	}
+
+	// Build a list nested deep enough to blow up a recursive printer and keep
+	// it in the environment.
+	deep = bamboo_int(1);
+	for (i = 0; i < DEEP_LEVELS; i++)
+		deep = cons(deep, nil);
+	err = bamboo_env_set(env, bamboo_symbol("DEEP"), deep);
+	IF_BAMBOO_ERROR(err)
+		return err;
+	if (!check_deep(deep))
+		failed++;
+
+	// It has to survive the garbage collector going through it as well.
+	if (!check_case(env, "(car (mk 50000 nil))", "1"))
+		failed++;
+	if (!check_deep(deep))
+		failed++;
+	total += 3;
+
+	printf("%lu of %lu cases failed\n", (unsigned long)failed,
+		(unsigned long)total);
+	bamboo_destroy(&env);
+
+	return (failed > 0) ? 1 : 0;
+}
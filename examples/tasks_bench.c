@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../src/bamboo.h"
+
+// Number of times each task yields.
+#define YIELDS 100000
+
+// Tasks that keep handing control to each other and report when done.
+static const char *library[] = {
+	"(define done (make-channel))",
+	"(define spin (lambda (n) (if (= n 0) (channel-send done n) "
+		"((lambda () (yield) (spin (- n 1)))))))",
+	"(define join (lambda (n) (if (= n 0) n "
+		"((lambda () (channel-recv done) (join (- n 1)))))))",
+	NULL
+};
+
+/**
+ * Gets the current wall clock time in seconds.
+ */
+double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/**
+ * Evaluates an expression from a string, bailing out if anything goes wrong.
+ */
+atom_t eval_str(env_t env, const char *str) {
+	bamboo_error_t err;
+	const char *end;
+	atom_t expr;
+	atom_t result;
+
+	err = bamboo_parse_expr(str, &end, &expr);
+	IF_BAMBOO_ERROR(err)
+		goto failed;
+	err = bamboo_eval_expr(expr, env, &result);
+	IF_BAMBOO_ERROR(err)
+		goto failed;
+
+	return result;
+
+failed:
+	bamboo_print_error(err);
+	fprintf(stderr, "\n");
+	exit(err);
+}
+
+int main(int argc, char **argv) {
+	bamboo_error_t err;
+	env_t env;
+	char spawn[64];
+	char join[64];
+	double elapsed;
+	size_t max_tasks;
+	size_t tasks;
+	size_t i;
+
+	// Get the maximum number of tasks to try.
+	max_tasks = (argc > 1) ? (size_t)atoi(argv[1]) : 64;
+
+	// Initialize the interpreter with our library.
+	err = bamboo_init(&env);
+	IF_BAMBOO_ERROR(err)
+		return err;
+	for (i = 0; library[i] != NULL; i++)
+		eval_str(env, library[i]);
+	snprintf(spawn, sizeof(spawn), "(spawn spin %d)", YIELDS);
+
+	// Time each number of tasks taking turns.
+	printf("tasks\tseconds\tswitches/s\n");
+	for (tasks = 1; tasks <= max_tasks; tasks *= 2) {
+		for (i = 0; i < tasks; i++)
+			eval_str(env, spawn);
+		snprintf(join, sizeof(join), "(join %lu)", (unsigned long)tasks);
+
+		elapsed = now();
+		eval_str(env, join);
+		elapsed = now() - elapsed;
+
+		printf("%lu\t%.3f\t%.0f\n", (unsigned long)tasks, elapsed,
+			(tasks * YIELDS) / elapsed);
+	}
+
+	return bamboo_destroy(&env);
+}
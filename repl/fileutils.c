@@ -9,11 +9,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #ifndef _WIN32
 	#include <unistd.h>
+	#include <fcntl.h>
+	#include <sys/mman.h>
 #endif  // _WIN32
 #include "strutils.h"
 
+// Private definitions.
+#define FILE_READ_MIN_CAP 4096
+
  /**
   * Checks if a file exists.
   *
@@ -136,115 +142,250 @@ TCHAR* extcat(const TCHAR *fpath, const TCHAR *ext) {
 }
 
 /**
- * Gets the size of a buffer to hold the whole contents of a file.
+ * Opens a file for reading, taking care of converting the path if needed.
+ * WARNING: Remember to close the returned file handle.
  *
  * @param  fname File path.
- * @return       Size of the content of specified file or 0 if an error occured.
+ * @return       File handle or NULL if an error occured.
  */
-size_t file_contents_size(const TCHAR *fname) {
+FILE *file_open(const TCHAR *fname) {
 	FILE *fh;
-	size_t nbytes;
 #ifdef UNICODE
-	char *tmp;
+	char *spath;
 
 	// Get the regular string version of the file path.
-	tmp = trunc_wchar(fname);
-	if (tmp == NULL)
-		return 0;
+	spath = trunc_wchar(fname);
+	if (spath == NULL)
+		return NULL;
 
-	// Open file.
-	fh = fopen(tmp, "r");
+	// Open file to read its contents.
+	fh = fopen(spath, "r");
+	free(spath);
 #else
-	// Open file.
+	// Open file to read its contents.
 	fh = fopen(fname, "r");
 #endif  // UNICODE
-	if (fh == NULL)
-		return 0L;
-
-	// Seek file to determine its size.
-	fseek(fh, 0L, SEEK_END);
-	nbytes = ftell(fh);
-
-#ifdef UNICODE
-	// Free our temporary conversion buffer.
-	free(tmp);
-#endif  // UNICODE
 
-	// Close the file handler and return.
-	fclose(fh);
-	return nbytes;
+	return fh;
 }
 
 /**
- * Reads a whole file and stores it into a string.
+ * Reads a whole file and stores it into a string. Regular files are read with
+ * a single fread, anything else (like pipes) is read until it runs dry.
  * WARNING: Remember to free the returned string allocated by this function.
  *
  * @param  fname File path.
+ * @param  len   Pointer to the variable that will hold the length of the
+ *               contents. Can be NULL.
  * @return       String where the file contents are to be stored (will be
- *               allocated by this function).
+ *               allocated by this function) or NULL if an error occured.
  */
-TCHAR* slurp_file(const TCHAR *fname) {
+TCHAR *slurp_file(const TCHAR *fname, size_t *len) {
 	FILE *fh;
-	size_t fsize;
-	int c;
-	TCHAR *contents;
-	TCHAR *tmp;
+	char *contents;
+	char *tmp;
+	size_t cap;
+	size_t nread;
+	struct stat st;
 #ifdef UNICODE
-	char *spath;
+	TCHAR *wcontents;
+	size_t i;
 #endif  // UNICODE
 
-	// Get file size.
-	fsize = file_contents_size(fname);
-	if (fsize == 0L)
+	// Open the file.
+	fh = file_open(fname);
+	if (fh == NULL)
 		return NULL;
 
-	// Allocate the string to hold the contents of the file.
-	contents = (TCHAR *)malloc((fsize + 1) * sizeof(TCHAR));
+	// Start off with a buffer that fits the whole file if we know its size.
+	cap = FILE_READ_MIN_CAP;
+	if ((fstat(fileno(fh), &st) == 0) && (st.st_size > 0))
+		cap = (size_t)st.st_size + 1;
+	contents = (char *)malloc(cap + 1);
 	if (contents == NULL)
-		return NULL;
+		goto fail;
+
+	// Read the file, growing the buffer if it turns out to be bigger.
+	nread = 0;
+	for (;;) {
+		nread += fread(contents + nread, sizeof(char), cap - nread, fh);
+		if (nread < cap)
+			break;
+
+		cap *= 2;
+		tmp = (char *)realloc(contents, cap + 1);
+		if (tmp == NULL)
+			goto fail;
+		contents = tmp;
+	}
+
+	// Check if we stopped because of an error.
+	if (ferror(fh))
+		goto fail;
+	fclose(fh);
+
+	// Make sure our string is properly terminated.
+	contents[nread] = '\0';
+	if (len != NULL)
+		*len = nread;
 
 #ifdef UNICODE
-	// Get the regular string version of the file path.
-	spath = trunc_wchar(fname);
-	if (spath == NULL) {
-		free(contents);
-		return NULL;
+	// Widen the characters.
+	wcontents = (TCHAR *)malloc((nread + 1) * sizeof(TCHAR));
+	if (wcontents != NULL) {
+		for (i = 0; i <= nread; i++)
+			wcontents[i] = (TCHAR)(unsigned char)contents[i];
 	}
+	free(contents);
 
-	// Open file to read its contents.
-	fh = fopen(spath, "r");
+	return wcontents;
 #else
-	// Open file to read its contents.
-	fh = fopen(fname, "r");
-#endif  // UNICODE
-	if (fh == NULL) {
-#ifdef UNICODE
-		free(spath);
+	return contents;
 #endif  // UNICODE
-		free(contents);
-		return NULL;
-	}
 
+fail:
+	free(contents);
+	fclose(fh);
+	return NULL;
+}
+
+/**
+ * Reads the next chunk of a file into a buffer.
+ *
+ * @param  fh  File handle.
+ * @param  buf Buffer that will hold the chunk. Must have room for len
+ *             characters plus the terminator.
+ * @param  len Maximum number of characters to read.
+ * @return     Number of characters read or 0 if we've reached the end of the
+ *             file.
+ */
+size_t file_read_chunk(FILE *fh, TCHAR *buf, size_t len) {
+	size_t nread;
 #ifdef UNICODE
-	// Clean up our temporary file path.
-	free(spath);
+	int c;
+
+	// Read the chunk one character at a time.
+	for (nread = 0; nread < len; nread++) {
+		c = fgetc(fh);
+		if (c == EOF)
+			break;
+
+		buf[nread] = (TCHAR)c;
+	}
+#else
+	// Read the chunk in one go.
+	nread = fread(buf, sizeof(TCHAR), len, fh);
 #endif  // UNICODE
 
-	// Reads the whole file into the buffer.
-	tmp = contents;
-	c = fgetc(fh);
-	while (c != EOF) {
-		// Append the character to our contents buffer and advance it.
-		*tmp = (TCHAR)c;
-		tmp++;
+	// Make sure our string is properly terminated.
+	buf[nread] = _T('\0');
 
-		// Get a character from the file.
-		c = fgetc(fh);
+	return nread;
+}
+
+/**
+ * Gets the contents of a regular file as a terminated string without copying
+ * them, by mapping the file into memory right in front of a zeroed page. Falls
+ * back to reading the whole file into memory when it can't be mapped. Anything
+ * that isn't a regular file (like pipes) isn't handled, since its size isn't
+ * bounded and it should be read in chunks with file_read_chunk instead.
+ * WARNING: Remember to release the contents with file_unmap.
+ *
+ * @param  fname File path.
+ * @param  fm    Pointer to the structure that will hold the contents.
+ * @return       TRUE if we were able to get the contents of the file. FALSE if
+ *               it couldn't be read or isn't a regular file.
+ */
+bool file_map(const TCHAR *fname, file_map_t *fm) {
+	struct stat st;
+#if !defined(_WIN32) && !defined(UNICODE)
+	size_t page;
+	void *base;
+	int fd;
+#else
+	FILE *fh;
+#endif  // !_WIN32 && !UNICODE
+
+	// Start from a clean slate.
+	fm->contents = NULL;
+	fm->len = 0;
+	fm->map = NULL;
+	fm->map_len = 0;
+
+#if !defined(_WIN32) && !defined(UNICODE)
+	// Only regular files are handled.
+	fd = open(fname, O_RDONLY);
+	if (fd < 0)
+		return false;
+	if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return false;
+	}
+	if (st.st_size == 0)
+		goto fallback;
+
+	// Reserve enough zeroed memory for the file plus its terminator.
+	page = (size_t)sysconf(_SC_PAGESIZE);
+	fm->len = (size_t)st.st_size;
+	fm->map_len = ((fm->len / page) + 1) * page;
+	base = mmap(NULL, fm->map_len, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+		-1, 0);
+	if (base == MAP_FAILED)
+		goto fallback;
+
+	// Map the file over the start of it. The rest of its last page and the
+	// reserved page after it are guaranteed to read as zeros.
+	if (mmap(base, fm->len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+			MAP_FAILED) {
+		munmap(base, fm->map_len);
+		goto fallback;
 	}
+	close(fd);
 
-	// Close the file handle and make sure our string is properly terminated.
+	// Let the kernel know we'll go through the file sequentially.
+	madvise(base, fm->len, MADV_SEQUENTIAL);
+	fm->map = base;
+	fm->contents = (const TCHAR *)base;
+
+	return true;
+
+fallback:
+	close(fd);
+	fm->len = 0;
+	fm->map_len = 0;
+#else
+	// Only regular files are handled.
+	fh = file_open(fname);
+	if (fh == NULL)
+		return false;
+	if ((fstat(fileno(fh), &st) != 0) || ((st.st_mode & S_IFMT) != S_IFREG)) {
+		fclose(fh);
+		return false;
+	}
 	fclose(fh);
-	*tmp = _T('\0');
+#endif  // !_WIN32 && !UNICODE
 
-	return contents;
+	// Read the whole thing into memory instead. Its size is known up front.
+	fm->contents = slurp_file(fname, &fm->len);
+	return fm->contents != NULL;
+}
+
+/**
+ * Releases the contents of a file obtained with file_map.
+ *
+ * @param fm Contents of the file.
+ */
+void file_unmap(file_map_t *fm) {
+#if !defined(_WIN32) && !defined(UNICODE)
+	if (fm->map != NULL) {
+		munmap(fm->map, fm->map_len);
+		fm->map = NULL;
+		fm->contents = NULL;
+
+		return;
+	}
+#endif  // !_WIN32 && !UNICODE
+
+	free((TCHAR *)fm->contents);
+	fm->contents = NULL;
 }
@@ -14,6 +14,7 @@ extern "C" {
 
 #include "../src/bamboo.h"
 #include <sys/types.h>
+#include <stdio.h>
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -24,6 +25,14 @@ extern "C" {
 	#endif  // INVALID_FILE_ATTRIBUTES
 #endif  // _WIN32
 
+// Contents of a file, either mapped into memory or read into a buffer.
+typedef struct {
+	const TCHAR *contents;
+	size_t len;
+	void *map;
+	size_t map_len;
+} file_map_t;
+
 // Checking.
 bool file_exists(const TCHAR *fpath);
 bool file_ext_match(const TCHAR *fpath, const TCHAR *ext);
@@ -33,8 +42,11 @@ size_t cleanup_path(TCHAR *path);
 TCHAR *extcat(const TCHAR *fpath, const TCHAR *ext);
 
 // File content.
-size_t file_contents_size(const TCHAR *fname);
-TCHAR *slurp_file(const TCHAR *fname);
+FILE *file_open(const TCHAR *fname);
+TCHAR *slurp_file(const TCHAR *fname, size_t *len);
+size_t file_read_chunk(FILE *fh, TCHAR *buf, size_t len);
+bool file_map(const TCHAR *fname, file_map_t *fm);
+void file_unmap(file_map_t *fm);
 
 #ifdef __cplusplus
 }
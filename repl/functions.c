@@ -9,13 +9,52 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "fileutils.h"
+#include "loadcache.h"
 #ifdef USE_PLOTTING
 	#include "plotting/plot.h"
 #endif  // USE_PLOTTING
 
+// Private definitions.
+#define LOAD_CHUNK_LEN 4096
+
+// Context shared with the callback while loading a source file.
+typedef struct {
+	env_t *env;
+	atom_t *result;
+	load_cache_forms_t *forms;
+} load_ctx_t;
+
+// Source file whose definitions are only loaded once they are used.
+typedef struct lazy_source_s lazy_source_t;
+typedef struct lazy_def_s lazy_def_t;
+struct lazy_source_s {
+	file_map_t fm;
+	lazy_def_t *defs;
+	lazy_source_t *next;
+};
+
+// Definition in a lazily loaded source file, indexed by its byte offset.
+struct lazy_def_s {
+	lazy_source_t *source;
+	size_t offset;
+	lazy_def_t *next;
+};
+
+// Private variables.
+static lazy_source_t *lazy_sources = NULL;
+
+// Private methods.
+bamboo_error_t load_stream(FILE *fh, load_ctx_t *ctx);
+bamboo_error_t load_cached_forms(load_cache_forms_t *forms, load_ctx_t *ctx);
+bamboo_error_t load_eval_form(atom_t form, void *arg);
+bamboo_error_t load_lazy(env_t *env, file_map_t *fm, atom_t *result);
+bamboo_error_t load_autoload(env_t env, atom_t symbol, void *arg);
+
 // Built-in function prototypes.
 bamboo_error_t builtin_quit(atom_t args, atom_t *result);
 bamboo_error_t builtin_load(atom_t args, atom_t *result);
+bamboo_error_t builtin_save_image(atom_t args, atom_t *result);
+bamboo_error_t builtin_load_cache_stats(atom_t args, atom_t *result);
 #ifdef USE_PLOTTING
 bamboo_error_t builtin_plot_init(atom_t args, atom_t *result);
 bamboo_error_t builtin_plot_destroy(atom_t args, atom_t *result);
@@ -30,81 +69,345 @@ bamboo_error_t builtin_plot_data(atom_t args, atom_t *result);
 #endif  // USE_PLOTTING
 
 /**
- * Loads the contents of a source file into the given environment.
+ * Loads the contents of a source file into the given environment. Files that
+ * have been loaded before have their forms taken straight from the load cache
+ * without being parsed again.
  * 
  * @param  env    Pointer to the environment for the source to be evaluated in.
  * @param  fname  Path to the file to be loaded.
+ * @param  lazy   Only index the top-level definitions and load each one of
+ *                them the first time its name is looked up?
  * @param  result Return atom of the last evaluated expression in the source.
  * @return        BAMBOO_OK if everything went fine.
  */
-bamboo_error_t load_source(env_t *env, const TCHAR *fname, atom_t *result) {
+bamboo_error_t load_source(env_t *env, const TCHAR *fname, bool lazy,
+						   atom_t *result) {
 	bamboo_error_t err;
-	atom_t parsed;
-	TCHAR *contents;
+	bamboo_parser_t *parser;
+	load_cache_forms_t forms;
+	load_cache_key_t key;
 	const TCHAR *end;
+	load_ctx_t ctx;
+	file_map_t fm;
+	bool cacheable;
+	FILE *fh;
 
 	// Start from a clean slate.
-	err = BAMBOO_OK;
 	*result = nil;
+	parser = NULL;
+	ctx.env = env;
+	ctx.result = result;
+	ctx.forms = NULL;
+	load_cache_forms_init(&forms);
 
 	// Just remind the user of what's happening.
 	_tprintf(_T("Loading ") SPEC_STR LINEBREAK, fname);
 
-	// Get the file contents.
-	contents = slurp_file(fname);
-	if (contents == NULL) {
-		return bamboo_error(BAMBOO_ERROR_UNKNOWN,
-			_T("Couldn't read the specified file for some reason"));
-	}
-
-	// Parse and evaluate the contents of the file.
-	end = contents;
-	while (*end != _T('\0')) {
-#ifdef DEBUG
-		// Check out our tokens.
-		bamboo_print_tokens(end);
-		_tprintf(LINEBREAK);
-#endif  // DEBUG
+	// Get the file contents without copying them around if it's a regular
+	// file. Anything else (like pipes) is streamed through the parser so that
+	// it doesn't have to fit in memory.
+	if (!file_map(fname, &fm)) {
+		if (!lazy) {
+			fh = file_open(fname);
+			if (fh == NULL) {
+				return bamboo_error(BAMBOO_ERROR_UNKNOWN,
+					_T("Couldn't read the specified file for some reason"));
+			}
 
-		// Parse the expression.
-		err = bamboo_parse_expr(end, &end, &parsed);
-		IF_BAMBOO_ERROR(err) {
-			// Show the error message.
-			bamboo_print_error(err);
+			err = load_stream(fh, &ctx);
+			fclose(fh);
 			goto stop;
 		}
 
-		// Deal with some special conditions from the parsing stage.
-		IF_BAMBOO_SPECIAL_COND(err) {
-			switch (err) {
-			case BAMBOO_EMPTY_LINE:
-				// Ignore things that are meant to be ignored.
-				end++;
-				continue;
-			default:
-				break;
-			}
+		// Lazily loaded definitions need the contents to stick around.
+		fm.contents = slurp_file(fname, &fm.len);
+		if (fm.contents == NULL) {
+			return bamboo_error(BAMBOO_ERROR_UNKNOWN,
+				_T("Couldn't read the specified file for some reason"));
 		}
+	}
 
-		// Evaluate the parsed expression.
-		err = bamboo_eval_expr(parsed, *env, result);
-		IF_BAMBOO_ERROR(err) {
-			// Check if we just got a quit situation.
-			if (err == (bamboo_error_t)BAMBOO_REPL_QUIT)
-				goto stop;
+	// Libraries don't need to be parsed in their entirety.
+	if (lazy) {
+		err = load_lazy(env, &fm, result);
+		goto stop;
+	}
+
+	// Evaluate the forms straight from the cache if they are in there.
+	cacheable = load_cache_enabled() &&
+		load_cache_key(fname, fm.contents, fm.len, &key);
+	if (cacheable && load_cache_read(&key, &forms)) {
+		err = load_cached_forms(&forms, &ctx);
+		goto stop;
+	}
 
-			// Explain the real issue then...
+	// Get a parser ready.
+	err = bamboo_parser_new(&parser);
+	IF_BAMBOO_ERROR(err)
+		goto stop;
+
+	// Keep the forms around for the cache as they get parsed.
+	if (cacheable)
+		ctx.forms = &forms;
+
+	// Parse and evaluate the contents of the file straight from memory.
+	err = bamboo_parser_feed(parser, fm.contents, &end, load_eval_form, &ctx);
+	IF_BAMBOO_ERROR(err)
+		goto stop;
+	if (end != (fm.contents + fm.len)) {
+		err = bamboo_error(BAMBOO_ERROR_SYNTAX,
+			_T("Unexpected NUL character in source file"));
+		goto stop;
+	}
+	err = bamboo_parser_finish(parser, load_eval_form, &ctx);
+
+	// Only cache files that were loaded in their entirety.
+	if (cacheable && (err <= BAMBOO_OK))
+		load_cache_write(&key, &forms);
+
+stop:
+	// Explain what went wrong unless we just got a quit situation.
+	IF_BAMBOO_ERROR(err) {
+		if (err != (bamboo_error_t)BAMBOO_REPL_QUIT)
 			bamboo_print_error(err);
+	}
+
+	// Clean up and return.
+	bamboo_parser_free(parser);
+	load_cache_forms_free(&forms);
+	file_unmap(&fm);
+	return err;
+}
+
+/**
+ * Loads a source file that can't be mapped into memory, like a pipe, by
+ * feeding it to the parser in chunks as they are read. These can't be cached
+ * since their contents are only ever seen a chunk at a time.
+ *
+ * @param  fh  Handle of the file to be loaded.
+ * @param  ctx Loading context.
+ * @return     BAMBOO_OK if everything went fine.
+ */
+bamboo_error_t load_stream(FILE *fh, load_ctx_t *ctx) {
+	bamboo_error_t err;
+	bamboo_parser_t *parser;
+	const TCHAR *end;
+	TCHAR *chunk;
+	size_t len;
+
+	// Allocate the buffer that will hold each chunk of the file.
+	chunk = (TCHAR *)malloc((LOAD_CHUNK_LEN + 1) * sizeof(TCHAR));
+	if (chunk == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+			_T("Couldn't allocate the buffer to read the file"));
+	}
+
+	// Get a parser ready.
+	err = bamboo_parser_new(&parser);
+	IF_BAMBOO_ERROR(err) {
+		free(chunk);
+		return err;
+	}
+
+	// Parse and evaluate the contents of the file as they are read.
+	while ((len = file_read_chunk(fh, chunk, LOAD_CHUNK_LEN)) > 0) {
+		err = bamboo_parser_feed(parser, chunk, &end, load_eval_form, ctx);
+		IF_BAMBOO_ERROR(err)
+			goto stop;
+		if (end != (chunk + len)) {
+			err = bamboo_error(BAMBOO_ERROR_SYNTAX,
+				_T("Unexpected NUL character in source file"));
 			goto stop;
 		}
 	}
+	err = bamboo_parser_finish(parser, load_eval_form, ctx);
 
 stop:
-	// Clean up and return.
-	free(contents);
+	bamboo_parser_free(parser);
+	free(chunk);
 	return err;
 }
 
+/**
+ * Evaluates the forms of a source file that were taken from the load cache.
+ *
+ * @param  forms Serialized forms of the source file.
+ * @param  ctx   Loading context.
+ * @return       BAMBOO_OK if every form was evaluated successfully.
+ */
+bamboo_error_t load_cached_forms(load_cache_forms_t *forms, load_ctx_t *ctx) {
+	bamboo_error_t err;
+	atom_t form;
+
+	// Forms are only brought back to life right before being evaluated.
+	while (!load_cache_forms_done(forms)) {
+		err = load_cache_forms_next(forms, &form);
+		IF_BAMBOO_ERROR(err)
+			return err;
+
+		err = load_eval_form(form, ctx);
+		IF_BAMBOO_ERROR(err)
+			return err;
+	}
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Evaluates a form that has just been read from a source file.
+ *
+ * @param  form Parsed form.
+ * @param  arg  Loading context.
+ * @return      BAMBOO_OK if the form was evaluated successfully.
+ */
+bamboo_error_t load_eval_form(atom_t form, void *arg) {
+	load_ctx_t *ctx = (load_ctx_t *)arg;
+
+#ifdef DEBUG
+	// Check out what we've parsed.
+	bamboo_print_expr(form);
+	_tprintf(LINEBREAK);
+#endif  // DEBUG
+
+	// Store the form for the cache before it gets evaluated.
+	if (ctx->forms != NULL)
+		load_cache_forms_add(ctx->forms, form);
+
+	return bamboo_eval_expr(form, *ctx->env, ctx->result);
+}
+
+/**
+ * Loads a source file lazily. Top-level definitions are only indexed and their
+ * names bound to autoload stubs, everything else is evaluated right away.
+ * The contents of the file are kept around until the definitions are needed.
+ *
+ * @param  env    Pointer to the environment for the source to be evaluated in.
+ * @param  fm     Contents of the file. They'll be taken over by this function.
+ * @param  result Return atom of the last evaluated expression in the source.
+ * @return        BAMBOO_OK if everything went fine.
+ */
+bamboo_error_t load_lazy(env_t *env, file_map_t *fm, atom_t *result) {
+	bamboo_error_t err;
+	lazy_source_t *source;
+	lazy_def_t *def;
+	const TCHAR *start;
+	const TCHAR *end;
+	atom_t name;
+	atom_t form;
+
+	// Keep the contents of the file around for as long as we are running.
+	source = (lazy_source_t *)malloc(sizeof(lazy_source_t));
+	if (source == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+			_T("Can't allocate lazily loaded source file"));
+	}
+	source->fm = *fm;
+	source->defs = NULL;
+	source->next = lazy_sources;
+	lazy_sources = source;
+	fm->contents = NULL;
+	fm->map = NULL;
+
+	// Make sure we'll be able to load the definitions once they are needed.
+	bamboo_set_autoload_handler(load_autoload);
+
+	// Go through the top-level forms without parsing them.
+	for (end = source->fm.contents; ; ) {
+		err = bamboo_scan_form(end, &start, &end, &name);
+		if (err == BAMBOO_EMPTY_LINE)
+			break;
+		IF_BAMBOO_ERROR(err)
+			return err;
+
+		// Evaluate anything that isn't a definition right away.
+		if (nilp(name)) {
+			const TCHAR *tmp;
+
+			err = bamboo_parse_expr(start, &tmp, &form);
+			IF_BAMBOO_ERROR(err)
+				return err;
+			err = bamboo_eval_expr(form, *env, result);
+			IF_BAMBOO_ERROR(err)
+				return err;
+
+			continue;
+		}
+
+		// Index the definition and bind its name to a stub.
+		def = (lazy_def_t *)malloc(sizeof(lazy_def_t));
+		if (def == NULL) {
+			return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+				_T("Can't allocate lazy definition index"));
+		}
+		def->source = source;
+		def->offset = (size_t)(start - source->fm.contents);
+		def->next = source->defs;
+		source->defs = def;
+
+		err = bamboo_env_set_autoload(*env, name, def);
+		IF_BAMBOO_ERROR(err)
+			return err;
+	}
+
+	// Scanning stops at the first NUL character.
+	if (start != (source->fm.contents + source->fm.len)) {
+		return bamboo_error(BAMBOO_ERROR_SYNTAX,
+			_T("Unexpected NUL character in source file"));
+	}
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Loads a definition from a lazily loaded source file the first time its name
+ * is looked up.
+ *
+ * @param  env    Environment the definition belongs to.
+ * @param  symbol Name of the definition.
+ * @param  arg    Index of the definition.
+ * @return        BAMBOO_OK if the definition was evaluated successfully.
+ */
+bamboo_error_t load_autoload(env_t env, atom_t symbol, void *arg) {
+	lazy_def_t *def = (lazy_def_t *)arg;
+	bamboo_error_t err;
+	const TCHAR *end;
+	atom_t result;
+	atom_t form;
+
+	(void)symbol;
+
+	// Parse the definition straight from where we've found it.
+	err = bamboo_parse_expr(def->source->fm.contents + def->offset, &end,
+		&form);
+	IF_BAMBOO_ERROR(err)
+		return err;
+
+	return bamboo_eval_expr(form, env, &result);
+}
+
+/**
+ * Releases the contents of every lazily loaded source file. Only call this
+ * after the environment that refers to them has been destroyed.
+ */
+void load_lazy_free(void) {
+	lazy_source_t *source;
+	lazy_def_t *def;
+
+	while (lazy_sources != NULL) {
+		source = lazy_sources;
+		lazy_sources = source->next;
+
+		while (source->defs != NULL) {
+			def = source->defs;
+			source->defs = def->next;
+			free(def);
+		}
+
+		file_unmap(&source->fm);
+		free(source);
+	}
+}
+
 /**
  * Populates the environment with our built-in functions.
  *
@@ -127,6 +430,17 @@ bamboo_error_t repl_populate_builtins(env_t *env) {
 	IF_BAMBOO_ERROR(err)
 		return err;
 
+	// Save heap image.
+	err = bamboo_env_set_builtin(*env, _T("SAVE-IMAGE"), builtin_save_image);
+	IF_BAMBOO_ERROR(err)
+		return err;
+
+	// Load cache statistics.
+	err = bamboo_env_set_builtin(*env, _T("LOAD-CACHE-STATS"),
+		builtin_load_cache_stats);
+	IF_BAMBOO_ERROR(err)
+		return err;
+
 #ifdef USE_PLOTTING
 	err = bamboo_env_set_builtin(*env, _T("PLOT-INIT"), builtin_plot_init);
 	IF_BAMBOO_ERROR(err)
@@ -215,6 +529,8 @@ bamboo_error_t builtin_quit(atom_t args, atom_t *result) {
  */
 bamboo_error_t builtin_load(atom_t args, atom_t *result) {
 	atom_t fname;
+	atom_t flag;
+	bool lazy;
 
 	// Just in case...
 	*result = nil;
@@ -225,10 +541,11 @@ bamboo_error_t builtin_load(atom_t args, atom_t *result) {
 			_T("A file path must be supplied to this function"));
 	}
 
-	// Check if we have more than a single argument.
-	if (!nilp(cdr(args))) {
+	// Check if we have more than a file path and a lazy flag.
+	if (!nilp(cdr(args)) && !nilp(cdr(cdr(args)))) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("Only a single file path should be supplied to this function"));
+			_T("Only a file path and a lazy flag should be supplied to this "
+			   "function"));
 	}
 
 	// Get the file name argument.
@@ -240,8 +557,82 @@ bamboo_error_t builtin_load(atom_t args, atom_t *result) {
 			_T("File name atom must be of type string"));
 	}
 
+	// Check if the file should be loaded lazily.
+	lazy = false;
+	if (!nilp(cdr(args))) {
+		flag = car(cdr(args));
+		lazy = !nilp(flag) && !((flag.type == ATOM_TYPE_BOOLEAN) &&
+			!flag.value.boolean);
+	}
+
 	// Load the file.
-	return load_source(bamboo_get_root_env(), *fname.value.str, result);
+	return load_source(bamboo_get_root_env(), bamboo_string_cstr(fname), lazy,
+		result);
+}
+
+/**
+ * Saves the current environment to a heap image that can be loaded with the
+ * -i command-line option.
+ *
+ * (save-image fname) -> #t
+ *
+ * @param  fname Path to the image file to be written.
+ * @return       True if the image was saved.
+ */
+bamboo_error_t builtin_save_image(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	atom_t fname;
+
+	// Just in case...
+	*result = nil;
+
+	// Check if we have a single argument.
+	if (nilp(args) || !nilp(cdr(args))) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("A single file path must be supplied to this function"));
+	}
+
+	// Check if its the right type of argument.
+	fname = car(args);
+	if (fname.type != ATOM_TYPE_STRING) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("File name atom must be of type string"));
+	}
+
+	// Save the image.
+	err = bamboo_image_save(*bamboo_get_root_env(), bamboo_string_cstr(fname));
+	IF_BAMBOO_ERROR(err)
+		return err;
+
+	*result = bamboo_boolean(true);
+	return BAMBOO_OK;
+}
+
+/**
+ * Gets the number of source files that were loaded from the cache and the
+ * number of those that had to be parsed.
+ *
+ * (load-cache-stats) -> (hits misses)
+ *
+ * @return List with the number of cache hits and misses.
+ */
+bamboo_error_t builtin_load_cache_stats(atom_t args, atom_t *result) {
+	load_cache_stats_t stats;
+
+	// Just in case...
+	*result = nil;
+
+	// Check if we don't have any arguments.
+	if (!nilp(args)) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("No arguments should be supplied to this function"));
+	}
+
+	stats = load_cache_stats();
+	*result = cons(bamboo_int((int64_t)stats.hits),
+		cons(bamboo_int((int64_t)stats.misses), nil));
+
+	return BAMBOO_OK;
 }
 
 #ifdef USE_PLOTTING
@@ -400,7 +791,7 @@ bamboo_error_t builtin_plot_title(atom_t args, atom_t *result) {
 
 	// Get the plotting handle, the equation, and plot it.
 	plt = (plot_t *)plthnd.value.pointer;
-	plot_set_title(plt, *title.value.str);
+	plot_set_title(plt, bamboo_string_cstr(title));
 
 	return BAMBOO_OK;
 }
@@ -449,7 +840,7 @@ bamboo_error_t builtin_plot_xlabel(atom_t args, atom_t *result) {
 
 	// Get the plotting handle, the equation, and plot it.
 	plt = (plot_t *)plthnd.value.pointer;
-	plot_set_xlabel(plt, *label.value.str);
+	plot_set_xlabel(plt, bamboo_string_cstr(label));
 
 	return BAMBOO_OK;
 }
@@ -498,7 +889,7 @@ bamboo_error_t builtin_plot_ylabel(atom_t args, atom_t *result) {
 
 	// Get the plotting handle, the equation, and plot it.
 	plt = (plot_t *)plthnd.value.pointer;
-	plot_set_ylabel(plt, *label.value.str);
+	plot_set_ylabel(plt, bamboo_string_cstr(label));
 
 	return BAMBOO_OK;
 }
@@ -547,7 +938,7 @@ bamboo_error_t builtin_plot_name(atom_t args, atom_t *result) {
 
 	// Get the plotting handle, the equation, and plot it.
 	plt = (plot_t *)plthnd.value.pointer;
-	plot_set_series_name(plt, *name.value.str);
+	plot_set_series_name(plt, bamboo_string_cstr(name));
 
 	return BAMBOO_OK;
 }
@@ -645,7 +1036,7 @@ bamboo_error_t builtin_plot_equation(atom_t args, atom_t *result) {
 
 	// Get the plotting handle, the equation, and plot it.
 	plt = (plot_t *)plthnd.value.pointer;
-	plot_equation(plt, *eqn.value.str);
+	plot_equation(plt, bamboo_string_cstr(eqn));
 
 	return BAMBOO_OK;
 }
@@ -654,9 +1045,12 @@ bamboo_error_t builtin_plot_equation(atom_t args, atom_t *result) {
  * Plots a series of data points.
  *
  * (plot-data plthnd data)
+ * (plot-data plthnd xs ys)
  *
  * @param plthnd Plotting handle pointer.
  * @param data   Data points to plot as a list of (X . Y) pairs.
+ * @param xs     X values of the data points as a f64vector.
+ * @param ys     Y values of the data points as a f64vector.
  */
 bamboo_error_t builtin_plot_data(atom_t args, atom_t *result) {
 	atom_t plthnd;
@@ -677,12 +1071,6 @@ bamboo_error_t builtin_plot_data(atom_t args, atom_t *result) {
 			_T("A plotting handle must be supplied to this function"));
 	}
 
-	// Check if we have more than two arguments.
-	if (bamboo_list_count(args) != 2) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("Only 2 arguments should be supplied to this function"));
-	}
-
 	// Check if we have a pointer argument.
 	plthnd = car(args);
 	if (plthnd.type != ATOM_TYPE_POINTER) {
@@ -690,6 +1078,39 @@ bamboo_error_t builtin_plot_data(atom_t args, atom_t *result) {
 			_T("Plotting handle atom must be of type pointer"));
 	}
 
+	// Check if we were given the data points as vectors.
+	if (bamboo_list_count(args) == 3) {
+		atom_t xs = car(cdr(args));
+		atom_t ys = car(cdr(cdr(args)));
+
+		// Check if we have a couple of f64vectors.
+		if ((xs.type != ATOM_TYPE_VECTOR) || (ys.type != ATOM_TYPE_VECTOR) ||
+				((*xs.value.vector)->type != VECTOR_TYPE_F64) ||
+				((*ys.value.vector)->type != VECTOR_TYPE_F64)) {
+			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+				_T("Data point vectors must be of type f64vector"));
+		}
+
+		// Check if both vectors have the same length.
+		if ((*xs.value.vector)->len != (*ys.value.vector)->len) {
+			return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+				_T("Data point vectors must have the same length"));
+		}
+
+		// Plot the vectors directly.
+		plt = (plot_t *)plthnd.value.pointer;
+		plot_data_d(plt, (*xs.value.vector)->len, (*xs.value.vector)->data.f64,
+			(*ys.value.vector)->data.f64);
+
+		return BAMBOO_OK;
+	}
+
+	// Check if we have more than two arguments.
+	if (bamboo_list_count(args) != 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("Only 2 or 3 arguments should be supplied to this function"));
+	}
+
 	// Check if we have a list argument.
 	data = car(cdr(args));
 	if (data.type != ATOM_TYPE_PAIR) {
@@ -23,7 +23,9 @@ typedef enum {
 bamboo_error_t repl_populate_builtins(env_t *env);
 
 // Misc. utilities.
-bamboo_error_t load_source(env_t *env, const TCHAR *fname, atom_t *result);
+bamboo_error_t load_source(env_t *env, const TCHAR *fname, bool lazy,
+						   atom_t *result);
+void load_lazy_free(void);
 
 #ifdef __cplusplus
 }
@@ -5,12 +5,14 @@
  * @author Nathan Campos <nathan@innoveworkshop.com>
  */
 
-// Make sure we also have a "T-variant" for int.
+// Make sure we also have a "T-variant" for int and EOF.
 #ifdef UNICODE
 #include <wchar.h>
 typedef wint_t TINT;
+#define TEOF WEOF
 #else
 typedef int TINT;
+#define TEOF EOF
 #endif  // UNICODE
 
 #include "input.h"
@@ -22,6 +24,9 @@ typedef int TINT;
 	#include <readline/history.h>
 #endif  // USE_GNU_READLINE
 
+// Private definitions.
+#define REPL_LINE_MIN_CAP 128
+
 /**
  * Initializes the REPL.
  */
@@ -40,93 +45,102 @@ void repl_destroy(void) {
 }
 
 /**
- * Reads the user input like a command prompt.
+ * Reads a line of user input like a command prompt.
+ * WARNING: Remember to free the returned string allocated by this function.
  *
- * @param  buf Pointer to the buffer that will hold the user input.
- * @param  len Maximum length to read the user input including NULL terminator.
- * @return     Non-zero to break out of the REPL loop.
+ * @param  continuation Are we continuing an expression from a previous line?
+ * @return              Line typed by the user, including the line break, or
+ *                      NULL if we've reached the end of the input.
  */
-int repl_readline(TCHAR *buf, size_t len) {
+TCHAR *repl_readline(bool continuation) {
+	TCHAR *buf;
 #ifdef USE_GNU_READLINE
 	char *line;
-	size_t linelen = 0;
+	size_t linelen;
 
 	// Read the line using GNU Readline.
-	line = readline("> ");
+	line = readline((continuation) ? "  " : "> ");
 	if (line == NULL)
-		return -1;
-
-	// Check if the line isn't too long.
-	linelen = strlen(line);
-	if (linelen > len)
-		return linelen;
+		return NULL;
 
 	// Add the line to the history.
+	linelen = strlen(line);
 	if (linelen > 0)
 		add_history(line);
 
+	// Allocate our buffer with room for the line break.
+	buf = (TCHAR *)malloc((linelen + 2) * sizeof(TCHAR));
+	if (buf == NULL) {
+		free(line);
+		return NULL;
+	}
+
 #ifdef UNICODE
 	// Convert our string to a wide string for the buffer.
-	mbstowcs(buf, line, len);
+	linelen = mbstowcs(buf, line, linelen + 1);
+	if (linelen == (size_t)-1)
+		linelen = 0;
 #else
 	// Copy the line to our buffer.
-	strcpy(buf, line);
+	memcpy(buf, line, linelen);
 #endif
 
-	// Free our buffer.
+	// Terminate the line and free the readline buffer.
+	buf[linelen] = _T('\n');
+	buf[linelen + 1] = _T('\0');
 	free(line);
 
-	return 0;
+	return buf;
 #else
 	// Implement our own line reader.
-	uint16_t i;
-	int16_t openparens = 0;
-	int16_t paren_index = 0;
-	bool instring = false;
+	size_t len = 0;
+	size_t cap = REPL_LINE_MIN_CAP;
+	TINT c;
 
-	// Put some safe guards in place.
-	buf[0] = _T('\0');
-	buf[len] = _T('\0');
+	// Allocate the initial buffer.
+	buf = (TCHAR *)malloc((cap + 1) * sizeof(TCHAR));
+	if (buf == NULL)
+		return NULL;
 
 	// Get user input.
-	_tprintf(_T("> "));
-	for (i = 0; i < len; i++) {
+	_tprintf((continuation) ? _T("  ") : _T("> "));
+	for (;;) {
 		// Get character from STDIN.
-		TINT c = _gettchar();
-
-		switch (c) {
-		case _T('\"'):
-			// Opening or closing a string.
-			instring = !instring;
-			break;
-		case _T('('):
-			// Opened a parenthesis.
-			if (!instring)
-				openparens++;
-			break;
-		case _T(')'):
-			// Closed a parenthesis.
-			if (!instring)
-				openparens--;
-			break;
-		case _T('\n'):
-			// Only return the string if all the parenthesis have been closed.
-			if (openparens < 1) {
-				buf[i] = _T('\0');
-				goto returnstr;
+		c = _gettchar();
+		if (c == TEOF) {
+			// Only give up if there's nothing left in the line.
+			if (len == 0) {
+				free(buf);
+				return NULL;
 			}
 
-			// Add some indentation into the mix.
-			for (paren_index = 0; paren_index <= openparens; paren_index++)
-				_tprintf(_T("  "));
 			break;
 		}
 
+		// Make sure we have room for the character and the line break.
+		if ((len + 1) >= cap) {
+			TCHAR *tmp;
+
+			cap *= 2;
+			tmp = (TCHAR *)realloc(buf, (cap + 1) * sizeof(TCHAR));
+			if (tmp == NULL) {
+				free(buf);
+				return NULL;
+			}
+			buf = tmp;
+		}
+
 		// Append character to the buffer.
-		buf[i] = (TCHAR)c;
+		buf[len++] = (TCHAR)c;
+		if (c == _T('\n'))
+			break;
 	}
 
-returnstr:
-	return 0;
+	// Make sure the line always ends with a line break.
+	if (buf[len - 1] != _T('\n'))
+		buf[len++] = _T('\n');
+	buf[len] = _T('\0');
+
+	return buf;
 #endif  // USE_GNU_READLINE
 }
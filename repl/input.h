@@ -20,7 +20,7 @@ void repl_init(void);
 void repl_destroy(void);
 
 // Input
-int repl_readline(TCHAR *buf, size_t len);
+TCHAR *repl_readline(bool continuation);
 
 #ifdef __cplusplus
 }
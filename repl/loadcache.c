@@ -0,0 +1,479 @@
+/**
+ * loadcache.c
+ * Cache of pre-parsed source files that makes loading them again faster.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "loadcache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+	#include <unistd.h>
+#endif  // _WIN32
+#include "strutils.h"
+
+// Private definitions.
+#define LOAD_CACHE_MAGIC "BAMBOOLC"
+#define LOAD_CACHE_VERSION 1
+#define LOAD_CACHE_EXT ".blc"
+#define LOAD_CACHE_MIN_CAP 4096
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+// Header of a cache entry. It's followed by the path of the source file and
+// its serialized forms.
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t tchar_size;
+	uint64_t size;
+	int64_t mtime;
+	uint64_t hash;
+	uint64_t path_len;
+	uint64_t forms_len;
+	uint64_t forms_hash;
+} load_cache_header_t;
+
+// Private variables.
+static bool cache_enabled = true;
+static load_cache_stats_t cache_stats = { 0, 0 };
+
+// Private methods.
+uint64_t fnv1a_hash(uint64_t hash, const void *data, size_t len);
+bool cache_dir(char *dir, size_t len);
+bool env_set(const char *value);
+bool mkdir_parents(char *path);
+
+/**
+ * Enables or disables the use of the cache when loading source files.
+ *
+ * @param enabled Should the cache be used?
+ */
+void load_cache_set_enabled(bool enabled) {
+	cache_enabled = enabled;
+}
+
+/**
+ * Checks if the cache should be used when loading source files.
+ *
+ * @return TRUE if the cache is enabled.
+ */
+bool load_cache_enabled(void) {
+	return cache_enabled;
+}
+
+/**
+ * Gets the number of cache hits and misses so far.
+ *
+ * @return Cache usage counters.
+ */
+load_cache_stats_t load_cache_stats(void) {
+	return cache_stats;
+}
+
+/**
+ * Builds the cache key of a source file from its path, size, modification
+ * time and the hash of its contents.
+ *
+ * @param  fname    Path to the source file.
+ * @param  contents Contents of the source file.
+ * @param  len      Length of the contents.
+ * @param  key      Pointer to the key to be built.
+ * @return          TRUE if the file can be cached.
+ */
+bool load_cache_key(const TCHAR *fname, const TCHAR *contents, size_t len,
+					load_cache_key_t *key) {
+#ifdef _WIN32
+	// Cache directories aren't supported on this platform yet.
+	(void)fname;
+	(void)contents;
+	(void)len;
+	(void)key;
+
+	return false;
+#else
+	char dir[LOAD_CACHE_PATH_MAX_LEN + 1];
+	struct stat st;
+	char *spath;
+	char *rpath;
+	int n;
+
+	// Get the regular string version of the file path.
+#ifdef UNICODE
+	spath = trunc_wchar(fname);
+	if (spath == NULL)
+		return false;
+#else
+	spath = (char *)fname;
+#endif  // UNICODE
+
+	// Use the absolute path so that the same file always gets the same entry.
+	rpath = realpath(spath, NULL);
+#ifdef UNICODE
+	free(spath);
+#endif  // UNICODE
+	if (rpath == NULL)
+		return false;
+	if (strlen(rpath) > LOAD_CACHE_PATH_MAX_LEN) {
+		free(rpath);
+		return false;
+	}
+	strcpy(key->path, rpath);
+	free(rpath);
+
+	// Only regular files can be cached.
+	if ((stat(key->path, &st) != 0) || !S_ISREG(st.st_mode))
+		return false;
+	key->size = (uint64_t)st.st_size;
+	key->mtime = (int64_t)st.st_mtime;
+	key->hash = fnv1a_hash(FNV_OFFSET_BASIS, contents, len * sizeof(TCHAR));
+
+	// Name the entry after the hash of the path.
+	if (!cache_dir(dir, LOAD_CACHE_PATH_MAX_LEN + 1))
+		return false;
+	n = snprintf(key->entry, LOAD_CACHE_PATH_MAX_LEN + 1, "%s/%016llx%s",
+		dir, (unsigned long long)fnv1a_hash(FNV_OFFSET_BASIS, key->path,
+		strlen(key->path)), LOAD_CACHE_EXT);
+
+	return (n > 0) && (n <= LOAD_CACHE_PATH_MAX_LEN);
+#endif  // _WIN32
+}
+
+/**
+ * Reads the forms of a source file from its cache entry. Entries that don't
+ * match the key anymore are considered stale and ignored.
+ * WARNING: Remember to free the forms with load_cache_forms_free.
+ *
+ * @param  key   Cache key of the source file.
+ * @param  forms Pointer to the forms that will be populated.
+ * @return       TRUE if we got a cache hit.
+ */
+bool load_cache_read(const load_cache_key_t *key, load_cache_forms_t *forms) {
+	char path[LOAD_CACHE_PATH_MAX_LEN];
+	load_cache_header_t hdr;
+	struct stat st;
+	FILE *fh;
+
+	// Start from a clean slate.
+	load_cache_forms_init(forms);
+	fh = fopen(key->entry, "rb");
+	if (fh == NULL)
+		goto miss;
+
+	// Check if the entry was made from the same contents of the same file.
+	if ((fread(&hdr, sizeof(load_cache_header_t), 1, fh) != 1) ||
+			(memcmp(hdr.magic, LOAD_CACHE_MAGIC, sizeof(hdr.magic)) != 0) ||
+			(hdr.version != LOAD_CACHE_VERSION) ||
+			(hdr.tchar_size != sizeof(TCHAR)) || (hdr.size != key->size) ||
+			(hdr.mtime != key->mtime) || (hdr.hash != key->hash) ||
+			(hdr.path_len != strlen(key->path))) {
+		goto stale;
+	}
+	if ((fread(path, sizeof(char), hdr.path_len, fh) != hdr.path_len) ||
+			(memcmp(path, key->path, hdr.path_len) != 0)) {
+		goto stale;
+	}
+
+	// Make sure the entry wasn't cut short.
+	if ((fstat(fileno(fh), &st) != 0) || ((uint64_t)st.st_size !=
+			(sizeof(load_cache_header_t) + hdr.path_len + hdr.forms_len))) {
+		goto stale;
+	}
+
+	// Read the serialized forms and check that they are still intact.
+	forms->buf = (uint8_t *)malloc(hdr.forms_len + 1);
+	if (forms->buf == NULL)
+		goto stale;
+	forms->cap = hdr.forms_len + 1;
+	forms->len = hdr.forms_len;
+	if ((fread(forms->buf, sizeof(uint8_t), forms->len, fh) != forms->len) ||
+			(fnv1a_hash(FNV_OFFSET_BASIS, forms->buf, forms->len) !=
+			hdr.forms_hash)) {
+		goto stale;
+	}
+
+	fclose(fh);
+	cache_stats.hits++;
+	return true;
+
+stale:
+	fclose(fh);
+	load_cache_forms_free(forms);
+miss:
+	cache_stats.misses++;
+	return false;
+}
+
+/**
+ * Stores the forms of a source file in its cache entry. The entry is written
+ * under a temporary name first so that nobody ever reads it half-written.
+ *
+ * @param  key   Cache key of the source file.
+ * @param  forms Serialized forms of the source file.
+ * @return       TRUE if the entry was written.
+ */
+bool load_cache_write(const load_cache_key_t *key,
+					  const load_cache_forms_t *forms) {
+#ifdef _WIN32
+	(void)key;
+	(void)forms;
+
+	return false;
+#else
+	char tmp[LOAD_CACHE_PATH_MAX_LEN + 32];
+	char dir[LOAD_CACHE_PATH_MAX_LEN + 1];
+	load_cache_header_t hdr;
+	FILE *fh;
+	bool ok;
+
+	// Don't store anything we weren't able to serialize.
+	if (forms->failed)
+		return false;
+
+	// Make sure the cache directory exists.
+	if (!cache_dir(dir, LOAD_CACHE_PATH_MAX_LEN + 1) || !mkdir_parents(dir))
+		return false;
+
+	// Build the header.
+	memset(&hdr, 0, sizeof(load_cache_header_t));
+	memcpy(hdr.magic, LOAD_CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.version = LOAD_CACHE_VERSION;
+	hdr.tchar_size = sizeof(TCHAR);
+	hdr.size = key->size;
+	hdr.mtime = key->mtime;
+	hdr.hash = key->hash;
+	hdr.path_len = strlen(key->path);
+	hdr.forms_len = forms->len;
+	hdr.forms_hash = fnv1a_hash(FNV_OFFSET_BASIS, forms->buf, forms->len);
+
+	// Write the entry.
+	snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", key->entry, (long)getpid());
+	fh = fopen(tmp, "wb");
+	if (fh == NULL)
+		return false;
+	ok = (fwrite(&hdr, sizeof(load_cache_header_t), 1, fh) == 1) &&
+		(fwrite(key->path, sizeof(char), hdr.path_len, fh) == hdr.path_len) &&
+		(fwrite(forms->buf, sizeof(uint8_t), forms->len, fh) == forms->len);
+	ok = (fclose(fh) == 0) && ok;
+
+	// Put it in place of the old one.
+	if (!ok || (rename(tmp, key->entry) != 0)) {
+		remove(tmp);
+		return false;
+	}
+
+	return true;
+#endif  // _WIN32
+}
+
+/**
+ * Initializes an empty list of serialized forms.
+ *
+ * @param forms List of serialized forms.
+ */
+void load_cache_forms_init(load_cache_forms_t *forms) {
+	forms->buf = NULL;
+	forms->len = 0;
+	forms->cap = 0;
+	forms->pos = 0;
+	forms->failed = false;
+}
+
+/**
+ * Serializes a form and appends it to the list.
+ *
+ * @param  forms List of serialized forms.
+ * @param  form  Form to be appended.
+ * @return       TRUE if the form was appended.
+ */
+bool load_cache_forms_add(load_cache_forms_t *forms, atom_t form) {
+	bamboo_error_t err;
+	uint8_t *data;
+	uint32_t len;
+	size_t dlen;
+
+	// Once something goes wrong the whole list is useless.
+	if (forms->failed)
+		return false;
+
+	// Serialize the form.
+	err = bamboo_serialize(form, &data, &dlen);
+	IF_BAMBOO_ERROR(err) {
+		forms->failed = true;
+		return false;
+	}
+	if (dlen > UINT32_MAX)
+		goto fail;
+	len = (uint32_t)dlen;
+
+	// Make sure we have enough room for it.
+	if ((forms->len + sizeof(uint32_t) + dlen) > forms->cap) {
+		size_t cap = (forms->cap == 0) ? LOAD_CACHE_MIN_CAP : forms->cap;
+		uint8_t *tmp;
+
+		while (cap < (forms->len + sizeof(uint32_t) + dlen))
+			cap *= 2;
+		tmp = (uint8_t *)realloc(forms->buf, cap);
+		if (tmp == NULL)
+			goto fail;
+
+		forms->buf = tmp;
+		forms->cap = cap;
+	}
+
+	// Append its length followed by the form itself.
+	memcpy(forms->buf + forms->len, &len, sizeof(uint32_t));
+	memcpy(forms->buf + forms->len + sizeof(uint32_t), data, dlen);
+	forms->len += sizeof(uint32_t) + dlen;
+	free(data);
+
+	return true;
+
+fail:
+	free(data);
+	forms->failed = true;
+	return false;
+}
+
+/**
+ * Checks if we've gone through every form in the list.
+ *
+ * @param  forms List of serialized forms.
+ * @return       TRUE if there are no more forms to be read.
+ */
+bool load_cache_forms_done(const load_cache_forms_t *forms) {
+	return forms->pos >= forms->len;
+}
+
+/**
+ * Deserializes the next form in the list.
+ *
+ * @param  forms List of serialized forms.
+ * @param  form  Pointer to the atom that will hold the form.
+ * @return       BAMBOO_OK if the form was deserialized successfully.
+ */
+bamboo_error_t load_cache_forms_next(load_cache_forms_t *forms, atom_t *form) {
+	bamboo_error_t err;
+	uint32_t len;
+
+	// Get the length of the form.
+	if ((forms->len - forms->pos) < sizeof(uint32_t))
+		goto corrupted;
+	memcpy(&len, forms->buf + forms->pos, sizeof(uint32_t));
+	forms->pos += sizeof(uint32_t);
+	if (len > (forms->len - forms->pos))
+		goto corrupted;
+
+	// Deserialize it.
+	err = bamboo_deserialize(forms->buf + forms->pos, len, form);
+	forms->pos += len;
+
+	return err;
+
+corrupted:
+	forms->pos = forms->len;
+	return bamboo_error(BAMBOO_ERROR_SYNTAX, _T("Load cache entry is ")
+		_T("corrupted"));
+}
+
+/**
+ * Frees up a list of serialized forms.
+ *
+ * @param forms List of serialized forms.
+ */
+void load_cache_forms_free(load_cache_forms_t *forms) {
+	free(forms->buf);
+	load_cache_forms_init(forms);
+}
+
+/**
+ * Computes the 64-bit FNV-1a hash of a block of data.
+ *
+ * @param  hash Initial hash value, usually FNV_OFFSET_BASIS.
+ * @param  data Data to be hashed.
+ * @param  len  Length of the data in bytes.
+ * @return      Hash of the data.
+ */
+uint64_t fnv1a_hash(uint64_t hash, const void *data, size_t len) {
+	const uint8_t *p = (const uint8_t *)data;
+	const uint8_t *end = p + len;
+
+	while (p < end) {
+		hash ^= *p++;
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/**
+ * Gets the path of the directory where cache entries are kept. It can be set
+ * with BAMBOO_CACHE_DIR and defaults to the user's cache directory.
+ *
+ * @param  dir Buffer that will hold the path.
+ * @param  len Size of the buffer.
+ * @return     TRUE if we were able to find out where the cache lives.
+ */
+bool cache_dir(char *dir, size_t len) {
+	const char *base;
+	int n;
+
+	// Empty variables are treated as if they weren't set at all.
+	if (env_set(base = getenv("BAMBOO_CACHE_DIR"))) {
+		n = snprintf(dir, len, "%s", base);
+	} else if (env_set(base = getenv("XDG_CACHE_HOME"))) {
+		n = snprintf(dir, len, "%s/bamboo", base);
+	} else if (env_set(base = getenv("HOME"))) {
+		n = snprintf(dir, len, "%s/.cache/bamboo", base);
+	} else {
+		return false;
+	}
+
+	return (n > 0) && ((size_t)n < len);
+}
+
+/**
+ * Checks if an environment variable has been set to something.
+ *
+ * @param  value Value of the environment variable.
+ * @return       TRUE if the variable is set and isn't empty.
+ */
+bool env_set(const char *value) {
+	return (value != NULL) && (value[0] != '\0');
+}
+
+/**
+ * Creates a directory along with any of its parents that don't exist yet.
+ *
+ * @param  path Path of the directory. It's changed while we work but restored
+ *              before returning.
+ * @return      TRUE if the directory exists at the end.
+ */
+bool mkdir_parents(char *path) {
+#ifdef _WIN32
+	(void)path;
+
+	return false;
+#else
+	char *p;
+
+	// Create each one of the parents.
+	for (p = path + 1; *p != '\0'; p++) {
+		if (*p != '/')
+			continue;
+
+		*p = '\0';
+		if ((mkdir(path, 0755) != 0) && (errno != EEXIST)) {
+			*p = '/';
+			return false;
+		}
+		*p = '/';
+	}
+
+	return (mkdir(path, 0755) == 0) || (errno == EEXIST);
+#endif  // _WIN32
+}
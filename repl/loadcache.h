@@ -0,0 +1,70 @@
+/**
+ * loadcache.h
+ * Cache of pre-parsed source files that makes loading them again faster.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef REPL_LOADCACHE_H
+#define REPL_LOADCACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../src/bamboo.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Longest path that can be used as a cache key.
+#define LOAD_CACHE_PATH_MAX_LEN 4096
+
+// Identity of a source file as far as the cache is concerned.
+typedef struct {
+	char path[LOAD_CACHE_PATH_MAX_LEN + 1];
+	char entry[LOAD_CACHE_PATH_MAX_LEN + 1];
+	uint64_t size;
+	int64_t mtime;
+	uint64_t hash;
+} load_cache_key_t;
+
+// Top-level forms of a source file, each one serialized on its own.
+typedef struct {
+	uint8_t *buf;
+	size_t len;
+	size_t cap;
+	size_t pos;
+	bool failed;
+} load_cache_forms_t;
+
+// Cache usage counters.
+typedef struct {
+	size_t hits;
+	size_t misses;
+} load_cache_stats_t;
+
+// Settings and statistics.
+void load_cache_set_enabled(bool enabled);
+bool load_cache_enabled(void);
+load_cache_stats_t load_cache_stats(void);
+
+// Cache entries.
+bool load_cache_key(const TCHAR *fname, const TCHAR *contents, size_t len,
+					load_cache_key_t *key);
+bool load_cache_read(const load_cache_key_t *key, load_cache_forms_t *forms);
+bool load_cache_write(const load_cache_key_t *key,
+					  const load_cache_forms_t *forms);
+
+// Serialized forms.
+void load_cache_forms_init(load_cache_forms_t *forms);
+bool load_cache_forms_add(load_cache_forms_t *forms, atom_t form);
+bool load_cache_forms_done(const load_cache_forms_t *forms);
+bamboo_error_t load_cache_forms_next(load_cache_forms_t *forms, atom_t *form);
+void load_cache_forms_free(load_cache_forms_t *forms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // REPL_LOADCACHE_H
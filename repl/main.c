@@ -40,14 +40,27 @@
 #include "../src/bamboo.h"
 #include "input.h"
 #include "functions.h"
-
-// Private definitions.
-#define REPL_INPUT_MAX_LEN 512
+#include "loadcache.h"
+#include "server.h"
+
+// Options that only have a long form.
+enum {
+	OPT_NO_CACHE = 0x100,
+	OPT_SERVER,
+	OPT_CONNECT
+};
+
+// Context shared with the callback while evaluating the user's input.
+typedef struct {
+	atom_t result;
+	bool evaluated;
+	bool eval_failed;
+} repl_ctx_t;
 
 // Private variables.
 static env_t repl_env;
-static TCHAR repl_input[REPL_INPUT_MAX_LEN + 1];
 static bool env_initialized;
+static bool server_worker;
 
 // Private methods.
 void enable_unicode(void);
@@ -56,8 +69,12 @@ void parse_args(int argc, TCHAR **argv);
 bamboo_error_t init_env(void);
 bamboo_error_t destroy_env(void);
 void repl(void);
-void load_include(const TCHAR *fname, bool terminate);
+bamboo_error_t repl_eval_form(atom_t form, void *arg);
+void load_include(const TCHAR *fname, bool lazy, bool terminate);
+void load_image(const TCHAR *fname);
 void run_source(const TCHAR *fname);
+void start_server(const TCHAR *path);
+void serve_client(int argc, TCHAR **argv);
 void cleanup(void);
 
 /**
@@ -72,6 +89,7 @@ int _tmain(int argc, TCHAR *argv[]) {
 
 	// Setup some flags.
 	env_initialized = false;
+	server_worker = false;
 
 	// Make sure we clean things up.
 	atexit(cleanup);
@@ -138,8 +156,13 @@ bamboo_error_t destroy_env(void) {
  * Performs some basic cleanup before the program exits.
  */
 void cleanup(void) {
+	// Workers share the server's environment, so let it go with the process.
+	if (server_worker)
+		return;
+
 	repl_destroy();
 	destroy_env();
+	load_lazy_free();
 }
 
 /**
@@ -147,84 +170,119 @@ void cleanup(void) {
  */
 void repl(void) {
 	bamboo_error_t err;
+	bamboo_parser_t *parser;
+	repl_ctx_t ctx;
+	TCHAR *line;
 	int retval = 0;
 
 	// Initialize the REPL.
-	err = BAMBOO_OK;
 	repl_init();
+	err = bamboo_parser_new(&parser);
+	IF_BAMBOO_ERROR(err) {
+		bamboo_print_error(err);
+		goto quit;
+	}
 
-	// Start the REPL loop.
-	while (!repl_readline(repl_input, REPL_INPUT_MAX_LEN)) {
-		atom_t parsed;
-		atom_t result;
-		const TCHAR *end = repl_input;
-
-		// Check if all we've got was an empty line.
-		if (*repl_input == _T('\0'))
-			continue;
-
-		// Check if we've parsed all of the statements in the expression.
-		while (*end != _T('\0')) {
-#ifdef DEBUG
-			// Check out our tokens.
-			bamboo_print_tokens(end);
-			_tprintf(LINEBREAK);
-#endif  // DEBUG
-
-			// Parse the user's input.
-			err = bamboo_parse_expr(end, &end, &parsed);
-			IF_BAMBOO_ERROR(err) {
-				uint8_t spaces;
+	// Start the REPL loop. Expressions are evaluated as soon as they are
+	// complete, and unfinished ones carry on into the following lines.
+	while ((line = repl_readline(bamboo_parser_pending(parser))) != NULL) {
+		const TCHAR *end = line;
+
+		// Parse and evaluate the user's input.
+		ctx.evaluated = false;
+		ctx.eval_failed = false;
+		err = bamboo_parser_feed(parser, line, &end, repl_eval_form, &ctx);
+		IF_BAMBOO_ERROR(err) {
+			size_t spaces;
+
+			// Check if we just got a quit situation.
+			if (err == (bamboo_error_t)BAMBOO_REPL_QUIT) {
+				retval = (int)ctx.result.value.integer;
+				err = BAMBOO_OK;
+				free(line);
+
+				goto quit;
+			}
 
-				// Show where the user was wrong.
-				_tprintf(_T("%s %s"), repl_input, LINEBREAK);
-				for (spaces = 0; spaces < (end - repl_input); spaces++)
+			// Show where the user was wrong.
+			if (!ctx.eval_failed) {
+				_tprintf(SPEC_STR, line);
+				for (spaces = 0; spaces < (size_t)(end - line); spaces++)
 					_puttchar(_T(' '));
 				_tprintf(_T("^ "));
-
-				// Show the error message.
-				bamboo_print_error(err);
-				goto next;
 			}
 
-			// Evaluate the parsed expression.
-			err = bamboo_eval_expr(parsed, repl_env, &result);
-			IF_BAMBOO_ERROR(err) {
-				// Check if we just got a quit situation.
-				if (err == (bamboo_error_t)BAMBOO_REPL_QUIT) {
-					retval = (int)result.value.integer;
-					err = BAMBOO_OK;
-
-					goto quit;
-				}
-
-				// Explain the real issue then...
-				bamboo_print_error(err);
-				goto next;
-			}
+			// Show the error message.
+			bamboo_print_error(err);
+			goto next;
 		}
 
-		// Print the evaluated result.
-		bamboo_print_expr(result);
-		_tprintf(LINEBREAK);
+		// Print the result of the last evaluated expression.
+		if (ctx.evaluated) {
+			bamboo_print_expr(ctx.result);
+			_tprintf(LINEBREAK);
+		}
 next:
-		;
+		free(line);
+	}
+
+	// Complain about anything left unfinished when the input ended.
+	ctx.eval_failed = false;
+	err = bamboo_parser_finish(parser, repl_eval_form, &ctx);
+	IF_BAMBOO_ERROR(err) {
+		if (err == (bamboo_error_t)BAMBOO_REPL_QUIT) {
+			retval = (int)ctx.result.value.integer;
+			err = BAMBOO_OK;
+		} else {
+			bamboo_print_error(err);
+			err = BAMBOO_OK;
+		}
 	}
 
 quit:
 	// Return the correct code.
+	bamboo_parser_free(parser);
 	IF_BAMBOO_ERROR(err)
 		exit((int)err);
 	exit(retval);
 }
 
+/**
+ * Evaluates a form typed by the user as soon as it is complete.
+ *
+ * @param  form Parsed form.
+ * @param  arg  REPL context.
+ * @return      BAMBOO_OK if the form was evaluated successfully.
+ */
+bamboo_error_t repl_eval_form(atom_t form, void *arg) {
+	repl_ctx_t *ctx = (repl_ctx_t *)arg;
+	bamboo_error_t err;
+
+#ifdef DEBUG
+	// Check out what we've parsed.
+	bamboo_print_expr(form);
+	_tprintf(LINEBREAK);
+#endif  // DEBUG
+
+	// Evaluate the parsed expression.
+	err = bamboo_eval_expr(form, repl_env, &ctx->result);
+	IF_BAMBOO_ERROR(err) {
+		ctx->eval_failed = true;
+		return err;
+	}
+
+	ctx->evaluated = true;
+	return BAMBOO_OK;
+}
+
 /**
  * Loads a source file into the current environment.
  *
  * @param fname     Path to the source file to be loaded.
+ * @param lazy      Only load the definitions of the file once they are used?
  * @param terminate Terminate the program after loading the source file?
  */
-void load_include(const TCHAR *fname, bool terminate) {
+void load_include(const TCHAR *fname, bool lazy, bool terminate) {
 	bamboo_error_t err;
 	atom_t result;
 	int retval = 0;
@@ -237,7 +295,7 @@ void load_include(const TCHAR *fname, bool terminate) {
 	}
 
 	// Load the file.
-	err = load_source(&repl_env, fname, &result);
+	err = load_source(&repl_env, fname, lazy, &result);
 	IF_BAMBOO_ERROR(err) {
 		// Check if we just got a quit situation.
 		if (err == (bamboo_error_t)BAMBOO_REPL_QUIT) {
@@ -268,13 +326,73 @@ quit:
 	exit(retval);
 }
 
+/**
+ * Replaces the current environment with the one saved in a heap image.
+ *
+ * @param fname Path to the image file to be loaded.
+ */
+void load_image(const TCHAR *fname) {
+	bamboo_error_t err;
+
+	// Initialize the Lisp environment.
+	if (!env_initialized) {
+		err = init_env();
+		IF_BAMBOO_ERROR(err)
+			exit((int)err);
+	}
+
+	// Load the image.
+	err = bamboo_image_load(&repl_env, fname);
+	IF_BAMBOO_ERROR(err) {
+		bamboo_print_error(err);
+		_ftprintf(stderr, LINEBREAK);
+		exit((int)err);
+	}
+}
+
 /**
  * Runs a source file and quits the application after its finished.
  *
  * @param fname Path to the source file to be executed.
  */
 void run_source(const TCHAR *fname) {
-	load_include(fname, true);
+	load_include(fname, false, true);
+}
+
+/**
+ * Serves requests from clients in copies of the current environment. Only
+ * returns if the server couldn't be started.
+ *
+ * @param path Path of the socket to listen on.
+ */
+void start_server(const TCHAR *path) {
+	bamboo_error_t err;
+
+	// Initialize the Lisp environment.
+	if (!env_initialized) {
+		err = init_env();
+		IF_BAMBOO_ERROR(err)
+			exit((int)err);
+	}
+
+	// Start serving.
+	if (!server_listen(path, serve_client))
+		exit(EXIT_FAILURE);
+}
+
+/**
+ * Handles the arguments sent by a client inside of a forked worker, exactly
+ * as if they had been given to a fresh instance of the program.
+ *
+ * @param argc Number of arguments sent by the client.
+ * @param argv Arguments sent by the client.
+ */
+void serve_client(int argc, TCHAR **argv) {
+	server_worker = true;
+
+	// Run the client's arguments and drop into the REPL if they haven't quit.
+	parse_args(argc, argv);
+	repl();
 }
 
 /**
@@ -285,9 +403,16 @@ void run_source(const TCHAR *fname) {
  * @return      0 if everything went fine.
  */
 void parse_args(int argc, TCHAR **argv) {
+	static const struct option long_opts[] = {
+		{ _T("no-cache"), no_argument, NULL, OPT_NO_CACHE },
+		{ _T("server"), required_argument, NULL, OPT_SERVER },
+		{ _T("connect"), required_argument, NULL, OPT_CONNECT },
+		{ NULL, 0, NULL, 0 }
+	};
 	int opt;
 
-	while ((opt = getopt(argc, argv, _T("-:r:l:h"))) != -1) {
+	while ((opt = getopt_long(argc, argv, _T("-:r:l:L:i:h"), long_opts,
+			NULL)) != -1) {
 		switch (opt) {
 		case _T('r'):
 		case 1:
@@ -296,7 +421,27 @@ void parse_args(int argc, TCHAR **argv) {
 			break;
 		case _T('l'):
 			// Load a script into the current environment.
-			load_include(optarg, false);
+			load_include(optarg, false, false);
+			break;
+		case _T('L'):
+			// Load the definitions of a library as they are needed.
+			load_include(optarg, true, false);
+			break;
+		case _T('i'):
+			// Start from a heap image.
+			load_image(optarg);
+			break;
+		case OPT_NO_CACHE:
+			// Always parse source files.
+			load_cache_set_enabled(false);
+			break;
+		case OPT_SERVER:
+			// Serve requests with everything we've loaded so far.
+			start_server(optarg);
+			break;
+		case OPT_CONNECT:
+			// Let a server deal with the rest of the arguments.
+			exit(server_connect(optarg, argv[0], argc - optind, argv + optind));
 			break;
 		case _T('h'):
 			// Help
@@ -323,14 +468,27 @@ void parse_args(int argc, TCHAR **argv) {
  * @param retval Return value to be used when exiting.
  */
 void usage(const TCHAR *pname, int retval) {
-	_tprintf(_T("Usage: ") SPEC_STR _T(" [[-rl] source]") LINEBREAK LINEBREAK,
-		pname);
+	_tprintf(_T("Usage: ") SPEC_STR _T(" [--no-cache] [-i image] [[-rlL] source]")
+		LINEBREAK _T("       ") SPEC_STR _T(" [options] --server socket")
+		LINEBREAK _T("       ") SPEC_STR _T(" --connect socket [options]")
+		LINEBREAK LINEBREAK, pname, pname, pname);
 
 	_tprintf(_T("Options:") LINEBREAK);
 	_tprintf(_T("    -r <source>  Runs the source file and quits.")
 		LINEBREAK);
 	_tprintf(_T("    -l <source>  Loads the source file before the REPL.")
 		LINEBREAK);
+	_tprintf(_T("    -L <source>  Loads the definitions in the source file as ")
+		_T("they are used.") LINEBREAK);
+	_tprintf(_T("    -i <image>   Starts from a heap image saved with ")
+		_T("save-image.") LINEBREAK);
+	_tprintf(_T("    --no-cache   Parses source files without using the load ")
+		_T("cache.") LINEBREAK);
+	_tprintf(_T("    --server <socket>   Serves requests on the socket from ")
+		_T("copies of the") LINEBREAK _T("                        environment ")
+		_T("set up by the preceding options.") LINEBREAK);
+	_tprintf(_T("    --connect <socket>  Runs the remaining options in a ")
+		_T("server.") LINEBREAK);
 	_tprintf(_T("    -h           Displays this message.")
 		LINEBREAK);
 
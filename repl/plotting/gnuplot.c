@@ -139,6 +139,26 @@ void plot_data_l(plot_t *plt, size_t len, long double x[], long double y[]) {
 	plt->pcount++;
 }
 
+void plot_data_d(plot_t *plt, size_t len, const double x[], const double y[]) {
+	size_t i;
+
+	// Build the plot/replot command.
+	gnuplot_cmd(plt, SPEC_STR _T(" '-' using 1:2 title \"") SPEC_STR
+		_T("\" with ") SPEC_STR,
+		(plt->pcount == 0) ? _T("plot") : _T("replot"), plt->sname, plt->pstyle);
+
+	// Send data points.
+	for (i = 0; i < len; i++) {
+		gnuplot_cmd(plt, _T("%.17g %.17g"), x[i], y[i]);
+	}
+
+	// Finish data points list.
+	gnuplot_cmd(plt, _T("e"));
+
+	// Increment the plot count.
+	plt->pcount++;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
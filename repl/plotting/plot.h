@@ -115,6 +115,16 @@ void plot_equation(plot_t *plt, const TCHAR *equation);
  */
 void plot_data_l(plot_t *plt, size_t len, long double x[], long double y[]);
 
+/**
+ * Plots a series of data points stored as double-precision arrays.
+ *
+ * @param plt Plotting handle.
+ * @param len Length of the arrays of values.
+ * @param x   Array of X values.
+ * @param y   Array of Y values.
+ */
+void plot_data_d(plot_t *plt, size_t len, const double x[], const double y[]);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,631 @@
+/**
+ * server.c
+ * Fork server that runs scripts in copies of an already initialized REPL.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+// Peer credentials are a GNU extension on Linux.
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+	#define _GNU_SOURCE
+#endif  // __linux__ && !_GNU_SOURCE
+
+#include "server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#ifndef _WIN32
+	#include <unistd.h>
+	#include <getopt.h>
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <signal.h>
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/wait.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+#endif  // _WIN32
+
+// Private definitions.
+#define SERVER_MAGIC 0x42535256UL
+#define SERVER_BACKLOG 64
+#define SERVER_MAX_REQUEST (1024 * 1024)
+#define SERVER_NUM_FDS 3
+
+#ifndef _WIN32
+// Header of a request. It carries the client's standard streams and is
+// followed by its working directory and arguments, all NUL-terminated.
+typedef struct {
+	uint32_t magic;
+	uint32_t len;
+} server_request_t;
+
+// Worker that is still running the request of a client.
+typedef struct server_worker_s server_worker_t;
+struct server_worker_s {
+	pid_t pid;
+	int conn;
+	server_worker_t *next;
+};
+
+// Private variables.
+static int sigchld_pipe[2] = { -1, -1 };
+static server_worker_t *workers = NULL;
+
+// Private methods.
+void server_sigchld(int signum);
+bool server_socket_addr(const char *path, struct sockaddr_un *addr);
+bool server_peer_trusted(int conn);
+bool server_write_all(int fd, const void *buf, size_t len);
+bool server_read_all(int fd, void *buf, size_t len);
+void server_reap(void);
+void server_worker(int conn, int sock, server_handler_t handler);
+#endif  // _WIN32
+
+/**
+ * Listens for clients on a Unix domain socket and runs each of their requests
+ * in a forked copy of the current process. This allows everything that was
+ * loaded before calling this function to be shared by every request.
+ *
+ * @param  path    Path of the socket to listen on.
+ * @param  handler Function that will handle the client's arguments inside of
+ *                 the worker process. It should never return.
+ * @return         FALSE if the server couldn't be started. It doesn't return
+ *                 otherwise.
+ */
+bool server_listen(const TCHAR *path, server_handler_t handler) {
+#ifdef _WIN32
+	(void)path;
+	(void)handler;
+
+	_ftprintf(stderr, _T("Server mode isn't supported on this platform")
+		LINEBREAK);
+	return false;
+#else
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	struct pollfd fds[2];
+	struct stat st;
+	mode_t mask;
+	int sock;
+	int conn;
+
+	// Build the address of the socket.
+	if (!server_socket_addr(path, &addr))
+		return false;
+
+	// Get rid of any stale socket left behind by a previous server, but never
+	// of anything that might belong to someone else.
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode) || (st.st_uid != geteuid())) {
+			fprintf(stderr, "Refusing to replace %s since it isn't a socket "
+				"owned by us\n", path);
+			return false;
+		}
+
+		unlink(path);
+	}
+
+	// Start listening on a socket that only we can connect to, since anyone
+	// who can is able to run code as us.
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		perror("Can't create server socket");
+		return false;
+	}
+	mask = umask(S_IRWXG | S_IRWXO | S_IXUSR);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		perror("Can't bind server socket");
+		umask(mask);
+		close(sock);
+		return false;
+	}
+	umask(mask);
+	if ((chmod(path, S_IRUSR | S_IWUSR) != 0) ||
+			(listen(sock, SERVER_BACKLOG) != 0)) {
+		perror("Can't listen on server socket");
+		close(sock);
+		unlink(path);
+		return false;
+	}
+	fcntl(sock, F_SETFD, FD_CLOEXEC);
+
+	// Get notified when workers finish without blocking the accept loop.
+	if (pipe(sigchld_pipe) != 0) {
+		perror("Can't create server pipe");
+		close(sock);
+		return false;
+	}
+	fcntl(sigchld_pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(sigchld_pipe[1], F_SETFL, O_NONBLOCK);
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = server_sigchld;
+	sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGCHLD, &sa, NULL);
+
+	// Clients that go away shouldn't take the server down with them.
+	signal(SIGPIPE, SIG_IGN);
+
+	// Serve requests forever.
+	fds[0].fd = sock;
+	fds[0].events = POLLIN;
+	fds[1].fd = sigchld_pipe[0];
+	fds[1].events = POLLIN;
+	for (;;) {
+		server_worker_t *worker;
+		pid_t pid;
+
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("Can't wait for clients");
+			return false;
+		}
+
+		// Tell the clients of finished workers how they went.
+		if (fds[1].revents & POLLIN)
+			server_reap();
+
+		// Check if we've got a new client.
+		if (!(fds[0].revents & POLLIN))
+			continue;
+		conn = accept(sock, NULL, NULL);
+		if (conn < 0)
+			continue;
+
+		// Only serve processes running as the same user as us.
+		if (!server_peer_trusted(conn)) {
+			fprintf(stderr, "Refused a client running as another user\n");
+			close(conn);
+			continue;
+		}
+
+		// Keep track of the client so that we can report back to it.
+		worker = (server_worker_t *)malloc(sizeof(server_worker_t));
+		if (worker == NULL) {
+			close(conn);
+			continue;
+		}
+
+		// Make sure nothing buffered gets duplicated in the worker.
+		fflush(NULL);
+
+		// Fork a worker to handle the request.
+		pid = fork();
+		if (pid == 0) {
+			free(worker);
+			server_worker(conn, sock, handler);
+		} else if (pid < 0) {
+			perror("Can't fork worker");
+			free(worker);
+			close(conn);
+			continue;
+		}
+
+		worker->pid = pid;
+		worker->conn = conn;
+		worker->next = workers;
+		workers = worker;
+	}
+#endif  // _WIN32
+}
+
+/**
+ * Asks a server to run a request with our arguments and standard streams and
+ * waits for it to finish.
+ *
+ * @param  path  Path of the server's socket.
+ * @param  pname Program name to be passed as the first argument.
+ * @param  argc  Number of arguments to be forwarded.
+ * @param  argv  Arguments to be forwarded.
+ * @return       Exit code of the request.
+ */
+int server_connect(const TCHAR *path, const TCHAR *pname, int argc,
+				   TCHAR **argv) {
+#ifdef _WIN32
+	(void)path;
+	(void)pname;
+	(void)argc;
+	(void)argv;
+
+	_ftprintf(stderr, _T("Server mode isn't supported on this platform")
+		LINEBREAK);
+	return EXIT_FAILURE;
+#else
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int) * SERVER_NUM_FDS)];
+	} control;
+	struct sockaddr_un addr;
+	server_request_t req;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	char *payload;
+	char *cwd;
+	size_t len;
+	int32_t code;
+	int fds[SERVER_NUM_FDS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+	int sock;
+	int i;
+
+	// Connect to the server.
+	if (!server_socket_addr(path, &addr))
+		return EXIT_FAILURE;
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		perror("Can't create client socket");
+		return EXIT_FAILURE;
+	}
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		perror("Can't connect to server");
+		close(sock);
+		return EXIT_FAILURE;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	// Build the request.
+	cwd = getcwd(NULL, 0);
+	if (cwd == NULL) {
+		perror("Can't get the working directory");
+		close(sock);
+		return EXIT_FAILURE;
+	}
+	len = strlen(cwd) + strlen(pname) + 2;
+	for (i = 0; i < argc; i++)
+		len += strlen(argv[i]) + 1;
+	if (len > SERVER_MAX_REQUEST) {
+		fprintf(stderr, "Too many arguments to forward to the server\n");
+		free(cwd);
+		close(sock);
+		return EXIT_FAILURE;
+	}
+	payload = (char *)malloc(len);
+	if (payload == NULL) {
+		free(cwd);
+		close(sock);
+		return EXIT_FAILURE;
+	}
+	len = 0;
+	strcpy(payload + len, cwd);
+	len += strlen(cwd) + 1;
+	strcpy(payload + len, pname);
+	len += strlen(pname) + 1;
+	for (i = 0; i < argc; i++) {
+		strcpy(payload + len, argv[i]);
+		len += strlen(argv[i]) + 1;
+	}
+	free(cwd);
+
+	// Send the header along with our standard streams.
+	req.magic = SERVER_MAGIC;
+	req.len = (uint32_t)len;
+	iov.iov_base = &req;
+	iov.iov_len = sizeof(req);
+	memset(&msg, 0, sizeof(msg));
+	memset(&control, 0, sizeof(control));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	while (sendmsg(sock, &msg, 0) < 0) {
+		if (errno == EINTR)
+			continue;
+
+		perror("Can't send request to server");
+		free(payload);
+		close(sock);
+		return EXIT_FAILURE;
+	}
+
+	// Send the rest of the request.
+	if (!server_write_all(sock, payload, len)) {
+		perror("Can't send request to server");
+		free(payload);
+		close(sock);
+		return EXIT_FAILURE;
+	}
+	free(payload);
+
+	// Wait for the request to finish.
+	if (!server_read_all(sock, &code, sizeof(code))) {
+		fprintf(stderr, "Server closed the connection unexpectedly\n");
+		close(sock);
+		return EXIT_FAILURE;
+	}
+	close(sock);
+
+	return (int)code;
+#endif  // _WIN32
+}
+
+#ifndef _WIN32
+/**
+ * Lets the accept loop know that a worker has finished.
+ *
+ * @param signum Signal number.
+ */
+void server_sigchld(int signum) {
+	int saved = errno;
+	char c = 0;
+
+	(void)signum;
+	if (write(sigchld_pipe[1], &c, 1) < 0) {
+		// The pipe is already full, so the loop will get to it anyway.
+	}
+	errno = saved;
+}
+
+/**
+ * Builds the address of a Unix domain socket.
+ *
+ * @param  path Path of the socket.
+ * @param  addr Address to be populated.
+ * @return      TRUE if the path fits in the address.
+ */
+bool server_socket_addr(const char *path, struct sockaddr_un *addr) {
+	memset(addr, 0, sizeof(struct sockaddr_un));
+	addr->sun_family = AF_UNIX;
+
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		fprintf(stderr, "Socket path is too long: %s\n", path);
+		return false;
+	}
+	strcpy(addr->sun_path, path);
+
+	return true;
+}
+
+/**
+ * Checks if the process on the other end of a connection runs as our user.
+ *
+ * @param  conn Connection to the client.
+ * @return      TRUE if the client can be trusted with our privileges.
+ */
+bool server_peer_trusted(int conn) {
+#ifdef SO_PEERCRED
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return false;
+
+	return cred.uid == geteuid();
+#else
+	uid_t uid;
+	gid_t gid;
+
+	if (getpeereid(conn, &uid, &gid) != 0)
+		return false;
+
+	return uid == geteuid();
+#endif  // SO_PEERCRED
+}
+
+/**
+ * Writes an entire buffer to a file descriptor.
+ *
+ * @param  fd  File descriptor to write to.
+ * @param  buf Data to be written.
+ * @param  len Length of the data.
+ * @return     TRUE if everything was written.
+ */
+bool server_write_all(int fd, const void *buf, size_t len) {
+	const char *p = (const char *)buf;
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		p += n;
+		len -= (size_t)n;
+	}
+
+	return true;
+}
+
+/**
+ * Reads an exact number of bytes from a file descriptor.
+ *
+ * @param  fd  File descriptor to read from.
+ * @param  buf Buffer to read into.
+ * @param  len Number of bytes to read.
+ * @return     TRUE if everything was read.
+ */
+bool server_read_all(int fd, void *buf, size_t len) {
+	char *p = (char *)buf;
+	ssize_t n;
+
+	while (len > 0) {
+		n = read(fd, p, len);
+		if (n <= 0) {
+			if ((n < 0) && (errno == EINTR))
+				continue;
+
+			return false;
+		}
+
+		p += n;
+		len -= (size_t)n;
+	}
+
+	return true;
+}
+
+/**
+ * Collects finished workers and sends their exit codes back to the clients.
+ */
+void server_reap(void) {
+	server_worker_t **prev;
+	server_worker_t *worker;
+	int32_t code;
+	char buf[64];
+	int status;
+	pid_t pid;
+
+	// Empty the notification pipe.
+	while (read(sigchld_pipe[0], buf, sizeof(buf)) > 0)
+		;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		// Follow the shell's convention for workers killed by a signal.
+		if (WIFEXITED(status)) {
+			code = WEXITSTATUS(status);
+		} else if (WIFSIGNALED(status)) {
+			code = 128 + WTERMSIG(status);
+		} else {
+			continue;
+		}
+
+		// Find the worker's client.
+		for (prev = &workers; *prev != NULL; prev = &(*prev)->next) {
+			if ((*prev)->pid == pid)
+				break;
+		}
+		if (*prev == NULL)
+			continue;
+
+		// Report back and forget about it.
+		worker = *prev;
+		*prev = worker->next;
+		server_write_all(worker->conn, &code, sizeof(code));
+		close(worker->conn);
+		free(worker);
+	}
+}
+
+/**
+ * Handles a client's request inside of a freshly forked worker.
+ *
+ * @param conn    Connection to the client.
+ * @param sock    Socket the server listens on.
+ * @param handler Function that will handle the client's arguments.
+ */
+void server_worker(int conn, int sock, server_handler_t handler) {
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int) * SERVER_NUM_FDS)];
+	} control;
+	server_worker_t *worker;
+	server_request_t req;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	char **argv;
+	char *payload;
+	char *p;
+	ssize_t n;
+	int fds[SERVER_NUM_FDS];
+	int argc;
+	int i;
+
+	// We don't need anything that belongs to the server.
+	close(sock);
+	close(sigchld_pipe[0]);
+	close(sigchld_pipe[1]);
+	while (workers != NULL) {
+		worker = workers;
+		workers = worker->next;
+		close(worker->conn);
+		free(worker);
+	}
+	signal(SIGCHLD, SIG_DFL);
+	signal(SIGPIPE, SIG_DFL);
+
+	// Receive the request header along with the client's standard streams.
+	iov.iov_base = &req;
+	iov.iov_len = sizeof(req);
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	while ((n = recvmsg(conn, &msg, 0)) < 0) {
+		if (errno != EINTR)
+			_exit(EXIT_FAILURE);
+	}
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if ((cmsg == NULL) || (cmsg->cmsg_level != SOL_SOCKET) ||
+			(cmsg->cmsg_type != SCM_RIGHTS) ||
+			(cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))) {
+		_exit(EXIT_FAILURE);
+	}
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+	// Make the client's streams our own.
+	for (i = 0; i < SERVER_NUM_FDS; i++) {
+		if (dup2(fds[i], i) < 0)
+			_exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < SERVER_NUM_FDS; i++) {
+		if (fds[i] >= SERVER_NUM_FDS)
+			close(fds[i]);
+	}
+
+	// Check the header and get the rest of the request.
+	if ((n == 0) || !server_read_all(conn, (char *)&req + n,
+			sizeof(req) - (size_t)n) || (req.magic != SERVER_MAGIC) ||
+			(req.len == 0) || (req.len > SERVER_MAX_REQUEST)) {
+		fprintf(stderr, "Invalid request sent to server\n");
+		_exit(EXIT_FAILURE);
+	}
+	payload = (char *)malloc(req.len);
+	if ((payload == NULL) || !server_read_all(conn, payload, req.len) ||
+			(payload[req.len - 1] != '\0')) {
+		fprintf(stderr, "Invalid request sent to server\n");
+		_exit(EXIT_FAILURE);
+	}
+	close(conn);
+
+	// Split the arguments.
+	argc = -1;
+	for (p = payload; p < (payload + req.len); p += strlen(p) + 1)
+		argc++;
+	if (argc < 1) {
+		fprintf(stderr, "Invalid request sent to server\n");
+		_exit(EXIT_FAILURE);
+	}
+	argv = (char **)malloc(sizeof(char *) * (argc + 1));
+	if (argv == NULL)
+		_exit(EXIT_FAILURE);
+	p = payload + strlen(payload) + 1;
+	for (i = 0; i < argc; i++) {
+		argv[i] = p;
+		p += strlen(p) + 1;
+	}
+	argv[argc] = NULL;
+
+	// Run relative to where the client is.
+	if (chdir(payload) != 0) {
+		perror("Can't change to the client's working directory");
+		exit(EXIT_FAILURE);
+	}
+
+	// Make sure getopt starts over with the client's arguments.
+#ifdef __GLIBC__
+	optind = 0;
+#else
+	optind = 1;
+	optreset = 1;
+#endif  // __GLIBC__
+
+	handler(argc, argv);
+	exit(EXIT_SUCCESS);
+}
+#endif  // _WIN32
@@ -0,0 +1,30 @@
+/**
+ * server.h
+ * Fork server that runs scripts in copies of an already initialized REPL.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef REPL_SERVER_H
+#define REPL_SERVER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../src/bamboo.h"
+#include <stdbool.h>
+
+// Handles the arguments of a client inside of a freshly forked worker.
+typedef void (*server_handler_t)(int argc, TCHAR **argv);
+
+// Server and client.
+bool server_listen(const TCHAR *path, server_handler_t handler);
+int server_connect(const TCHAR *path, const TCHAR *pname, int argc,
+				   TCHAR **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // REPL_SERVER_H
@@ -23,23 +23,54 @@
 using namespace Bamboo;
 
 /**
- * Initializes a brand new interpreter environment.
+ * Initializes a brand new interpreter environment in its own context, which
+ * becomes the current one of the calling thread.
  */
-Lisp::Lisp() {
+Lisp::Lisp() : m_ctx(create_context()) {
 	bamboo_error_t err = bamboo_init(&m_env.env());
 	IF_BAMBOO_ERROR(err)
 		throw BambooException(err);
 }
 
 /**
- * Destroys the interpreter environment.
+ * Destroys the interpreter environment along with its context.
  */
 Lisp::~Lisp() {
-	bamboo_error_t err = bamboo_destroy(&m_env.env());
+	bamboo_error_t err;
+
+	activate();
+	err = bamboo_destroy(&m_env.env());
+	bamboo_ctx_free(m_ctx);
 	IF_BAMBOO_ERROR(err)
 		throw BambooException(err);
 }
 
+/**
+ * Creates a new interpreter context and makes it the current one of the
+ * calling thread.
+ *
+ * @return Newly created context.
+ */
+bamboo_ctx_t* Lisp::create_context() {
+	bamboo_ctx_t *ctx;
+	bamboo_error_t err;
+
+	err = bamboo_ctx_new(&ctx);
+	IF_BAMBOO_ERROR(err)
+		throw BambooException(err);
+	bamboo_ctx_switch(ctx);
+
+	return ctx;
+}
+
+/**
+ * Makes this interpreter the current one of the calling thread. Each instance
+ * can run on its own thread, but only on one thread at a time.
+ */
+void Lisp::activate() {
+	bamboo_ctx_switch(m_ctx);
+}
+
 /**
  * Parses an expression into an atom. Throws an exception if the input could
  * not be parsed.
@@ -54,6 +85,7 @@ atom_t Lisp::parse_expr(const TCHAR *input, const TCHAR **end) {
 	bamboo_error_t err;
 
 	// Parse the expression.
+	activate();
 	err = bamboo_parse_expr(input, end, &atom);
 	IF_BAMBOO_ERROR(err)
 		throw BambooException(err);
@@ -73,6 +105,7 @@ atom_t Lisp::eval_expr(atom_t expr) {
 	bamboo_error_t err;
 
 	// Evaluate the expression.
+	activate();
 	err = bamboo_eval_expr(expr, m_env.env(), &result);
 	IF_BAMBOO_ERROR(err)
 		throw BambooException(err);
@@ -103,6 +136,8 @@ atom_t Lisp::parse_expr(const TCHAR *input) {
  */
 TCHAR* Lisp::expr_str(atom_t atom) {
 	TCHAR *buf;
+
+	activate();
 	bamboo_expr_str(&buf, atom);
 
 	return buf;
@@ -114,6 +149,7 @@ TCHAR* Lisp::expr_str(atom_t atom) {
  * @return Reference to our current environment.
  */
 Environment& Lisp::env() {
+	activate();
 	return m_env;
 }
 
@@ -74,12 +74,18 @@ namespace Bamboo {
 	 */
 	class Lisp {
 	protected:
+		bamboo_ctx_t *m_ctx;
 		Environment m_env;
 
+		static bamboo_ctx_t* create_context();
+
 	public:
 		Lisp();
 		virtual ~Lisp();
 
+		// Context.
+		void activate();
+
 		// Parsing and evaluation.
 		atom_t parse_expr(const TCHAR *input);
 		atom_t parse_expr(const TCHAR *input, const TCHAR **end);
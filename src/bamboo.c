@@ -20,22 +20,164 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+// SIMD kernels are only available on x86 with GCC-compatible compilers, since
+// we rely on per-function target attributes to select them at runtime.
+#if (defined(__GNUC__) || defined(__clang__)) && \
+		(defined(__x86_64__) || defined(__i386__))
+	#define USE_SIMD_X86
+	#include <immintrin.h>
+#endif  // __GNUC__ && __x86_64__
+
+// Threads get their own current context, and the shared tables are built only
+// once per process.
+#if !defined(_WIN32) && !defined(BAMBOO_NO_THREADS)
+	#define USE_PTHREADS
+	#include <pthread.h>
+	#include <unistd.h>
+#endif  // !_WIN32 && !BAMBOO_NO_THREADS
+#if defined(BAMBOO_NO_THREADS) || defined(_WIN32_WCE)
+	#define THREAD_LOCAL
+#elif defined(_MSC_VER) || defined(__WATCOMC__)
+	#define THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+	#define THREAD_LOCAL __thread
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
+	#define THREAD_LOCAL _Thread_local
+#else
+	#define THREAD_LOCAL
+#endif  // BAMBOO_NO_THREADS
+
+// Wall clock used to enforce evaluation deadlines.
+#ifndef _WIN32
+	#include <time.h>
+#endif  // !_WIN32
+
+// Number of evaluation steps taken between checks of an evaluation deadline.
+#ifndef EVAL_DEADLINE_STEPS
+	#define EVAL_DEADLINE_STEPS 1024
+#endif  // EVAL_DEADLINE_STEPS
+
 // Convinience macros.
 #define IF_ERROR(err)        IF_BAMBOO_ERROR(err)
 #define IF_SPECIAL_COND(err) IF_BAMBOO_SPECIAL_COND(err)
 #define IF_NOT_ERROR(err)    if ((err) <= BAMBOO_OK)
 
-// Make Visual C++ 6.0 not complain about passing NULL to _sntprintf.
-#if defined(_MSC_VER) && (_MSC_VER <= 1400)
-	#define I64_MAX_DIGITS        128
-	#define LONGDOUBLE_MAX_DIGITS 128
-#endif
+// Checks if a symbol atom is a given special form by comparing pointers.
+#define SPECIAL_FORM_P(sym, form) \
+	(*(sym).value.symbol == *bamboo_ctx->special_forms[(form)].value.symbol)
+
+// Checks if an atom holds an exact integer of any size.
+#define INTEGRAL_P(atom) \
+	(((atom).type == ATOM_TYPE_INTEGER) || ((atom).type == ATOM_TYPE_BIGNUM))
+
+// Character classes used by the lexer. Anything outside of the table is just a
+// regular symbol character.
+#define CHAR_CLASS_SPACE  0x01
+#define CHAR_CLASS_DELIM  0x02
+#define CHAR_CLASS_PREFIX 0x04
+#ifdef UNICODE
+	#define CHAR_CLASS(c) \
+		(((unsigned long)(c) < 256) ? bamboo_char_class[(uint8_t)(c)] : 0)
+#else
+	#define CHAR_CLASS(c) bamboo_char_class[(uint8_t)(c)]
+#endif  // UNICODE
+
+// Maximum nesting of arithmetic expressions evaluated inline by the evaluator.
+#define EVAL_FAST_ARITH_DEPTH 4
+
+// Big integers with less limbs than this are multiplied using the schoolbook
+// method since Karatsuba's overhead isn't worth it for them.
+#ifndef BIGNUM_KARATSUBA_THRESHOLD
+	#define BIGNUM_KARATSUBA_THRESHOLD 32
+#endif  // BIGNUM_KARATSUBA_THRESHOLD
+
+// Overflow-checked integer arithmetic.
+#if (defined(__GNUC__) && (__GNUC__ >= 5)) || defined(__clang__)
+	#define INT_ADD_OVERFLOW(a, b, r) __builtin_add_overflow(a, b, r)
+	#define INT_SUB_OVERFLOW(a, b, r) __builtin_sub_overflow(a, b, r)
+	#define INT_MUL_OVERFLOW(a, b, r) __builtin_mul_overflow(a, b, r)
+#else
+	#define INT_ADD_OVERFLOW(a, b, r) int_add_overflow(a, b, r)
+	#define INT_SUB_OVERFLOW(a, b, r) int_sub_overflow(a, b, r)
+	#define INT_MUL_OVERFLOW(a, b, r) int_mul_overflow(a, b, r)
+#endif  // __GNUC__ >= 5
 
 // HUGE_VALL is C99, so let's just make sure we cater to the previous decade.
 #ifndef HUGE_VALL
 	#define HUGE_VALL LDBL_MAX
 #endif  // HUGE_VALL
 
+// Floating-point operations matching our float atom type.
+#ifdef BAMBOO_USE_DOUBLE
+	#define FLOAT_EXP_SPEC  _T("%.*e")
+	#define FLOAT_SCAN_SPEC _T("%lg")
+	#define FLOAT_DIG       DBL_DIG
+	#define FLOAT_MANT_DIG  DBL_MANT_DIG
+	#define FLOAT_HUGE_VAL  HUGE_VAL
+	#define FLOAT_MIN_VAL   DBL_MIN
+	#define FLOAT_POW       pow
+	#define FLOAT_FMOD      fmod
+	#define FLOAT_FLOOR     floor
+	#define FLOAT_ROUND     round
+	#define FLOAT_CEIL      ceil
+	#define FLOAT_TRUNC     trunc
+	#define FLOAT_FABS      fabs
+	#define FLOAT_SQRT      sqrt
+	#define FLOAT_EXP       exp
+	#define FLOAT_LOG       log
+	#define FLOAT_SIN       sin
+	#define FLOAT_COS       cos
+	#define FLOAT_ATAN      atan
+	#define FLOAT_ATAN2     atan2
+	#ifdef _tcstold
+		#ifdef UNICODE
+			#define _tcstofloat wcstod
+		#else
+			#define _tcstofloat strtod
+		#endif  // UNICODE
+	#endif  // _tcstold
+#else
+	#define FLOAT_EXP_SPEC  _T("%.*Le")
+	#define FLOAT_SCAN_SPEC _T("%Lg")
+	#define FLOAT_DIG       LDBL_DIG
+	#define FLOAT_MANT_DIG  LDBL_MANT_DIG
+	#define FLOAT_HUGE_VAL  HUGE_VALL
+	#define FLOAT_MIN_VAL   LDBL_MIN
+	#define FLOAT_POW       powl
+	#define FLOAT_FMOD      fmodl
+	#define FLOAT_FLOOR     floorl
+	#define FLOAT_ROUND     roundl
+	#define FLOAT_CEIL      ceill
+	#define FLOAT_TRUNC     truncl
+	#define FLOAT_FABS      fabsl
+	#define FLOAT_SQRT      sqrtl
+	#define FLOAT_EXP       expl
+	#define FLOAT_LOG       logl
+	#define FLOAT_SIN       sinl
+	#define FLOAT_COS       cosl
+	#define FLOAT_ATAN      atanl
+	#define FLOAT_ATAN2     atan2l
+	#ifdef _tcstold
+		#define _tcstofloat _tcstold
+	#endif  // _tcstold
+#endif  // BAMBOO_USE_DOUBLE
+
+// Digits needed to round-trip any float, as well as the largest integer and
+// power of ten that can be represented exactly.
+#if FLOAT_MANT_DIG == 53
+	#define FLOAT_DECIMAL_DIG 17
+#elif FLOAT_MANT_DIG == 64
+	#define FLOAT_DECIMAL_DIG 21
+#else
+	#define FLOAT_DECIMAL_DIG 36
+#endif  // FLOAT_MANT_DIG
+#if FLOAT_MANT_DIG >= 64
+	#define FLOAT_EXACT_INT_MAX UINT64_MAX
+#else
+	#define FLOAT_EXACT_INT_MAX ((uint64_t)1 << FLOAT_MANT_DIG)
+#endif  // FLOAT_MANT_DIG >= 64
+#define FLOAT_EXACT_POW10_MAX ((FLOAT_MANT_DIG * 43) / 100)
+
 // Make Microsoft's Visual C++ 6.0 happy about our limits.
 #ifndef LLONG_MAX
 	#define LLONG_MAX _I64_MAX
@@ -53,6 +195,38 @@
 
 // Private definitions.
 #define ERROR_MSG_STR_LEN 200
+#define SYMTAB_MIN_CAP 256
+#define SORT_INSERTION_THRESHOLD 16
+#define STRBUF_MIN_CAP 16
+#define STRBUF_NUM_MAX_LEN 64
+#define FLOAT_MAX_FAST_DIGITS 19
+#define FLOAT_MAX_FAST_EXP 100000
+#define FLOAT_FIXED_MIN_EXP -4
+#define POW5_MIN_EXP -342
+#define POW5_MAX_EXP 308
+#define POW5_MAX_LIMBS 26
+#define GRISU_ALPHA -60
+#define GRISU_CACHED_MIN_EXP10 300
+#define PARSER_FRAMES_MIN_CAP 16
+#define PRINT_FRAMES_LOCAL 16
+#define GC_MARK_STACK_LOCAL 32
+#define BUILTINS_MIN_CAP 128
+#define IMAGE_MAGIC "BAMBOOIM"
+#define IMAGE_VERSION 1
+#define IMAGE_BYTE_ORDER 0x0102
+#define IMAGE_ALIGN 8
+#define IMAGE_PATH_MAX_LEN 4096
+#define FASL_MAGIC_0 'B'
+#define FASL_MAGIC_1 'F'
+#define FASL_VERSION 1
+#define FASL_MIN_CAP 256
+#define FASL_TABLE_MIN_CAP 64
+#define FASL_MAX_DEPTH 100000
+#define PTRMAP_MIN_CAP 64
+
+// Parallel map work splitting.
+#define PMAP_CHUNKS_PER_WORKER 16
+#define PMAP_MIN_CAP 4096
 
 // Token structure.
 typedef struct {
@@ -74,42 +248,726 @@ typedef enum {
 // Garbage collection definitions.
 typedef enum {
 	GC_TO_FREE = 0,
-	GC_IN_USE
+	GC_IN_USE,
+	GC_FROZEN
 } gc_mark_t;
 typedef enum {
 	ALLOCATION_TYPE_PAIR = 0,
-	ALLOCATION_TYPE_STRING
+	ALLOCATION_TYPE_SYMBOL,
+	ALLOCATION_TYPE_STRING,
+	ALLOCATION_TYPE_VECTOR,
+	ALLOCATION_TYPE_BIGNUM
 } alloc_type_t;
 typedef struct allocation_s allocation_t;
 struct allocation_s {
-	pair_t pair;
-	TCHAR *str;
+	union {
+		pair_t pair;
+		TCHAR *str;
+		string_t *string;
+		vector_t *vector;
+		bignum_t *bignum;
+	} data;
 	alloc_type_t type;
 	gc_mark_t mark;
 	allocation_t *next;
 };
 
+// Built-in function registered under a name, so that it can be found again
+// when loading an image.
+typedef struct {
+	atom_t name;
+	builtin_func_t func;
+} builtin_entry_t;
+
+// Header of a heap image file.
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint16_t order;
+	uint8_t tchar_size;
+	uint8_t float_size;
+	uint32_t count;
+	uint32_t reserved;
+} image_header_t;
+
+// State of a heap image being written.
+typedef struct {
+	FILE *fh;
+	allocation_t **objs;
+	size_t count;
+	size_t offset;
+	bamboo_error_t err;
+} image_writer_t;
+
+// State of a heap image being read.
+typedef struct {
+	const uint8_t *start;
+	const uint8_t *cur;
+	const uint8_t *end;
+	atom_t *objs;
+	size_t count;
+} image_reader_t;
+
+// Tags of the serialized expression format. Objects that are referenced more
+// than once have FASL_SHARED set on their tag and are later written as a
+// FASL_REF to their index.
+typedef enum {
+	FASL_NIL = 0x00,
+	FASL_TRUE,
+	FASL_FALSE,
+	FASL_INT,
+	FASL_FLOAT64,
+	FASL_FLOAT_NATIVE,
+	FASL_BIGNUM,
+	FASL_STRING,
+	FASL_SYMBOL,
+	FASL_SYMREF,
+	FASL_LIST = 0x0B,
+	FASL_VECTOR,
+	FASL_CLOSURE,
+	FASL_MACRO,
+	FASL_BUILTIN,
+	FASL_ROOT_ENV,
+	FASL_REF,
+	FASL_SHARED = 0x80
+} fasl_tag_t;
+
+// Open addressing hash map keyed by pointers.
+typedef struct {
+	const void *key;
+	size_t count;
+	size_t index;
+} ptrmap_entry_t;
+typedef struct {
+	ptrmap_entry_t *entries;
+	size_t cap;
+	size_t count;
+} ptrmap_t;
+
+// State of an expression being serialized.
+typedef struct {
+	uint8_t *buf;
+	size_t len;
+	size_t cap;
+	ptrmap_t objs;
+	ptrmap_t syms;
+	size_t nrefs;
+	size_t nsyms;
+	bamboo_error_t err;
+} fasl_writer_t;
+
+// State of an expression being deserialized.
+typedef struct {
+	const uint8_t *cur;
+	const uint8_t *end;
+	size_t depth;
+	atom_t *syms;
+	size_t nsyms;
+	size_t capsyms;
+	atom_t *refs;
+	size_t nrefs;
+	size_t caprefs;
+} fasl_reader_t;
+
+// Entry of the interned symbol table.
+typedef struct {
+	uint32_t hash;
+	allocation_t *alloc;
+} symtab_entry_t;
+
+// Iterator over the numbers stored in either a list or a numeric vector.
+typedef struct {
+	atom_t list;
+	const vector_t *vec;
+	size_t index;
+} numiter_t;
+
+// Numeric operations shared by the arithmetic built-ins and the evaluator.
+typedef enum {
+	NUMERIC_OP_SUM = 0,
+	NUMERIC_OP_SUBTRACT,
+	NUMERIC_OP_MULTIPLY,
+	NUMERIC_OP_EQ,
+	NUMERIC_OP_LT,
+	NUMERIC_OP_GT
+} numeric_op_t;
+#define ARITH_OP_COUNT (NUMERIC_OP_GT + 1)
+
+// Growable string builder. The buffer is always terminated and has room for
+// cap characters plus the terminator.
+typedef struct {
+	TCHAR *buf;
+	size_t len;
+	size_t cap;
+} strbuf_t;
+
+// Output sink used by the printer. Writes to the string builder if there's
+// one, otherwise straight to the stream.
+typedef struct {
+	strbuf_t *sb;
+	FILE *fh;
+} sink_t;
+
+// What's left to print of a list or function once the atom currently being
+// printed inside of it is done.
+typedef enum {
+	PRINT_FRAME_LIST = 0,
+	PRINT_FRAME_FUNC_BODY,
+	PRINT_FRAME_FUNC_END
+} print_frame_kind_t;
+typedef struct {
+	print_frame_kind_t kind;
+	atom_t rest;
+} print_frame_t;
+
+// Incremental parser definitions.
+typedef enum {
+	PARSER_STATE_IDLE = 0,
+	PARSER_STATE_TOKEN,
+	PARSER_STATE_STRING,
+	PARSER_STATE_STRING_ESCAPE,
+	PARSER_STATE_COMMENT,
+	PARSER_STATE_COMMA
+} parser_state_t;
+typedef enum {
+	PARSER_FRAME_LIST = 0,
+	PARSER_FRAME_VECTOR,
+	PARSER_FRAME_QUOTE
+} parser_frame_kind_t;
+typedef struct {
+	parser_frame_kind_t kind;
+	vector_type_t vtype;
+	atom_t head;
+	atom_t last;
+	bool dotted;
+	bool closed;
+} parser_frame_t;
+struct bamboo_parser_s {
+	parser_frame_t *frames;
+	size_t depth;
+	size_t cap;
+	parser_state_t state;
+	strbuf_t partial;
+	bool escapes;
+	bamboo_parser_t *next;
+};
+
+// State shared by the sorting routines.
+typedef struct {
+	atom_t less;
+	numeric_op_t op;
+	bool fast;
+	bamboo_error_t err;
+} sort_ctx_t;
+
+// Floating-point math functions that take a single argument.
+typedef enum {
+	FLOAT_FUNC_IDENTITY = 0,
+	FLOAT_FUNC_SQRT,
+	FLOAT_FUNC_EXP,
+	FLOAT_FUNC_LOG,
+	FLOAT_FUNC_SIN,
+	FLOAT_FUNC_COS,
+	FLOAT_FUNC_ATAN
+} float_func_t;
+
+// Special forms that are handled directly by the evaluator.
+typedef enum {
+	SPECIAL_FORM_QUOTE = 0,
+	SPECIAL_FORM_IF,
+	SPECIAL_FORM_DEFINE,
+	SPECIAL_FORM_LAMBDA,
+	SPECIAL_FORM_DEFINE_MACRO,
+	SPECIAL_FORM_APPLY,
+	SPECIAL_FORM_COUNT
+} special_form_t;
+
+// View of the magnitude of an integer or big integer atom.
+typedef struct {
+	bool negative;
+	size_t len;
+	const uint32_t *limbs;
+	uint32_t buf[2];
+} bigview_t;
+
+// Garbage collection root of an evaluation in progress.
+typedef struct eval_root_s eval_root_t;
+struct eval_root_s {
+	atom_t *expr;
+	env_t *env;
+	frame_t *stack;
+	eval_root_t *prev;
+};
+
+// Lightweight task that takes turns with the others inside of the evaluator.
+// Tasks that aren't running keep the stack they'll carry on with and the value
+// that the built-in function they were waiting on will return.
+typedef enum {
+	TASK_RUNNING = 0,
+	TASK_READY,
+	TASK_SENDING,
+	TASK_RECEIVING
+} task_status_t;
+typedef struct task_s task_t;
+struct task_s {
+	frame_t stack;
+	atom_t value;
+	atom_t channel;
+	task_status_t status;
+	bool spawned;
+	unsigned long id;
+	task_t *next;
+	task_t *prev_task;
+	task_t *next_task;
+};
+
+// What the running task asked to wait for.
+typedef struct {
+	task_status_t status;
+	atom_t channel;
+	atom_t value;
+} task_wait_t;
+
+// Channel fields indices.
+typedef enum {
+	CHANNEL_ITEMS_INDEX = 0,
+	CHANNEL_LAST_INDEX,
+	CHANNEL_COUNT_INDEX,
+	CHANNEL_CAPACITY_INDEX,
+	CHANNEL_WAIT_HEAD_INDEX,
+	CHANNEL_WAIT_TAIL_INDEX
+} channel_idx_t;
+
+// Evaluation that runs a limited number of steps at a time. Its own code runs
+// as the main task, while current is the task that was running when it ran out
+// of steps.
+struct bamboo_eval_s {
+	atom_t expr;
+	env_t env;
+	frame_t stack;
+	atom_t result;
+	bamboo_error_t err;
+	task_t task;
+	task_t *current;
+	bamboo_eval_t *prev;
+	bamboo_eval_t *next;
+};
+
+// Vector kernels dispatch table.
+typedef struct {
+	void (*add)(double *dst, const double *a, const double *b, size_t len);
+	void (*mul)(double *dst, const double *a, const double *b, size_t len);
+	void (*affine)(double *dst, const double *src, double a, double b,
+		size_t len);
+	double (*sum)(const double *src, size_t len);
+	double (*dot)(const double *a, const double *b, size_t len);
+	double (*min)(const double *src, size_t len);
+	double (*max)(const double *src, size_t len);
+} vector_kernels_t;
+
+// Lexer kernels dispatch table.
+typedef struct {
+	const TCHAR *(*skip_space)(const TCHAR *str);
+	const TCHAR *(*find)(const TCHAR *str, TCHAR a, TCHAR b);
+} lexer_kernels_t;
+
+#ifdef BAMBOO_USE_DOUBLE
+// Extended float used by the Grisu2 algorithm, holding f * 2^e.
+typedef struct {
+	uint64_t f;
+	int e;
+} diyfp_t;
+
+// Cached power of ten used by the Grisu2 algorithm, holding f * 2^e ~= 10^k.
+typedef struct {
+	uint64_t f;
+	int16_t e;
+	int16_t k;
+} cached_pow_t;
+#endif  // BAMBOO_USE_DOUBLE
+
+#ifdef USE_PTHREADS
+// Chunks that a parallel map worker still has to go through. The owner takes
+// them from the front while other workers steal them from the back.
+typedef struct {
+	pthread_mutex_t lock;
+	size_t head;
+	size_t tail;
+} pmap_deque_t;
+
+// Slice of the list handed out to the parallel map workers.
+typedef struct {
+	uint8_t *args;
+	size_t args_len;
+	uint8_t *results;
+	size_t results_len;
+	bamboo_error_t err;
+	TCHAR msg[ERROR_MSG_STR_LEN + 1];
+} pmap_chunk_t;
+
+// Worker interpreter of a parallel map pool.
+typedef struct pmap_pool_s pmap_pool_t;
+typedef struct {
+	pmap_pool_t *pool;
+	size_t index;
+	pthread_t thread;
+	bamboo_ctx_t *ctx;
+	env_t env;
+	pmap_deque_t deque;
+	uint64_t generation;
+	uint64_t lib_version;
+} pmap_worker_t;
+
+// Pool of worker interpreters, each one running on its own thread.
+struct pmap_pool_s {
+	pmap_worker_t *workers;
+	size_t count;
+	pid_t owner;
+
+	// Synchronization between the caller and the workers.
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	uint64_t generation;
+	size_t pending;
+	bool quit;
+
+	// Library code loaded into every worker.
+	uint8_t *lib;
+	size_t lib_len;
+	uint64_t lib_version;
+	const builtin_entry_t *builtins;
+	size_t builtins_count;
+
+	// Current job.
+	const uint8_t *func;
+	size_t func_len;
+	pmap_chunk_t *chunks;
+};
+#endif  // USE_PTHREADS
+
+// State of an interpreter. Each thread works on its own current context.
+struct bamboo_ctx_s {
+	TCHAR error_msg[ERROR_MSG_STR_LEN + 1];
+	symtab_entry_t *symtab;
+	size_t symtab_cap;
+	size_t symtab_count;
+	allocation_t *allocations;
+	allocation_t *frozen;
+	bool frozen_pinned;
+	atom_t forks;
+	uint32_t gc_iter_counter;
+	env_t *root_env;
+	atom_t special_forms[SPECIAL_FORM_COUNT];
+	atom_t arith_ops[ARITH_OP_COUNT];
+	bool arith_builtin[ARITH_OP_COUNT];
+	uint32_t arith_gen;
+	uint32_t arith_cache_gen;
+	eval_root_t *eval_roots;
+	bamboo_eval_t *evals;
+	task_t *tasks;
+	unsigned long task_ids;
+	task_t *task_main;
+	task_t *task_current;
+	task_t *run_head;
+	task_t *run_tail;
+	task_wait_t task_wait;
+	bamboo_parser_t *parsers;
+	bamboo_autoload_func_t autoload_handler;
+	builtin_entry_t *builtins;
+	size_t builtins_count;
+	size_t builtins_cap;
+	strbuf_t *output_capture;
+	bool pmap_worker;
+#ifdef USE_PTHREADS
+	pmap_pool_t *pmap_pool;
+#endif  // USE_PTHREADS
+};
+
 // Private variables.
-static TCHAR bamboo_error_msg[ERROR_MSG_STR_LEN + 1];
-static atom_t bamboo_symbol_table = { ATOM_TYPE_NIL };
-static allocation_t *bamboo_allocations = NULL;
-static uint32_t bamboo_gc_iter_counter = 0;
-static env_t *bamboo_root_env = NULL;
+static bamboo_ctx_t bamboo_default_ctx;
+static THREAD_LOCAL bamboo_ctx_t *bamboo_ctx = &bamboo_default_ctx;
+#ifdef USE_PTHREADS
+static pthread_once_t bamboo_tables_once = PTHREAD_ONCE_INIT;
+#else
+static bool bamboo_tables_ready = false;
+#endif  // USE_PTHREADS
+static vector_kernels_t bamboo_vkernels;
+static lexer_kernels_t bamboo_lkernels;
+static uint8_t bamboo_char_class[256];
+static bamboo_float_t bamboo_pow10[FLOAT_EXACT_POW10_MAX + 1];
+#ifdef BAMBOO_USE_DOUBLE
+static uint64_t bamboo_pow5[2 * (POW5_MAX_EXP - POW5_MIN_EXP + 1)];
+static const cached_pow_t bamboo_grisu_pows[] = {
+	{ UINT64_C(0xAB70FE17C79AC6CA), -1060, -300 },
+	{ UINT64_C(0xFF77B1FCBEBCDC4F), -1034, -292 },
+	{ UINT64_C(0xBE5691EF416BD60C), -1007, -284 },
+	{ UINT64_C(0x8DD01FAD907FFC3C), -980, -276 },
+	{ UINT64_C(0xD3515C2831559A83), -954, -268 },
+	{ UINT64_C(0x9D71AC8FADA6C9B5), -927, -260 },
+	{ UINT64_C(0xEA9C227723EE8BCB), -901, -252 },
+	{ UINT64_C(0xAECC49914078536D), -874, -244 },
+	{ UINT64_C(0x823C12795DB6CE57), -847, -236 },
+	{ UINT64_C(0xC21094364DFB5637), -821, -228 },
+	{ UINT64_C(0x9096EA6F3848984F), -794, -220 },
+	{ UINT64_C(0xD77485CB25823AC7), -768, -212 },
+	{ UINT64_C(0xA086CFCD97BF97F4), -741, -204 },
+	{ UINT64_C(0xEF340A98172AACE5), -715, -196 },
+	{ UINT64_C(0xB23867FB2A35B28E), -688, -188 },
+	{ UINT64_C(0x84C8D4DFD2C63F3B), -661, -180 },
+	{ UINT64_C(0xC5DD44271AD3CDBA), -635, -172 },
+	{ UINT64_C(0x936B9FCEBB25C996), -608, -164 },
+	{ UINT64_C(0xDBAC6C247D62A584), -582, -156 },
+	{ UINT64_C(0xA3AB66580D5FDAF6), -555, -148 },
+	{ UINT64_C(0xF3E2F893DEC3F126), -529, -140 },
+	{ UINT64_C(0xB5B5ADA8AAFF80B8), -502, -132 },
+	{ UINT64_C(0x87625F056C7C4A8B), -475, -124 },
+	{ UINT64_C(0xC9BCFF6034C13053), -449, -116 },
+	{ UINT64_C(0x964E858C91BA2655), -422, -108 },
+	{ UINT64_C(0xDFF9772470297EBD), -396, -100 },
+	{ UINT64_C(0xA6DFBD9FB8E5B88F), -369, -92 },
+	{ UINT64_C(0xF8A95FCF88747D94), -343, -84 },
+	{ UINT64_C(0xB94470938FA89BCF), -316, -76 },
+	{ UINT64_C(0x8A08F0F8BF0F156B), -289, -68 },
+	{ UINT64_C(0xCDB02555653131B6), -263, -60 },
+	{ UINT64_C(0x993FE2C6D07B7FAC), -236, -52 },
+	{ UINT64_C(0xE45C10C42A2B3B06), -210, -44 },
+	{ UINT64_C(0xAA242499697392D3), -183, -36 },
+	{ UINT64_C(0xFD87B5F28300CA0E), -157, -28 },
+	{ UINT64_C(0xBCE5086492111AEB), -130, -20 },
+	{ UINT64_C(0x8CBCCC096F5088CC), -103, -12 },
+	{ UINT64_C(0xD1B71758E219652C), -77, -4 },
+	{ UINT64_C(0x9C40000000000000), -50, 4 },
+	{ UINT64_C(0xE8D4A51000000000), -24, 12 },
+	{ UINT64_C(0xAD78EBC5AC620000), 3, 20 },
+	{ UINT64_C(0x813F3978F8940984), 30, 28 },
+	{ UINT64_C(0xC097CE7BC90715B3), 56, 36 },
+	{ UINT64_C(0x8F7E32CE7BEA5C70), 83, 44 },
+	{ UINT64_C(0xD5D238A4ABE98068), 109, 52 },
+	{ UINT64_C(0x9F4F2726179A2245), 136, 60 },
+	{ UINT64_C(0xED63A231D4C4FB27), 162, 68 },
+	{ UINT64_C(0xB0DE65388CC8ADA8), 189, 76 },
+	{ UINT64_C(0x83C7088E1AAB65DB), 216, 84 },
+	{ UINT64_C(0xC45D1DF942711D9A), 242, 92 },
+	{ UINT64_C(0x924D692CA61BE758), 269, 100 },
+	{ UINT64_C(0xDA01EE641A708DEA), 295, 108 },
+	{ UINT64_C(0xA26DA3999AEF774A), 322, 116 },
+	{ UINT64_C(0xF209787BB47D6B85), 348, 124 },
+	{ UINT64_C(0xB454E4A179DD1877), 375, 132 },
+	{ UINT64_C(0x865B86925B9BC5C2), 402, 140 },
+	{ UINT64_C(0xC83553C5C8965D3D), 428, 148 },
+	{ UINT64_C(0x952AB45CFA97A0B3), 455, 156 },
+	{ UINT64_C(0xDE469FBD99A05FE3), 481, 164 },
+	{ UINT64_C(0xA59BC234DB398C25), 508, 172 },
+	{ UINT64_C(0xF6C69A72A3989F5C), 534, 180 },
+	{ UINT64_C(0xB7DCBF5354E9BECE), 561, 188 },
+	{ UINT64_C(0x88FCF317F22241E2), 588, 196 },
+	{ UINT64_C(0xCC20CE9BD35C78A5), 614, 204 },
+	{ UINT64_C(0x98165AF37B2153DF), 641, 212 },
+	{ UINT64_C(0xE2A0B5DC971F303A), 667, 220 },
+	{ UINT64_C(0xA8D9D1535CE3B396), 694, 228 },
+	{ UINT64_C(0xFB9B7CD9A4A7443C), 720, 236 },
+	{ UINT64_C(0xBB764C4CA7A44410), 747, 244 },
+	{ UINT64_C(0x8BAB8EEFB6409C1A), 774, 252 },
+	{ UINT64_C(0xD01FEF10A657842C), 800, 260 },
+	{ UINT64_C(0x9B10A4E5E9913129), 827, 268 },
+	{ UINT64_C(0xE7109BFBA19C0C9D), 853, 276 },
+	{ UINT64_C(0xAC2820D9623BF429), 880, 284 },
+	{ UINT64_C(0x80444B5E7AA7CF85), 907, 292 },
+	{ UINT64_C(0xBF21E44003ACDD2D), 933, 300 },
+	{ UINT64_C(0x8E679C2F5E44FF8F), 960, 308 },
+	{ UINT64_C(0xD433179D9C8CB841), 986, 316 },
+	{ UINT64_C(0x9E19DB92B4E31BA9), 1013, 324 }
+};
+#endif  // BAMBOO_USE_DOUBLE
 
 // Private methods.
+void tables_init(void);
 void putstr(const TCHAR *str);
+atom_t symbol_intern(const TCHAR *name, size_t len, bool fold);
+bool symtab_grow(void);
 void putstrerr(const TCHAR *str);
 TCHAR* strcpyse(const TCHAR *start, const TCHAR *end);
 bool contains_point(const TCHAR *str);
 bool atom_boolean_val(atom_t atom);
+bool atom_numeric_val(atom_t atom, double *num);
+bool atom_float_val(atom_t atom, bamboo_float_t *num);
+bamboo_error_t numeric_binop(numeric_op_t op, atom_t a, atom_t b,
+	atom_t *result);
+bamboo_error_t numeric_fold(numeric_op_t op, atom_t args, atom_t *result);
+bamboo_error_t numeric_compare_chain(numeric_op_t op, atom_t args,
+	atom_t *result);
+bamboo_error_t numeric_extreme(numeric_op_t op, atom_t args, atom_t *result);
+bamboo_error_t number_abs(atom_t atom, atom_t *result);
+bamboo_error_t float_func(atom_t args, float_func_t func, atom_t *result);
+size_t vector_elem_size(vector_type_t type);
+bamboo_error_t list_to_vector(vector_type_t type, atom_t list, atom_t *result);
+bamboo_error_t f64vector_arg(atom_t atom, vector_t **vec);
+bamboo_error_t f64vector_pair_args(atom_t args, vector_t **a, vector_t **b);
+bamboo_error_t numiter_init(numiter_t *iter, atom_t seq);
+bool numiter_next(numiter_t *iter, bamboo_float_t *num,
+	bamboo_error_t *err);
+bamboo_float_t select_nth(bamboo_float_t *data, size_t len, size_t k);
+atom_t alist_push(atom_t alist, const TCHAR *key, atom_t value);
+atom_t string_atom(string_t *string);
+string_t *string_alloc(size_t len);
+atom_t string_take(TCHAR *buf, size_t len);
+atom_t string_view(atom_t atom, size_t start, size_t len);
+int hex_digit(TCHAR c);
+size_t encode_codepoint(TCHAR *buf, uint32_t cp);
+uint32_t string_hash(string_t *string);
+bool string_equal(string_t *a, string_t *b);
+bamboo_error_t string_index_arg(atom_t atom, size_t max, size_t *index);
+bamboo_error_t strbuf_init(strbuf_t *sb, size_t cap);
+bamboo_error_t strbuf_reserve(strbuf_t *sb, size_t extra);
+bamboo_error_t strbuf_append(strbuf_t *sb, const TCHAR *str, size_t len);
+atom_t strbuf_to_string(strbuf_t *sb);
+void strbuf_free(strbuf_t *sb);
+bamboo_error_t sort_ctx_init(sort_ctx_t *ctx, atom_t less);
+bool sort_less(sort_ctx_t *ctx, atom_t a, atom_t b);
+void sort_merge_cells(sort_ctx_t *ctx, atom_t *cells, atom_t *tmp, size_t lo,
+	size_t mid, size_t hi);
+bamboo_error_t sort_list_cells(sort_ctx_t *ctx, atom_t *cells, size_t len);
+bool sort_vector_less(sort_ctx_t *ctx, const vector_t *vec, size_t i,
+	size_t j);
+void sort_vector_swap(vector_t *vec, size_t i, size_t j);
+void sort_vector_heap(sort_ctx_t *ctx, vector_t *vec, size_t lo, size_t hi);
+void sort_vector_intro(sort_ctx_t *ctx, vector_t *vec, size_t lo, size_t hi,
+	uint8_t depth);
+bamboo_error_t sort_vector(sort_ctx_t *ctx, vector_t *vec);
+bamboo_error_t sort_seq(atom_t args, bool in_place, atom_t *result);
+atom_t vector_elem(const vector_t *vec, size_t index);
+bamboo_error_t vector_elem_set(vector_t *vec, size_t index, atom_t value);
+void vector_kernels_init(void);
+void number_init(void);
+uint64_t mul_64x64(uint64_t a, uint64_t b, uint64_t *hi);
+bool float_from_decimal(uint64_t mant, int exp10, bamboo_float_t *num);
+bool parse_decimal(const TCHAR *start, const TCHAR *end, atom_t *atom);
+size_t float_shortest(bamboo_float_t num, TCHAR *digits, int *exp10);
+size_t format_int(TCHAR *buf, int64_t num);
+size_t format_float(TCHAR *buf, bamboo_float_t num);
+#ifdef BAMBOO_USE_DOUBLE
+void pow5_table_init(void);
+uint8_t mag_clz(uint32_t limb);
+void mag_top128(const uint32_t *a, size_t len, uint64_t *r);
+bool eisel_lemire(uint64_t mant, int exp10, double *num);
+diyfp_t diyfp_mul(diyfp_t x, diyfp_t y);
+diyfp_t diyfp_normalize(diyfp_t x);
+size_t grisu2_digits(TCHAR *digits, int *dec_exp, diyfp_t low, diyfp_t w,
+	diyfp_t high);
+size_t grisu2(double value, TCHAR *digits, int *dec_exp);
+#endif  // BAMBOO_USE_DOUBLE
+bool int_add_overflow(int64_t a, int64_t b, int64_t *r);
+bool int_sub_overflow(int64_t a, int64_t b, int64_t *r);
+bool int_mul_overflow(int64_t a, int64_t b, int64_t *r);
+size_t mag_trim(const uint32_t *a, size_t len);
+int mag_cmp(const uint32_t *a, size_t alen, const uint32_t *b, size_t blen);
+size_t mag_add(uint32_t *r, const uint32_t *a, size_t alen, const uint32_t *b,
+	size_t blen);
+size_t mag_sub(uint32_t *r, const uint32_t *a, size_t alen, const uint32_t *b,
+	size_t blen);
+void mag_add_into(uint32_t *r, size_t rlen, const uint32_t *b, size_t blen);
+void mag_sub_into(uint32_t *r, size_t rlen, const uint32_t *b, size_t blen);
+void mag_mul_school(uint32_t *r, const uint32_t *a, size_t alen,
+	const uint32_t *b, size_t blen);
+void mag_mul(uint32_t *r, const uint32_t *a, size_t alen, const uint32_t *b,
+	size_t blen);
+uint32_t mag_divmod_small(uint32_t *a, size_t len, uint32_t d);
+uint32_t mag_mul_small_add(uint32_t *a, size_t len, uint32_t m, uint32_t add);
+void mag_divmod(uint32_t *q, uint32_t *r, const uint32_t *a, size_t alen,
+	const uint32_t *b, size_t blen);
+bamboo_error_t bignum_divmod(atom_t a, atom_t b, atom_t *quot, atom_t *rem);
+bamboo_error_t bignum_isqrt(atom_t x, atom_t *root);
+void bignum_view(atom_t atom, bigview_t *view);
+atom_t bignum_from_mag(const uint32_t *limbs, size_t len, bool negative);
+int bignum_cmp(atom_t a, atom_t b);
+bamboo_error_t bignum_binop(numeric_op_t op, atom_t a, atom_t b,
+	atom_t *result);
+bamboo_float_t bignum_to_float(const bignum_t *num);
+TCHAR *bignum_str(const bignum_t *num);
+bool bignum_parse(const TCHAR *start, const TCHAR *end, atom_t *atom);
 void set_error_msg(const TCHAR *msg);
 void fatal_error(bamboo_error_t err, const TCHAR *msg);
+void sink_stdout(sink_t *sink);
+void sink_write(sink_t *sink, const TCHAR *str, size_t len);
+void sink_puts(sink_t *sink, const TCHAR *str);
+int image_cmp_alloc(const void *a, const void *b);
+void image_put(image_writer_t *w, const void *ptr, size_t len);
+void image_put_block(image_writer_t *w, const void *ptr, size_t len,
+	size_t sz);
+void image_put_object(image_writer_t *w, const allocation_t *alloc);
+void image_put_atom(image_writer_t *w, atom_t atom);
+bool image_get(image_reader_t *r, void *ptr, size_t len);
+const void *image_get_block(image_reader_t *r, size_t *len, size_t sz);
+bamboo_error_t image_get_object(image_reader_t *r, atom_t *atom);
+bamboo_error_t image_get_atom(image_reader_t *r, atom_t *atom);
+FILE *tfopen(const TCHAR *path, const TCHAR *mode);
+bamboo_error_t fasl_count(fasl_writer_t *w, atom_t atom);
+bool fasl_root_env_p(atom_t atom);
+bamboo_error_t pmap_serial(atom_t func, atom_t list, atom_t *result);
+#ifdef USE_PTHREADS
+size_t pmap_cpu_count(void);
+bamboo_error_t pmap_pool_new(size_t count, pmap_pool_t **pool);
+void pmap_pool_free(pmap_pool_t *pool);
+bamboo_error_t pmap_snapshot(pmap_pool_t *pool);
+bamboo_error_t pmap_chunks_new(atom_t list, size_t len, size_t count,
+	pmap_chunk_t **chunks);
+void pmap_chunks_free(pmap_chunk_t *chunks, size_t count);
+bool pmap_append(uint8_t **buf, size_t *len, size_t *cap, const void *data,
+	size_t size);
+void *pmap_worker_main(void *arg);
+void pmap_worker_run(pmap_worker_t *worker);
+bamboo_error_t pmap_worker_sync(pmap_worker_t *worker);
+void pmap_worker_chunk(atom_t func, pmap_chunk_t *chunk, atom_t work);
+bool pmap_take(pmap_worker_t *worker, size_t *index);
+#endif  // USE_PTHREADS
+void fasl_put(fasl_writer_t *w, const void *ptr, size_t len);
+void fasl_put_byte(fasl_writer_t *w, uint8_t b);
+void fasl_put_varint(fasl_writer_t *w, uint64_t num);
+void fasl_put_le(fasl_writer_t *w, const void *ptr, size_t sz, size_t n);
+void fasl_put_chars(fasl_writer_t *w, const TCHAR *str, size_t len);
+void fasl_put_atom(fasl_writer_t *w, atom_t atom);
+const uint8_t *fasl_get(fasl_reader_t *r, size_t len);
+bool fasl_get_varint(fasl_reader_t *r, uint64_t *num);
+bool fasl_get_len(fasl_reader_t *r, size_t sz, size_t *len);
+bool fasl_get_le(fasl_reader_t *r, void *dst, size_t sz, size_t n);
+bamboo_error_t fasl_push(atom_t **table, size_t *len, size_t *cap,
+						 atom_t atom);
+bamboo_error_t fasl_add_ref(fasl_reader_t *r, atom_t atom);
+bamboo_error_t fasl_get_atom(fasl_reader_t *r, atom_t *atom);
+bool host_little_endian(void);
+bamboo_error_t ptrmap_get(ptrmap_t *map, const void *key,
+						  ptrmap_entry_t **entry);
+ptrmap_entry_t *ptrmap_find(const ptrmap_t *map, const void *key);
+void ptrmap_free(ptrmap_t *map);
+void print_string(sink_t *sink, const string_t *string);
+void print_atom(sink_t *sink, atom_t atom, bool display);
+void print_display(sink_t *sink, atom_t atom);
+allocation_t *atom_alloc(atom_t atom);
 void gc_mark(atom_t root);
+void gc_mark_roots(void);
+void gc_mark_task(const task_t *task);
 void gc(bool respect_marks);
+void gc_freeze(atom_t root);
+void gc_frozen_mark(gc_mark_t mark);
+void gc_thaw(void);
+bool gc_frozen_p(atom_t atom);
 atom_t shallow_copy_list(atom_t list);
+bool env_lookup(env_t env, atom_t symbol, atom_t *atom);
+bool env_lookup_binding(env_t env, atom_t symbol, env_t *frame,
+	atom_t *binding);
+bamboo_error_t env_autoload(env_t env, atom_t symbol, atom_t *atom);
+bamboo_error_t env_autoload_all(env_t env);
+bamboo_error_t env_freeze(env_t base);
+bool arith_op(atom_t symbol, numeric_op_t *op);
+bool arith_builtin_p(env_t env, numeric_op_t op);
+bool eval_fast_arith(atom_t expr, env_t env, atom_t *result, uint8_t depth);
+void lexer_init(void);
 bamboo_error_t lex(const TCHAR *str, token_t *token);
 bamboo_error_t parse_hash_expr(const token_t *token, const TCHAR **end,
 	atom_t *atom);
+bamboo_error_t parse_vector(const token_t *token, vector_type_t type,
+	const TCHAR **end, atom_t *atom);
 bamboo_error_t parse_primitive(const token_t *token, const TCHAR **end,
 	atom_t *atom);
 bamboo_error_t parse_string(const token_t *token, const TCHAR **end,
@@ -117,6 +975,45 @@ bamboo_error_t parse_string(const token_t *token, const TCHAR **end,
 bamboo_error_t parse_list(const TCHAR *input, const TCHAR **end, atom_t *atom);
 bamboo_error_t parse_comment(const token_t *token, const TCHAR **end,
 	atom_t *atom);
+bool vector_prefix(const token_t *token, vector_type_t *type);
+bool pair_delimiter_p(const TCHAR *start, const TCHAR *end);
+bool scan_symbol(const token_t *token, atom_t *symbol);
+const TCHAR *string_scan(const TCHAR *str, bool *escapes);
+bamboo_error_t string_literal(const TCHAR *start, size_t len, bool escapes,
+	atom_t *atom);
+bamboo_error_t string_unescape(const TCHAR *src, size_t len, TCHAR *dst,
+	size_t *dlen);
+bamboo_error_t parser_push_frame(bamboo_parser_t *parser,
+	parser_frame_kind_t kind, atom_t head);
+bamboo_error_t parser_deliver(bamboo_parser_t *parser, atom_t atom,
+	bamboo_form_func_t func, void *arg);
+bamboo_error_t parser_close(bamboo_parser_t *parser, bamboo_form_func_t func,
+	void *arg);
+bamboo_error_t parser_token(bamboo_parser_t *parser, const TCHAR *start,
+	const TCHAR *end, TCHAR next, bamboo_form_func_t func, void *arg,
+	bool *opened);
+bamboo_error_t eval_expr_loop(bamboo_eval_t *state, atom_t *result,
+	size_t steps, eval_root_t *root);
+uint64_t eval_clock_usec(void);
+void task_enter(bamboo_eval_t *state);
+void task_settle(bamboo_eval_t *state, bamboo_error_t err);
+bool task_can_wait(void);
+void task_ready(task_t *task, atom_t value);
+bool task_run_remove(task_t *task);
+void task_unqueue(task_t *task);
+void task_free(task_t *task);
+bamboo_error_t task_wait(frame_t *stack, atom_t *result);
+bamboo_error_t task_switch(frame_t *stack, atom_t *result);
+bamboo_error_t task_deadlock(void);
+size_t task_deadlock_append(TCHAR *msg, size_t len, const task_t *task);
+bamboo_error_t task_exit(frame_t *stack, atom_t *result);
+atom_t channel_new(int64_t capacity);
+bamboo_error_t channel_arg(atom_t args, uint16_t argc, atom_t *channel);
+void channel_push(atom_t channel, atom_t value);
+atom_t channel_pop(atom_t channel);
+void channel_wait(atom_t channel, task_t *task);
+task_t *channel_waiter(atom_t channel, task_status_t status);
+void channel_unwait(atom_t channel, task_t *task);
 frame_t new_stack_frame(frame_t parent, env_t env, atom_t tail);
 bamboo_error_t eval_expr_exec(frame_t *stack, atom_t *expr, env_t *env);
 bamboo_error_t eval_expr_bind(frame_t *stack, atom_t *expr, env_t *env);
@@ -134,6 +1031,20 @@ bamboo_error_t builtin_multiply(atom_t args, atom_t *result);
 bamboo_error_t builtin_divide(atom_t args, atom_t *result);
 bamboo_error_t builtin_expt(atom_t args, atom_t *result);
 bamboo_error_t builtin_modulo(atom_t args, atom_t *result);
+bamboo_error_t builtin_quotient(atom_t args, atom_t *result);
+bamboo_error_t builtin_remainder(atom_t args, atom_t *result);
+bamboo_error_t builtin_gcd(atom_t args, atom_t *result);
+bamboo_error_t builtin_lcm(atom_t args, atom_t *result);
+bamboo_error_t builtin_abs(atom_t args, atom_t *result);
+bamboo_error_t builtin_min(atom_t args, atom_t *result);
+bamboo_error_t builtin_max(atom_t args, atom_t *result);
+bamboo_error_t builtin_exact_inexact(atom_t args, atom_t *result);
+bamboo_error_t builtin_sqrt(atom_t args, atom_t *result);
+bamboo_error_t builtin_exp(atom_t args, atom_t *result);
+bamboo_error_t builtin_log(atom_t args, atom_t *result);
+bamboo_error_t builtin_sin(atom_t args, atom_t *result);
+bamboo_error_t builtin_cos(atom_t args, atom_t *result);
+bamboo_error_t builtin_atan(atom_t args, atom_t *result);
 bamboo_error_t builtin_floor(atom_t args, atom_t *result);
 bamboo_error_t builtin_round(atom_t args, atom_t *result);
 bamboo_error_t builtin_ceil(atom_t args, atom_t *result);
@@ -157,9 +1068,47 @@ bamboo_error_t builtin_macrop(atom_t args, atom_t *result);
 bamboo_error_t builtin_display(atom_t args, atom_t *result);
 bamboo_error_t builtin_concat(atom_t args, atom_t *result);
 bamboo_error_t builtin_newline(atom_t args, atom_t *result);
+bamboo_error_t builtin_string_length(atom_t args, atom_t *result);
+bamboo_error_t builtin_substring(atom_t args, atom_t *result);
+bamboo_error_t builtin_string_ref(atom_t args, atom_t *result);
+bamboo_error_t builtin_string_eq(atom_t args, atom_t *result);
+bamboo_error_t builtin_string_append(atom_t args, atom_t *result);
+bamboo_error_t builtin_string_join(atom_t args, atom_t *result);
+bamboo_error_t builtin_with_output_to_string(atom_t args, atom_t *result);
 bamboo_error_t builtin_display_env(atom_t args, atom_t *result);
+bamboo_error_t builtin_f64vector(atom_t args, atom_t *result);
+bamboo_error_t builtin_i64vector(atom_t args, atom_t *result);
+bamboo_error_t builtin_f32vector(atom_t args, atom_t *result);
+bamboo_error_t builtin_list_to_f64vector(atom_t args, atom_t *result);
+bamboo_error_t builtin_vectorp(atom_t args, atom_t *result);
+bamboo_error_t builtin_vector_length(atom_t args, atom_t *result);
+bamboo_error_t builtin_vector_ref(atom_t args, atom_t *result);
+bamboo_error_t builtin_vector_set(atom_t args, atom_t *result);
+bamboo_error_t builtin_vector_to_list(atom_t args, atom_t *result);
+bamboo_error_t builtin_f64v_add(atom_t args, atom_t *result);
+bamboo_error_t builtin_f64v_mul(atom_t args, atom_t *result);
+bamboo_error_t builtin_f64v_sum(atom_t args, atom_t *result);
+bamboo_error_t builtin_f64v_dot(atom_t args, atom_t *result);
+bamboo_error_t builtin_f64v_min(atom_t args, atom_t *result);
+bamboo_error_t builtin_f64v_max(atom_t args, atom_t *result);
+bamboo_error_t builtin_f64v_map_affine(atom_t args, atom_t *result);
+bamboo_error_t builtin_stats_summary(atom_t args, atom_t *result);
+bamboo_error_t builtin_histogram(atom_t args, atom_t *result);
+bamboo_error_t builtin_quantiles(atom_t args, atom_t *result);
+bamboo_error_t builtin_cumulative_sum(atom_t args, atom_t *result);
+bamboo_error_t builtin_sort(atom_t args, atom_t *result);
+bamboo_error_t builtin_sort_in_place(atom_t args, atom_t *result);
+bamboo_error_t builtin_serialize(atom_t args, atom_t *result);
+bamboo_error_t builtin_deserialize(atom_t args, atom_t *result);
+bamboo_error_t builtin_pmap(atom_t args, atom_t *result);
+bamboo_error_t builtin_spawn(atom_t args, atom_t *result);
+bamboo_error_t builtin_yield(atom_t args, atom_t *result);
+bamboo_error_t builtin_make_channel(atom_t args, atom_t *result);
+bamboo_error_t builtin_channel_send(atom_t args, atom_t *result);
+bamboo_error_t builtin_channel_recv(atom_t args, atom_t *result);
 
 // Initialization functions.
+bamboo_error_t context_init(env_t *env);
 bamboo_error_t populate_builtins(env_t *env);
 
 /**
@@ -169,21 +1118,63 @@ bamboo_error_t populate_builtins(env_t *env);
  * @return     BAMBOO_OK if everything went fine.
  */
 bamboo_error_t bamboo_init(env_t *env) {
-	bamboo_error_t err;
-
 	// Display a pretty welcome message.
 	putstr(_T("Bamboo Lisp v0.1a") LINEBREAK LINEBREAK);
 
+	return context_init(env);
+}
+
+/**
+ * Initializes the interpreter of the current context without any fanfare.
+ *
+ * @param  env Pointer to the root environment of the interpreter.
+ * @return     BAMBOO_OK if everything went fine.
+ */
+bamboo_error_t context_init(env_t *env) {
+	bamboo_error_t err;
+	atom_t *forms;
+	atom_t *ops;
+
 	// Make sure the error message string is properly terminated.
-	bamboo_error_msg[0] = _T('\0');
-	bamboo_error_msg[ERROR_MSG_STR_LEN] = _T('\0');
+	bamboo_ctx->error_msg[0] = _T('\0');
+	bamboo_ctx->error_msg[ERROR_MSG_STR_LEN] = _T('\0');
 
 	// Make sure the garbage collection iteration counter is zeroed out.
-	bamboo_gc_iter_counter = 0;
+	bamboo_ctx->gc_iter_counter = 0;
+
+	// Build the tables shared by every context if nobody has done it yet.
+#ifdef USE_PTHREADS
+	pthread_once(&bamboo_tables_once, tables_init);
+#else
+	if (!bamboo_tables_ready) {
+		tables_init();
+		bamboo_tables_ready = true;
+	}
+#endif  // USE_PTHREADS
+
+	// Intern the special form symbols so that the evaluator can compare them
+	// by pointer.
+	forms = bamboo_ctx->special_forms;
+	forms[SPECIAL_FORM_QUOTE] = bamboo_symbol(_T("QUOTE"));
+	forms[SPECIAL_FORM_IF] = bamboo_symbol(_T("IF"));
+	forms[SPECIAL_FORM_DEFINE] = bamboo_symbol(_T("DEFINE"));
+	forms[SPECIAL_FORM_LAMBDA] = bamboo_symbol(_T("LAMBDA"));
+	forms[SPECIAL_FORM_DEFINE_MACRO] = bamboo_symbol(_T("DEFINE-MACRO"));
+	forms[SPECIAL_FORM_APPLY] = bamboo_symbol(_T("APPLY"));
+
+	// Along with the names of the built-ins that are evaluated inline.
+	ops = bamboo_ctx->arith_ops;
+	ops[NUMERIC_OP_SUM] = bamboo_symbol(_T("+"));
+	ops[NUMERIC_OP_SUBTRACT] = bamboo_symbol(_T("-"));
+	ops[NUMERIC_OP_MULTIPLY] = bamboo_symbol(_T("*"));
+	ops[NUMERIC_OP_EQ] = bamboo_symbol(_T("="));
+	ops[NUMERIC_OP_LT] = bamboo_symbol(_T("<"));
+	ops[NUMERIC_OP_GT] = bamboo_symbol(_T(">"));
+	bamboo_ctx->arith_gen++;
 
 	// Initialize the root environment.
 	*env = bamboo_env_new(nil);
-	bamboo_root_env = env;
+	bamboo_ctx->root_env = env;
 
 	// Populate the environment with our built-in functions.
 	err = populate_builtins(env);
@@ -200,10 +1191,126 @@ bamboo_error_t bamboo_init(env_t *env) {
  * @return     BAMBOO_OK if everything went fine.
  */
 bamboo_error_t bamboo_destroy(env_t *env) {
+#ifdef USE_PTHREADS
+	// Get rid of our parallel map workers.
+	if (bamboo_ctx->pmap_pool != NULL) {
+		pmap_pool_free(bamboo_ctx->pmap_pool);
+		bamboo_ctx->pmap_pool = NULL;
+	}
+#endif  // USE_PTHREADS
+
+	// Forget about the tasks that were still around.
+	while (bamboo_ctx->tasks != NULL) {
+		task_t *task = bamboo_ctx->tasks;
+
+		bamboo_ctx->tasks = task->next_task;
+		free(task);
+	}
+	bamboo_ctx->task_ids = 0;
+	bamboo_ctx->task_main = NULL;
+	bamboo_ctx->task_current = NULL;
+	bamboo_ctx->run_head = NULL;
+	bamboo_ctx->run_tail = NULL;
+
 	gc(false);
+	bamboo_ctx->frozen = NULL;
+	bamboo_ctx->frozen_pinned = false;
+	bamboo_ctx->forks = nil;
+
+	// Everything is gone, including our interned symbols.
+	free(bamboo_ctx->symtab);
+	bamboo_ctx->symtab = NULL;
+	bamboo_ctx->symtab_cap = 0;
+	bamboo_ctx->symtab_count = 0;
+
+	// Along with the built-in functions registered by name.
+	free(bamboo_ctx->builtins);
+	bamboo_ctx->builtins = NULL;
+	bamboo_ctx->builtins_count = 0;
+	bamboo_ctx->builtins_cap = 0;
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Builds the tables that are shared by every context. They are never changed
+ * afterwards, so any thread can read them without locking.
+ */
+void tables_init(void) {
+	// Select the best vector kernels for the CPU we are running on.
+	vector_kernels_init();
+
+	// Build the tables used to format and parse numbers.
+	number_init();
+
+	// Get the lexer ready for action.
+	lexer_init();
+}
+
+/**
+ * Creates a brand new interpreter context. Make it the current one with
+ * bamboo_ctx_switch before initializing it with bamboo_init. Separate contexts
+ * share nothing but read-only tables, so they can run on separate threads
+ * without any locking.
+ *
+ * @param  ctx Pointer that will hold the newly created context.
+ * @return     BAMBOO_OK if the context was created.
+ */
+bamboo_error_t bamboo_ctx_new(bamboo_ctx_t **ctx) {
+	*ctx = (bamboo_ctx_t *)calloc(1, sizeof(bamboo_ctx_t));
+	if (*ctx == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+			_T("Can't allocate interpreter context"));
+	}
+
 	return BAMBOO_OK;
 }
 
+/**
+ * Frees an interpreter context along with anything its interpreter left
+ * behind. If it's the current context of this thread the default one takes
+ * its place.
+ *
+ * @param ctx Context to be freed.
+ */
+void bamboo_ctx_free(bamboo_ctx_t *ctx) {
+	bamboo_ctx_t *prev;
+
+	if ((ctx == NULL) || (ctx == &bamboo_default_ctx))
+		return;
+
+	// Release whatever is still allocated in the context.
+	prev = bamboo_ctx_switch(ctx);
+	bamboo_destroy(ctx->root_env);
+	bamboo_ctx_switch((prev == ctx) ? NULL : prev);
+
+	free(ctx);
+}
+
+/**
+ * Gets the context that the calling thread is currently working on.
+ *
+ * @return Current context of the calling thread.
+ */
+bamboo_ctx_t *bamboo_ctx_current(void) {
+	return bamboo_ctx;
+}
+
+/**
+ * Makes a context the current one of the calling thread. Every other function
+ * in the library works on the current context. A context must only be current
+ * in one thread at a time.
+ *
+ * @param  ctx Context to switch to or NULL to use the default context.
+ * @return     Previous context of the calling thread.
+ */
+bamboo_ctx_t *bamboo_ctx_switch(bamboo_ctx_t *ctx) {
+	bamboo_ctx_t *prev = bamboo_ctx;
+
+	bamboo_ctx = (ctx == NULL) ? &bamboo_default_ctx : ctx;
+	return prev;
+}
+
 /**
  * Populates the environment with our built-in functions.
  *
@@ -237,7 +1344,53 @@ bamboo_error_t populate_builtins(env_t *env) {
 	err = bamboo_env_set_builtin(*env, _T("/"), builtin_divide);
 	IF_ERROR(err)
 		return err;
-	err = bamboo_env_set_builtin(*env, _T("MOD"), builtin_modulo);
+	err = bamboo_env_set_builtin(*env, _T("MOD"), builtin_remainder);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("MODULO"), builtin_modulo);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("QUOTIENT"), builtin_quotient);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("REMAINDER"), builtin_remainder);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("GCD"), builtin_gcd);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("LCM"), builtin_lcm);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("ABS"), builtin_abs);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("MIN"), builtin_min);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("MAX"), builtin_max);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("EXACT->INEXACT"),
+		builtin_exact_inexact);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("SQRT"), builtin_sqrt);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("EXP"), builtin_exp);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("LOG"), builtin_log);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("SIN"), builtin_sin);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("COS"), builtin_cos);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("ATAN"), builtin_atan);
 	IF_ERROR(err)
 		return err;
 	err = bamboo_env_set_builtin(*env, _T("EXPT"), builtin_expt);
@@ -307,6 +1460,114 @@ bamboo_error_t populate_builtins(env_t *env) {
 	IF_ERROR(err)
 		return err;
 	err = bamboo_env_set_builtin(*env, _T("MACRO?"), builtin_macrop);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("VECTOR?"), builtin_vectorp);
+	IF_ERROR(err)
+		return err;
+
+	// Numeric vectors.
+	err = bamboo_env_set_builtin(*env, _T("F64VECTOR"), builtin_f64vector);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("I64VECTOR"), builtin_i64vector);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("F32VECTOR"), builtin_f32vector);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("LIST->F64VECTOR"),
+		builtin_list_to_f64vector);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("VECTOR-LENGTH"),
+		builtin_vector_length);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("VECTOR-REF"), builtin_vector_ref);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("VECTOR-SET!"), builtin_vector_set);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("VECTOR->LIST"),
+		builtin_vector_to_list);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("F64V+"), builtin_f64v_add);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("F64V*"), builtin_f64v_mul);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("F64V-SUM"), builtin_f64v_sum);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("F64V-DOT"), builtin_f64v_dot);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("F64V-MIN"), builtin_f64v_min);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("F64V-MAX"), builtin_f64v_max);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("F64V-MAP-AFFINE"),
+		builtin_f64v_map_affine);
+	IF_ERROR(err)
+		return err;
+
+	// Statistics.
+	err = bamboo_env_set_builtin(*env, _T("STATS-SUMMARY"),
+		builtin_stats_summary);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("HISTOGRAM"), builtin_histogram);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("QUANTILES"), builtin_quantiles);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("CUMULATIVE-SUM"),
+		builtin_cumulative_sum);
+	IF_ERROR(err)
+		return err;
+
+	// Sorting.
+	err = bamboo_env_set_builtin(*env, _T("SORT"), builtin_sort);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("SORT!"), builtin_sort_in_place);
+	IF_ERROR(err)
+		return err;
+
+	// Serialization.
+	err = bamboo_env_set_builtin(*env, _T("SERIALIZE"), builtin_serialize);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("DESERIALIZE"), builtin_deserialize);
+	IF_ERROR(err)
+		return err;
+
+	// Parallelism.
+	err = bamboo_env_set_builtin(*env, _T("PMAP"), builtin_pmap);
+	IF_ERROR(err)
+		return err;
+
+	// Tasks.
+	err = bamboo_env_set_builtin(*env, _T("SPAWN"), builtin_spawn);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("YIELD"), builtin_yield);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("MAKE-CHANNEL"), builtin_make_channel);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("CHANNEL-SEND"), builtin_channel_send);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("CHANNEL-RECV"), builtin_channel_recv);
 	IF_ERROR(err)
 		return err;
 
@@ -321,6 +1582,32 @@ bamboo_error_t populate_builtins(env_t *env) {
 	IF_ERROR(err)
 		return err;
 
+	// Strings.
+	err = bamboo_env_set_builtin(*env, _T("STRING-LENGTH"),
+		builtin_string_length);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("SUBSTRING"), builtin_substring);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("STRING-REF"), builtin_string_ref);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("STRING=?"), builtin_string_eq);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("STRING-APPEND"),
+		builtin_string_append);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("STRING-JOIN"), builtin_string_join);
+	IF_ERROR(err)
+		return err;
+	err = bamboo_env_set_builtin(*env, _T("WITH-OUTPUT-TO-STRING"),
+		builtin_with_output_to_string);
+	IF_ERROR(err)
+		return err;
+
 	// Misc.
 	err = bamboo_env_set_builtin(*env, _T("DISPLAY-ENV"), builtin_display_env);
 	IF_ERROR(err)
@@ -369,7 +1656,7 @@ atom_t bamboo_int(int64_t num) {
  * @param  num Double floating-point number.
  * @return     Floating-point atom.
  */
-atom_t bamboo_float(long double num) {
+atom_t bamboo_float(bamboo_float_t num) {
 	atom_t atom;
 
 	// Populate the atom.
@@ -386,18 +1673,62 @@ atom_t bamboo_float(long double num) {
  * @return      Symbol atom.
  */
 atom_t bamboo_symbol(const TCHAR *name) {
+	return symbol_intern(name, _tcslen(name), false);
+}
+
+/**
+ * Gets the interned symbol atom for a name, only allocating a new one the
+ * first time the name is seen.
+ *
+ * @param  name Symbol name. Doesn't need to be terminated.
+ * @param  len  Length of the name.
+ * @param  fold Should the name be converted to upper-case?
+ * @return      Symbol atom.
+ */
+atom_t symbol_intern(const TCHAR *name, size_t len, bool fold) {
 	atom_t atom;
-	atom_t tmp;
 	allocation_t *alloc;
+	symtab_entry_t *table;
+	symtab_entry_t *entry;
+	uint32_t hash;
+	size_t mask;
+	size_t i;
+
+	// Case-fold and hash the name in a single pass.
+	hash = 2166136261u;
+	for (i = 0; i < len; i++) {
+		hash ^= (uint32_t)((fold) ? _totupper(name[i]) : name[i]);
+		hash *= 16777619u;
+	}
+
+	// Make sure the table has room for a new symbol.
+	if ((bamboo_ctx->symtab_count * 2) >= bamboo_ctx->symtab_cap) {
+		if (!symtab_grow())
+			return nil;
+	}
 
 	// Check if the symbol already exists in the symbol table.
-	tmp = bamboo_symbol_table;
-	while (!nilp(tmp)) {
-		atom = car(tmp);
-		if (_tcscmp(*atom.value.symbol, name) == 0)
-			return atom;
+	table = bamboo_ctx->symtab;
+	mask = bamboo_ctx->symtab_cap - 1;
+	for (entry = &table[hash & mask]; entry->alloc != NULL;
+			entry = &table[(entry - table + 1) & mask]) {
+		const TCHAR *str;
 
-		tmp = cdr(tmp);
+		if (entry->hash != hash)
+			continue;
+
+		// Compare the names character by character.
+		str = entry->alloc->data.str;
+		for (i = 0; i < len; i++) {
+			if (str[i] != ((fold) ? _totupper(name[i]) : name[i]))
+				break;
+		}
+		if ((i == len) && (str[len] == _T('\0'))) {
+			atom.type = ATOM_TYPE_SYMBOL;
+			atom.value.symbol = &entry->alloc->data.str;
+
+			return atom;
+		}
 	}
 
 	// Create a new allocation for the symbol name.
@@ -407,23 +1738,76 @@ atom_t bamboo_symbol(const TCHAR *name) {
 			_T("garbage collector symbol allocation tracking"));
 		return nil;
 	}
+	alloc->data.str = (TCHAR *)malloc((len + 1) * sizeof(TCHAR));
+	if (alloc->data.str == NULL) {
+		free(alloc);
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate symbol name"));
+		return nil;
+	}
+	for (i = 0; i < len; i++)
+		alloc->data.str[i] = (fold) ? (TCHAR)_totupper(name[i]) : name[i];
+	alloc->data.str[len] = _T('\0');
 
 	// Fill up the new allocation and push the linked list forward.
 	alloc->mark = GC_TO_FREE;
-	alloc->type = ALLOCATION_TYPE_STRING;
-	alloc->str = _tcsdup(name);
-	alloc->next = bamboo_allocations;
-	bamboo_allocations = alloc;
+	alloc->type = ALLOCATION_TYPE_SYMBOL;
+	alloc->next = bamboo_ctx->allocations;
+	bamboo_ctx->allocations = alloc;
+
+	// Add the symbol to the table.
+	entry->hash = hash;
+	entry->alloc = alloc;
+	bamboo_ctx->symtab_count++;
 
 	// Create the new symbol atom.
 	atom.type = ATOM_TYPE_SYMBOL;
-	atom.value.symbol = &alloc->str;
+	atom.value.symbol = &alloc->data.str;
 
-	// Prepend the symbol atom to the symbol table and return the atom.
-	bamboo_symbol_table = cons(atom, bamboo_symbol_table);
 	return atom;
 }
 
+/**
+ * Doubles the capacity of the interned symbol table.
+ *
+ * @return TRUE if the table was grown successfully.
+ */
+bool symtab_grow(void) {
+	symtab_entry_t *table;
+	size_t cap;
+	size_t mask;
+	size_t i;
+
+	// Allocate the new table.
+	cap = (bamboo_ctx->symtab_cap == 0) ? SYMTAB_MIN_CAP :
+		(bamboo_ctx->symtab_cap * 2);
+	table = (symtab_entry_t *)calloc(cap, sizeof(symtab_entry_t));
+	if (table == NULL) {
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate interned ")
+			_T("symbol table"));
+		return false;
+	}
+
+	// Rehash the existing symbols into it.
+	mask = cap - 1;
+	for (i = 0; i < bamboo_ctx->symtab_cap; i++) {
+		size_t j;
+
+		if (bamboo_ctx->symtab[i].alloc == NULL)
+			continue;
+
+		j = bamboo_ctx->symtab[i].hash & mask;
+		while (table[j].alloc != NULL)
+			j = (j + 1) & mask;
+		table[j] = bamboo_ctx->symtab[i];
+	}
+
+	free(bamboo_ctx->symtab);
+	bamboo_ctx->symtab = table;
+	bamboo_ctx->symtab_cap = cap;
+
+	return true;
+}
+
 /**
  * Build an boolean atom.
  *
@@ -447,29 +1831,20 @@ atom_t bamboo_boolean(bool value) {
  * @return     String atom.
  */
 atom_t bamboo_string(const TCHAR *str) {
-	allocation_t *alloc;
-	atom_t atom;
+	string_t *string;
+	size_t len;
 
-	// Create a new allocation.
-	alloc = (allocation_t *)malloc(sizeof(allocation_t));
-	if (alloc == NULL) {
-		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate structure for ")
-			_T("garbage collector string allocation tracking"));
+	// Allocate the string header and its characters in a single go.
+	len = _tcslen(str);
+	string = string_alloc(len);
+	if (string == NULL) {
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate string ")
+			_T("characters"));
 		return nil;
 	}
+	memcpy((TCHAR *)string->chars, str, (len + 1) * sizeof(TCHAR));
 
-	// Fill up the new allocation and push the linked list forward.
-	alloc->mark = GC_TO_FREE;
-	alloc->type = ALLOCATION_TYPE_STRING;
-	alloc->str = _tcsdup(str);
-	alloc->next = bamboo_allocations;
-	bamboo_allocations = alloc;
-
-	// Create the new string atom.
-	atom.type = ATOM_TYPE_STRING;
-	atom.value.str = &alloc->str;
-
-	return atom;
+	return string_atom(string);
 }
 
 /**
@@ -546,6 +1921,53 @@ atom_t bamboo_pointer(void *pointer) {
 	return atom;
 }
 
+/**
+ * Builds a homogeneous numeric vector atom with all of its elements zeroed.
+ *
+ * @param  type Type of the elements of the vector.
+ * @param  len  Number of elements in the vector.
+ * @return      Vector atom.
+ */
+atom_t bamboo_vector(vector_type_t type, size_t len) {
+	allocation_t *alloc;
+	vector_t *vec;
+	atom_t atom;
+
+	// Allocate the vector header and its contiguous data in a single go.
+	vec = (vector_t *)calloc(1, sizeof(vector_t) +
+		(len * vector_elem_size(type)));
+	if (vec == NULL) {
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate vector ")
+			_T("elements"));
+		return nil;
+	}
+	vec->type = type;
+	vec->len = len;
+	vec->data.raw = (void *)(vec + 1);
+
+	// Create a new allocation.
+	alloc = (allocation_t *)malloc(sizeof(allocation_t));
+	if (alloc == NULL) {
+		free(vec);
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate structure for ")
+			_T("garbage collector vector allocation tracking"));
+		return nil;
+	}
+
+	// Fill up the new allocation and push the linked list forward.
+	alloc->mark = GC_TO_FREE;
+	alloc->type = ALLOCATION_TYPE_VECTOR;
+	alloc->data.vector = vec;
+	alloc->next = bamboo_ctx->allocations;
+	bamboo_ctx->allocations = alloc;
+
+	// Create the new vector atom.
+	atom.type = ATOM_TYPE_VECTOR;
+	atom.value.vector = &alloc->data.vector;
+
+	return atom;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 //                           List Atom Manipulation                           //
@@ -574,12 +1996,12 @@ atom_t cons(atom_t _car, atom_t _cdr) {
 	// Fill up the new allocation and push the linked list forward.
 	alloc->mark = GC_TO_FREE;
 	alloc->type = ALLOCATION_TYPE_PAIR;
-	alloc->next = bamboo_allocations;
-	bamboo_allocations = alloc;
+	alloc->next = bamboo_ctx->allocations;
+	bamboo_ctx->allocations = alloc;
 
 	// Setup the pair atom.
 	pair.type = ATOM_TYPE_PAIR;
-	pair.value.pair = &alloc->pair;
+	pair.value.pair = &alloc->data.pair;
 
 	// Populate the pair.
 	car(pair) = _car;
@@ -715,8 +2137,8 @@ atom_t shallow_copy_list(atom_t list) {
  * @param  list List atom to have its elements counted.
  * @return      Number of elements in the list. 0 if it isn't a valid list.
  */
-uint16_t bamboo_list_count(atom_t list) {
-	uint16_t count = 0;
+size_t bamboo_list_count(atom_t list) {
+	size_t count = 0;
 
 	// Iterate over the list until we reach the final nil atom.
 	while (!nilp(list)) {
@@ -792,6 +2214,175 @@ void bamboo_list_reverse(atom_t *list) {
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
+/*
+ * Scalar lexer kernels. These are also the only ones available when we are
+ * dealing with wide characters.
+ */
+
+static const TCHAR *lk_skip_space_scalar(const TCHAR *str) {
+	while (CHAR_CLASS(*str) & CHAR_CLASS_SPACE)
+		str++;
+
+	return str;
+}
+
+static const TCHAR *lk_find_scalar(const TCHAR *str, TCHAR a, TCHAR b) {
+	while ((*str != a) && (*str != b) && (*str != _T('\0')))
+		str++;
+
+	return str;
+}
+
+#if defined(USE_SIMD_X86) && !defined(UNICODE)
+/*
+ * SSE2 and AVX2 lexer kernels. These only ever use aligned loads, so reading
+ * past the terminator never crosses into a page we don't own, which is also
+ * why the address sanitizer must be kept out of them.
+ */
+
+__attribute__((target("sse2"), no_sanitize_address))
+static const TCHAR *lk_skip_space_sse2(const TCHAR *str) {
+	const __m128i sp = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+
+	// Most runs are short, so go through the unaligned head one at a time.
+	while (((size_t)str & 15) != 0) {
+		if (!(CHAR_CLASS(*str) & CHAR_CLASS_SPACE))
+			return str;
+		str++;
+	}
+
+	for (;; str += 16) {
+		__m128i chunk = _mm_load_si128((const __m128i *)str);
+		__m128i space = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, sp), _mm_cmpeq_epi8(chunk, tab)),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, lf)));
+		unsigned int mask = ~(unsigned int)_mm_movemask_epi8(space) & 0xFFFF;
+
+		if (mask != 0)
+			return str + __builtin_ctz(mask);
+	}
+}
+
+__attribute__((target("sse2"), no_sanitize_address))
+static const TCHAR *lk_find_sse2(const TCHAR *str, TCHAR a, TCHAR b) {
+	const __m128i va = _mm_set1_epi8(a);
+	const __m128i vb = _mm_set1_epi8(b);
+	const __m128i zero = _mm_setzero_si128();
+
+	while (((size_t)str & 15) != 0) {
+		if ((*str == a) || (*str == b) || (*str == _T('\0')))
+			return str;
+		str++;
+	}
+
+	for (;; str += 16) {
+		__m128i chunk = _mm_load_si128((const __m128i *)str);
+		__m128i hit = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)),
+			_mm_cmpeq_epi8(chunk, zero));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(hit);
+
+		if (mask != 0)
+			return str + __builtin_ctz(mask);
+	}
+}
+
+__attribute__((target("avx2"), no_sanitize_address))
+static const TCHAR *lk_skip_space_avx2(const TCHAR *str) {
+	const __m256i sp = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i lf = _mm256_set1_epi8('\n');
+
+	while (((size_t)str & 31) != 0) {
+		if (!(CHAR_CLASS(*str) & CHAR_CLASS_SPACE))
+			return str;
+		str++;
+	}
+
+	for (;; str += 32) {
+		__m256i chunk = _mm256_load_si256((const __m256i *)str);
+		__m256i space = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, sp),
+				_mm256_cmpeq_epi8(chunk, tab)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, cr),
+				_mm256_cmpeq_epi8(chunk, lf)));
+		unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(space);
+
+		if (mask != 0)
+			return str + __builtin_ctz(mask);
+	}
+}
+
+__attribute__((target("avx2"), no_sanitize_address))
+static const TCHAR *lk_find_avx2(const TCHAR *str, TCHAR a, TCHAR b) {
+	const __m256i va = _mm256_set1_epi8(a);
+	const __m256i vb = _mm256_set1_epi8(b);
+	const __m256i zero = _mm256_setzero_si256();
+
+	while (((size_t)str & 31) != 0) {
+		if ((*str == a) || (*str == b) || (*str == _T('\0')))
+			return str;
+		str++;
+	}
+
+	for (;; str += 32) {
+		__m256i chunk = _mm256_load_si256((const __m256i *)str);
+		__m256i hit = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, va),
+				_mm256_cmpeq_epi8(chunk, vb)),
+			_mm256_cmpeq_epi8(chunk, zero));
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(hit);
+
+		if (mask != 0)
+			return str + __builtin_ctz(mask);
+	}
+}
+#endif  // USE_SIMD_X86 && !UNICODE
+
+/**
+ * Builds the character class table and selects the best lexer kernels for the
+ * CPU we are running on.
+ */
+void lexer_init(void) {
+	const TCHAR *tmp;
+
+	// Populate the character class table.
+	memset(bamboo_char_class, 0, sizeof(bamboo_char_class));
+	for (tmp = _T(" \t\r\n"); *tmp != _T('\0'); tmp++)
+		bamboo_char_class[(uint8_t)*tmp] |= CHAR_CLASS_SPACE;
+	for (tmp = _T("()\"; \t\r\n"); *tmp != _T('\0'); tmp++)
+		bamboo_char_class[(uint8_t)*tmp] |= CHAR_CLASS_DELIM;
+	for (tmp = _T("()\'`\";"); *tmp != _T('\0'); tmp++)
+		bamboo_char_class[(uint8_t)*tmp] |= CHAR_CLASS_PREFIX;
+	bamboo_char_class[0] |= CHAR_CLASS_DELIM;
+
+	// Start with the scalar fallbacks.
+	bamboo_lkernels.skip_space = lk_skip_space_scalar;
+	bamboo_lkernels.find = lk_find_scalar;
+
+#if defined(USE_SIMD_X86) && !defined(UNICODE)
+	__builtin_cpu_init();
+
+	// Upgrade to SSE2 if we can.
+	if (__builtin_cpu_supports("sse2")) {
+		bamboo_lkernels.skip_space = lk_skip_space_sse2;
+		bamboo_lkernels.find = lk_find_sse2;
+	} else {
+		return;
+	}
+
+	// Upgrade to AVX2 if we can.
+	if (__builtin_cpu_supports("avx2")) {
+		bamboo_lkernels.skip_space = lk_skip_space_avx2;
+		bamboo_lkernels.find = lk_find_avx2;
+	}
+#endif  // USE_SIMD_X86 && !UNICODE
+}
+
 /**
  * A very simple lexer to find the beginning and the end of tokens in a string.
  *
@@ -802,13 +2393,15 @@ void bamboo_list_reverse(atom_t *list) {
  *               reached the end of the string without finding any tokens.
  */
 bamboo_error_t lex(const TCHAR *str, token_t *token) {
-	const TCHAR *tmp = str;
-	const TCHAR *wspace = _T(" \t\r\n");
-	const TCHAR *delim = _T("()\"; \t\r\n");
-	const TCHAR *prefix = _T("()\'`\";");
+	const TCHAR *tmp;
 
-	// Skip any leading whitespace.
-	tmp += _tcsspn(tmp, wspace);
+	// Skip any leading whitespace, which is usually just a single space.
+	tmp = str;
+	if (CHAR_CLASS(*tmp) & CHAR_CLASS_SPACE) {
+		// Long runs are better left to the vectorized kernels.
+		if (CHAR_CLASS(*++tmp) & CHAR_CLASS_SPACE)
+			tmp = bamboo_lkernels.skip_space(tmp);
+	}
 
 	// Check if this was an empty line.
 	if (tmp[0] == _T('\0')) {
@@ -822,7 +2415,7 @@ bamboo_error_t lex(const TCHAR *str, token_t *token) {
 	token->start = tmp;
 
 	// Check if the token is just a parenthesis or unquotation.
-	if (_tcschr(prefix, tmp[0]) != NULL) {
+	if (CHAR_CLASS(tmp[0]) & CHAR_CLASS_PREFIX) {
 		token->end = tmp + 1;
 		return BAMBOO_OK;
 	} else if (tmp[0] == _T(',')) {
@@ -833,7 +2426,10 @@ bamboo_error_t lex(const TCHAR *str, token_t *token) {
 	}
 
 	// Find the end of the token.
-	token->end = tmp + _tcscspn(tmp, delim);
+	for (tmp++; !(CHAR_CLASS(*tmp) & CHAR_CLASS_DELIM); tmp++)
+		;
+	token->end = tmp;
+
 	return BAMBOO_OK;
 }
 
@@ -861,6 +2457,8 @@ bamboo_error_t bamboo_parse_expr(const TCHAR *input, const TCHAR **end,
 		case BAMBOO_EMPTY_LINE:
 			*atom = nil;
 			return err;
+		default:
+			break;
 		}
 	}
 
@@ -912,9 +2510,8 @@ bamboo_error_t bamboo_parse_expr(const TCHAR *input, const TCHAR **end,
 bamboo_error_t parse_primitive(const token_t *token, const TCHAR **end,
 							   atom_t *atom) {
 	TCHAR *buf;
-	TCHAR *buftmp;
-	const TCHAR *tmp;
-#ifndef _tcstold
+	size_t len;
+#ifndef _tcstofloat
 	int cret = 0;
 #endif
 
@@ -926,7 +2523,13 @@ bamboo_error_t parse_primitive(const token_t *token, const TCHAR **end,
 	if (((token->start[0] >= _T('0')) && (token->start[0] <= _T('9'))) ||
 			(token->start[0] == _T('+')) || (token->start[0] == _T('-'))) {
 		int64_t integer;
-		long double dfloat;
+		bamboo_float_t dfloat;
+
+		// Plain decimal numbers can be parsed quickly without the C library.
+		if (parse_decimal(token->start, token->end, atom)) {
+			*end = token->end;
+			return BAMBOO_OK;
+		}
 
 #if defined(_MSC_VER) && (_MSC_VER <= 1400)
 		// Create a string with only the number.
@@ -951,14 +2554,22 @@ bamboo_error_t parse_primitive(const token_t *token, const TCHAR **end,
 			buf = NULL;
 		}
 #else
+#ifndef _WIN32_WCE
+		errno = 0;
+#endif  // _WIN32_WCE
 		integer = _tcstoll(token->start, &buf, 0);
 #endif  // _MSC_VER
 		if (buf == token->end) {
 #ifndef _WIN32_WCE
 			// Check for overflows/underflows.
 			if (errno == ERANGE) {
-				*atom = nil;
+				// Too big for a regular integer, so let's try a big one.
+				if (bignum_parse(token->start, token->end, atom)) {
+					*end = token->end;
+					return BAMBOO_OK;
+				}
 
+				*atom = nil;
 				if (integer == LLONG_MAX) {
 					return bamboo_error(BAMBOO_ERROR_NUM_OVERFLOW,
 						_T("An integer overflow occured while parsing"));
@@ -980,26 +2591,29 @@ bamboo_error_t parse_primitive(const token_t *token, const TCHAR **end,
 		}
 
 		// Try to parse an float.
-#ifndef _tcstold
-		cret = _stscanf(token->start, "%lg", &dfloat);
+#ifndef _tcstofloat
+		cret = _stscanf(token->start, FLOAT_SCAN_SPEC, &dfloat);
 		if ((cret != 0) && (cret != EOF)) {
 			buf = token->end;
 		} else {
 			buf = NULL;
 		}
 #else
-		dfloat = _tcstold(token->start, &buf);
-#endif  // _tcstold
+#ifndef _WIN32_WCE
+		errno = 0;
+#endif  // _WIN32_WCE
+		dfloat = _tcstofloat(token->start, &buf);
+#endif  // _tcstofloat
 		if (buf == token->end) {
 #ifndef _WIN32_WCE
 			// Check for overflows/underflows.
 			if (errno == ERANGE) {
 				*atom = nil;
 
-				if (dfloat == HUGE_VALL) {
+				if (dfloat == FLOAT_HUGE_VAL) {
 					return bamboo_error(BAMBOO_ERROR_NUM_OVERFLOW,
 						_T("An float overflow occured while parsing"));
-				} else if (dfloat == LDBL_MIN) {
+				} else if (dfloat == FLOAT_MIN_VAL) {
 					return bamboo_error(BAMBOO_ERROR_NUM_UNDERFLOW,
 						_T("An float underflow occured while parsing"));
 				}
@@ -1021,33 +2635,20 @@ bamboo_error_t parse_primitive(const token_t *token, const TCHAR **end,
 symbolparser:
 #endif  // _MSC_VER
 
-	// Allocate string for symbol upper-case conversion.
-	buf = (TCHAR *)malloc(sizeof(TCHAR) * (token->end - token->start + 1));
-	if (buf == NULL) {
-		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate string ")
-			_T("for symbol upper-case conversion"));
-	}
-
-	// Convert the symbol to upper-case.
-	buftmp = buf;
-	tmp = token->start;
-	while (tmp != token->end)
-		*buftmp++ = _totupper(*tmp++);
-	*buftmp = _T('\0');
-
 	// Check if we are dealing with a NIL symbol.
-	if (_tcscmp(buf, _T("NIL")) == 0) {
+	len = token->end - token->start;
+	if ((len == 3) && (_totupper(token->start[0]) == _T('N')) &&
+			(_totupper(token->start[1]) == _T('I')) &&
+			(_totupper(token->start[2]) == _T('L'))) {
 		*atom = nil;
 	} else {
 		// Looks like a regular symbol.
-		*atom = bamboo_symbol(buf);
+		*atom = symbol_intern(token->start, len, true);
 	}
 
 	// Set the end pointer.
 	*end = token->end;
 
-	// Clean up and return OK.
-	free(buf);
 	return BAMBOO_OK;
 }
 
@@ -1062,6 +2663,8 @@ symbolparser:
  */
 bamboo_error_t parse_hash_expr(const token_t *token, const TCHAR **end,
 							   atom_t *atom) {
+	vector_type_t type;
+
 	// Check if we don't have an invalid syntax.
 	if ((token->start + 1) == token->end) {
 		return bamboo_error(BAMBOO_ERROR_SYNTAX,
@@ -1069,6 +2672,10 @@ bamboo_error_t parse_hash_expr(const token_t *token, const TCHAR **end,
 			_T("character"));
 	}
 
+	// Check if we are dealing with a numeric vector literal.
+	if (vector_prefix(token, &type))
+		return parse_vector(token, type, end, atom);
+
 	// Check which kind of special value we are dealing with.
 	switch (token->start[1]) {
 	case _T('F'):
@@ -1087,6 +2694,85 @@ bamboo_error_t parse_hash_expr(const token_t *token, const TCHAR **end,
 	}
 }
 
+/**
+ * Checks if a token is the prefix of a numeric vector literal.
+ *
+ * @param  token Pointer to token structure that holds the hash expression.
+ * @param  type  Pointer to the variable that will hold the type of the
+ *               elements of the vector.
+ * @return       TRUE if the token is a numeric vector prefix.
+ */
+bool vector_prefix(const token_t *token, vector_type_t *type) {
+	TCHAR prefix[4];
+	uint8_t i;
+
+	// All of the prefixes have the same length.
+	if ((token->end - token->start) != 4)
+		return false;
+
+	// Get the vector prefix in upper-case for comparison.
+	for (i = 0; i < 3; i++)
+		prefix[i] = _totupper(token->start[i + 1]);
+	prefix[3] = _T('\0');
+
+	if (_tcscmp(prefix, _T("F64")) == 0) {
+		*type = VECTOR_TYPE_F64;
+	} else if (_tcscmp(prefix, _T("I64")) == 0) {
+		*type = VECTOR_TYPE_I64;
+	} else if (_tcscmp(prefix, _T("F32")) == 0) {
+		*type = VECTOR_TYPE_F32;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Parses a numeric vector literal in the form of #f64(1 2 3).
+ *
+ * @param  token Pointer to token structure that holds the vector prefix.
+ * @param  type  Type of the elements of the vector.
+ * @param  end   Pointer to the end of the last parsed part of the expression.
+ * @param  atom  Pointer to an atom structure that will hold the parsed atom.
+ * @return       BAMBOO_OK if we were able to parse the vector correctly.
+ */
+bamboo_error_t parse_vector(const token_t *token, vector_type_t type,
+							const TCHAR **end, atom_t *atom) {
+	bamboo_error_t err;
+	atom_t items;
+	size_t i;
+
+	// Vector elements must be supplied right after the prefix as a list.
+	if (*token->end != _T('(')) {
+		return bamboo_error(BAMBOO_ERROR_SYNTAX,
+			_T("Vector literals must be followed by a list of numbers"));
+	}
+
+	// Parse the elements as a regular list.
+	err = parse_list(token->end + 1, end, &items);
+	IF_ERROR(err)
+		return err;
+
+	// Check if we actually have a proper list.
+	if (!listp(items)) {
+		return bamboo_error(BAMBOO_ERROR_SYNTAX,
+			_T("Vector literals can't be made out of pairs"));
+	}
+
+	// Populate the vector with the parsed elements.
+	*atom = bamboo_vector(type, bamboo_list_count(items));
+	for (i = 0; !nilp(items); i++) {
+		err = vector_elem_set(*atom->value.vector, i, car(items));
+		IF_ERROR(err)
+			return err;
+
+		items = cdr(items);
+	}
+
+	return BAMBOO_OK;
+}
+
 /**
  * Parses a string from a given token.
  *
@@ -1098,51 +2784,174 @@ bamboo_error_t parse_hash_expr(const token_t *token, const TCHAR **end,
  */
 bamboo_error_t parse_string(const token_t *token, const TCHAR **end,
 							atom_t *atom) {
-	size_t len;
-	TCHAR *buf;
-	TCHAR *buftmp;
 	const TCHAR *tmp;
+	bool escapes = false;
 
-	// Calculate the length of our string.
-	tmp = token->end;
-	len = 0;
-	while (*tmp != _T('\"')) {
-		// Check if the string is never terminated.
-		if (*tmp == _T('\0')) {
-			*end = tmp;
-			return bamboo_error(BAMBOO_ERROR_SYNTAX, _T("String never terminated"));
-		}
+	// Find the end of our string.
+	tmp = string_scan(token->end, &escapes);
+	if (*tmp != _T('\"')) {
+		*end = tmp;
+		return bamboo_error(BAMBOO_ERROR_SYNTAX, _T("String never terminated"));
+	}
 
-		tmp++;
-		len++;
+	// Build the string atom.
+	*end = tmp + 1;
+	return string_literal(token->end, tmp - token->end, escapes, atom);
+}
+
+/**
+ * Finds the closing quote of a string literal, skipping over escaped
+ * characters along the way.
+ *
+ * @param  str     First character of the contents of the literal.
+ * @param  escapes Pointer to a flag that will be set if any escape sequences
+ *                 were found. It's never cleared, so it can be carried over
+ *                 from a previous piece of the same literal.
+ * @return         Pointer to the closing quote, to the end of the input if the
+ *                 literal was never terminated, or to a backslash that was left
+ *                 dangling right before the end of the input.
+ */
+const TCHAR *string_scan(const TCHAR *str, bool *escapes) {
+	for (;;) {
+		str = bamboo_lkernels.find(str, _T('\"'), _T('\\'));
+		if (*str != _T('\\'))
+			return str;
+
+		// Skip over the escaped character.
+		*escapes = true;
+		if (str[1] == _T('\0'))
+			return str;
+		str += 2;
 	}
+}
 
-	// Allocate space for our string.
-	buf = (TCHAR *)malloc((len + 1) * sizeof(TCHAR));
-	if (buf == NULL) {
+/**
+ * Builds a string atom out of the contents of a string literal, decoding its
+ * escape sequences straight into the storage of the string.
+ *
+ * @param  start   Beginning of the contents of the literal.
+ * @param  len     Length of the contents of the literal.
+ * @param  escapes Does the literal contain any escape sequences?
+ * @param  atom    Pointer to an atom structure that will hold the string.
+ * @return         BAMBOO_OK if the string was built successfully.
+ */
+bamboo_error_t string_literal(const TCHAR *start, size_t len, bool escapes,
+							  atom_t *atom) {
+	bamboo_error_t err;
+	string_t *string;
+	TCHAR *chars;
+
+	// Escape sequences only ever shrink, so the raw length is enough.
+	string = string_alloc(len);
+	if (string == NULL) {
 		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate string ")
 			_T("for string atom"));
 	}
 
-	// Pre-terminate the string.
-	buf[len] = _T('\0');
-
-	// Copy the string into our buffer.
-	tmp = token->end;
-	buftmp = buf;
-	while (*tmp != _T('\"')) {
-		*buftmp = *tmp++;
-		buftmp++;
+	// Get the characters into the string.
+	chars = (TCHAR *)string->chars;
+	if (escapes) {
+		err = string_unescape(start, len, chars, &string->len);
+		IF_ERROR(err) {
+			free(string);
+			return err;
+		}
+		chars[string->len] = _T('\0');
+	} else {
+		memcpy(chars, start, len * sizeof(TCHAR));
 	}
 
-	// Make the atom and free our buffer.
-	*end = ++tmp;
-	*atom = bamboo_string(buf);
-	free(buf);
+	// Make the atom. Literals tend to be compared over and over, so get their
+	// hash ready.
+	*atom = string_atom(string);
+	string_hash(string);
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Decodes the escape sequences of a string literal. Supports \", \\, \n, \t
+ * and \x<hex>; for arbitrary code points.
+ *
+ * @param  src  Raw contents of the literal.
+ * @param  len  Length of the raw contents of the literal.
+ * @param  dst  Buffer that will hold the decoded characters. Must be able to
+ *              hold at least len characters.
+ * @param  dlen Pointer to the variable that will hold the decoded length.
+ * @return      BAMBOO_OK if all of the escape sequences were valid.
+ */
+bamboo_error_t string_unescape(const TCHAR *src, size_t len, TCHAR *dst,
+							   size_t *dlen) {
+	const TCHAR *end = src + len;
+	TCHAR *tmp = dst;
+	uint32_t cp;
+	int digit;
+
+	while (src < end) {
+		// Copy regular characters straight away.
+		if (*src != _T('\\')) {
+			*tmp++ = *src++;
+			continue;
+		}
+
+		// Decode the escape sequence.
+		src++;
+		switch ((src < end) ? *src : _T('\0')) {
+		case _T('\"'):
+		case _T('\\'):
+			*tmp++ = *src++;
+			break;
+		case _T('n'):
+			*tmp++ = _T('\n');
+			src++;
+			break;
+		case _T('t'):
+			*tmp++ = _T('\t');
+			src++;
+			break;
+		case _T('x'):
+		case _T('X'):
+			// Gather the hexadecimal code point up to the semicolon.
+			cp = 0;
+			for (src++; (src < end) && (*src != _T(';')); src++) {
+				digit = hex_digit(*src);
+				if ((digit < 0) || (cp > 0x10FFFF)) {
+					return bamboo_error(BAMBOO_ERROR_SYNTAX,
+						_T("Invalid hexadecimal escape in string"));
+				}
+				cp = (cp << 4) | (uint32_t)digit;
+			}
+			if ((src == end) || (cp == 0) || (cp > 0x10FFFF) ||
+					((cp >= 0xD800) && (cp <= 0xDFFF))) {
+				return bamboo_error(BAMBOO_ERROR_SYNTAX,
+					_T("Invalid hexadecimal escape in string"));
+			}
+			src++;
+
+			tmp += encode_codepoint(tmp, cp);
+			break;
+		default:
+			return bamboo_error(BAMBOO_ERROR_SYNTAX,
+				_T("Unknown escape sequence in string"));
+		}
+	}
 
+	*dlen = tmp - dst;
 	return BAMBOO_OK;
 }
 
+/**
+ * Checks if a token is the delimiter of a dotted pair. Only a lone dot counts,
+ * anything else that starts with one (like ...) is just a symbol.
+ *
+ * @param  start Pointer to the first character of the token.
+ * @param  end   Pointer to the character right after the token.
+ * @return       TRUE if the token is a pair delimiter.
+ */
+bool pair_delimiter_p(const TCHAR *start, const TCHAR *end) {
+	return ((end - start) == 1) && (*start == _T('.'));
+}
+
 /**
  * Parses an list expression.
  *
@@ -1169,13 +2978,16 @@ bamboo_error_t parse_list(const TCHAR *input, const TCHAR **end, atom_t *atom) {
 
 	while (!(err = lex(token.end, &token))) {
 		// Check if we have a pair.
-		if (token.start[0] == _T('.')) {
+		if (pair_delimiter_p(token.start, token.end)) {
 			token_t test_token;
 
 			// Check if the pair separator is the first token in the atom.
 			if (nilp(*atom)) {
 				return bamboo_error(BAMBOO_ERROR_SYNTAX,
 					_T("Pair delimiter without left-hand atom"));
+			} else if (is_pair) {
+				return bamboo_error(BAMBOO_ERROR_SYNTAX,
+					_T("Tried to append an atom to a pair"));
 			}
 
 			// Check if we have something after the pair separator.
@@ -1257,10 +3069,7 @@ bamboo_error_t parse_comment(const token_t *token, const TCHAR **end,
 	*atom = nil;
 
 	// Skip to the nearest newline character or string terminator.
-	tmp = token->end;
-	while ((*tmp != _T('\0')) && (*tmp != _T('\n'))) {
-		tmp++;
-	}
+	tmp = bamboo_lkernels.find(token->end, _T('\n'), _T('\n'));
 
 	// We've reached the end of the comment.
 	*end = tmp;
@@ -1268,2345 +3077,11213 @@ bamboo_error_t parse_comment(const token_t *token, const TCHAR **end,
 	return BAMBOO_COMMENT;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-//                                                                            //
-//                                 Evaluation                                 //
-//                                                                            //
-////////////////////////////////////////////////////////////////////////////////
-
 /**
- * Evaluates an expression in a given environment.
+ * Finds the boundaries of the next top-level form without building it, along
+ * with the name it defines in case it's a (define name ...), a
+ * (define (name args...) ...) or a define-macro form. This allows definitions
+ * to be indexed and only parsed when they are actually needed.
  *
- * This function used to be so simple, but used recursion and caused stack
- * overflows in deep recursions, so it had to be re-written, for the older
- * version check the commit 0d1bc6c.
- *
- * @param  expr   Expression to be evaluated.
- * @param  env    Environment list to use for this evaluation.
- * @param  result Pointer to the resulting atom of the evaluation.
- * @return        BAMBOO_OK if the evaluation was successful.
- *
- * @see https://lwh.jp/lisp/continuations.html
+ * @param  input Source code to be scanned.
+ * @param  start Pointer that will hold the beginning of the form.
+ * @param  end   Pointer that will hold the point right after the form.
+ * @param  name  Pointer to the symbol defined by the form or nil if it isn't a
+ *               definition.
+ * @return       BAMBOO_OK if a form was found, BAMBOO_EMPTY_LINE if there's
+ *               nothing but whitespace and comments left.
  */
-bamboo_error_t bamboo_eval_expr(atom_t expr, env_t env, atom_t *result) {
-	frame_t stack;
-	bamboo_error_t err;
-
-	// Clean slate.
-	err = BAMBOO_OK;
-	stack = nil;
-	*result = nil;
+bamboo_error_t bamboo_scan_form(const TCHAR *input, const TCHAR **start,
+								const TCHAR **end, atom_t *name) {
+	vector_type_t vtype;
+	token_t token;
+	atom_t symbol;
+	size_t depth;
+	size_t elem;
+	bool definition;
+	bool escapes;
+	bool named;
+
+	// Start from a clean slate.
+	*start = NULL;
+	*end = input;
+	*name = nil;
+	depth = 0;
+	elem = 0;
+	definition = false;
+	named = true;
+
+	for (;;) {
+		// Get the next token.
+		if (lex(*end, &token) == BAMBOO_EMPTY_LINE) {
+			*end = token.start;
+			if (*start != NULL) {
+				return bamboo_error(BAMBOO_ERROR_SYNTAX,
+					_T("Expression never terminated"));
+			}
 
-	do {
-		// Should we trigger the garbage collector?
-		if (++bamboo_gc_iter_counter == GC_ITER_COUNT_SWEEP) {
-			// Mark our current parameters as in use for good measure.
-			gc_mark(expr);
-			gc_mark(env);
-			gc_mark(stack);
+			*start = token.start;
+			return BAMBOO_EMPTY_LINE;
+		}
+		*end = token.end;
 
-			// Collect the garbage and reset the iteration counter.
-			gc(true);
-			bamboo_gc_iter_counter = 0;
+		// Comments are skipped entirely.
+		if (token.start[0] == _T(';')) {
+			*end = bamboo_lkernels.find(token.end, _T('\n'), _T('\n'));
+			continue;
 		}
 
-		// Check if the expression is simple and doesn't require manipulation.
-		if (expr.type == ATOM_TYPE_SYMBOL) {
-			// A symbol from the environment was requested.
-			err = bamboo_env_get(env, expr, result);
-		} else if (expr.type != ATOM_TYPE_PAIR) {
-			// Literals always evaluate to themselves.
-			*result = expr;
-		} else {
-			atom_t op;
-			atom_t args;
+		// Mark the beginning of the form.
+		if (*start == NULL)
+			*start = token.start;
 
-			// Get the op and its arguments.
-			op = car(expr);
-			args = cdr(expr);
+		// Quotes and vector prefixes belong to whatever comes after them.
+		if ((token.start[0] == _T('\'')) || (token.start[0] == _T('`')) ||
+				(token.start[0] == _T(',')) || ((token.start[0] == _T('#')) &&
+				(*token.end == _T('(')) && vector_prefix(&token, &vtype))) {
+			continue;
+		}
 
-			// Check if it's a special form to be evaluated.
-			if (op.type == ATOM_TYPE_SYMBOL) {
-				// Check which special form we need to evaluate.
-				if (_tcscmp(*op.value.symbol, _T("QUOTE")) == 0) {
-					// Check if we have the single required arguments.
-					if (bamboo_list_count(args) != 1) {
-						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-							_T("Wrong number of arguments. Expected 1"));
-					}
+		// Strings may contain delimiters, so we have to find their real end.
+		if (token.start[0] == _T('\"')) {
+			*end = string_scan(token.start + 1, &escapes);
+			if (**end != _T('\"')) {
+				return bamboo_error(BAMBOO_ERROR_SYNTAX,
+					_T("String never terminated"));
+			}
+			(*end)++;
+		}
 
-					// Return the arguments without evaluating.
-					*result = car(args);
-				} else if (_tcscmp(*op.value.symbol, _T("IF")) == 0) {
-					// Check if we have the right number of arguments.
-					if (bamboo_list_count(args) != 3) {
-						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-							_T("Wrong number of arguments. Expected 3"));
-					}
+		// Keep track of the items of the top-level list to find out which name
+		// is being defined.
+		if (token.start[0] == _T(')')) {
+			if (depth == 0) {
+				return bamboo_error(BAMBOO_ERROR_SYNTAX,
+					_T("Unexpected closing parenthesis"));
+			}
+			depth--;
+		} else if (depth == 1) {
+			if (elem == 0) {
+				definition = scan_symbol(&token, &symbol) &&
+					(SPECIAL_FORM_P(symbol, SPECIAL_FORM_DEFINE) ||
+					SPECIAL_FORM_P(symbol, SPECIAL_FORM_DEFINE_MACRO));
+			} else if ((elem == 1) && definition) {
+				// Function definitions have their name inside a list.
+				named = token.start[0] != _T('(');
+				if (named && scan_symbol(&token, &symbol))
+					*name = symbol;
+			}
+			elem++;
+		} else if ((depth == 2) && !named) {
+			named = true;
+			if (scan_symbol(&token, &symbol))
+				*name = symbol;
+		}
 
-					// Place it in the stack for later evaluation.
-					stack = new_stack_frame(stack, env, cdr(args));
-					bamboo_list_set(stack, STACK_EVAL_OP_INDEX, op);
-					expr = car(args);
+		// Go into lists.
+		if (token.start[0] == _T('(')) {
+			depth++;
+			continue;
+		}
 
-					continue;
-				} else if (_tcscmp(*op.value.symbol, _T("DEFINE")) == 0) {
-					atom_t symbol;
+		// Check if the form is complete.
+		if (depth == 0)
+			return BAMBOO_OK;
+	}
+}
 
-					// Check if we have both of the required 2 arguments.
-					if (bamboo_list_count(args) < 2) {
-						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-							_T("Wrong number of arguments. Expected at least 2"));
-					}
+/**
+ * Checks if a token is a symbol and interns it.
+ *
+ * @param  token  Token to be checked.
+ * @param  symbol Pointer to the atom that will hold the symbol.
+ * @return        TRUE if the token is a symbol.
+ */
+bool scan_symbol(const token_t *token, atom_t *symbol) {
+	const TCHAR *end;
 
-					// Get the reference symbol.
-					symbol = car(args);
-					switch (symbol.type) {
-					case ATOM_TYPE_SYMBOL:
-						// Defining a simple symbol.
-						stack = new_stack_frame(stack, env, nil);
-						bamboo_list_set(stack, STACK_EVAL_OP_INDEX, op);
-						bamboo_list_set(stack, STACK_EVAL_ARGS_INDEX, symbol);
-						expr = car(cdr(args));
-						continue;
-					case ATOM_TYPE_PAIR:
-						// Build a closure since we are using the define lambda
-						// shorthand.
-						err = bamboo_closure(env, cdr(symbol), cdr(args),
-							result);
-						symbol = car(symbol);
+	// Hash expressions, strings and lists can't be symbols.
+	if ((token->start[0] == _T('#')) || (token->start[0] == _T('\"')) ||
+			(token->start[0] == _T('(')) || (token->start[0] == _T(')'))) {
+		return false;
+	}
 
-						// Check if we actually have a symbol for closure name.
-						if (symbol.type != ATOM_TYPE_SYMBOL) {
-							return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-								_T("First element of argument 0 list should be a ")
-								_T("symbol"));
-						}
+	return (parse_primitive(token, &end, symbol) == BAMBOO_OK) &&
+		(symbol->type == ATOM_TYPE_SYMBOL);
+}
 
-						// Put the symbol in th environment.
-						(void)bamboo_env_set(env, symbol, *result);
-						*result = symbol;
-						break;
-					default:
-						return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-							_T("Argument 0 should be of type symbol or pair"));
-					}
-				} else if (_tcscmp(*op.value.symbol, _T("LAMBDA")) == 0) {
-					// Check if we have both of the required 2 arguments.
-					if (bamboo_list_count(args) < 2) {
-						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-							_T("Wrong number of arguments. Expected at least 2"));
-					}
+/**
+ * Creates a new incremental parser that accepts its input in arbitrary chunks
+ * and hands out top-level forms as soon as they are complete.
+ *
+ * @param  parser Pointer to the variable that will hold the new parser.
+ * @return        BAMBOO_OK if the parser was created successfully.
+ */
+bamboo_error_t bamboo_parser_new(bamboo_parser_t **parser) {
+	bamboo_error_t err;
 
-					// Make the closure.
-					err = bamboo_closure(env, car(args), cdr(args), result);
-				} else if (_tcscmp(*op.value.symbol, _T("DEFINE-MACRO")) == 0) {
-					atom_t name;
-					atom_t macro;
+	// Allocate the parser.
+	*parser = (bamboo_parser_t *)calloc(1, sizeof(bamboo_parser_t));
+	if (*parser == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+			_T("incremental parser"));
+	}
 
-					// Check if we have both of the required 2 arguments.
-					if (bamboo_list_count(args) < 2) {
-						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-							_T("Wrong number of arguments. Expected at least 2"));
-					}
+	// Get the buffer for partial tokens ready.
+	err = strbuf_init(&(*parser)->partial, STRBUF_MIN_CAP);
+	IF_ERROR(err) {
+		free(*parser);
+		*parser = NULL;
 
-					// Check if the first argument is defined like a define
-					// lambda shorthand.
-					if (car(args).type != ATOM_TYPE_PAIR) {
-						return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-							_T("First argument must be a pair or a list like when ")
-							_T("defining a function using only define"));
-					}
+		return err;
+	}
 
-					// Get macro name.
-					name = car(car(args));
-					if (name.type != ATOM_TYPE_SYMBOL) {
-						return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-							_T("Macro name must be of type symbol"));
-					}
+	// Register the parser so that its unfinished lists survive collections.
+	(*parser)->state = PARSER_STATE_IDLE;
+	(*parser)->next = bamboo_ctx->parsers;
+	bamboo_ctx->parsers = *parser;
 
-					// Make the macro.
-					err = bamboo_closure(env, cdr(car(args)), cdr(args),
-						&macro);
-					IF_NOT_ERROR(err) {
-						// Return the name symbol and add the macro to the
-						// environment.
-						macro.type = ATOM_TYPE_MACRO;
-						*result = name;
-						(void)bamboo_env_set(env, name, macro);
-					}
-				} else if (_tcscmp(*op.value.symbol, _T("APPLY")) == 0) {
-					// Check if we have both of the required 2 arguments.
-					if (bamboo_list_count(args) < 2) {
-						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-							_T("Wrong number of arguments. Expected at least 2"));
-					}
+	return BAMBOO_OK;
+}
 
-					// Evaluate the apply by the magic of the stack.
-					stack = new_stack_frame(stack, env, cdr(args));
-					bamboo_list_set(stack, STACK_EVAL_OP_INDEX, op);
-					expr = car(args);
-					continue;
-				} else {
-					goto push;
-				}
-			} else if (op.type == ATOM_TYPE_BUILTIN) {
-				// Execute a built-in function.
-				err = (*op.value.builtin)(args, result);
-			} else {
-				// Handle a closure or macro.
-push:
-				stack = new_stack_frame(stack, env, args);
-				expr = op;
-				continue;
-			}
-		}
+/**
+ * Frees up an incremental parser, discarding anything left unfinished.
+ *
+ * @param parser Parser to be freed.
+ */
+void bamboo_parser_free(bamboo_parser_t *parser) {
+	bamboo_parser_t **tmp;
 
-		// Are we at the end of the stack?
-		if (nilp(stack))
-			break;
+	if (parser == NULL)
+		return;
 
-		// Get the return value from the stack frame evaluation.
-		IF_NOT_ERROR(err)
-			err = eval_expr_return(&stack, &expr, &env, result);
-	} while (err <= BAMBOO_OK);
+	// Unregister the parser.
+	for (tmp = &bamboo_ctx->parsers; *tmp != NULL; tmp = &(*tmp)->next) {
+		if (*tmp == parser) {
+			*tmp = parser->next;
+			break;
+		}
+	}
 
-	return err;
+	strbuf_free(&parser->partial);
+	free(parser->frames);
+	free(parser);
 }
 
 /**
- * Creates a brand new virtual stack frame used to allow us to not run into CPU
- * stack overflows while evaluating expressions.
- *
- * To be honest I have no clue how this whole thing is working, I just want to
- * make sure we don't run into stack overflows.
- *
- * This is how the stack frame structure should look like:
- * (parent env evaluated-op (pending-arg...) (evaluated-arg...) (body...))
- *
- * @param  parent Parent stack frame.
- * @param  env    Environment for the stack frame to be evaluated in.
- * @param  tail   Rest of the stack frame to be evaluated later.
- * @return        A brand new stack frame atom.
+ * Discards any unfinished form the parser is holding on to.
  *
- * @see https://lwh.jp/lisp/continuations.html
+ * @param parser Parser to be reset.
  */
-frame_t new_stack_frame(frame_t parent, env_t env, atom_t tail) {
-	return cons(parent, cons(env, cons(nil /* evaluated-op */, cons(tail,
-   		cons(nil /* evaluated-args */, cons(nil /* body */, nil))))));
+void bamboo_parser_reset(bamboo_parser_t *parser) {
+	parser->depth = 0;
+	parser->state = PARSER_STATE_IDLE;
+	parser->partial.len = 0;
+	parser->partial.buf[0] = _T('\0');
 }
 
 /**
- * Grabs the current expression to be evaluated from the body of the stack
- * frame.
- *
- * To be honest I have no clue how this whole thing is working, I just want to
- * make sure we don't run into stack overflows.
- *
- * @param  stack Pointer to the stack frame we are currently evaluating.
- * @param  expr  Pointer to the expression that will be grabbed from the stack
- *               to be evaluated later.
- * @param  env   Pointer to the environment where the current expression will be
- *               evaluated in. This will also come from our stack frame.
- * @return       BAMBOO_OK if everything went fine.
+ * Checks if the parser is in the middle of a form and needs more input to
+ * finish it.
  *
- * @see https://lwh.jp/lisp/continuations.html
+ * @param  parser Parser to be checked.
+ * @return        TRUE if there's an unfinished form.
  */
-bamboo_error_t eval_expr_exec(frame_t *stack, atom_t *expr, env_t *env) {
-	atom_t body;
-
-	// Get the different parts of the stack.
-	*env = bamboo_list_ref(*stack, STACK_ENV_INDEX);
-	body = bamboo_list_ref(*stack, STACK_BODY_INDEX);
-	*expr = car(body);
-
-	// Check the next item in line.
-	body = cdr(body);
-	if (nilp(body)) {
-		// We've reached the of this stack. Pop the stack to its parent.
-		*stack = car(*stack);
-	} else {
-		// Advance the body of the atom to the next item in line.
-		bamboo_list_set(*stack, STACK_BODY_INDEX, body);
-	}
-
-	return BAMBOO_OK;
+bool bamboo_parser_pending(const bamboo_parser_t *parser) {
+	return (parser->depth > 0) || ((parser->state != PARSER_STATE_IDLE) &&
+		(parser->state != PARSER_STATE_COMMENT));
 }
 
 /**
- * Binds function arguments into the new stack frame environment if they haven't
- * been bound already.
- *
- * To be honest I have no clue how this whole thing is working, I just want to
- * make sure we don't run into stack overflows.
- *
- * @param  stack Pointer to the stack frame we are currently evaluating.
- * @param  expr  Pointer to the expression that will be grabbed from the stack
- *               to be evaluated later.
- * @param  env   Pointer to the environment where the current expression will be
- *               evaluated in. This will also come from our stack frame.
- * @return       BAMBOO_OK if everything went fine.
+ * Feeds a chunk of input to the parser. Every top-level form that gets
+ * completed by this chunk is handed to the callback function right away, and
+ * anything left unfinished is kept for the next chunk.
  *
- * @see https://lwh.jp/lisp/continuations.html
+ * @param  parser Parser to be fed.
+ * @param  chunk  Chunk of input. Can end anywhere, even in the middle of a
+ *                token.
+ * @param  end    Pointer that will hold the point where the parsing stopped.
+ *                Can be NULL.
+ * @param  func   Function that will receive the complete top-level forms.
+ * @param  arg    Argument to be passed along to the callback function.
+ * @return        BAMBOO_OK if the whole chunk was consumed. Any error returned
+ *                by the callback function stops the parsing.
  */
-bamboo_error_t eval_expr_bind(frame_t *stack, atom_t *expr, env_t *env) {
-	atom_t op;
-	atom_t args;
-	atom_t arg_names;
-	atom_t body;
-
-	// If we have anything in the body just return it then.
-	body = bamboo_list_ref(*stack, STACK_BODY_INDEX);
-	if (!nilp(body))
-		return eval_expr_exec(stack, expr, env);
+bamboo_error_t bamboo_parser_feed(bamboo_parser_t *parser, const TCHAR *chunk,
+								  const TCHAR **end, bamboo_form_func_t func,
+								  void *arg) {
+	bamboo_error_t err = BAMBOO_OK;
+	const TCHAR *tmp = chunk;
+	const TCHAR *stop;
+	atom_t atom;
+	bool opened;
+
+	// Pick up where the previous chunk left us.
+	switch (parser->state) {
+	case PARSER_STATE_TOKEN:
+		// Gather the rest of the token.
+		for (stop = tmp; !(CHAR_CLASS(*stop) & CHAR_CLASS_DELIM); stop++)
+			;
+		err = strbuf_append(&parser->partial, tmp, stop - tmp);
+		IF_ERROR(err)
+			goto fail;
+		tmp = stop;
+		if (*tmp == _T('\0'))
+			goto done;
+
+		// Parse the whole token.
+		parser->state = PARSER_STATE_IDLE;
+		err = parser_token(parser, parser->partial.buf,
+			parser->partial.buf + parser->partial.len, *tmp, func, arg,
+			&opened);
+		parser->partial.len = 0;
+		IF_ERROR(err)
+			goto fail;
+		if (opened)
+			tmp++;
+		break;
+	case PARSER_STATE_STRING_ESCAPE:
+		// Finish off the escape sequence that got split between chunks.
+		if (*tmp == _T('\0'))
+			goto done;
+		err = strbuf_append(&parser->partial, tmp, 1);
+		IF_ERROR(err)
+			goto fail;
+		tmp++;
+		parser->state = PARSER_STATE_STRING;
+		// Fallthrough...
+	case PARSER_STATE_STRING:
+		// Gather the rest of the string.
+		stop = string_scan(tmp, &parser->escapes);
+		if (*stop == _T('\\')) {
+			stop++;
+			parser->state = PARSER_STATE_STRING_ESCAPE;
+		}
+		err = strbuf_append(&parser->partial, tmp, stop - tmp);
+		IF_ERROR(err)
+			goto fail;
+		tmp = stop;
+		if (*tmp == _T('\0'))
+			goto done;
 
-	// Get the op and function arguments from the stack frame.
-	op = bamboo_list_ref(*stack, STACK_EVAL_OP_INDEX);
-	args = bamboo_list_ref(*stack, STACK_EVAL_ARGS_INDEX);
+		// Build the whole string.
+		tmp++;
+		parser->state = PARSER_STATE_IDLE;
+		err = string_literal(parser->partial.buf, parser->partial.len,
+			parser->escapes, &atom);
+		parser->partial.len = 0;
+		IF_ERROR(err)
+			goto fail;
+		err = parser_deliver(parser, atom, func, arg);
+		IF_ERROR(err)
+			goto fail;
+		break;
+	case PARSER_STATE_COMMENT:
+		// Skip the rest of the comment.
+		tmp = bamboo_lkernels.find(tmp, _T('\n'), _T('\n'));
+		if (*tmp == _T('\0'))
+			goto done;
+		parser->state = PARSER_STATE_IDLE;
+		break;
+	case PARSER_STATE_COMMA:
+		// Check if this is an unquote or an unquote splicing.
+		if (*tmp == _T('\0'))
+			goto done;
+		parser->state = PARSER_STATE_IDLE;
+		err = parser_push_frame(parser, PARSER_FRAME_QUOTE,
+			bamboo_symbol((*tmp == _T('@')) ? _T("UNQUOTE-SPLICING") :
+			_T("UNQUOTE")));
+		IF_ERROR(err)
+			goto fail;
+		if (*tmp == _T('@'))
+			tmp++;
+		break;
+	case PARSER_STATE_IDLE:
+		break;
+	}
 
-	// Get all of the parameters from the stack frame.
-	*env = bamboo_env_new(car(op));
-	arg_names = car(cdr(op));
-	body = cdr(cdr(op));
-	bamboo_list_set(*stack, STACK_ENV_INDEX, *env);
-	bamboo_list_set(*stack, STACK_BODY_INDEX, body);
+	// Go through the rest of the chunk.
+	for (;;) {
+		// Skip any whitespace.
+		if (CHAR_CLASS(*tmp) & CHAR_CLASS_SPACE)
+			tmp = bamboo_lkernels.skip_space(tmp);
+
+		switch (*tmp) {
+		case _T('\0'):
+			// We need more input.
+			goto done;
+		case _T('('):
+			// List beginning.
+			err = parser_push_frame(parser, PARSER_FRAME_LIST, nil);
+			tmp++;
+			break;
+		case _T(')'):
+			// List ending.
+			err = parser_close(parser, func, arg);
+			tmp++;
+			break;
+		case _T('\''):
+			// Quote
+			err = parser_push_frame(parser, PARSER_FRAME_QUOTE,
+				bamboo_symbol(_T("QUOTE")));
+			tmp++;
+			break;
+		case _T('`'):
+			// Quasiquote
+			err = parser_push_frame(parser, PARSER_FRAME_QUOTE,
+				bamboo_symbol(_T("QUASIQUOTE")));
+			tmp++;
+			break;
+		case _T(','):
+			// Unquote, which needs to know what comes next.
+			tmp++;
+			if (*tmp == _T('\0')) {
+				parser->state = PARSER_STATE_COMMA;
+				goto done;
+			}
+			err = parser_push_frame(parser, PARSER_FRAME_QUOTE,
+				bamboo_symbol((*tmp == _T('@')) ? _T("UNQUOTE-SPLICING") :
+				_T("UNQUOTE")));
+			if (*tmp == _T('@'))
+				tmp++;
+			break;
+		case _T(';'):
+			// Comment
+			tmp = bamboo_lkernels.find(tmp + 1, _T('\n'), _T('\n'));
+			if (*tmp == _T('\0')) {
+				parser->state = PARSER_STATE_COMMENT;
+				goto done;
+			}
+			break;
+		case _T('\"'):
+			// String, which might continue in the next chunk.
+			parser->escapes = false;
+			stop = string_scan(tmp + 1, &parser->escapes);
+			if (*stop != _T('\"')) {
+				parser->state = PARSER_STATE_STRING;
+				if (*stop == _T('\\')) {
+					stop++;
+					parser->state = PARSER_STATE_STRING_ESCAPE;
+				}
 
-	// Go through the arguments binding them to the environment.
-	while (!nilp(arg_names)) {
-		// Looks like we just have a symbol, nothing else to do here.
-		if (arg_names.type == ATOM_TYPE_SYMBOL) {
-			bamboo_env_set(*env, arg_names, args);
-			args = nil;
+				err = strbuf_append(&parser->partial, tmp + 1,
+					stop - tmp - 1);
+				tmp = stop;
+				break;
+			}
+
+			err = string_literal(tmp + 1, stop - tmp - 1, parser->escapes,
+				&atom);
+			tmp = stop + 1;
+			IF_NOT_ERROR(err)
+				err = parser_deliver(parser, atom, func, arg);
 			break;
-		}
+		default:
+			// Primitive, which might continue in the next chunk.
+			for (stop = tmp + 1; !(CHAR_CLASS(*stop) & CHAR_CLASS_DELIM);
+					stop++)
+				;
+			if (*stop == _T('\0')) {
+				err = strbuf_append(&parser->partial, tmp, stop - tmp);
+				parser->state = PARSER_STATE_TOKEN;
+				tmp = stop;
+				break;
+			}
 
-		// Not enough argument values given the amount of argument names.
-		if (nilp(args)) {
- 			return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
- 				_T("Argument value list ended prematurely"));
+			err = parser_token(parser, tmp, stop, *stop, func, arg, &opened);
+			tmp = (opened) ? (stop + 1) : stop;
+			break;
 		}
 
-		// Push the argument into the environment.
-		bamboo_env_set(*env, car(arg_names), car(args));
+		IF_ERROR(err)
+			goto fail;
+	}
 
-		// Move to the next argument.
-		arg_names = cdr(arg_names);
-		args = cdr(args);
+done:
+	if (end != NULL)
+		*end = tmp;
+	return BAMBOO_OK;
+
+fail:
+	if (end != NULL)
+		*end = tmp;
+	bamboo_parser_reset(parser);
+	return err;
+}
+
+/**
+ * Tells the parser that there's no more input coming, handing out the last
+ * top-level form if the input ended right after it.
+ *
+ * @param  parser Parser to be finished.
+ * @param  func   Function that will receive the last top-level form.
+ * @param  arg    Argument to be passed along to the callback function.
+ * @return        BAMBOO_OK if there wasn't anything left unfinished.
+ */
+bamboo_error_t bamboo_parser_finish(bamboo_parser_t *parser,
+									bamboo_form_func_t func, void *arg) {
+	bamboo_error_t err = BAMBOO_OK;
+	bool opened;
+
+	// Deal with whatever was left halfway through.
+	switch (parser->state) {
+	case PARSER_STATE_TOKEN:
+		err = parser_token(parser, parser->partial.buf,
+			parser->partial.buf + parser->partial.len, _T('\0'), func, arg,
+			&opened);
+		break;
+	case PARSER_STATE_STRING:
+	case PARSER_STATE_STRING_ESCAPE:
+		err = bamboo_error(BAMBOO_ERROR_SYNTAX, _T("String never terminated"));
+		break;
+	case PARSER_STATE_COMMA:
+		err = bamboo_error(BAMBOO_ERROR_SYNTAX,
+			_T("Unquote without an expression"));
+		break;
+	default:
+		break;
 	}
 
-	// Check if we have arguments remaining.
-	if (!nilp(args)) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("Arguments left over after iterating through argument names"));
+	// Check if we still have open lists or quotes.
+	IF_NOT_ERROR(err) {
+		if (parser->depth > 0) {
+			err = bamboo_error(BAMBOO_ERROR_SYNTAX,
+				_T("Expression never terminated"));
+		}
 	}
 
-	bamboo_list_set(*stack, STACK_EVAL_ARGS_INDEX, nil);
-	return eval_expr_exec(stack, expr, env);
+	bamboo_parser_reset(parser);
+	return err;
 }
 
 /**
- * Once all arguments have been evaluated, this function is responsible for
- * generating an expression to call a builtin, or delegating to 'eval_do_bind'.
- *
- * To be honest I have no clue how this whole thing is working, I just want to
- * make sure we don't run into stack overflows.
- *
- * @param  stack Pointer to the stack frame we are currently evaluating.
- * @param  expr  Pointer to the expression that will be grabbed from the stack
- *               to be evaluated later.
- * @param  env   Pointer to the environment where the current expression will be
- *               evaluated in. This will also come from our stack frame.
- * @return       BAMBOO_OK if everything went fine.
+ * Opens a new list, vector or quote in the parser.
  *
- * @see https://lwh.jp/lisp/continuations.html
+ * @param  parser Incremental parser.
+ * @param  kind   Kind of frame to be opened.
+ * @param  head   Quote symbol if we are opening a quote, nil otherwise.
+ * @return        BAMBOO_OK if the frame was opened.
  */
-bamboo_error_t eval_expr_apply(frame_t *stack, atom_t *expr, env_t *env) {
-	atom_t op;
-	atom_t args;
-
-	// Get the op and arguments from the stack frame.
-	op = bamboo_list_ref(*stack, STACK_EVAL_OP_INDEX);
-	args = bamboo_list_ref(*stack, STACK_EVAL_ARGS_INDEX);
+bamboo_error_t parser_push_frame(bamboo_parser_t *parser,
+								 parser_frame_kind_t kind, atom_t head) {
+	parser_frame_t *frame;
+
+	// Make sure we have room for another frame.
+	if (parser->depth == parser->cap) {
+		size_t cap = (parser->cap == 0) ? PARSER_FRAMES_MIN_CAP :
+			(parser->cap * 2);
+
+		frame = (parser_frame_t *)realloc(parser->frames,
+			cap * sizeof(parser_frame_t));
+		if (frame == NULL) {
+			return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+				_T("incremental parser frames"));
+		}
 
-	// Reverse the arguments if we have any.
-	if (!nilp(args)) {
-		bamboo_list_reverse(&args);
-		bamboo_list_set(*stack, STACK_EVAL_ARGS_INDEX, args);
+		parser->frames = frame;
+		parser->cap = cap;
 	}
 
-	// Handle the apply special form.
-	if (op.type == ATOM_TYPE_SYMBOL) {
-		if (_tcscmp(*op.value.symbol, _T("APPLY")) == 0) {
-			// Replace the current frame.
-			*stack = car(*stack);
-			*stack = new_stack_frame(*stack, *env, nil);
-			op = car(args);
-			args = car(cdr(args));
+	// Populate the new frame.
+	frame = &parser->frames[parser->depth++];
+	frame->kind = kind;
+	frame->vtype = VECTOR_TYPE_F64;
+	frame->head = head;
+	frame->last = nil;
+	frame->dotted = false;
+	frame->closed = false;
 
-			// Check if we actually have an arguments list.
-			if (!listp(args)) {
-				return bamboo_error(BAMBOO_ERROR_SYNTAX,
-					_T("Arguments atom must be of list type"));
-			}
+	return BAMBOO_OK;
+}
 
-			// Go to the next one.
-			bamboo_list_set(*stack, STACK_EVAL_OP_INDEX, op);
-			bamboo_list_set(*stack, STACK_EVAL_ARGS_INDEX, args);
-		}
+/**
+ * Hands a complete expression to the innermost open frame, or to the callback
+ * function if it was a top-level form.
+ *
+ * @param  parser Incremental parser.
+ * @param  atom   Complete expression.
+ * @param  func   Function that will receive the complete top-level forms.
+ * @param  arg    Argument to be passed along to the callback function.
+ * @return        BAMBOO_OK if the expression was delivered.
+ */
+bamboo_error_t parser_deliver(bamboo_parser_t *parser, atom_t atom,
+							  bamboo_form_func_t func, void *arg) {
+	parser_frame_t *frame;
+	atom_t cell;
+
+	// Quotes are done as soon as they get their expression.
+	while ((parser->depth > 0) &&
+			(parser->frames[parser->depth - 1].kind == PARSER_FRAME_QUOTE)) {
+		parser->depth--;
+		atom = cons(parser->frames[parser->depth].head, cons(atom, nil));
 	}
 
-	// Handle built-ins.
-	if (op.type == ATOM_TYPE_BUILTIN) {
-		*stack = car(*stack);
-		*expr = cons(op, args);
+	// Top-level forms go straight to the callback.
+	if (parser->depth == 0)
+		return (func != NULL) ? func(atom, arg) : BAMBOO_OK;
+
+	// Check if we are trying to append something to a pair.
+	frame = &parser->frames[parser->depth - 1];
+	if (frame->closed) {
+		return bamboo_error(BAMBOO_ERROR_SYNTAX,
+			_T("Tried to append an atom to a pair"));
+	}
+
+	// Check if we are dealing with a pair.
+	if (frame->dotted) {
+		cdr(frame->last) = atom;
+		frame->closed = true;
 
 		return BAMBOO_OK;
-	} else if (op.type != ATOM_TYPE_CLOSURE) {
-		// Looks like we don't have anything that's "apply"able.
-		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-			_T("Applyable op must be either a built-in or a closure"));
 	}
 
-	return eval_expr_bind(stack, expr, env);
+	// Append a new item to the list.
+	cell = cons(atom, nil);
+	if (nilp(frame->head)) {
+		frame->head = cell;
+	} else {
+		cdr(frame->last) = cell;
+	}
+	frame->last = cell;
+
+	return BAMBOO_OK;
 }
 
 /**
- * Once an expression has been evaluated, this function is responsible for
- * storing the result, which is either an op, an argument, or an
- * intermediate body expression, and fetching the next expression to evaluate.
- *
- * To be honest I have no clue how this whole thing is working, I just want to
- * make sure we don't run into stack overflows.
- *
- * @param  stack  Pointer to the stack frame we are currently evaluating.
- * @param  expr   Pointer to the expression that will be grabbed from the stack
- *                to be evaluated later.
- * @param  env    Pointer to the environment where the current expression will be
- *                evaluated in. This will also come from our stack frame.
- * @param  result Pointer to the return value of the evaluated stack frame.
- * @return        BAMBOO_OK if everything went fine.
+ * Closes the innermost open list or vector.
  *
- * @see https://lwh.jp/lisp/continuations.html
+ * @param  parser Incremental parser.
+ * @param  func   Function that will receive the complete top-level forms.
+ * @param  arg    Argument to be passed along to the callback function.
+ * @return        BAMBOO_OK if the list was closed.
  */
-bamboo_error_t eval_expr_return(frame_t *stack, atom_t *expr, env_t *env,
-		atom_t *result) {
-	atom_t op;
-	atom_t args;
-	atom_t body;
+bamboo_error_t parser_close(bamboo_parser_t *parser, bamboo_form_func_t func,
+							void *arg) {
+	bamboo_error_t err;
+	parser_frame_t *frame;
+	atom_t atom;
 
-	// Gets the parameters from the stack frame.
-	*env = bamboo_list_ref(*stack, STACK_ENV_INDEX);
-	op = bamboo_list_ref(*stack, STACK_EVAL_OP_INDEX);
-	body = bamboo_list_ref(*stack, STACK_BODY_INDEX);
+	// Check if we have anything to close.
+	if (parser->depth == 0) {
+		return bamboo_error(BAMBOO_ERROR_SYNTAX,
+			_T("Closing parenthesis without an opening one"));
+	}
 
-	// Check if we are still running a procedure. If so, just ignore the result.
-	if (!nilp(body))
-		return eval_expr_apply(stack, expr, env);
+	// Check if the list is in a state where it can be closed.
+	frame = &parser->frames[parser->depth - 1];
+	if (frame->kind == PARSER_FRAME_QUOTE) {
+		return bamboo_error(BAMBOO_ERROR_SYNTAX,
+			_T("Quote without an expression"));
+	} else if (frame->dotted && !frame->closed) {
+		return bamboo_error(BAMBOO_ERROR_SYNTAX,
+			_T("Pair ends without right-hand atom"));
+	}
+	parser->depth--;
 
-	// Check in which phase of evaluation we are currently at.
-	if (nilp(op)) {
-		// Finished evaluating op.
-		op = *result;
-		bamboo_list_set(*stack, STACK_EVAL_OP_INDEX, op);
+	// Turn numeric vector literals into actual vectors.
+	atom = frame->head;
+	if (frame->kind == PARSER_FRAME_VECTOR) {
+		if (!listp(atom)) {
+			return bamboo_error(BAMBOO_ERROR_SYNTAX,
+				_T("Vector literals can't be made out of pairs"));
+		}
 
-		// Are we doing a macro?
-		if (op.type == ATOM_TYPE_MACRO) {
-			// Don't evaluate macro arguments.
-			args = bamboo_list_ref(*stack, STACK_PENDING_ARGS_INDEX);
+		err = list_to_vector(frame->vtype, atom, &atom);
+		IF_ERROR(err)
+			return err;
+	}
 
-			*stack = new_stack_frame(*stack, *env, nil);
-			op.type = ATOM_TYPE_CLOSURE;
-			bamboo_list_set(*stack, STACK_EVAL_OP_INDEX, op);
-			bamboo_list_set(*stack, STACK_EVAL_ARGS_INDEX, args);
+	return parser_deliver(parser, atom, func, arg);
+}
 
-			return eval_expr_bind(stack, expr, env);
-		}
-	} else if (op.type == ATOM_TYPE_SYMBOL) {
-		// Finished working on an special form.
-		if (_tcscmp(*op.value.symbol, _T("DEFINE")) == 0) {
-			atom_t symbol;
+/**
+ * Handles a complete primitive token.
+ *
+ * @param  parser Incremental parser.
+ * @param  start  Beginning of the token.
+ * @param  end    End of the token.
+ * @param  next   Character right after the token.
+ * @param  func   Function that will receive the complete top-level forms.
+ * @param  arg    Argument to be passed along to the callback function.
+ * @param  opened Pointer to a flag that will be set if the character right
+ *                after the token was consumed to open a vector literal.
+ * @return        BAMBOO_OK if the token was handled.
+ */
+bamboo_error_t parser_token(bamboo_parser_t *parser, const TCHAR *start,
+							const TCHAR *end, TCHAR next,
+							bamboo_form_func_t func, void *arg, bool *opened) {
+	bamboo_error_t err;
+	parser_frame_t *frame;
+	vector_type_t type;
+	token_t token;
+	atom_t atom;
 
-			symbol = bamboo_list_ref(*stack, STACK_EVAL_ARGS_INDEX);
-			(void)bamboo_env_set(*env, symbol, *result);
-			*stack = car(*stack);
-			*expr = cons(bamboo_symbol(_T("QUOTE")), cons(symbol, nil));
+	*opened = false;
+	token.start = start;
+	token.end = end;
+	frame = (parser->depth > 0) ? &parser->frames[parser->depth - 1] : NULL;
 
-			return BAMBOO_OK;
-		} else if (_tcscmp(*op.value.symbol, _T("IF")) == 0) {
-			args = bamboo_list_ref(*stack, STACK_PENDING_ARGS_INDEX);
+	// Check if we have a pair.
+	if (pair_delimiter_p(start, end) && (frame != NULL) &&
+			(frame->kind != PARSER_FRAME_QUOTE)) {
+		if (nilp(frame->head)) {
+			return bamboo_error(BAMBOO_ERROR_SYNTAX,
+				_T("Pair delimiter without left-hand atom"));
+		} else if (frame->dotted) {
+			return bamboo_error(BAMBOO_ERROR_SYNTAX,
+				_T("Tried to append an atom to a pair"));
+		}
 
-			// Choose which path to go for an if statement.
-			if ((result->type == ATOM_TYPE_BOOLEAN) && (!result->value.boolean)) {
-				*expr = car(cdr(args));
-			} else {
-				*expr = car(args);
-			}
+		frame->dotted = true;
+		return BAMBOO_OK;
+	}
 
-			*stack = car(*stack);
-			return BAMBOO_OK;
-		} else {
-			goto store_argument;
+	// Check if we are opening a numeric vector literal.
+	if ((*start == _T('#')) && vector_prefix(&token, &type)) {
+		if (next != _T('(')) {
+			return bamboo_error(BAMBOO_ERROR_SYNTAX,
+				_T("Vector literals must be followed by a list of numbers"));
 		}
-	} else if (op.type == ATOM_TYPE_MACRO) {
-		// Finished evaluating macro.
-		*expr = *result;
-		*stack = car(*stack);
+
+		err = parser_push_frame(parser, PARSER_FRAME_VECTOR, nil);
+		IF_ERROR(err)
+			return err;
+		parser->frames[parser->depth - 1].vtype = type;
+		*opened = true;
 
 		return BAMBOO_OK;
-	} else {
-store_argument:
-		// Store the evaluated argument.
-		args = bamboo_list_ref(*stack, STACK_EVAL_ARGS_INDEX);
-		bamboo_list_set(*stack, STACK_EVAL_ARGS_INDEX, cons(*result, args));
 	}
 
-	// Get the next set of arguments to evaluate.
-	args = bamboo_list_ref(*stack, STACK_PENDING_ARGS_INDEX);
-	if (nilp(args)) {
-		// No more arguments left to evaluate.
-		return eval_expr_apply(stack, expr, env);
-	}
+	// Primitive it is.
+	err = parse_primitive(&token, &end, &atom);
+	IF_ERROR(err)
+		return err;
 
-	// Evaluate the next argument.
-	*expr = car(args);
-	bamboo_list_set(*stack, STACK_PENDING_ARGS_INDEX, cdr(args));
-
-	return BAMBOO_OK;
-}
+	return parser_deliver(parser, atom, func, arg);
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
-//                                Environment                                 //
+//                                 Evaluation                                 //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
 /**
- * Creates a new child environment list.
+ * Evaluates an expression in a given environment.
  *
- * @param  parent Parent environment to this new child.
- * @return        New child environment list.
+ * @param  expr   Expression to be evaluated.
+ * @param  env    Environment list to use for this evaluation.
+ * @param  result Pointer to the resulting atom of the evaluation.
+ * @return        BAMBOO_OK if the evaluation was successful.
  */
-env_t bamboo_env_new(env_t parent) {
-	return cons(parent, nil);
+bamboo_error_t bamboo_eval_expr(atom_t expr, env_t env, atom_t *result) {
+	bamboo_eval_t state;
+	eval_root_t root;
+	bamboo_error_t err;
+
+	// Start from an empty stack.
+	state.expr = expr;
+	state.env = env;
+	state.stack = nil;
+	memset(&state.task, 0, sizeof(task_t));
+	state.current = NULL;
+
+	// Register this evaluation as a garbage collection root, since built-ins
+	// may call closures that trigger a collection in a nested evaluation.
+	root.prev = bamboo_ctx->eval_roots;
+	bamboo_ctx->eval_roots = &root;
+
+	// Only evaluations that aren't nested take turns with spawned tasks.
+	if (root.prev == NULL)
+		task_enter(&state);
+	err = eval_expr_loop(&state, result, SIZE_MAX, &root);
+	if (root.prev == NULL)
+		task_settle(&state, err);
+
+	bamboo_ctx->eval_roots = root.prev;
+	return err;
 }
 
 /**
- * Gets a symbol definition from an environment list recursively searching
- * through its parents.
+ * Starts an evaluation that can be run a few steps at a time with
+ * bamboo_eval_step, so that the host doesn't have to wait for long running
+ * scripts to finish. It must be released with bamboo_eval_finish before the
+ * interpreter is destroyed.
  *
- * @param  env    Environment list to search for the desired symbol in.
- * @param  symbol Symbol you're searching for.
- * @param  atom   Pointer to the resulting atom of the symbol definition.
- * @return        BAMBOO_OK if the symbol was found. BAMBOO_ERROR_UNBOUND
- *                otherwise.
+ * @param  expr  Expression to be evaluated.
+ * @param  env   Environment list to use for this evaluation.
+ * @param  state Pointer to the state of the newly started evaluation.
+ * @return       BAMBOO_OK if the evaluation was started successfully.
  */
-bamboo_error_t bamboo_env_get(env_t env, atom_t symbol, atom_t *atom) {
-	env_t parent = car(env);
-	env_t current = cdr(env);
+bamboo_error_t bamboo_eval_begin(atom_t expr, env_t env,
+								 bamboo_eval_t **state) {
+	// Allocate the evaluation state.
+	*state = (bamboo_eval_t *)calloc(1, sizeof(bamboo_eval_t));
+	if (*state == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+			_T("Can't allocate evaluation state"));
+	}
 
-	// Clean up the result just in case.
-	*atom = nil;
+	// Nothing has been evaluated yet.
+	(*state)->expr = expr;
+	(*state)->env = env;
+	(*state)->stack = nil;
+	(*state)->result = nil;
+	(*state)->err = BAMBOO_SUSPENDED;
 
-	// Iterate through the symbols in the environment list.
-	while (!nilp(current)) {
-		// Get symbol-value pair.
-		atom_t item = car(current);
+	// Keep its state safe from the garbage collector.
+	(*state)->prev = NULL;
+	(*state)->next = bamboo_ctx->evals;
+	if (bamboo_ctx->evals != NULL)
+		bamboo_ctx->evals->prev = *state;
+	bamboo_ctx->evals = *state;
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Carries on with an evaluation started with bamboo_eval_begin until it's done
+ * or it has taken a number of steps. Closures called from within built-in
+ * functions always run to completion in a single step.
+ *
+ * @param  state     Evaluation to carry on with.
+ * @param  max_steps Maximum number of steps to be taken.
+ * @return           BAMBOO_SUSPENDED if the evaluation ran out of steps,
+ *                   BAMBOO_OK if it's done, or the error it ran into.
+ */
+bamboo_error_t bamboo_eval_step(bamboo_eval_t *state, size_t max_steps) {
+	eval_root_t root;
+
+	// Evaluations that are over have nothing else to do.
+	if (state->err != BAMBOO_SUSPENDED)
+		return state->err;
+
+	// Register this evaluation as a garbage collection root while it runs.
+	root.prev = bamboo_ctx->eval_roots;
+	bamboo_ctx->eval_roots = &root;
+
+	if (root.prev == NULL)
+		task_enter(state);
+	state->err = eval_expr_loop(state, &state->result, max_steps, &root);
+	if (root.prev == NULL)
+		task_settle(state, state->err);
+
+	bamboo_ctx->eval_roots = root.prev;
+	return state->err;
+}
+
+/**
+ * Carries on with an evaluation started with bamboo_eval_begin until it's done
+ * or a wall clock deadline has passed.
+ *
+ * @param  state   Evaluation to carry on with.
+ * @param  timeout Time in microseconds that the evaluation is allowed to run
+ *                 for.
+ * @return         BAMBOO_SUSPENDED if the evaluation ran out of time,
+ *                 BAMBOO_OK if it's done, or the error it ran into.
+ */
+bamboo_error_t bamboo_eval_step_timed(bamboo_eval_t *state,
+									  uint32_t timeout) {
+	bamboo_error_t err;
+	uint64_t start;
+
+	// Check the clock every once in a while.
+	start = eval_clock_usec();
+	do {
+		err = bamboo_eval_step(state, EVAL_DEADLINE_STEPS);
+	} while ((err == BAMBOO_SUSPENDED) &&
+		((eval_clock_usec() - start) < timeout));
+
+	return err;
+}
+
+/**
+ * Releases an evaluation started with bamboo_eval_begin. Evaluations that
+ * haven't finished yet are simply abandoned.
+ *
+ * @param  state  Evaluation to be released.
+ * @param  result Pointer to the resulting atom of the evaluation.
+ * @return        BAMBOO_OK if the evaluation finished successfully,
+ *                BAMBOO_SUSPENDED if it was abandoned, or the error it ran
+ *                into.
+ */
+bamboo_error_t bamboo_eval_finish(bamboo_eval_t *state, atom_t *result) {
+	bamboo_error_t err;
+
+	// Get the outcome of the evaluation.
+	err = state->err;
+	*result = (err == BAMBOO_OK) ? state->result : nil;
+
+	// Drop the task that was left halfway through.
+	if ((state->current != NULL) && (state->current != &state->task))
+		task_free(state->current);
+	task_unqueue(&state->task);
+
+	// Let the garbage collector have its state.
+	if (state->prev != NULL) {
+		state->prev->next = state->next;
+	} else {
+		bamboo_ctx->evals = state->next;
+	}
+	if (state->next != NULL)
+		state->next->prev = state->prev;
+	free(state);
+
+	return err;
+}
+
+/**
+ * Gets a monotonic wall clock time.
+ *
+ * @return Current time in microseconds since an arbitrary point.
+ */
+uint64_t eval_clock_usec(void) {
+#ifdef _WIN32
+	return (uint64_t)GetTickCount() * 1000;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+#endif  // _WIN32
+}
+
+/**
+ * Evaluation loop that does the actual evaluation of an expression.
+ *
+ * This function used to be so simple, but used recursion and caused stack
+ * overflows in deep recursions, so it had to be re-written, for the older
+ * version check the commit 0d1bc6c.
+ *
+ * @param  state  Evaluation to carry on with. Its expression, environment and
+ *                stack are updated if it runs out of steps.
+ * @param  result Pointer to the resulting atom of the evaluation.
+ * @param  steps  Maximum number of steps to be taken.
+ * @param  root   Garbage collection root of this evaluation.
+ * @return        BAMBOO_OK if the evaluation was successful. BAMBOO_SUSPENDED
+ *                if it ran out of steps.
+ *
+ * @see https://lwh.jp/lisp/continuations.html
+ */
+bamboo_error_t eval_expr_loop(bamboo_eval_t *state, atom_t *result,
+							  size_t steps, eval_root_t *root) {
+	atom_t expr;
+	env_t env;
+	frame_t stack;
+	bamboo_error_t err;
+
+	// Pick up from where we left off.
+	err = BAMBOO_OK;
+	expr = state->expr;
+	env = state->env;
+	stack = state->stack;
+	*result = nil;
+
+	// Let the garbage collector know where our state lives.
+	root->expr = &expr;
+	root->env = &env;
+	root->stack = &stack;
+
+	do {
+		// Hand control back to the host if we ran out of steps.
+		if (steps-- == 0) {
+			state->expr = expr;
+			state->env = env;
+			state->stack = stack;
+
+			return BAMBOO_SUSPENDED;
+		}
+
+		// Should we trigger the garbage collector?
+		if (++bamboo_ctx->gc_iter_counter == GC_ITER_COUNT_SWEEP) {
+			// Mark the state of every evaluation in progress as in use.
+			gc_mark_roots();
+
+			// Collect the garbage and reset the iteration counter.
+			gc(true);
+			bamboo_ctx->gc_iter_counter = 0;
+		}
+
+		// Check if the expression is simple and doesn't require manipulation.
+		if (expr.type == ATOM_TYPE_SYMBOL) {
+			// A symbol from the environment was requested.
+			err = bamboo_env_get(env, expr, result);
+		} else if (expr.type != ATOM_TYPE_PAIR) {
+			// Literals always evaluate to themselves.
+			*result = expr;
+		} else {
+			atom_t op;
+			atom_t args;
+
+			// Get the op and its arguments.
+			op = car(expr);
+			args = cdr(expr);
+
+			// Check if it's a special form to be evaluated.
+			if (op.type == ATOM_TYPE_SYMBOL) {
+				// Check which special form we need to evaluate.
+				if (SPECIAL_FORM_P(op, SPECIAL_FORM_QUOTE)) {
+					// Check if we have the single required arguments.
+					if (bamboo_list_count(args) != 1) {
+						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+							_T("Wrong number of arguments. Expected 1"));
+					}
+
+					// Return the arguments without evaluating.
+					*result = car(args);
+				} else if (SPECIAL_FORM_P(op, SPECIAL_FORM_IF)) {
+					// Check if we have the right number of arguments.
+					if (bamboo_list_count(args) != 3) {
+						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+							_T("Wrong number of arguments. Expected 3"));
+					}
+
+					// Place it in the stack for later evaluation.
+					stack = new_stack_frame(stack, env, cdr(args));
+					bamboo_list_set(stack, STACK_EVAL_OP_INDEX, op);
+					expr = car(args);
+
+					continue;
+				} else if (SPECIAL_FORM_P(op, SPECIAL_FORM_DEFINE)) {
+					atom_t symbol;
+
+					// Check if we have both of the required 2 arguments.
+					if (bamboo_list_count(args) < 2) {
+						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+							_T("Wrong number of arguments. Expected at least 2"));
+					}
+
+					// Get the reference symbol.
+					symbol = car(args);
+					switch (symbol.type) {
+					case ATOM_TYPE_SYMBOL:
+						// Defining a simple symbol.
+						stack = new_stack_frame(stack, env, nil);
+						bamboo_list_set(stack, STACK_EVAL_OP_INDEX, op);
+						bamboo_list_set(stack, STACK_EVAL_ARGS_INDEX, symbol);
+						expr = car(cdr(args));
+						continue;
+					case ATOM_TYPE_PAIR:
+						// Build a closure since we are using the define lambda
+						// shorthand.
+						err = bamboo_closure(env, cdr(symbol), cdr(args),
+							result);
+						symbol = car(symbol);
+
+						// Check if we actually have a symbol for closure name.
+						if (symbol.type != ATOM_TYPE_SYMBOL) {
+							return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+								_T("First element of argument 0 list should be a ")
+								_T("symbol"));
+						}
+
+						// Put the symbol in th environment.
+						IF_NOT_ERROR(err)
+							err = bamboo_env_set(env, symbol, *result);
+						*result = symbol;
+						break;
+					default:
+						return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+							_T("Argument 0 should be of type symbol or pair"));
+					}
+				} else if (SPECIAL_FORM_P(op, SPECIAL_FORM_LAMBDA)) {
+					// Check if we have both of the required 2 arguments.
+					if (bamboo_list_count(args) < 2) {
+						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+							_T("Wrong number of arguments. Expected at least 2"));
+					}
+
+					// Make the closure.
+					err = bamboo_closure(env, car(args), cdr(args), result);
+				} else if (SPECIAL_FORM_P(op, SPECIAL_FORM_DEFINE_MACRO)) {
+					atom_t name;
+					atom_t macro;
+
+					// Check if we have both of the required 2 arguments.
+					if (bamboo_list_count(args) < 2) {
+						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+							_T("Wrong number of arguments. Expected at least 2"));
+					}
+
+					// Check if the first argument is defined like a define
+					// lambda shorthand.
+					if (car(args).type != ATOM_TYPE_PAIR) {
+						return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+							_T("First argument must be a pair or a list like when ")
+							_T("defining a function using only define"));
+					}
+
+					// Get macro name.
+					name = car(car(args));
+					if (name.type != ATOM_TYPE_SYMBOL) {
+						return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+							_T("Macro name must be of type symbol"));
+					}
+
+					// Make the macro.
+					err = bamboo_closure(env, cdr(car(args)), cdr(args),
+						&macro);
+					IF_NOT_ERROR(err) {
+						// Return the name symbol and add the macro to the
+						// environment.
+						macro.type = ATOM_TYPE_MACRO;
+						*result = name;
+						err = bamboo_env_set(env, name, macro);
+					}
+				} else if (SPECIAL_FORM_P(op, SPECIAL_FORM_APPLY)) {
+					// Check if we have both of the required 2 arguments.
+					if (bamboo_list_count(args) < 2) {
+						return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+							_T("Wrong number of arguments. Expected at least 2"));
+					}
+
+					// Evaluate the apply by the magic of the stack.
+					stack = new_stack_frame(stack, env, cdr(args));
+					bamboo_list_set(stack, STACK_EVAL_OP_INDEX, op);
+					expr = car(args);
+					continue;
+				} else if (!eval_fast_arith(expr, env, result, 0)) {
+					goto push;
+				}
+			} else if (op.type == ATOM_TYPE_BUILTIN) {
+				// Execute a built-in function.
+				err = (*op.value.builtin)(args, result);
+
+				// Let another task run while this one waits.
+				if (err == BAMBOO_SUSPENDED)
+					err = task_wait(&stack, result);
+			} else {
+				// Handle a closure or macro.
+push:
+				stack = new_stack_frame(stack, env, args);
+				expr = op;
+				continue;
+			}
+		}
+
+		// Are we at the end of the stack? Spawned tasks that are done make way
+		// for the next one in line, only our own code finishing ends the loop.
+		while (nilp(stack) && (root->prev == NULL) && (err <= BAMBOO_OK) &&
+				(bamboo_ctx->task_current != bamboo_ctx->task_main)) {
+			err = task_exit(&stack, result);
+		}
+		if (nilp(stack))
+			break;
+
+		// Get the return value from the stack frame evaluation.
+		IF_NOT_ERROR(err)
+			err = eval_expr_return(&stack, &expr, &env, result);
+	} while (err <= BAMBOO_OK);
+
+	return err;
+}
+
+/**
+ * Checks if a symbol is the name of one of the arithmetic built-ins that can be
+ * evaluated inline.
+ *
+ * @param  symbol Symbol to be checked.
+ * @param  op     Pointer to the operation performed by the built-in.
+ * @return        TRUE if the symbol names an inline arithmetic built-in.
+ */
+bool arith_op(atom_t symbol, numeric_op_t *op) {
+	uint8_t i;
+
+	for (i = 0; i < ARITH_OP_COUNT; i++) {
+		if (*symbol.value.symbol == *bamboo_ctx->arith_ops[i].value.symbol) {
+			*op = (numeric_op_t)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Checks if the name of an inline arithmetic operation is still bound to its
+ * built-in in an environment. Looking it up every time means walking the whole
+ * root environment, so only the frames above it are searched and the answers
+ * for the root itself are kept until one of the names gets defined there again.
+ *
+ * @param  env Environment where the operation is going to be evaluated.
+ * @param  op  Operation to be checked.
+ * @return     TRUE if the operation can be evaluated inline.
+ */
+bool arith_builtin_p(env_t env, numeric_op_t op) {
+	static const builtin_func_t builtins[ARITH_OP_COUNT] = {
+		builtin_sum, builtin_subtract, builtin_multiply, builtin_numeq,
+		builtin_lt, builtin_gt
+	};
+	atom_t symbol;
+	atom_t current;
+	atom_t value;
+	uint8_t i;
+
+	// Closures and function calls may be shadowing the name, no matter how
+	// their environments were built.
+	symbol = bamboo_ctx->arith_ops[op];
+	for (; !nilp(env); env = car(env)) {
+		if ((bamboo_ctx->root_env != NULL) &&
+				(env.value.pair == bamboo_ctx->root_env->value.pair)) {
+			break;
+		}
+
+		for (current = cdr(env); !nilp(current); current = cdr(current)) {
+			if (*car(car(current)).value.symbol == *symbol.value.symbol) {
+				value = cdr(car(current));
+				return (value.type == ATOM_TYPE_BUILTIN) &&
+					(value.value.builtin == builtins[op]);
+			}
+		}
+	}
+
+	// Environments that don't hang from the root don't have it at all.
+	if (nilp(env))
+		return false;
+
+	// Only look at the root again if something has been defined over them.
+	if (bamboo_ctx->arith_cache_gen != bamboo_ctx->arith_gen) {
+		for (i = 0; i < ARITH_OP_COUNT; i++) {
+			bamboo_ctx->arith_builtin[i] =
+				env_lookup(env, bamboo_ctx->arith_ops[i], &value) &&
+				(value.type == ATOM_TYPE_BUILTIN) &&
+				(value.value.builtin == builtins[i]);
+		}
+		bamboo_ctx->arith_cache_gen = bamboo_ctx->arith_gen;
+	}
+
+	return bamboo_ctx->arith_builtin[op];
+}
+
+/**
+ * Tries to evaluate a simple arithmetic or comparison expression, such as
+ * (+ n 1) or (< a b), inline without building an argument list or pushing a
+ * stack frame. Only calls to the built-in + - * < > = with exactly 2 operands
+ * that are numeric literals, symbols bound to numbers, or other expressions of
+ * this kind are handled.
+ *
+ * @param  expr   Expression to be evaluated.
+ * @param  env    Environment list to use for this evaluation.
+ * @param  result Pointer to the resulting atom of the evaluation.
+ * @param  depth  How deep into nested fast expressions we currently are.
+ * @return        TRUE if the expression was evaluated. FALSE if it must go
+ *                through the regular evaluator.
+ */
+bool eval_fast_arith(atom_t expr, env_t env, atom_t *result, uint8_t depth) {
+	numeric_op_t op;
+	atom_t operands[2];
+	atom_t args;
+	uint8_t i;
+
+	// Check if the op is one of the arithmetic built-ins.
+	if ((car(expr).type != ATOM_TYPE_SYMBOL) || !arith_op(car(expr), &op) ||
+			!arith_builtin_p(env, op)) {
+		return false;
+	}
+
+	// Make sure we have exactly 2 operands.
+	args = cdr(expr);
+	if ((args.type != ATOM_TYPE_PAIR) || (cdr(args).type != ATOM_TYPE_PAIR) ||
+			!nilp(cdr(cdr(args)))) {
+		return false;
+	}
+
+	// Resolve the operands.
+	for (i = 0; i < 2; i++) {
+		atom_t operand = car(args);
+
+		switch (operand.type) {
+		case ATOM_TYPE_INTEGER:
+		case ATOM_TYPE_FLOAT:
+		case ATOM_TYPE_BIGNUM:
+			operands[i] = operand;
+			break;
+		case ATOM_TYPE_SYMBOL:
+			if (!env_lookup(env, operand, &operands[i]))
+				return false;
+			break;
+		case ATOM_TYPE_PAIR:
+			if ((depth >= EVAL_FAST_ARITH_DEPTH) ||
+					!eval_fast_arith(operand, env, &operands[i], depth + 1)) {
+				return false;
+			}
+			break;
+		default:
+			return false;
+		}
+
+		// Only numbers are allowed in here.
+		if (!INTEGRAL_P(operands[i]) && (operands[i].type != ATOM_TYPE_FLOAT))
+			return false;
+
+		args = cdr(args);
+	}
+
+	return numeric_binop(op, operands[0], operands[1], result) == BAMBOO_OK;
+}
+
+/**
+ * Creates a brand new virtual stack frame used to allow us to not run into CPU
+ * stack overflows while evaluating expressions.
+ *
+ * To be honest I have no clue how this whole thing is working, I just want to
+ * make sure we don't run into stack overflows.
+ *
+ * This is how the stack frame structure should look like:
+ * (parent env evaluated-op (pending-arg...) (evaluated-arg...) (body...))
+ *
+ * @param  parent Parent stack frame.
+ * @param  env    Environment for the stack frame to be evaluated in.
+ * @param  tail   Rest of the stack frame to be evaluated later.
+ * @return        A brand new stack frame atom.
+ *
+ * @see https://lwh.jp/lisp/continuations.html
+ */
+frame_t new_stack_frame(frame_t parent, env_t env, atom_t tail) {
+	return cons(parent, cons(env, cons(nil /* evaluated-op */, cons(tail,
+   		cons(nil /* evaluated-args */, cons(nil /* body */, nil))))));
+}
+
+/**
+ * Grabs the current expression to be evaluated from the body of the stack
+ * frame.
+ *
+ * To be honest I have no clue how this whole thing is working, I just want to
+ * make sure we don't run into stack overflows.
+ *
+ * @param  stack Pointer to the stack frame we are currently evaluating.
+ * @param  expr  Pointer to the expression that will be grabbed from the stack
+ *               to be evaluated later.
+ * @param  env   Pointer to the environment where the current expression will be
+ *               evaluated in. This will also come from our stack frame.
+ * @return       BAMBOO_OK if everything went fine.
+ *
+ * @see https://lwh.jp/lisp/continuations.html
+ */
+bamboo_error_t eval_expr_exec(frame_t *stack, atom_t *expr, env_t *env) {
+	atom_t body;
+
+	// Get the different parts of the stack.
+	*env = bamboo_list_ref(*stack, STACK_ENV_INDEX);
+	body = bamboo_list_ref(*stack, STACK_BODY_INDEX);
+	*expr = car(body);
+
+	// Check the next item in line.
+	body = cdr(body);
+	if (nilp(body)) {
+		// We've reached the of this stack. Pop the stack to its parent.
+		*stack = car(*stack);
+	} else {
+		// Advance the body of the atom to the next item in line.
+		bamboo_list_set(*stack, STACK_BODY_INDEX, body);
+	}
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Binds function arguments into the new stack frame environment if they haven't
+ * been bound already.
+ *
+ * To be honest I have no clue how this whole thing is working, I just want to
+ * make sure we don't run into stack overflows.
+ *
+ * @param  stack Pointer to the stack frame we are currently evaluating.
+ * @param  expr  Pointer to the expression that will be grabbed from the stack
+ *               to be evaluated later.
+ * @param  env   Pointer to the environment where the current expression will be
+ *               evaluated in. This will also come from our stack frame.
+ * @return       BAMBOO_OK if everything went fine.
+ *
+ * @see https://lwh.jp/lisp/continuations.html
+ */
+bamboo_error_t eval_expr_bind(frame_t *stack, atom_t *expr, env_t *env) {
+	atom_t op;
+	atom_t args;
+	atom_t arg_names;
+	atom_t body;
+
+	// If we have anything in the body just return it then.
+	body = bamboo_list_ref(*stack, STACK_BODY_INDEX);
+	if (!nilp(body))
+		return eval_expr_exec(stack, expr, env);
+
+	// Get the op and function arguments from the stack frame.
+	op = bamboo_list_ref(*stack, STACK_EVAL_OP_INDEX);
+	args = bamboo_list_ref(*stack, STACK_EVAL_ARGS_INDEX);
+
+	// Get all of the parameters from the stack frame.
+	*env = bamboo_env_new(car(op));
+	arg_names = car(cdr(op));
+	body = cdr(cdr(op));
+	bamboo_list_set(*stack, STACK_ENV_INDEX, *env);
+	bamboo_list_set(*stack, STACK_BODY_INDEX, body);
+
+	// Go through the arguments binding them to the environment.
+	while (!nilp(arg_names)) {
+		// Looks like we just have a symbol, nothing else to do here.
+		if (arg_names.type == ATOM_TYPE_SYMBOL) {
+			bamboo_env_set(*env, arg_names, args);
+			args = nil;
+			break;
+		}
+
+		// Not enough argument values given the amount of argument names.
+		if (nilp(args)) {
+ 			return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+ 				_T("Argument value list ended prematurely"));
+		}
+
+		// Push the argument into the environment.
+		bamboo_env_set(*env, car(arg_names), car(args));
+
+		// Move to the next argument.
+		arg_names = cdr(arg_names);
+		args = cdr(args);
+	}
+
+	// Check if we have arguments remaining.
+	if (!nilp(args)) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("Arguments left over after iterating through argument names"));
+	}
+
+	bamboo_list_set(*stack, STACK_EVAL_ARGS_INDEX, nil);
+	return eval_expr_exec(stack, expr, env);
+}
+
+/**
+ * Once all arguments have been evaluated, this function is responsible for
+ * generating an expression to call a builtin, or delegating to 'eval_do_bind'.
+ *
+ * To be honest I have no clue how this whole thing is working, I just want to
+ * make sure we don't run into stack overflows.
+ *
+ * @param  stack Pointer to the stack frame we are currently evaluating.
+ * @param  expr  Pointer to the expression that will be grabbed from the stack
+ *               to be evaluated later.
+ * @param  env   Pointer to the environment where the current expression will be
+ *               evaluated in. This will also come from our stack frame.
+ * @return       BAMBOO_OK if everything went fine.
+ *
+ * @see https://lwh.jp/lisp/continuations.html
+ */
+bamboo_error_t eval_expr_apply(frame_t *stack, atom_t *expr, env_t *env) {
+	atom_t op;
+	atom_t args;
+
+	// Get the op and arguments from the stack frame.
+	op = bamboo_list_ref(*stack, STACK_EVAL_OP_INDEX);
+	args = bamboo_list_ref(*stack, STACK_EVAL_ARGS_INDEX);
+
+	// Reverse the arguments if we have any.
+	if (!nilp(args)) {
+		bamboo_list_reverse(&args);
+		bamboo_list_set(*stack, STACK_EVAL_ARGS_INDEX, args);
+	}
+
+	// Handle the apply special form.
+	if (op.type == ATOM_TYPE_SYMBOL) {
+		if (SPECIAL_FORM_P(op, SPECIAL_FORM_APPLY)) {
+			// Replace the current frame.
+			*stack = car(*stack);
+			*stack = new_stack_frame(*stack, *env, nil);
+			op = car(args);
+			args = car(cdr(args));
+
+			// Check if we actually have an arguments list.
+			if (!listp(args)) {
+				return bamboo_error(BAMBOO_ERROR_SYNTAX,
+					_T("Arguments atom must be of list type"));
+			}
+
+			// Go to the next one.
+			bamboo_list_set(*stack, STACK_EVAL_OP_INDEX, op);
+			bamboo_list_set(*stack, STACK_EVAL_ARGS_INDEX, args);
+		}
+	}
+
+	// Handle built-ins.
+	if (op.type == ATOM_TYPE_BUILTIN) {
+		*stack = car(*stack);
+		*expr = cons(op, args);
+
+		return BAMBOO_OK;
+	} else if (op.type != ATOM_TYPE_CLOSURE) {
+		// Looks like we don't have anything that's "apply"able.
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Applyable op must be either a built-in or a closure"));
+	}
+
+	return eval_expr_bind(stack, expr, env);
+}
+
+/**
+ * Once an expression has been evaluated, this function is responsible for
+ * storing the result, which is either an op, an argument, or an
+ * intermediate body expression, and fetching the next expression to evaluate.
+ *
+ * To be honest I have no clue how this whole thing is working, I just want to
+ * make sure we don't run into stack overflows.
+ *
+ * @param  stack  Pointer to the stack frame we are currently evaluating.
+ * @param  expr   Pointer to the expression that will be grabbed from the stack
+ *                to be evaluated later.
+ * @param  env    Pointer to the environment where the current expression will be
+ *                evaluated in. This will also come from our stack frame.
+ * @param  result Pointer to the return value of the evaluated stack frame.
+ * @return        BAMBOO_OK if everything went fine.
+ *
+ * @see https://lwh.jp/lisp/continuations.html
+ */
+bamboo_error_t eval_expr_return(frame_t *stack, atom_t *expr, env_t *env,
+		atom_t *result) {
+	bamboo_error_t err;
+	atom_t op;
+	atom_t args;
+	atom_t body;
+
+	// Gets the parameters from the stack frame.
+	*env = bamboo_list_ref(*stack, STACK_ENV_INDEX);
+	op = bamboo_list_ref(*stack, STACK_EVAL_OP_INDEX);
+	body = bamboo_list_ref(*stack, STACK_BODY_INDEX);
+
+	// Check if we are still running a procedure. If so, just ignore the result.
+	if (!nilp(body))
+		return eval_expr_apply(stack, expr, env);
+
+	// Check in which phase of evaluation we are currently at.
+	if (nilp(op)) {
+		// Finished evaluating op.
+		op = *result;
+		bamboo_list_set(*stack, STACK_EVAL_OP_INDEX, op);
+
+		// Are we doing a macro?
+		if (op.type == ATOM_TYPE_MACRO) {
+			// Don't evaluate macro arguments.
+			args = bamboo_list_ref(*stack, STACK_PENDING_ARGS_INDEX);
+
+			*stack = new_stack_frame(*stack, *env, nil);
+			op.type = ATOM_TYPE_CLOSURE;
+			bamboo_list_set(*stack, STACK_EVAL_OP_INDEX, op);
+			bamboo_list_set(*stack, STACK_EVAL_ARGS_INDEX, args);
+
+			return eval_expr_bind(stack, expr, env);
+		}
+	} else if (op.type == ATOM_TYPE_SYMBOL) {
+		// Finished working on an special form.
+		if (SPECIAL_FORM_P(op, SPECIAL_FORM_DEFINE)) {
+			atom_t symbol;
+
+			symbol = bamboo_list_ref(*stack, STACK_EVAL_ARGS_INDEX);
+			err = bamboo_env_set(*env, symbol, *result);
+			IF_ERROR(err)
+				return err;
+			*stack = car(*stack);
+			*expr = cons(bamboo_ctx->special_forms[SPECIAL_FORM_QUOTE],
+				cons(symbol, nil));
+
+			return BAMBOO_OK;
+		} else if (SPECIAL_FORM_P(op, SPECIAL_FORM_IF)) {
+			args = bamboo_list_ref(*stack, STACK_PENDING_ARGS_INDEX);
+
+			// Choose which path to go for an if statement.
+			if ((result->type == ATOM_TYPE_BOOLEAN) && (!result->value.boolean)) {
+				*expr = car(cdr(args));
+			} else {
+				*expr = car(args);
+			}
+
+			*stack = car(*stack);
+			return BAMBOO_OK;
+		} else {
+			goto store_argument;
+		}
+	} else if (op.type == ATOM_TYPE_MACRO) {
+		// Finished evaluating macro.
+		*expr = *result;
+		*stack = car(*stack);
+
+		return BAMBOO_OK;
+	} else {
+store_argument:
+		// Store the evaluated argument.
+		args = bamboo_list_ref(*stack, STACK_EVAL_ARGS_INDEX);
+		bamboo_list_set(*stack, STACK_EVAL_ARGS_INDEX, cons(*result, args));
+	}
+
+	// Get the next set of arguments to evaluate.
+	args = bamboo_list_ref(*stack, STACK_PENDING_ARGS_INDEX);
+	if (nilp(args)) {
+		// No more arguments left to evaluate.
+		return eval_expr_apply(stack, expr, env);
+	}
+
+	// Evaluate the next argument.
+	*expr = car(args);
+	bamboo_list_set(*stack, STACK_PENDING_ARGS_INDEX, cdr(args));
+
+	return BAMBOO_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                Environment                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new child environment list.
+ *
+ * @param  parent Parent environment to this new child.
+ * @return        New child environment list.
+ */
+env_t bamboo_env_new(env_t parent) {
+	return cons(parent, nil);
+}
+
+/**
+ * Gets a symbol definition from an environment list recursively searching
+ * through its parents.
+ *
+ * @param  env    Environment list to search for the desired symbol in.
+ * @param  symbol Symbol you're searching for.
+ * @param  atom   Pointer to the resulting atom of the symbol definition.
+ * @return        BAMBOO_OK if the symbol was found. BAMBOO_ERROR_UNBOUND
+ *                otherwise.
+ */
+bamboo_error_t bamboo_env_get(env_t env, atom_t symbol, atom_t *atom) {
+	TCHAR msg[ERROR_MSG_STR_LEN + 1];
+
+	// Search for the symbol.
+	if (env_lookup(env, symbol, atom)) {
+		// Load the actual definition the first time the symbol is used.
+		if (atom->type == ATOM_TYPE_AUTOLOAD)
+			return env_autoload(env, symbol, atom);
+
+		return BAMBOO_OK;
+	}
+
+	// Build the error string.
+	_sntprintf(msg, ERROR_MSG_STR_LEN, _T("Symbol '") SPEC_STR _T("' not ")
+		_T("found in any of the environments"), *symbol.value.symbol);
+	return bamboo_error(BAMBOO_ERROR_UNBOUND, msg);
+}
+
+/**
+ * Gets a symbol definition from an environment list iteratively searching
+ * through its parents without touching the error message.
+ *
+ * @param  env    Environment list to search for the desired symbol in.
+ * @param  symbol Symbol you're searching for.
+ * @param  atom   Pointer to the resulting atom of the symbol definition.
+ * @return        TRUE if the symbol was found.
+ */
+bool env_lookup(env_t env, atom_t symbol, atom_t *atom) {
+	// Clean up the result just in case.
+	*atom = nil;
+
+	while (!nilp(env)) {
+		env_t current = cdr(env);
+
+		// Iterate through the symbols in the environment list.
+		while (!nilp(current)) {
+			// Get symbol-value pair.
+			atom_t item = car(current);
+
+			// Take advantage of the fact we can't have different symbols with
+			// same name to compare them by pointer instead of having to do
+			// strcmp.
+			if (*car(item).value.symbol == *symbol.value.symbol) {
+				*atom = cdr(item);
+				return true;
+			}
+
+			// Check the next symbol in the list.
+			current = cdr(current);
+		}
+
+		// Search for the symbol in the parent.
+		env = car(env);
+	}
+
+	return false;
+}
+
+/**
+ * Finds the symbol-value pair that binds a symbol in an environment list or
+ * any of its parents.
+ *
+ * @param  env     Environment list to search for the desired symbol in.
+ * @param  symbol  Symbol you're searching for.
+ * @param  frame   Pointer to the environment where the symbol was found.
+ * @param  binding Pointer to the symbol-value pair of the symbol.
+ * @return         TRUE if the symbol was found.
+ */
+bool env_lookup_binding(env_t env, atom_t symbol, env_t *frame,
+						atom_t *binding) {
+	while (!nilp(env)) {
+		atom_t current;
+
+		for (current = cdr(env); !nilp(current); current = cdr(current)) {
+			if (*car(car(current)).value.symbol == *symbol.value.symbol) {
+				*frame = env;
+				*binding = car(current);
+
+				return true;
+			}
+		}
+
+		env = car(env);
+	}
+
+	return false;
+}
+
+/**
+ * Replaces the autoload stub bound to a symbol with its actual definition by
+ * handing it over to the autoload handler.
+ *
+ * @param  env    Environment list where the symbol was looked up.
+ * @param  symbol Symbol bound to the autoload stub.
+ * @param  atom   Pointer to the resulting atom of the symbol definition.
+ * @return        BAMBOO_OK if the definition was loaded successfully.
+ */
+bamboo_error_t env_autoload(env_t env, atom_t symbol, atom_t *atom) {
+	TCHAR msg[ERROR_MSG_STR_LEN + 1];
+	bamboo_error_t err;
+	atom_t binding;
+	atom_t stub;
+	env_t frame;
+
+	// Find out where the stub lives.
+	*atom = nil;
+	if (!env_lookup_binding(env, symbol, &frame, &binding) ||
+			(bamboo_ctx->autoload_handler == NULL)) {
+		_sntprintf(msg, ERROR_MSG_STR_LEN, _T("Symbol '") SPEC_STR _T("' ")
+			_T("can't be autoloaded"), *symbol.value.symbol);
+		return bamboo_error(BAMBOO_ERROR_UNBOUND, msg);
+	}
+	stub = cdr(binding);
+
+	// Bind the symbol to nil while loading so that a definition that refers
+	// to itself doesn't send us around in circles.
+	cdr(binding) = nil;
+	err = bamboo_ctx->autoload_handler(frame, symbol, stub.value.pointer);
+	IF_ERROR(err) {
+		// Give it another try next time if nothing got defined.
+		if (nilp(cdr(binding)))
+			cdr(binding) = stub;
+
+		return err;
+	}
+
+	// The definition should have taken the place of the stub by now.
+	*atom = cdr(binding);
+	return BAMBOO_OK;
+}
+
+/**
+ * Loads the actual definitions of every symbol in an environment that is still
+ * bound to an autoload stub.
+ *
+ * @param  env Environment to go through.
+ * @return     BAMBOO_OK if every definition was loaded successfully.
+ */
+bamboo_error_t env_autoload_all(env_t env) {
+	bamboo_error_t err;
+	atom_t current;
+	atom_t atom;
+
+	for (current = cdr(env); !nilp(current); current = cdr(current)) {
+		if (cdr(car(current)).type == ATOM_TYPE_AUTOLOAD) {
+			err = env_autoload(env, car(car(current)), &atom);
+			IF_ERROR(err)
+				return err;
+		}
+	}
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Creates a new symbol inside an environment or changes it if it already
+ * exists in the specified environment.
+ *
+ * @param  env    Parent environment where the symbol resides.
+ * @param  symbol Symbol to be created or edited.
+ * @param  value  Value attributed to the symbol.
+ * @return        BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t bamboo_env_set(env_t env, atom_t symbol, atom_t value) {
+	env_t current = cdr(env);
+	atom_t item = nil;
+	numeric_op_t op;
+
+	// Environments shared by forks can't be changed anymore.
+	if (gc_frozen_p(env)) {
+		return bamboo_error(BAMBOO_ERROR_READ_ONLY,
+			_T("Can't define symbols in a read-only environment"));
+	}
+
+	// Let the inline arithmetic know that its built-ins might have changed.
+	if (arith_op(symbol, &op) && (bamboo_ctx->root_env != NULL) &&
+			(env.value.pair == bamboo_ctx->root_env->value.pair)) {
+		bamboo_ctx->arith_gen++;
+	}
+
+	// Iterate over the symbols in the environment list checking if the symbol
+	// already exists in the current environment.
+	while (!nilp(current)) {
+		// Get a symbol from the list.
+		item = car(current);
+
+		// Check if the symbol matches another one in the environment.
+		if (*car(item).value.symbol == *symbol.value.symbol) {
+			cdr(item) = value;
+			return BAMBOO_OK;
+		}
+
+		// Go to the next symbol.
+		current = cdr(current);
+	}
+
+	// Looks like this is a new symbol definition. Create it then...
+	item = cons(symbol, value);
+	cdr(env) = cons(item, cdr(env));
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Binds a symbol to an autoload stub inside an environment, so that its actual
+ * definition is only loaded by the autoload handler the first time the symbol
+ * is looked up.
+ *
+ * @param  env    Parent environment where the symbol resides.
+ * @param  symbol Symbol to be bound to the stub.
+ * @param  arg    Argument passed to the autoload handler to identify the
+ *                definition of the symbol.
+ * @return        BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t bamboo_env_set_autoload(env_t env, atom_t symbol, void *arg) {
+	atom_t stub;
+
+	stub.type = ATOM_TYPE_AUTOLOAD;
+	stub.value.pointer = arg;
+
+	return bamboo_env_set(env, symbol, stub);
+}
+
+/**
+ * Sets the function that loads the definitions of symbols bound to autoload
+ * stubs. It's expected to evaluate the definition in the given environment.
+ *
+ * @param func Autoload handler.
+ */
+void bamboo_set_autoload_handler(bamboo_autoload_func_t func) {
+	bamboo_ctx->autoload_handler = func;
+}
+
+/**
+ * Creates a new built-in function symbol inside an environment or changes it if
+ * it already exists in the specified environment.
+ *
+ * @param  env  Parent environment where the built-in function symbol resides.
+ * @param  name Name of the symbol for the built-in function.
+ * @param  func Built-in function that will be called for this symbol.
+ * @return      BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t bamboo_env_set_builtin(env_t env, const TCHAR *name,
+									  builtin_func_t func) {
+	atom_t symbol;
+	size_t i;
+
+	// Register the function by name so that images can refer to it.
+	symbol = bamboo_symbol(name);
+	for (i = 0; i < bamboo_ctx->builtins_count; i++) {
+		if (bamboo_ctx->builtins[i].func == func)
+			break;
+	}
+	if (i == bamboo_ctx->builtins_count) {
+		if (bamboo_ctx->builtins_count == bamboo_ctx->builtins_cap) {
+			size_t cap = (bamboo_ctx->builtins_cap == 0) ? BUILTINS_MIN_CAP :
+				(bamboo_ctx->builtins_cap * 2);
+			builtin_entry_t *tmp;
+
+			tmp = (builtin_entry_t *)realloc(bamboo_ctx->builtins,
+				cap * sizeof(builtin_entry_t));
+			if (tmp == NULL) {
+				return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't ")
+					_T("allocate built-in function registry"));
+			}
+
+			bamboo_ctx->builtins = tmp;
+			bamboo_ctx->builtins_cap = cap;
+		}
+
+		bamboo_ctx->builtins[i].name = symbol;
+		bamboo_ctx->builtins[i].func = func;
+		bamboo_ctx->builtins_count++;
+	}
+
+	return bamboo_env_set(env, symbol, bamboo_builtin(func));
+}
+
+/**
+ * Gets the root environment current in use by the interpreter.
+ *
+ * @return Pointer to the current root environment.
+ */
+env_t *bamboo_get_root_env(void) {
+	return bamboo_ctx->root_env;
+}
+
+/**
+ * Freezes everything that's reachable from an environment unless it's already
+ * frozen.
+ *
+ * @param  base Environment to be frozen.
+ * @return      BAMBOO_OK if the environment was frozen successfully.
+ */
+bamboo_error_t env_freeze(env_t base) {
+	bamboo_error_t err;
+	env_t frame;
+
+	if (gc_frozen_p(base))
+		return BAMBOO_OK;
+
+	// Stubs can't be replaced by their definitions once frozen.
+	for (frame = base; !nilp(frame); frame = car(frame)) {
+		err = env_autoload_all(frame);
+		IF_ERROR(err)
+			return err;
+	}
+
+	gc_freeze(base);
+	return BAMBOO_OK;
+}
+
+/**
+ * Freezes a base environment ahead of time and keeps it frozen until
+ * bamboo_env_thaw is called, even while it isn't forked. Freezing walks the
+ * whole base, so this saves doing it all over again when forks are created and
+ * discarded one at a time.
+ *
+ * @param  base Environment to be frozen, usually the root environment.
+ * @return      BAMBOO_OK if the environment was frozen successfully.
+ */
+bamboo_error_t bamboo_env_freeze(env_t base) {
+	bamboo_error_t err;
+
+	err = env_freeze(base);
+	IF_ERROR(err)
+		return err;
+
+	bamboo_ctx->frozen_pinned = true;
+	return BAMBOO_OK;
+}
+
+/**
+ * Thaws a base environment frozen with bamboo_env_freeze so that it can be
+ * changed again.
+ *
+ * @return BAMBOO_OK if the base was thawed or BAMBOO_ERROR_READ_ONLY if it's
+ *         still shared by forks.
+ */
+bamboo_error_t bamboo_env_thaw(void) {
+	if (!nilp(bamboo_ctx->forks)) {
+		return bamboo_error(BAMBOO_ERROR_READ_ONLY,
+			_T("Can't thaw an environment that's still forked"));
+	}
+
+	bamboo_ctx->frozen_pinned = false;
+	gc_thaw();
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Creates a child environment that sees everything defined in a base
+ * environment while keeping its own definitions to itself. Everything that's
+ * reachable from the base gets frozen the first time it's forked: the garbage
+ * collector stops looking at it and it can't be changed anymore, so any number
+ * of forks can share it without leaking definitions into each other. It's
+ * thawed once the last fork is discarded unless it was frozen with
+ * bamboo_env_freeze.
+ *
+ * @param  base Environment to be forked, usually the root environment.
+ * @param  env  Pointer to the forked environment.
+ * @return      BAMBOO_OK if the environment was forked successfully.
+ */
+bamboo_error_t bamboo_env_fork(env_t base, env_t *env) {
+	bamboo_error_t err;
+
+	// Freeze the base unless it has already been forked before.
+	*env = nil;
+	err = env_freeze(base);
+	IF_ERROR(err)
+		return err;
+
+	// Keep the fork around until it's discarded.
+	*env = bamboo_env_new(base);
+	bamboo_ctx->forks = cons(*env, bamboo_ctx->forks);
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Discards an environment created with bamboo_env_fork, freeing everything
+ * that was allocated by it and isn't used anywhere else. The frozen base
+ * isn't even looked at. Discarding the last fork thaws the base instead, unless
+ * it was frozen with bamboo_env_freeze.
+ *
+ * @param env Forked environment to be discarded.
+ */
+void bamboo_env_discard(env_t env) {
+	atom_t *fork;
+
+	// Stop holding on to the fork.
+	for (fork = &bamboo_ctx->forks; !nilp(*fork); fork = &cdr(*fork)) {
+		if (car(*fork).value.pair == env.value.pair) {
+			*fork = cdr(*fork);
+			break;
+		}
+	}
+
+	// The base can be changed again once nobody is sharing it. It's only kept
+	// alive by whoever is holding on to it from outside of the interpreter, so
+	// what the fork left behind is left for the next collection.
+	if (nilp(bamboo_ctx->forks) && !bamboo_ctx->frozen_pinned) {
+		gc_thaw();
+		return;
+	}
+
+	// Collect whatever it left behind.
+	gc_mark_roots();
+	gc(true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                             Garbage Collection                             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Gets the garbage collector allocation that holds the value of an atom.
+ *
+ * @param  atom Atom to get the allocation from.
+ * @return      Allocation of the atom or NULL if it isn't garbage collected.
+ */
+allocation_t *atom_alloc(atom_t atom) {
+	switch (atom.type) {
+	case ATOM_TYPE_PAIR:
+	case ATOM_TYPE_CLOSURE:
+	case ATOM_TYPE_MACRO:
+	case ATOM_TYPE_CHANNEL:
+		return (allocation_t *)((size_t)atom.value.pair -
+			offsetof(allocation_t, data));
+	case ATOM_TYPE_SYMBOL:
+		return (allocation_t *)((size_t)atom.value.symbol -
+			offsetof(allocation_t, data));
+	case ATOM_TYPE_STRING:
+		return (allocation_t *)((size_t)atom.value.str -
+			offsetof(allocation_t, data));
+	case ATOM_TYPE_VECTOR:
+		return (allocation_t *)((size_t)atom.value.vector -
+			offsetof(allocation_t, data));
+	case ATOM_TYPE_BIGNUM:
+		return (allocation_t *)((size_t)atom.value.bignum -
+			offsetof(allocation_t, data));
+	default:
+		return NULL;
+	}
+}
+
+/**
+ * Marks a whole tree of pairs as "in use" so that the garbage collector won't
+ * free them up. The parts of the tree that still have to be visited are kept
+ * in a stack of our own, so deeply nested data doesn't use up the C stack.
+ *
+ * @param root Root of the pair tree to be marked as "in use".
+ */
+void gc_mark(atom_t root) {
+	atom_t local[GC_MARK_STACK_LOCAL];
+	allocation_t *alloc;
+	atom_t *stack;
+	atom_t *grown;
+	size_t depth;
+	size_t cap;
+
+	stack = local;
+	depth = 0;
+	cap = GC_MARK_STACK_LOCAL;
+
+mark:
+	// Get the allocation from the atom, ignoring non-"garbage collectable"
+	// types. If it's already marked, then there's nothing to do.
+	alloc = atom_alloc(root);
+	if ((alloc == NULL) || (alloc->mark != GC_TO_FREE))
+		goto next;
+
+	// Mark it as "in use".
+	alloc->mark = GC_IN_USE;
+
+	// Substring views must keep the characters of their parent around.
+	if ((alloc->type == ALLOCATION_TYPE_STRING) &&
+			(alloc->data.string->parent != NULL)) {
+		atom_t parent;
+
+		parent.type = ATOM_TYPE_STRING;
+		parent.value.str = alloc->data.string->parent;
+		root = parent;
+		goto mark;
+	}
+
+	// Only pairs have other atoms inside of them.
+	if (alloc->type != ALLOCATION_TYPE_PAIR)
+		goto next;
+
+	// Leave the cdr for later and go into the car. Only the cdrs of nested
+	// lists pile up this way, so long lists don't grow the stack.
+	if (!nilp(cdr(root))) {
+		if (depth == cap) {
+			grown = (stack == local) ?
+				(atom_t *)malloc(cap * 2 * sizeof(atom_t)) :
+				(atom_t *)realloc(stack, cap * 2 * sizeof(atom_t));
+			if (grown == NULL) {
+				fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+					_T("garbage collector mark stack"));
+			}
+			if (stack == local)
+				memcpy(grown, local, sizeof(local));
+
+			stack = grown;
+			cap *= 2;
+		}
+
+		stack[depth++] = cdr(root);
+	}
+	root = car(root);
+	goto mark;
+
+next:
+	// Go back to the parts we have left for later.
+	if (depth > 0) {
+		root = stack[--depth];
+		goto mark;
+	}
+
+	if (stack != local)
+		free(stack);
+}
+
+/**
+ * Marks the state of every evaluation currently in progress, including the ones
+ * that are suspended, every task, and every unfinished form held by an
+ * incremental parser as "in use".
+ */
+void gc_mark_roots(void) {
+	bamboo_parser_t *parser;
+	bamboo_eval_t *state;
+	task_t *task;
+	eval_root_t *root;
+	size_t i;
+
+	gc_mark(bamboo_ctx->forks);
+	for (root = bamboo_ctx->eval_roots; root != NULL; root = root->prev) {
+		gc_mark(*root->expr);
+		gc_mark(*root->env);
+		gc_mark(*root->stack);
+	}
+
+	for (state = bamboo_ctx->evals; state != NULL; state = state->next) {
+		gc_mark(state->expr);
+		gc_mark(state->env);
+		gc_mark(state->stack);
+		gc_mark(state->result);
+		gc_mark_task(&state->task);
+	}
+
+	if (bamboo_ctx->task_main != NULL)
+		gc_mark_task(bamboo_ctx->task_main);
+	for (task = bamboo_ctx->tasks; task != NULL; task = task->next_task)
+		gc_mark_task(task);
+
+	for (parser = bamboo_ctx->parsers; parser != NULL; parser = parser->next) {
+		for (i = 0; i < parser->depth; i++)
+			gc_mark(parser->frames[i].head);
+	}
+}
+
+/**
+ * Marks everything a task that isn't running holds on to as "in use".
+ *
+ * @param task Task to be marked.
+ */
+void gc_mark_task(const task_t *task) {
+	gc_mark(task->stack);
+	gc_mark(task->value);
+	gc_mark(task->channel);
+}
+
+/**
+ * Go through the allocation linked list collecting the garbage.
+ *
+ * @param respect_marks Should we respect the "in use" marks in allocations? If
+ *                      set to FALSE this will deallocate everything.
+ */
+void gc(bool respect_marks) {
+	allocation_t *alloc;
+	allocation_t **tmp;
+
+	// Make sure we don't trash our interned symbols.
+	if (respect_marks) {
+		size_t i;
+
+		for (i = 0; i < bamboo_ctx->symtab_cap; i++) {
+			alloc = bamboo_ctx->symtab[i].alloc;
+			if ((alloc != NULL) && (alloc->mark == GC_TO_FREE))
+				alloc->mark = GC_IN_USE;
+		}
+	}
+
+	// Free up all unmarked allocations. Frozen ones are always at the end of
+	// the list and are only freed along with everything else.
+	tmp = &bamboo_ctx->allocations;
+	while ((*tmp != NULL) && (!respect_marks ||
+			(*tmp != bamboo_ctx->frozen))) {
+		alloc = *tmp;
+
+		// Check if it's marked to be freed.
+		if ((alloc->mark == GC_TO_FREE) | !respect_marks) {
+			// Free it up!
+			*tmp = alloc->next;
+			if (alloc->type == ALLOCATION_TYPE_SYMBOL) {
+				free(alloc->data.str);
+			} else if (alloc->type == ALLOCATION_TYPE_STRING) {
+				free(alloc->data.string->buf);
+				free(alloc->data.string);
+			} else if (alloc->type == ALLOCATION_TYPE_VECTOR) {
+				free(alloc->data.vector);
+			} else if (alloc->type == ALLOCATION_TYPE_BIGNUM) {
+				free(alloc->data.bignum);
+			}
+			free(alloc);
+
+			continue;
+		}
+
+		// Let's go to the next item in the allocation list.
+		tmp = &alloc->next;
+	}
+
+	// Clear all the marks for the next round.
+	alloc = bamboo_ctx->allocations;
+	while ((alloc != NULL) && (alloc != bamboo_ctx->frozen)) {
+		alloc->mark = GC_TO_FREE;
+		alloc = alloc->next;
+	}
+}
+
+/**
+ * Freezes everything that's reachable from a root, along with all of the
+ * interned symbols. Frozen allocations are moved to the end of the allocation
+ * list, where the garbage collector won't bother with them anymore.
+ *
+ * @param root Root of the tree to be frozen.
+ */
+void gc_freeze(atom_t root) {
+	allocation_t *frozen;
+	allocation_t *alloc;
+	allocation_t **tail;
+	allocation_t **tmp;
+	size_t i;
+
+	// Mark everything that should be frozen.
+	gc_mark(root);
+	for (i = 0; i < bamboo_ctx->symtab_cap; i++) {
+		alloc = bamboo_ctx->symtab[i].alloc;
+		if ((alloc != NULL) && (alloc->mark == GC_TO_FREE))
+			alloc->mark = GC_IN_USE;
+	}
+
+	// Move the marked allocations out of the list.
+	frozen = NULL;
+	tail = &frozen;
+	tmp = &bamboo_ctx->allocations;
+	while (*tmp != bamboo_ctx->frozen) {
+		alloc = *tmp;
+
+		if (alloc->mark == GC_IN_USE) {
+			*tmp = alloc->next;
+			alloc->mark = GC_FROZEN;
+			*tail = alloc;
+			tail = &alloc->next;
+
+			continue;
+		}
+
+		tmp = &alloc->next;
+	}
+
+	// Put them right before the ones that were already frozen.
+	*tail = bamboo_ctx->frozen;
+	*tmp = frozen;
+	bamboo_ctx->frozen = frozen;
+}
+
+/**
+ * Sets the mark of every frozen allocation.
+ *
+ * @param mark GC_FROZEN to freeze them again or GC_TO_FREE to have them marked
+ *             like any other allocation for a while.
+ */
+void gc_frozen_mark(gc_mark_t mark) {
+	allocation_t *alloc;
+
+	for (alloc = bamboo_ctx->frozen; alloc != NULL; alloc = alloc->next)
+		alloc->mark = mark;
+}
+
+/**
+ * Thaws every frozen allocation, handing them back to the garbage collector
+ * and allowing them to be changed again.
+ */
+void gc_thaw(void) {
+	gc_frozen_mark(GC_TO_FREE);
+	bamboo_ctx->frozen = NULL;
+}
+
+/**
+ * Checks if an atom lives in the frozen part of the heap and can't be changed.
+ *
+ * @param  atom Atom to be checked.
+ * @return      TRUE if the atom is frozen.
+ */
+bool gc_frozen_p(atom_t atom) {
+	allocation_t *alloc;
+
+	alloc = atom_alloc(atom);
+	return (alloc != NULL) && (alloc->mark == GC_FROZEN);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                Heap Images                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Saves everything that's reachable from an environment, along with all of the
+ * interned symbols, to a binary image that can be loaded back in later on
+ * without having to parse and evaluate anything. Objects reference each other
+ * by index, so the image doesn't depend on where things were in memory, and
+ * built-in functions are stored by name.
+ *
+ * @param  env  Environment to be saved, usually the root environment.
+ * @param  path Path to the image file to be written.
+ * @return      BAMBOO_OK if the image was saved successfully.
+ */
+bamboo_error_t bamboo_image_save(env_t env, const TCHAR *path) {
+	bamboo_error_t err = BAMBOO_OK;
+	image_writer_t w;
+	image_header_t hdr;
+	allocation_t **objs;
+	allocation_t *alloc;
+	size_t count;
+	size_t i;
+
+	// Images can't refer back to the files definitions would be loaded from.
+	err = env_autoload_all(env);
+	IF_ERROR(err)
+		return err;
+
+	// Mark everything that's reachable along with our interned symbols,
+	// including the parts that were frozen.
+	gc_frozen_mark(GC_TO_FREE);
+	gc_mark(env);
+	for (i = 0; i < bamboo_ctx->symtab_cap; i++) {
+		if (bamboo_ctx->symtab[i].alloc != NULL)
+			bamboo_ctx->symtab[i].alloc->mark = GC_IN_USE;
+	}
+
+	// Gather the marked allocations.
+	count = 0;
+	for (alloc = bamboo_ctx->allocations; alloc != NULL; alloc = alloc->next) {
+		if (alloc->mark == GC_IN_USE)
+			count++;
+	}
+	objs = (allocation_t **)malloc((count + 1) * sizeof(allocation_t *));
+	if (objs == NULL) {
+		err = bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate image ")
+			_T("object table"));
+		goto unmark;
+	}
+	count = 0;
+	for (alloc = bamboo_ctx->allocations; alloc != NULL; alloc = alloc->next) {
+		if (alloc->mark == GC_IN_USE)
+			objs[count++] = alloc;
+	}
+
+	// Sort them by address so that references can be looked up quickly.
+	qsort(objs, count, sizeof(allocation_t *), image_cmp_alloc);
+
+	// Open the image file.
+	w.fh = tfopen(path, _T("wb"));
+	if (w.fh == NULL) {
+		err = bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Can't open image file ")
+			_T("for writing"));
+		goto cleanup;
+	}
+	w.objs = objs;
+	w.count = count;
+	w.offset = 0;
+	w.err = BAMBOO_OK;
+
+	// Write the header.
+	memset(&hdr, 0, sizeof(image_header_t));
+	memcpy(hdr.magic, IMAGE_MAGIC, sizeof(hdr.magic));
+	hdr.version = IMAGE_VERSION;
+	hdr.order = IMAGE_BYTE_ORDER;
+	hdr.tchar_size = sizeof(TCHAR);
+	hdr.float_size = sizeof(bamboo_float_t);
+	hdr.count = (uint32_t)count;
+	image_put(&w, &hdr, sizeof(image_header_t));
+
+	// Write the objects themselves, leaving the insides of pairs for later so
+	// that they can all be created before being linked together.
+	for (i = 0; (i < count) && (w.err == BAMBOO_OK); i++)
+		image_put_object(&w, objs[i]);
+	for (i = 0; (i < count) && (w.err == BAMBOO_OK); i++) {
+		if (objs[i]->type == ALLOCATION_TYPE_PAIR) {
+			image_put_atom(&w, objs[i]->data.pair.atom[0]);
+			image_put_atom(&w, objs[i]->data.pair.atom[1]);
+		}
+	}
+	image_put_atom(&w, env);
+
+	// Close the file and check if everything went fine.
+	err = w.err;
+	if ((fclose(w.fh) != 0) && (err == BAMBOO_OK)) {
+		err = bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Can't write image ")
+			_T("file"));
+	}
+
+cleanup:
+	free(objs);
+unmark:
+	// Leave the marks clean for the garbage collector.
+	for (alloc = bamboo_ctx->allocations; alloc != NULL; alloc = alloc->next)
+		alloc->mark = GC_TO_FREE;
+	gc_frozen_mark(GC_FROZEN);
+
+	return err;
+}
+
+/**
+ * Loads an image saved with bamboo_image_save, replacing the environment with
+ * the one stored in it. The interpreter must have been initialized already so
+ * that the built-in functions referenced by the image can be found.
+ *
+ * @param  env  Pointer to the environment that will be replaced.
+ * @param  path Path to the image file to be loaded.
+ * @return      BAMBOO_OK if the image was loaded successfully.
+ */
+bamboo_error_t bamboo_image_load(env_t *env, const TCHAR *path) {
+	bamboo_error_t err;
+	image_reader_t r;
+	image_header_t hdr;
+	uint8_t *buf;
+	atom_t root;
+	FILE *fh;
+	long size;
+	size_t i;
+
+	// Read the whole image into memory.
+	fh = tfopen(path, _T("rb"));
+	if (fh == NULL) {
+		return bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Can't open image file ")
+			_T("for reading"));
+	}
+	fseek(fh, 0L, SEEK_END);
+	size = ftell(fh);
+	rewind(fh);
+	buf = (size > 0) ? (uint8_t *)malloc((size_t)size) : NULL;
+	if ((buf == NULL) || (fread(buf, 1, (size_t)size, fh) != (size_t)size)) {
+		free(buf);
+		fclose(fh);
+		return bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Can't read image file"));
+	}
+	fclose(fh);
+	r.start = buf;
+	r.cur = buf;
+	r.end = buf + size;
+	r.objs = NULL;
+	r.count = 0;
+
+	// Check if the image is one we can actually use.
+	if (!image_get(&r, &hdr, sizeof(image_header_t)) ||
+			(memcmp(hdr.magic, IMAGE_MAGIC, sizeof(hdr.magic)) != 0)) {
+		err = bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Not a valid image file"));
+		goto cleanup;
+	}
+	if ((hdr.version != IMAGE_VERSION) || (hdr.order != IMAGE_BYTE_ORDER) ||
+			(hdr.tchar_size != sizeof(TCHAR)) ||
+			(hdr.float_size != sizeof(bamboo_float_t))) {
+		err = bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Image file was saved by ")
+			_T("an incompatible build"));
+		goto cleanup;
+	}
+
+	// Create all of the objects.
+	r.count = hdr.count;
+	r.objs = (atom_t *)malloc((r.count + 1) * sizeof(atom_t));
+	if (r.objs == NULL) {
+		err = bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate image ")
+			_T("object table"));
+		goto cleanup;
+	}
+	for (i = 0; i < r.count; i++) {
+		err = image_get_object(&r, &r.objs[i]);
+		IF_ERROR(err)
+			goto cleanup;
+	}
+
+	// Link the pairs together.
+	for (i = 0; i < r.count; i++) {
+		if (r.objs[i].type != ATOM_TYPE_PAIR)
+			continue;
+
+		err = image_get_atom(&r, &car(r.objs[i]));
+		IF_ERROR(err)
+			goto cleanup;
+		err = image_get_atom(&r, &cdr(r.objs[i]));
+		IF_ERROR(err)
+			goto cleanup;
+	}
+
+	// Get the environment.
+	err = image_get_atom(&r, &root);
+	IF_ERROR(err)
+		goto cleanup;
+	if ((root.type != ATOM_TYPE_PAIR) || (r.cur != r.end)) {
+		err = bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Image file is corrupted"));
+		goto cleanup;
+	}
+	*env = root;
+	bamboo_ctx->arith_gen++;
+
+cleanup:
+	// Anything we've created but didn't use is left to the garbage collector.
+	free(r.objs);
+	free(buf);
+
+	return err;
+}
+
+/**
+ * Compares two allocations by address for sorting.
+ *
+ * @param  a Pointer to the first allocation pointer.
+ * @param  b Pointer to the second allocation pointer.
+ * @return   Negative, zero or positive like strcmp.
+ */
+int image_cmp_alloc(const void *a, const void *b) {
+	uintptr_t x = (uintptr_t)*(allocation_t * const *)a;
+	uintptr_t y = (uintptr_t)*(allocation_t * const *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * Writes raw data to an image, keeping track of the offset.
+ *
+ * @param w   Image writer.
+ * @param ptr Data to be written.
+ * @param len Length of the data in bytes.
+ */
+void image_put(image_writer_t *w, const void *ptr, size_t len) {
+	if (w->err != BAMBOO_OK)
+		return;
+
+	if (fwrite(ptr, 1, len, w->fh) != len) {
+		w->err = bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Can't write image ")
+			_T("file"));
+		return;
+	}
+	w->offset += len;
+}
+
+/**
+ * Writes a length followed by a block of data aligned to IMAGE_ALIGN, so that
+ * it can be used straight from memory when the image is loaded.
+ *
+ * @param w   Image writer.
+ * @param ptr Data to be written.
+ * @param len Number of elements to be written.
+ * @param sz  Size of each element in bytes.
+ */
+void image_put_block(image_writer_t *w, const void *ptr, size_t len,
+					 size_t sz) {
+	static const uint8_t zeros[IMAGE_ALIGN] = { 0 };
+	uint64_t len64 = len;
+
+	image_put(w, &len64, sizeof(uint64_t));
+	image_put(w, zeros, (IMAGE_ALIGN - (w->offset % IMAGE_ALIGN)) %
+		IMAGE_ALIGN);
+	image_put(w, ptr, len * sz);
+}
+
+/**
+ * Writes an object to an image. Pairs only get their type written, their
+ * contents come later.
+ *
+ * @param w     Image writer.
+ * @param alloc Allocation of the object to be written.
+ */
+void image_put_object(image_writer_t *w, const allocation_t *alloc) {
+	uint8_t tmp;
+
+	tmp = (uint8_t)alloc->type;
+	image_put(w, &tmp, sizeof(uint8_t));
+
+	switch (alloc->type) {
+	case ALLOCATION_TYPE_SYMBOL:
+		image_put_block(w, alloc->data.str, _tcslen(alloc->data.str), sizeof(TCHAR));
+		break;
+	case ALLOCATION_TYPE_STRING:
+		image_put_block(w, alloc->data.string->chars, alloc->data.string->len,
+			sizeof(TCHAR));
+		break;
+	case ALLOCATION_TYPE_VECTOR:
+		tmp = (uint8_t)alloc->data.vector->type;
+		image_put(w, &tmp, sizeof(uint8_t));
+		image_put_block(w, alloc->data.vector->data.raw, alloc->data.vector->len,
+			vector_elem_size(alloc->data.vector->type));
+		break;
+	case ALLOCATION_TYPE_BIGNUM:
+		tmp = (uint8_t)alloc->data.bignum->negative;
+		image_put(w, &tmp, sizeof(uint8_t));
+		image_put_block(w, alloc->data.bignum->limbs, alloc->data.bignum->len,
+			sizeof(uint32_t));
+		break;
+	case ALLOCATION_TYPE_PAIR:
+		break;
+	}
+}
+
+/**
+ * Writes an atom to an image, turning references into object indices.
+ *
+ * @param w    Image writer.
+ * @param atom Atom to be written.
+ */
+void image_put_atom(image_writer_t *w, atom_t atom) {
+	allocation_t *alloc;
+	allocation_t **found;
+	uint32_t index;
+	uint8_t tmp;
+	size_t i;
+
+	tmp = (uint8_t)atom.type;
+	image_put(w, &tmp, sizeof(uint8_t));
+
+	switch (atom.type) {
+	case ATOM_TYPE_NIL:
+		break;
+	case ATOM_TYPE_INTEGER:
+		image_put(w, &atom.value.integer, sizeof(int64_t));
+		break;
+	case ATOM_TYPE_FLOAT:
+		image_put(w, &atom.value.dfloat, sizeof(bamboo_float_t));
+		break;
+	case ATOM_TYPE_BOOLEAN:
+		tmp = (uint8_t)atom.value.boolean;
+		image_put(w, &tmp, sizeof(uint8_t));
+		break;
+	case ATOM_TYPE_BUILTIN:
+		// Built-in functions are stored as the symbol they were registered as.
+		for (i = 0; i < bamboo_ctx->builtins_count; i++) {
+			if (bamboo_ctx->builtins[i].func == atom.value.builtin)
+				break;
+		}
+		if (i == bamboo_ctx->builtins_count) {
+			w->err = bamboo_error(BAMBOO_ERROR_WRONG_TYPE, _T("Unregistered ")
+				_T("built-in functions can't be saved in an image"));
+			return;
+		}
+
+		image_put_atom(w, bamboo_ctx->builtins[i].name);
+		break;
+	case ATOM_TYPE_POINTER:
+		w->err = bamboo_error(BAMBOO_ERROR_WRONG_TYPE, _T("Pointers can't be ")
+			_T("saved in an image"));
+		break;
+	case ATOM_TYPE_AUTOLOAD:
+		w->err = bamboo_error(BAMBOO_ERROR_WRONG_TYPE, _T("Autoload stubs ")
+			_T("can't be saved in an image"));
+		break;
+	case ATOM_TYPE_CHANNEL:
+		w->err = bamboo_error(BAMBOO_ERROR_WRONG_TYPE, _T("Channels can't ")
+			_T("be saved in an image"));
+		break;
+	default:
+		// Everything else lives in an allocation.
+		alloc = atom_alloc(atom);
+		found = (allocation_t **)bsearch(&alloc, w->objs, w->count,
+			sizeof(allocation_t *), image_cmp_alloc);
+		if (found == NULL) {
+			w->err = bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Found an ")
+				_T("unreachable object while saving an image"));
+			return;
+		}
+
+		index = (uint32_t)(found - w->objs);
+		image_put(w, &index, sizeof(uint32_t));
+		break;
+	}
+}
+
+/**
+ * Reads raw data from an image.
+ *
+ * @param  r   Image reader.
+ * @param  ptr Buffer that will hold the data.
+ * @param  len Length of the data in bytes.
+ * @return     TRUE if there was enough data to be read.
+ */
+bool image_get(image_reader_t *r, void *ptr, size_t len) {
+	if ((size_t)(r->end - r->cur) < len)
+		return false;
+
+	memcpy(ptr, r->cur, len);
+	r->cur += len;
+
+	return true;
+}
+
+/**
+ * Reads a length followed by an aligned block of data from an image.
+ *
+ * @param  r   Image reader.
+ * @param  len Pointer to the variable that will hold the number of elements.
+ * @param  sz  Size of each element in bytes.
+ * @return     Pointer to the data inside the image or NULL if the image is
+ *             corrupted.
+ */
+const void *image_get_block(image_reader_t *r, size_t *len, size_t sz) {
+	const uint8_t *data;
+	uint64_t len64;
+	size_t pad;
+
+	// Get the length and skip over the padding.
+	if (!image_get(r, &len64, sizeof(uint64_t)))
+		return NULL;
+	pad = (IMAGE_ALIGN - ((r->cur - r->start) % IMAGE_ALIGN)) % IMAGE_ALIGN;
+	if (((size_t)(r->end - r->cur) < pad) ||
+			(len64 > ((uint64_t)(r->end - r->cur - pad) / sz))) {
+		return NULL;
+	}
+
+	data = r->cur + pad;
+	r->cur = data + (len64 * sz);
+	*len = (size_t)len64;
+
+	return data;
+}
+
+/**
+ * Reads an object from an image and creates it. Pairs are created empty.
+ *
+ * @param  r    Image reader.
+ * @param  atom Pointer to the atom that will hold the object.
+ * @return      BAMBOO_OK if the object was created successfully.
+ */
+bamboo_error_t image_get_object(image_reader_t *r, atom_t *atom) {
+	const void *data;
+	string_t *string;
+	uint8_t type;
+	uint8_t tmp;
+	size_t len;
+
+	if (!image_get(r, &type, sizeof(uint8_t)))
+		goto corrupted;
+
+	switch (type) {
+	case ALLOCATION_TYPE_PAIR:
+		*atom = cons(nil, nil);
+		break;
+	case ALLOCATION_TYPE_SYMBOL:
+		data = image_get_block(r, &len, sizeof(TCHAR));
+		if (data == NULL)
+			goto corrupted;
+
+		*atom = symbol_intern((const TCHAR *)data, len, false);
+		break;
+	case ALLOCATION_TYPE_STRING:
+		data = image_get_block(r, &len, sizeof(TCHAR));
+		if (data == NULL)
+			goto corrupted;
+
+		string = string_alloc(len);
+		if (string == NULL) {
+			return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+				_T("string from image"));
+		}
+		memcpy((TCHAR *)string->chars, data, len * sizeof(TCHAR));
+		*atom = string_atom(string);
+		break;
+	case ALLOCATION_TYPE_VECTOR:
+		if (!image_get(r, &tmp, sizeof(uint8_t)) || (tmp > VECTOR_TYPE_F32))
+			goto corrupted;
+		data = image_get_block(r, &len, vector_elem_size((vector_type_t)tmp));
+		if (data == NULL)
+			goto corrupted;
+
+		*atom = bamboo_vector((vector_type_t)tmp, len);
+		memcpy((*atom->value.vector)->data.raw, data,
+			len * vector_elem_size((vector_type_t)tmp));
+		break;
+	case ALLOCATION_TYPE_BIGNUM:
+		if (!image_get(r, &tmp, sizeof(uint8_t)))
+			goto corrupted;
+		data = image_get_block(r, &len, sizeof(uint32_t));
+		if (data == NULL)
+			goto corrupted;
+
+		*atom = bignum_from_mag((const uint32_t *)data, len, tmp != 0);
+		break;
+	default:
+		goto corrupted;
+	}
+
+	return BAMBOO_OK;
+
+corrupted:
+	return bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Image file is corrupted"));
+}
+
+/**
+ * Reads an atom from an image, resolving references to the objects that have
+ * already been created.
+ *
+ * @param  r    Image reader.
+ * @param  atom Pointer to the atom that will hold the result.
+ * @return      BAMBOO_OK if the atom was read successfully.
+ */
+bamboo_error_t image_get_atom(image_reader_t *r, atom_t *atom) {
+	TCHAR msg[ERROR_MSG_STR_LEN + 1];
+	bamboo_error_t err;
+	uint32_t index;
+	uint8_t type;
+	uint8_t tmp;
+	size_t i;
+
+	if (!image_get(r, &type, sizeof(uint8_t)))
+		goto corrupted;
+
+	atom->type = (atom_type_t)type;
+	switch (type) {
+	case ATOM_TYPE_NIL:
+		*atom = nil;
+		break;
+	case ATOM_TYPE_INTEGER:
+		if (!image_get(r, &atom->value.integer, sizeof(int64_t)))
+			goto corrupted;
+		break;
+	case ATOM_TYPE_FLOAT:
+		if (!image_get(r, &atom->value.dfloat, sizeof(bamboo_float_t)))
+			goto corrupted;
+		break;
+	case ATOM_TYPE_BOOLEAN:
+		if (!image_get(r, &tmp, sizeof(uint8_t)))
+			goto corrupted;
+		atom->value.boolean = tmp != 0;
+		break;
+	case ATOM_TYPE_BUILTIN:
+		// Find the built-in function registered under this symbol.
+		err = image_get_atom(r, atom);
+		IF_ERROR(err)
+			return err;
+		if (atom->type != ATOM_TYPE_SYMBOL)
+			goto corrupted;
+		for (i = 0; i < bamboo_ctx->builtins_count; i++) {
+			if (*bamboo_ctx->builtins[i].name.value.symbol ==
+					*atom->value.symbol) {
+				*atom = bamboo_builtin(bamboo_ctx->builtins[i].func);
+				return BAMBOO_OK;
+			}
+		}
+
+		_sntprintf(msg, ERROR_MSG_STR_LEN, _T("Image references unknown ")
+			_T("built-in function '") SPEC_STR _T("'"), *atom->value.symbol);
+		return bamboo_error(BAMBOO_ERROR_UNBOUND, msg);
+	case ATOM_TYPE_SYMBOL:
+	case ATOM_TYPE_STRING:
+	case ATOM_TYPE_VECTOR:
+	case ATOM_TYPE_BIGNUM:
+	case ATOM_TYPE_PAIR:
+	case ATOM_TYPE_CLOSURE:
+	case ATOM_TYPE_MACRO:
+		// References to objects.
+		if (!image_get(r, &index, sizeof(uint32_t)) || (index >= r->count))
+			goto corrupted;
+		if ((type == ATOM_TYPE_CLOSURE) || (type == ATOM_TYPE_MACRO)) {
+			if (r->objs[index].type != ATOM_TYPE_PAIR)
+				goto corrupted;
+		} else if (r->objs[index].type != type) {
+			goto corrupted;
+		}
+
+		*atom = r->objs[index];
+		atom->type = (atom_type_t)type;
+		break;
+	default:
+		goto corrupted;
+	}
+
+	return BAMBOO_OK;
+
+corrupted:
+	return bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Image file is corrupted"));
+}
+
+/**
+ * Opens a file using a wide or narrow path depending on how we were built.
+ *
+ * @param  path Path to the file.
+ * @param  mode Mode to open the file in.
+ * @return      File handle or NULL if the file couldn't be opened.
+ */
+FILE *tfopen(const TCHAR *path, const TCHAR *mode) {
+#if defined(UNICODE) && !defined(_WIN32)
+	char spath[IMAGE_PATH_MAX_LEN + 1];
+	char smode[4];
+
+	// Convert the path and mode to narrow strings.
+	if ((wcstombs(spath, path, IMAGE_PATH_MAX_LEN) == (size_t)-1) ||
+			(wcstombs(smode, mode, 3) == (size_t)-1)) {
+		return NULL;
+	}
+	spath[IMAGE_PATH_MAX_LEN] = '\0';
+	smode[3] = '\0';
+
+	return fopen(spath, smode);
+#else
+	return _tfopen(path, mode);
+#endif  // UNICODE && !_WIN32
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                               Serialization                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Serializes an expression to a compact binary encoding that preserves shared
+ * and cyclic structure.
+ * WARNING: Remember to free the returned buffer.
+ *
+ * @param  expr Expression to be serialized.
+ * @param  buf  Pointer to the buffer that will be allocated to hold the data.
+ * @param  len  Pointer to the variable that will hold the length of the data.
+ * @return      BAMBOO_OK if the expression was serialized successfully.
+ */
+bamboo_error_t bamboo_serialize(atom_t expr, uint8_t **buf, size_t *len) {
+	fasl_writer_t w;
+
+	*buf = NULL;
+	*len = 0;
+	memset(&w, 0, sizeof(fasl_writer_t));
+
+	// Find out which objects are referenced more than once.
+	w.err = fasl_count(&w, expr);
+
+	// Encode the expression.
+	if (w.err == BAMBOO_OK) {
+		fasl_put_byte(&w, FASL_MAGIC_0);
+		fasl_put_byte(&w, FASL_MAGIC_1);
+		fasl_put_byte(&w, FASL_VERSION);
+		fasl_put_byte(&w, (uint8_t)sizeof(TCHAR));
+		fasl_put_atom(&w, expr);
+	}
+
+	// Clean up.
+	ptrmap_free(&w.objs);
+	ptrmap_free(&w.syms);
+	if (w.err != BAMBOO_OK) {
+		free(w.buf);
+		return w.err;
+	}
+
+	*buf = w.buf;
+	*len = w.len;
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Deserializes an expression encoded with bamboo_serialize, allocating it
+ * straight into the heap.
+ *
+ * @param  buf  Serialized data.
+ * @param  len  Length of the serialized data.
+ * @param  expr Pointer to the atom that will hold the expression.
+ * @return      BAMBOO_OK if the expression was deserialized successfully.
+ */
+bamboo_error_t bamboo_deserialize(const uint8_t *buf, size_t len,
+								  atom_t *expr) {
+	bamboo_error_t err;
+	fasl_reader_t r;
+
+	*expr = nil;
+	memset(&r, 0, sizeof(fasl_reader_t));
+	r.cur = buf;
+	r.end = buf + len;
+
+	// Check the header.
+	if ((len < 4) || (buf[0] != FASL_MAGIC_0) || (buf[1] != FASL_MAGIC_1) ||
+			(buf[2] != FASL_VERSION)) {
+		return bamboo_error(BAMBOO_ERROR_SYNTAX, _T("Not a serialized ")
+			_T("expression"));
+	} else if (buf[3] != sizeof(TCHAR)) {
+		return bamboo_error(BAMBOO_ERROR_SYNTAX, _T("Serialized expression ")
+			_T("uses a different character width"));
+	}
+	r.cur += 4;
+
+	// Decode the expression.
+	err = fasl_get_atom(&r, expr);
+	IF_NOT_ERROR(err) {
+		if (r.cur != r.end) {
+			err = bamboo_error(BAMBOO_ERROR_SYNTAX, _T("Trailing data after ")
+				_T("serialized expression"));
+		}
+	}
+
+	free(r.syms);
+	free(r.refs);
+	IF_ERROR(err)
+		*expr = nil;
+
+	return err;
+}
+
+/**
+ * Counts the references to every object in an expression, stopping at objects
+ * that have been seen before so that cycles are only followed once.
+ *
+ * @param  w    FASL writer.
+ * @param  atom Expression to go through.
+ * @return      BAMBOO_OK if everything went fine.
+ */
+bamboo_error_t fasl_count(fasl_writer_t *w, atom_t atom) {
+	bamboo_error_t err;
+	ptrmap_entry_t *entry;
+	allocation_t *alloc;
+
+	for (;;) {
+		// Only heap objects can be shared, and symbols have their own table.
+		alloc = atom_alloc(atom);
+		if ((alloc == NULL) || (atom.type == ATOM_TYPE_SYMBOL) ||
+				fasl_root_env_p(atom)) {
+			return BAMBOO_OK;
+		}
+
+		// Have we been here before?
+		err = ptrmap_get(&w->objs, alloc, &entry);
+		IF_ERROR(err)
+			return err;
+		if (entry->count++ > 0)
+			return BAMBOO_OK;
+
+		// Go through the insides of pairs.
+		if (alloc->type != ALLOCATION_TYPE_PAIR)
+			return BAMBOO_OK;
+		err = fasl_count(w, car(atom));
+		IF_ERROR(err)
+			return err;
+		atom = cdr(atom);
+	}
+}
+
+/**
+ * Checks if an atom is the root environment, which is never serialized and is
+ * instead replaced by the root environment of whoever deserializes it.
+ *
+ * @param  atom Atom to be checked.
+ * @return      TRUE if the atom is the root environment.
+ */
+bool fasl_root_env_p(atom_t atom) {
+	return (atom.type == ATOM_TYPE_PAIR) && (bamboo_ctx->root_env != NULL) &&
+		(atom.value.pair == bamboo_ctx->root_env->value.pair);
+}
+
+/**
+ * Appends raw bytes to the FASL output.
+ *
+ * @param w   FASL writer.
+ * @param ptr Bytes to be appended.
+ * @param len Number of bytes to append.
+ */
+void fasl_put(fasl_writer_t *w, const void *ptr, size_t len) {
+	if (w->err != BAMBOO_OK)
+		return;
+
+	// Make sure we have enough room.
+	if ((w->len + len) > w->cap) {
+		size_t cap = (w->cap == 0) ? FASL_MIN_CAP : w->cap;
+		uint8_t *tmp;
+
+		while (cap < (w->len + len))
+			cap *= 2;
+		tmp = (uint8_t *)realloc(w->buf, cap);
+		if (tmp == NULL) {
+			w->err = bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't ")
+				_T("allocate serialization buffer"));
+			return;
+		}
+
+		w->buf = tmp;
+		w->cap = cap;
+	}
+
+	memcpy(w->buf + w->len, ptr, len);
+	w->len += len;
+}
+
+/**
+ * Appends a single byte to the FASL output.
+ *
+ * @param w FASL writer.
+ * @param b Byte to be appended.
+ */
+void fasl_put_byte(fasl_writer_t *w, uint8_t b) {
+	fasl_put(w, &b, 1);
+}
+
+/**
+ * Appends an unsigned variable-length integer (LEB128) to the FASL output.
+ *
+ * @param w   FASL writer.
+ * @param num Number to be appended.
+ */
+void fasl_put_varint(fasl_writer_t *w, uint64_t num) {
+	uint8_t tmp[10];
+	size_t len = 0;
+
+	while (num >= 0x80) {
+		tmp[len++] = (uint8_t)(num | 0x80);
+		num >>= 7;
+	}
+	tmp[len++] = (uint8_t)num;
+
+	fasl_put(w, tmp, len);
+}
+
+/**
+ * Appends an array of little-endian numbers to the FASL output.
+ *
+ * @param w   FASL writer.
+ * @param ptr Array of numbers.
+ * @param sz  Size of each number in bytes.
+ * @param n   Number of elements in the array.
+ */
+void fasl_put_le(fasl_writer_t *w, const void *ptr, size_t sz, size_t n) {
+	const uint8_t *src = (const uint8_t *)ptr;
+	uint8_t tmp[8];
+	size_t i;
+	size_t j;
+
+	// Little-endian hosts can copy everything in one go.
+	if (host_little_endian()) {
+		fasl_put(w, ptr, sz * n);
+		return;
+	}
+
+	for (i = 0; i < n; i++, src += sz) {
+		for (j = 0; j < sz; j++)
+			tmp[j] = src[sz - j - 1];
+		fasl_put(w, tmp, sz);
+	}
+}
+
+/**
+ * Appends a run of characters to the FASL output, prefixed by its length.
+ *
+ * @param w   FASL writer.
+ * @param str Characters to be appended.
+ * @param len Number of characters.
+ */
+void fasl_put_chars(fasl_writer_t *w, const TCHAR *str, size_t len) {
+	fasl_put_varint(w, len);
+	fasl_put_le(w, str, sizeof(TCHAR), len);
+}
+
+/**
+ * Appends an atom to the FASL output.
+ *
+ * @param w    FASL writer.
+ * @param atom Atom to be appended.
+ */
+void fasl_put_atom(fasl_writer_t *w, atom_t atom) {
+	ptrmap_entry_t *entry;
+	allocation_t *alloc;
+	bamboo_float_t fnum;
+	uint8_t shared;
+	uint64_t bits;
+	double dnum;
+	size_t count;
+	size_t i;
+	atom_t tmp;
+
+	if (w->err != BAMBOO_OK)
+		return;
+
+	// Check if we've already written this object.
+	shared = 0;
+	alloc = atom_alloc(atom);
+	if ((alloc != NULL) && (atom.type != ATOM_TYPE_SYMBOL) &&
+			!fasl_root_env_p(atom)) {
+		w->err = ptrmap_get(&w->objs, alloc, &entry);
+		if (w->err != BAMBOO_OK)
+			return;
+
+		if (entry->index > 0) {
+			fasl_put_byte(w, FASL_REF);
+			fasl_put_varint(w, entry->index - 1);
+			return;
+		} else if (entry->count > 1) {
+			// Shared objects get an index for later references.
+			entry->index = ++w->nrefs;
+			shared = FASL_SHARED;
+		}
+	}
+
+	switch (atom.type) {
+	case ATOM_TYPE_NIL:
+		fasl_put_byte(w, FASL_NIL);
+		break;
+	case ATOM_TYPE_BOOLEAN:
+		fasl_put_byte(w, (atom.value.boolean) ? FASL_TRUE : FASL_FALSE);
+		break;
+	case ATOM_TYPE_INTEGER:
+		// Zigzag encoding keeps small negative numbers short.
+		fasl_put_byte(w, FASL_INT);
+		fasl_put_varint(w, ((uint64_t)atom.value.integer << 1) ^
+			(uint64_t)(atom.value.integer >> 63));
+		break;
+	case ATOM_TYPE_FLOAT:
+		// Use a plain double whenever it's able to hold the number exactly.
+		fnum = atom.value.dfloat;
+		dnum = (double)fnum;
+		if (((bamboo_float_t)dnum == fnum) || isnan(fnum)) {
+			memcpy(&bits, &dnum, sizeof(uint64_t));
+			fasl_put_byte(w, FASL_FLOAT64);
+			fasl_put_le(w, &bits, sizeof(uint64_t), 1);
+		} else {
+			fasl_put_byte(w, FASL_FLOAT_NATIVE);
+			fasl_put_byte(w, (uint8_t)sizeof(bamboo_float_t));
+			fasl_put(w, &fnum, sizeof(bamboo_float_t));
+		}
+		break;
+	case ATOM_TYPE_BIGNUM:
+		fasl_put_byte(w, FASL_BIGNUM | shared);
+		fasl_put_byte(w, (uint8_t)(*atom.value.bignum)->negative);
+		fasl_put_varint(w, (*atom.value.bignum)->len);
+		fasl_put_le(w, (*atom.value.bignum)->limbs, sizeof(uint32_t),
+			(*atom.value.bignum)->len);
+		break;
+	case ATOM_TYPE_STRING:
+		fasl_put_byte(w, FASL_STRING | shared);
+		fasl_put_chars(w, (*atom.value.str)->chars, (*atom.value.str)->len);
+		break;
+	case ATOM_TYPE_VECTOR:
+		fasl_put_byte(w, FASL_VECTOR | shared);
+		fasl_put_byte(w, (uint8_t)(*atom.value.vector)->type);
+		fasl_put_varint(w, (*atom.value.vector)->len);
+		fasl_put_le(w, (*atom.value.vector)->data.raw,
+			vector_elem_size((*atom.value.vector)->type),
+			(*atom.value.vector)->len);
+		break;
+	case ATOM_TYPE_SYMBOL:
+		// Symbols are written out once and referenced by index afterwards.
+		w->err = ptrmap_get(&w->syms, atom_alloc(atom), &entry);
+		if (w->err != BAMBOO_OK)
+			return;
+		if (entry->index > 0) {
+			fasl_put_byte(w, FASL_SYMREF);
+			fasl_put_varint(w, entry->index - 1);
+		} else {
+			entry->index = ++w->nsyms;
+			fasl_put_byte(w, FASL_SYMBOL);
+			fasl_put_chars(w, *atom.value.symbol,
+				_tcslen(*atom.value.symbol));
+		}
+		break;
+	case ATOM_TYPE_BUILTIN:
+		// Built-in functions are written as the symbol they were registered as.
+		for (i = 0; i < bamboo_ctx->builtins_count; i++) {
+			if (bamboo_ctx->builtins[i].func == atom.value.builtin)
+				break;
+		}
+		if (i == bamboo_ctx->builtins_count) {
+			w->err = bamboo_error(BAMBOO_ERROR_WRONG_TYPE, _T("Unregistered ")
+				_T("built-in functions can't be serialized"));
+			return;
+		}
+
+		fasl_put_byte(w, FASL_BUILTIN);
+		fasl_put_atom(w, bamboo_ctx->builtins[i].name);
+		break;
+	case ATOM_TYPE_CLOSURE:
+	case ATOM_TYPE_MACRO:
+		// Closures and macros are written just like a pair.
+		fasl_put_byte(w, ((atom.type == ATOM_TYPE_CLOSURE) ? FASL_CLOSURE :
+			FASL_MACRO) | shared);
+		fasl_put_atom(w, car(atom));
+		fasl_put_atom(w, cdr(atom));
+		break;
+	case ATOM_TYPE_PAIR:
+		if (fasl_root_env_p(atom)) {
+			fasl_put_byte(w, FASL_ROOT_ENV);
+			break;
+		}
+
+		// Count the cells of the list that nothing else refers to.
+		count = 1;
+		for (tmp = cdr(atom); (tmp.type == ATOM_TYPE_PAIR) &&
+				!fasl_root_env_p(tmp); tmp = cdr(tmp)) {
+			if (ptrmap_find(&w->objs, atom_alloc(tmp))->count > 1)
+				break;
+			count++;
+		}
+
+		// Write the items of the list followed by its tail.
+		fasl_put_byte(w, FASL_LIST | shared);
+		fasl_put_varint(w, count);
+		for (i = 0; i < count; i++) {
+			fasl_put_atom(w, car(atom));
+			atom = cdr(atom);
+		}
+		fasl_put_atom(w, atom);
+		break;
+	case ATOM_TYPE_POINTER:
+		w->err = bamboo_error(BAMBOO_ERROR_WRONG_TYPE, _T("Pointers can't be ")
+			_T("serialized"));
+		break;
+	case ATOM_TYPE_AUTOLOAD:
+		w->err = bamboo_error(BAMBOO_ERROR_WRONG_TYPE, _T("Autoload stubs ")
+			_T("can't be serialized"));
+		break;
+	case ATOM_TYPE_CHANNEL:
+		w->err = bamboo_error(BAMBOO_ERROR_WRONG_TYPE, _T("Channels can't ")
+			_T("be serialized"));
+		break;
+	}
+}
+
+/**
+ * Reads raw bytes from the FASL input.
+ *
+ * @param  r   FASL reader.
+ * @param  len Number of bytes to read.
+ * @return     Pointer to the bytes or NULL if there aren't enough of them.
+ */
+const uint8_t *fasl_get(fasl_reader_t *r, size_t len) {
+	const uint8_t *data = r->cur;
+
+	if ((size_t)(r->end - r->cur) < len)
+		return NULL;
+	r->cur += len;
+
+	return data;
+}
+
+/**
+ * Reads an unsigned variable-length integer (LEB128) from the FASL input.
+ *
+ * @param  r   FASL reader.
+ * @param  num Pointer to the variable that will hold the number.
+ * @return     TRUE if a valid number was read.
+ */
+bool fasl_get_varint(fasl_reader_t *r, uint64_t *num) {
+	unsigned int shift = 0;
+	uint8_t b;
+
+	*num = 0;
+	do {
+		if ((r->cur == r->end) || (shift > 63))
+			return false;
+
+		b = *r->cur++;
+		*num |= (uint64_t)(b & 0x7F) << shift;
+		shift += 7;
+	} while (b & 0x80);
+
+	return true;
+}
+
+/**
+ * Reads a length that is bounded by the number of bytes left in the input.
+ *
+ * @param  r   FASL reader.
+ * @param  sz  Minimum number of bytes each element takes up in the input.
+ * @param  len Pointer to the variable that will hold the length.
+ * @return     TRUE if a valid length was read.
+ */
+bool fasl_get_len(fasl_reader_t *r, size_t sz, size_t *len) {
+	uint64_t num;
+
+	if (!fasl_get_varint(r, &num) ||
+			(num > ((uint64_t)(r->end - r->cur) / sz))) {
+		return false;
+	}
+	*len = (size_t)num;
+
+	return true;
+}
+
+/**
+ * Reads an array of little-endian numbers from the FASL input.
+ *
+ * @param  r   FASL reader.
+ * @param  dst Array that will hold the numbers.
+ * @param  sz  Size of each number in bytes.
+ * @param  n   Number of elements to read.
+ * @return     TRUE if there were enough bytes to read.
+ */
+bool fasl_get_le(fasl_reader_t *r, void *dst, size_t sz, size_t n) {
+	const uint8_t *src;
+	uint8_t *out = (uint8_t *)dst;
+	size_t i;
+	size_t j;
+
+	src = fasl_get(r, sz * n);
+	if (src == NULL)
+		return false;
+
+	// Little-endian hosts can copy everything in one go.
+	if (host_little_endian()) {
+		memcpy(dst, src, sz * n);
+		return true;
+	}
+
+	for (i = 0; i < n; i++, out += sz, src += sz) {
+		for (j = 0; j < sz; j++)
+			out[j] = src[sz - j - 1];
+	}
+
+	return true;
+}
+
+/**
+ * Registers a shared object so that later references can find it.
+ *
+ * @param  r    FASL reader.
+ * @param  atom Shared object.
+ * @return      BAMBOO_OK if the object was registered.
+ */
+bamboo_error_t fasl_add_ref(fasl_reader_t *r, atom_t atom) {
+	return fasl_push(&r->refs, &r->nrefs, &r->caprefs, atom);
+}
+
+/**
+ * Appends an atom to one of the tables of a FASL reader.
+ *
+ * @param  table Pointer to the table.
+ * @param  len   Pointer to the number of atoms in the table.
+ * @param  cap   Pointer to the capacity of the table.
+ * @param  atom  Atom to be appended.
+ * @return       BAMBOO_OK if the atom was appended.
+ */
+bamboo_error_t fasl_push(atom_t **table, size_t *len, size_t *cap,
+						 atom_t atom) {
+	if (*len == *cap) {
+		size_t ncap = (*cap == 0) ? FASL_TABLE_MIN_CAP : (*cap * 2);
+		atom_t *tmp;
+
+		tmp = (atom_t *)realloc(*table, ncap * sizeof(atom_t));
+		if (tmp == NULL) {
+			return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+				_T("deserialization table"));
+		}
+
+		*table = tmp;
+		*cap = ncap;
+	}
+
+	(*table)[(*len)++] = atom;
+	return BAMBOO_OK;
+}
+
+/**
+ * Reads an atom from the FASL input, allocating it straight into the heap.
+ *
+ * @param  r    FASL reader.
+ * @param  atom Pointer to the atom that will hold the result.
+ * @return      BAMBOO_OK if the atom was read successfully.
+ */
+bamboo_error_t fasl_get_atom(fasl_reader_t *r, atom_t *atom) {
+	bamboo_error_t err;
+	const uint8_t *data;
+	string_t *string;
+	bamboo_float_t fnum;
+	uint64_t num;
+	uint32_t *limbs;
+	double dnum;
+	size_t len;
+	size_t i;
+	uint8_t tag;
+	uint8_t tmp;
+	atom_t cell;
+
+	// Keep corrupted data from exhausting the stack.
+	if (r->depth >= FASL_MAX_DEPTH) {
+		return bamboo_error(BAMBOO_ERROR_SYNTAX, _T("Serialized expression ")
+			_T("is nested too deeply"));
+	}
+
+	data = fasl_get(r, 1);
+	if (data == NULL)
+		goto corrupted;
+	tag = *data;
+
+	err = BAMBOO_OK;
+	r->depth++;
+	switch (tag & ~FASL_SHARED) {
+	case FASL_NIL:
+		*atom = nil;
+		break;
+	case FASL_TRUE:
+	case FASL_FALSE:
+		*atom = bamboo_boolean(tag == FASL_TRUE);
+		break;
+	case FASL_INT:
+		if (!fasl_get_varint(r, &num))
+			goto corrupted;
+		*atom = bamboo_int((int64_t)((num >> 1) ^ (~(num & 1) + 1)));
+		break;
+	case FASL_FLOAT64:
+		if (!fasl_get_le(r, &num, sizeof(uint64_t), 1))
+			goto corrupted;
+		memcpy(&dnum, &num, sizeof(double));
+		*atom = bamboo_float((bamboo_float_t)dnum);
+		break;
+	case FASL_FLOAT_NATIVE:
+		data = fasl_get(r, 1);
+		if ((data == NULL) || (*data != sizeof(bamboo_float_t)))
+			goto corrupted;
+		data = fasl_get(r, sizeof(bamboo_float_t));
+		if (data == NULL)
+			goto corrupted;
+		memcpy(&fnum, data, sizeof(bamboo_float_t));
+		*atom = bamboo_float(fnum);
+		break;
+	case FASL_BIGNUM:
+		data = fasl_get(r, 1);
+		if ((data == NULL) || !fasl_get_len(r, sizeof(uint32_t), &len))
+			goto corrupted;
+		tmp = *data;
+
+		limbs = (uint32_t *)malloc((len + 1) * sizeof(uint32_t));
+		if (limbs == NULL) {
+			err = bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+				_T("big integer limbs"));
+			break;
+		}
+		fasl_get_le(r, limbs, sizeof(uint32_t), len);
+		*atom = bignum_from_mag(limbs, len, tmp != 0);
+		free(limbs);
+		break;
+	case FASL_STRING:
+		if (!fasl_get_len(r, sizeof(TCHAR), &len))
+			goto corrupted;
+
+		string = string_alloc(len);
+		if (string == NULL) {
+			err = bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+				_T("string"));
+			break;
+		}
+		fasl_get_le(r, (TCHAR *)string->chars, sizeof(TCHAR), len);
+		*atom = string_atom(string);
+		break;
+	case FASL_VECTOR:
+		data = fasl_get(r, 1);
+		if ((data == NULL) || (*data > VECTOR_TYPE_F32))
+			goto corrupted;
+		tmp = *data;
+		if (!fasl_get_len(r, vector_elem_size((vector_type_t)tmp), &len))
+			goto corrupted;
+
+		*atom = bamboo_vector((vector_type_t)tmp, len);
+		fasl_get_le(r, (*atom->value.vector)->data.raw,
+			vector_elem_size((vector_type_t)tmp), len);
+		break;
+	case FASL_SYMBOL:
+		if (!fasl_get_len(r, sizeof(TCHAR), &len))
+			goto corrupted;
+
+		// Symbol names are usually short, so decode them on the stack.
+		data = fasl_get(r, len * sizeof(TCHAR));
+		if (host_little_endian() && ((sizeof(TCHAR) == 1) ||
+				(((uintptr_t)data % sizeof(TCHAR)) == 0))) {
+			*atom = symbol_intern((const TCHAR *)data, len, false);
+		} else {
+			TCHAR *name = (TCHAR *)malloc((len + 1) * sizeof(TCHAR));
+
+			if (name == NULL) {
+				err = bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't ")
+					_T("allocate symbol name"));
+				break;
+			}
+			r->cur = data;
+			fasl_get_le(r, name, sizeof(TCHAR), len);
+			*atom = symbol_intern(name, len, false);
+			free(name);
+		}
+
+		err = fasl_push(&r->syms, &r->nsyms, &r->capsyms, *atom);
+		break;
+	case FASL_SYMREF:
+		if (!fasl_get_varint(r, &num) || (num >= r->nsyms))
+			goto corrupted;
+		*atom = r->syms[num];
+		break;
+	case FASL_REF:
+		if (!fasl_get_varint(r, &num) || (num >= r->nrefs))
+			goto corrupted;
+		*atom = r->refs[num];
+		break;
+	case FASL_ROOT_ENV:
+		if (bamboo_ctx->root_env == NULL)
+			goto corrupted;
+		*atom = *bamboo_ctx->root_env;
+		break;
+	case FASL_BUILTIN:
+		err = fasl_get_atom(r, atom);
+		IF_ERROR(err)
+			break;
+		if (atom->type != ATOM_TYPE_SYMBOL)
+			goto corrupted;
+
+		// Find the built-in function registered under this symbol.
+		for (i = 0; i < bamboo_ctx->builtins_count; i++) {
+			if (*bamboo_ctx->builtins[i].name.value.symbol ==
+					*atom->value.symbol) {
+				break;
+			}
+		}
+		if (i == bamboo_ctx->builtins_count) {
+			err = bamboo_error(BAMBOO_ERROR_UNBOUND, _T("Serialized ")
+				_T("expression references an unknown built-in function"));
+			break;
+		}
+		*atom = bamboo_builtin(bamboo_ctx->builtins[i].func);
+		break;
+	case FASL_CLOSURE:
+	case FASL_MACRO:
+		// Create the closure before its insides, since they may refer to it.
+		*atom = cons(nil, nil);
+		atom->type = ((tag & ~FASL_SHARED) == FASL_CLOSURE) ?
+			ATOM_TYPE_CLOSURE : ATOM_TYPE_MACRO;
+		if (tag & FASL_SHARED) {
+			err = fasl_add_ref(r, *atom);
+			IF_ERROR(err)
+				break;
+		}
+
+		err = fasl_get_atom(r, &car(*atom));
+		IF_NOT_ERROR(err)
+			err = fasl_get_atom(r, &cdr(*atom));
+		break;
+	case FASL_LIST:
+		if (!fasl_get_len(r, 1, &len) || (len == 0))
+			goto corrupted;
+
+		// Create the head before its items, since they may refer to it.
+		*atom = cons(nil, nil);
+		if (tag & FASL_SHARED) {
+			err = fasl_add_ref(r, *atom);
+			IF_ERROR(err)
+				break;
+		}
+
+		// Build the list one cell at a time.
+		cell = *atom;
+		for (i = 0; ; i++) {
+			err = fasl_get_atom(r, &car(cell));
+			IF_ERROR(err)
+				break;
+			if (i == (len - 1))
+				break;
+
+			cdr(cell) = cons(nil, nil);
+			cell = cdr(cell);
+		}
+		IF_NOT_ERROR(err)
+			err = fasl_get_atom(r, &cdr(cell));
+		break;
+	default:
+		goto corrupted;
+	}
+
+	// Remember shared objects that weren't registered up front.
+	if ((err == BAMBOO_OK) && (tag & FASL_SHARED) &&
+			((tag & ~FASL_SHARED) != FASL_LIST) &&
+			((tag & ~FASL_SHARED) != FASL_CLOSURE) &&
+			((tag & ~FASL_SHARED) != FASL_MACRO)) {
+		err = fasl_add_ref(r, *atom);
+	}
+
+	r->depth--;
+	return err;
+
+corrupted:
+	return bamboo_error(BAMBOO_ERROR_SYNTAX, _T("Serialized expression is ")
+		_T("corrupted"));
+}
+
+/**
+ * Checks if we are running on a little-endian machine.
+ *
+ * @return TRUE if the machine is little-endian.
+ */
+bool host_little_endian(void) {
+	const uint16_t probe = 1;
+
+	return *(const uint8_t *)&probe == 1;
+}
+
+/**
+ * Gets the entry of a pointer in a pointer map, adding it if needed.
+ *
+ * @param  map   Pointer map.
+ * @param  key   Pointer to look up.
+ * @param  entry Pointer to the variable that will hold the entry.
+ * @return       BAMBOO_OK if the entry was found or added.
+ */
+bamboo_error_t ptrmap_get(ptrmap_t *map, const void *key,
+						  ptrmap_entry_t **entry) {
+	ptrmap_entry_t *e;
+
+	// Grow the table if it's getting crowded.
+	if (((map->count + 1) * 2) > map->cap) {
+		ptrmap_t grown;
+		size_t i;
+
+		grown.cap = (map->cap == 0) ? PTRMAP_MIN_CAP : (map->cap * 2);
+		grown.count = 0;
+		grown.entries = (ptrmap_entry_t *)calloc(grown.cap,
+			sizeof(ptrmap_entry_t));
+		if (grown.entries == NULL) {
+			return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+				_T("pointer map"));
+		}
+
+		for (i = 0; i < map->cap; i++) {
+			if (map->entries[i].key != NULL) {
+				e = ptrmap_find(&grown, map->entries[i].key);
+				*e = map->entries[i];
+				grown.count++;
+			}
+		}
+
+		free(map->entries);
+		*map = grown;
+	}
+
+	// Find the slot and claim it if it's a new one.
+	e = ptrmap_find(map, key);
+	if (e->key == NULL) {
+		e->key = key;
+		map->count++;
+	}
+	*entry = e;
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Finds the slot of a pointer in a pointer map, which is either the one that
+ * holds it or the empty one it should go in.
+ *
+ * @param  map Pointer map. Must have at least one empty slot.
+ * @param  key Pointer to look up.
+ * @return     Slot of the pointer.
+ */
+ptrmap_entry_t *ptrmap_find(const ptrmap_t *map, const void *key) {
+	size_t mask = map->cap - 1;
+	size_t i;
+
+	// Allocations are at least 8 bytes apart, so mix in the higher bits.
+	i = (size_t)(((uintptr_t)key >> 4) * 0x9E3779B97F4A7C15ULL) & mask;
+	while ((map->entries[i].key != NULL) && (map->entries[i].key != key))
+		i = (i + 1) & mask;
+
+	return &map->entries[i];
+}
+
+/**
+ * Frees up a pointer map.
+ *
+ * @param map Pointer map to be freed.
+ */
+void ptrmap_free(ptrmap_t *map) {
+	free(map->entries);
+	map->entries = NULL;
+	map->cap = 0;
+	map->count = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                Parallel Map                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Applies a function to every element of a list using a pool of worker
+ * interpreters running on separate threads. Each worker has its own heap, so
+ * the definitions in the root environment, the function, the arguments and the
+ * results are all copied between heaps using the serialization format. The
+ * list is split into chunks that idle workers steal from busy ones.
+ *
+ * @param  func    Function to be applied. It shouldn't have side effects, since
+ *                 it runs in a copy of the environment.
+ * @param  list    List of arguments.
+ * @param  workers Number of workers to use. If 0 one per processor is used.
+ * @param  result  List with the result of each application, in order.
+ * @return         BAMBOO_OK if every application was successful.
+ */
+bamboo_error_t bamboo_pmap(atom_t func, atom_t list, size_t workers,
+						   atom_t *result) {
+#ifdef USE_PTHREADS
+	bamboo_error_t err;
+	eval_root_t root;
+	pmap_pool_t *pool;
+	pmap_chunk_t *chunks;
+	uint8_t *buf;
+	atom_t last;
+	atom_t tail;
+	atom_t cur;
+	size_t count;
+	size_t flen;
+	size_t len;
+	size_t i;
+#endif  // USE_PTHREADS
+
+	// Check the arguments.
+	*result = nil;
+	if ((func.type != ATOM_TYPE_BUILTIN) && (func.type != ATOM_TYPE_CLOSURE)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Function atom must be of type built-in or closure"));
+	}
+	if (!listp(list)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Arguments must be supplied as a list"));
+	}
+
+#ifndef USE_PTHREADS
+	(void)workers;
+	return pmap_serial(func, list, result);
+#else
+	// Small jobs and workers themselves don't get any help.
+	if (workers == 0)
+		workers = pmap_cpu_count();
+	for (len = 0, cur = list; !nilp(cur); cur = cdr(cur))
+		len++;
+	if ((workers < 2) || (len < 2) || bamboo_ctx->pmap_worker)
+		return pmap_serial(func, list, result);
+
+	// Threads don't survive a fork, so abandon pools from our parent process.
+	pool = bamboo_ctx->pmap_pool;
+	if ((pool != NULL) && (pool->owner != getpid())) {
+		bamboo_ctx->pmap_pool = NULL;
+		pool = NULL;
+	}
+
+	// Get a pool of the right size ready.
+	if ((pool != NULL) && (pool->count != workers)) {
+		pmap_pool_free(pool);
+		bamboo_ctx->pmap_pool = NULL;
+		pool = NULL;
+	}
+	if (pool == NULL) {
+		err = pmap_pool_new(workers, &pool);
+		IF_ERROR(err)
+			return err;
+		bamboo_ctx->pmap_pool = pool;
+	}
+
+	// Make sure the workers know about everything we've defined. Lazily loaded
+	// definitions may trigger a collection, so keep our arguments safe.
+	root.expr = &func;
+	root.env = bamboo_ctx->root_env;
+	root.stack = &list;
+	root.prev = bamboo_ctx->eval_roots;
+	bamboo_ctx->eval_roots = &root;
+	err = pmap_snapshot(pool);
+	bamboo_ctx->eval_roots = root.prev;
+	IF_ERROR(err)
+		return err;
+
+	// Copy the function and split the list into chunks.
+	err = bamboo_serialize(func, &buf, &flen);
+	IF_ERROR(err)
+		return err;
+	count = pool->count * PMAP_CHUNKS_PER_WORKER;
+	if (count > len)
+		count = len;
+	err = pmap_chunks_new(list, len, count, &chunks);
+	IF_ERROR(err) {
+		free(buf);
+		return err;
+	}
+
+	// Give each worker an even share of the chunks.
+	for (i = 0; i < pool->count; i++) {
+		pool->workers[i].deque.head = (i * count) / pool->count;
+		pool->workers[i].deque.tail = ((i + 1) * count) / pool->count;
+	}
+
+	// Start the workers and wait for all of them to finish.
+	pthread_mutex_lock(&pool->lock);
+	pool->func = buf;
+	pool->func_len = flen;
+	pool->chunks = chunks;
+	pool->pending = pool->count;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	while (pool->pending > 0)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pool->func = NULL;
+	pool->chunks = NULL;
+	pthread_mutex_unlock(&pool->lock);
+	free(buf);
+
+	// Put the results back together in order.
+	err = BAMBOO_OK;
+	last = nil;
+	for (i = 0; i < count; i++) {
+		IF_ERROR(chunks[i].err) {
+			err = bamboo_error(chunks[i].err, chunks[i].msg);
+			break;
+		}
+
+		err = bamboo_deserialize(chunks[i].results, chunks[i].results_len,
+			&tail);
+		IF_ERROR(err)
+			break;
+		if (nilp(tail))
+			continue;
+
+		// Append the results of the chunk to the list.
+		if (nilp(last)) {
+			*result = tail;
+		} else {
+			cdr(last) = tail;
+		}
+		for (last = tail; !nilp(cdr(last)); last = cdr(last))
+			;
+	}
+
+	pmap_chunks_free(chunks, count);
+	IF_ERROR(err)
+		*result = nil;
+
+	return err;
+#endif  // USE_PTHREADS
+}
+
+/**
+ * Applies a function to every element of a list in the current interpreter.
+ *
+ * @param  func   Function to be applied.
+ * @param  list   List of arguments.
+ * @param  result List with the result of each application.
+ * @return        BAMBOO_OK if every application was successful.
+ */
+bamboo_error_t pmap_serial(atom_t func, atom_t list, atom_t *result) {
+	bamboo_error_t err;
+	eval_root_t root;
+	atom_t value;
+	atom_t last;
+	atom_t work;
+
+	// We may be called from outside of an evaluation, so keep everything safe
+	// from the garbage collector.
+	work = cons(list, nil);
+	root.expr = &func;
+	root.env = bamboo_ctx->root_env;
+	root.stack = &work;
+	root.prev = bamboo_ctx->eval_roots;
+	bamboo_ctx->eval_roots = &root;
+
+	err = BAMBOO_OK;
+	last = nil;
+	for (; !nilp(list); list = cdr(list)) {
+		err = apply(func, cons(car(list), nil), &value);
+		IF_ERROR(err)
+			break;
+
+		// Append the value to the result list.
+		if (nilp(last)) {
+			cdr(work) = cons(value, nil);
+			last = cdr(work);
+		} else {
+			cdr(last) = cons(value, nil);
+			last = cdr(last);
+		}
+	}
+
+	bamboo_ctx->eval_roots = root.prev;
+	*result = (err == BAMBOO_OK) ? cdr(work) : nil;
+
+	return err;
+}
+
+#ifdef USE_PTHREADS
+/**
+ * Gets the number of processors that are currently online.
+ *
+ * @return Number of processors. At least 1.
+ */
+size_t pmap_cpu_count(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (count > 0) ? (size_t)count : 1;
+#else
+	return 1;
+#endif  // _SC_NPROCESSORS_ONLN
+}
+
+/**
+ * Creates a pool of worker interpreters and starts their threads.
+ *
+ * @param  count Number of workers.
+ * @param  pool  Pointer that will hold the newly created pool.
+ * @return       BAMBOO_OK if every worker is up and running.
+ */
+bamboo_error_t pmap_pool_new(size_t count, pmap_pool_t **pool) {
+	bamboo_error_t err;
+	pmap_worker_t *worker;
+	bamboo_ctx_t *prev;
+	size_t i;
+
+	// Allocate the pool.
+	*pool = (pmap_pool_t *)calloc(1, sizeof(pmap_pool_t));
+	if (*pool == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+			_T("Can't allocate parallel map pool"));
+	}
+	(*pool)->workers = (pmap_worker_t *)calloc(count, sizeof(pmap_worker_t));
+	if ((*pool)->workers == NULL) {
+		free(*pool);
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+			_T("Can't allocate parallel map workers"));
+	}
+	(*pool)->owner = getpid();
+	pthread_mutex_init(&(*pool)->lock, NULL);
+	pthread_cond_init(&(*pool)->start, NULL);
+	pthread_cond_init(&(*pool)->done, NULL);
+
+	// Bring up each worker.
+	for (i = 0; i < count; i++) {
+		worker = &(*pool)->workers[i];
+		worker->pool = *pool;
+		worker->index = i;
+
+		// Give it an interpreter of its own.
+		err = bamboo_ctx_new(&worker->ctx);
+		IF_ERROR(err)
+			goto failed;
+		prev = bamboo_ctx_switch(worker->ctx);
+		err = context_init(&worker->env);
+		worker->ctx->pmap_worker = true;
+		bamboo_ctx_switch(prev);
+		IF_ERROR(err) {
+			bamboo_ctx_free(worker->ctx);
+			goto failed;
+		}
+
+		// Start its thread.
+		pthread_mutex_init(&worker->deque.lock, NULL);
+		if (pthread_create(&worker->thread, NULL, pmap_worker_main,
+				worker) != 0) {
+			pthread_mutex_destroy(&worker->deque.lock);
+			bamboo_ctx_free(worker->ctx);
+			err = bamboo_error(BAMBOO_ERROR_UNKNOWN,
+				_T("Can't start parallel map worker thread"));
+			goto failed;
+		}
+
+		(*pool)->count++;
+	}
+
+	return BAMBOO_OK;
+
+failed:
+	pmap_pool_free(*pool);
+	*pool = NULL;
+
+	return err;
+}
+
+/**
+ * Stops the threads of a pool and frees up its workers.
+ *
+ * @param pool Pool to be freed.
+ */
+void pmap_pool_free(pmap_pool_t *pool) {
+	size_t i;
+
+	// Ask the workers to quit and wait for them.
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 0; i < pool->count; i++)
+		pthread_join(pool->workers[i].thread, NULL);
+
+	// Get rid of their interpreters.
+	for (i = 0; i < pool->count; i++) {
+		pthread_mutex_destroy(&pool->workers[i].deque.lock);
+		bamboo_ctx_free(pool->workers[i].ctx);
+	}
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->lib);
+	free(pool->workers);
+	free(pool);
+}
+
+/**
+ * Takes a snapshot of the definitions in our root environment, so that the
+ * workers can load the ones they don't have yet. Definitions that can't be
+ * copied to another heap are left out.
+ *
+ * @param  pool Pool that the snapshot is for.
+ * @return      BAMBOO_OK if the snapshot was taken.
+ */
+bamboo_error_t pmap_snapshot(pmap_pool_t *pool) {
+	bamboo_error_t err;
+	uint8_t *lib;
+	uint8_t *buf;
+	atom_t cur;
+	size_t cap;
+	size_t len;
+	size_t blen;
+	uint32_t size;
+
+	// Lazily loaded definitions must be loaded for us to be able to copy them.
+	err = env_autoload_all(*bamboo_ctx->root_env);
+	IF_ERROR(err)
+		return err;
+
+	// Serialize each binding on its own.
+	lib = NULL;
+	cap = 0;
+	len = 0;
+	for (cur = cdr(*bamboo_ctx->root_env); !nilp(cur); cur = cdr(cur)) {
+		err = bamboo_serialize(car(cur), &buf, &blen);
+		IF_ERROR(err)
+			continue;
+
+		size = (uint32_t)blen;
+		if (!pmap_append(&lib, &len, &cap, &size, sizeof(uint32_t)) ||
+				!pmap_append(&lib, &len, &cap, buf, blen)) {
+			free(buf);
+			free(lib);
+			return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+				_T("Can't allocate parallel map library snapshot"));
+		}
+		free(buf);
+	}
+
+	// Only bother the workers if something has changed.
+	if ((len == pool->lib_len) &&
+			(pool->builtins_count == bamboo_ctx->builtins_count) &&
+			((len == 0) || (memcmp(lib, pool->lib, len) == 0))) {
+		free(lib);
+		return BAMBOO_OK;
+	}
+
+	free(pool->lib);
+	pool->lib = lib;
+	pool->lib_len = len;
+	pool->builtins = bamboo_ctx->builtins;
+	pool->builtins_count = bamboo_ctx->builtins_count;
+	pool->lib_version++;
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Splits a list into chunks of serialized arguments.
+ *
+ * @param  list   List to be split.
+ * @param  len    Length of the list.
+ * @param  count  Number of chunks. Must not be more than the length.
+ * @param  chunks Pointer that will hold the array of chunks.
+ * @return        BAMBOO_OK if the chunks were created.
+ */
+bamboo_error_t pmap_chunks_new(atom_t list, size_t len, size_t count,
+							   pmap_chunk_t **chunks) {
+	bamboo_error_t err;
+	atom_t slice;
+	atom_t last;
+	size_t end;
+	size_t i;
+	size_t j;
+
+	// Allocate the chunks.
+	*chunks = (pmap_chunk_t *)calloc(count, sizeof(pmap_chunk_t));
+	if (*chunks == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+			_T("Can't allocate parallel map chunks"));
+	}
+
+	// Copy each slice of the list into its chunk.
+	for (i = 0, j = 0; i < count; i++) {
+		end = ((i + 1) * len) / count;
+
+		slice = nil;
+		last = nil;
+		for (; j < end; j++, list = cdr(list)) {
+			if (nilp(last)) {
+				slice = cons(car(list), nil);
+				last = slice;
+			} else {
+				cdr(last) = cons(car(list), nil);
+				last = cdr(last);
+			}
+		}
+
+		err = bamboo_serialize(slice, &(*chunks)[i].args,
+			&(*chunks)[i].args_len);
+		IF_ERROR(err) {
+			pmap_chunks_free(*chunks, count);
+			*chunks = NULL;
+			return err;
+		}
+	}
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Frees up the chunks of a parallel map job.
+ *
+ * @param chunks Array of chunks.
+ * @param count  Number of chunks.
+ */
+void pmap_chunks_free(pmap_chunk_t *chunks, size_t count) {
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		free(chunks[i].args);
+		free(chunks[i].results);
+	}
+	free(chunks);
+}
+
+/**
+ * Appends data to a growable byte buffer.
+ *
+ * @param  buf  Pointer to the buffer.
+ * @param  len  Pointer to the length of the data in the buffer.
+ * @param  cap  Pointer to the capacity of the buffer.
+ * @param  data Data to be appended.
+ * @param  size Size of the data.
+ * @return      TRUE if the data was appended.
+ */
+bool pmap_append(uint8_t **buf, size_t *len, size_t *cap, const void *data,
+				 size_t size) {
+	uint8_t *tmp;
+	size_t ncap;
+
+	// Grow the buffer if needed.
+	if ((*len + size) > *cap) {
+		ncap = (*cap == 0) ? PMAP_MIN_CAP : *cap;
+		while (ncap < (*len + size))
+			ncap *= 2;
+
+		tmp = (uint8_t *)realloc(*buf, ncap);
+		if (tmp == NULL)
+			return false;
+		*buf = tmp;
+		*cap = ncap;
+	}
+
+	memcpy(*buf + *len, data, size);
+	*len += size;
+
+	return true;
+}
+
+/**
+ * Main loop of a worker thread. It waits for jobs until the pool is freed.
+ *
+ * @param  arg Worker.
+ * @return     Nothing.
+ */
+void *pmap_worker_main(void *arg) {
+	pmap_worker_t *worker = (pmap_worker_t *)arg;
+	pmap_pool_t *pool = worker->pool;
+
+	bamboo_ctx_switch(worker->ctx);
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		// Wait for a new job.
+		while (!pool->quit && (worker->generation == pool->generation))
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->quit)
+			break;
+		worker->generation = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		pmap_worker_run(worker);
+
+		// Let the caller know when the last one of us is done.
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->pending == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	bamboo_ctx_switch(NULL);
+	return NULL;
+}
+
+/**
+ * Works on the current job until there are no chunks left to steal.
+ *
+ * @param worker Worker doing the job.
+ */
+void pmap_worker_run(pmap_worker_t *worker) {
+	pmap_pool_t *pool = worker->pool;
+	bamboo_error_t err;
+	eval_root_t root;
+	atom_t func;
+	atom_t work;
+	size_t index;
+
+	// Keep our function and the chunk we're working on safe from the garbage
+	// collector.
+	func = nil;
+	work = cons(nil, nil);
+	root.expr = &func;
+	root.env = &worker->env;
+	root.stack = &work;
+	root.prev = bamboo_ctx->eval_roots;
+	bamboo_ctx->eval_roots = &root;
+
+	// Catch up with the caller's definitions and get the function.
+	err = BAMBOO_OK;
+	if (worker->lib_version != pool->lib_version)
+		err = pmap_worker_sync(worker);
+	IF_NOT_ERROR(err)
+		err = bamboo_deserialize(pool->func, pool->func_len, &func);
+
+	// Go through our chunks and then everybody else's.
+	while (pmap_take(worker, &index)) {
+		IF_ERROR(err) {
+			pool->chunks[index].err = err;
+			_tcsncpy(pool->chunks[index].msg, bamboo_ctx->error_msg,
+				ERROR_MSG_STR_LEN);
+			continue;
+		}
+
+		pmap_worker_chunk(func, &pool->chunks[index], work);
+	}
+
+	// Clean up after ourselves.
+	bamboo_ctx->eval_roots = root.prev;
+	gc_mark(worker->env);
+	gc(true);
+}
+
+/**
+ * Loads the latest library snapshot and built-in functions of the caller into
+ * a worker's root environment.
+ *
+ * @param  worker Worker to be brought up to date.
+ * @return        BAMBOO_OK if everything was loaded.
+ */
+bamboo_error_t pmap_worker_sync(pmap_worker_t *worker) {
+	pmap_pool_t *pool = worker->pool;
+	bamboo_error_t err;
+	atom_t binding;
+	uint32_t size;
+	size_t pos;
+	size_t i;
+
+	// Built-in functions first, since they are referenced by name.
+	for (i = 0; i < pool->builtins_count; i++) {
+		err = bamboo_env_set_builtin(worker->env,
+			*pool->builtins[i].name.value.symbol, pool->builtins[i].func);
+		IF_ERROR(err)
+			return err;
+	}
+
+	// Followed by the definitions.
+	for (pos = 0; (pos + sizeof(uint32_t)) <= pool->lib_len; pos += size) {
+		memcpy(&size, pool->lib + pos, sizeof(uint32_t));
+		pos += sizeof(uint32_t);
+
+		err = bamboo_deserialize(pool->lib + pos, size, &binding);
+		IF_ERROR(err)
+			return err;
+		err = bamboo_env_set(worker->env, car(binding), cdr(binding));
+		IF_ERROR(err)
+			return err;
+	}
+
+	worker->lib_version = pool->lib_version;
+	return BAMBOO_OK;
+}
+
+/**
+ * Applies the function to every argument in a chunk and stores the serialized
+ * results in it.
+ *
+ * @param func  Function to be applied.
+ * @param chunk Chunk to work on.
+ * @param work  Garbage collection root that holds the arguments and results.
+ */
+void pmap_worker_chunk(atom_t func, pmap_chunk_t *chunk, atom_t work) {
+	bamboo_error_t err;
+	atom_t value;
+	atom_t last;
+	atom_t args;
+
+	// Get our arguments.
+	err = bamboo_deserialize(chunk->args, chunk->args_len, &args);
+	IF_ERROR(err)
+		goto failed;
+	car(work) = args;
+	cdr(work) = nil;
+
+	// Apply the function to each one of them.
+	last = nil;
+	for (; !nilp(args); args = cdr(args)) {
+		err = apply(func, cons(car(args), nil), &value);
+		IF_ERROR(err)
+			goto failed;
+
+		if (nilp(last)) {
+			cdr(work) = cons(value, nil);
+			last = cdr(work);
+		} else {
+			cdr(last) = cons(value, nil);
+			last = cdr(last);
+		}
+	}
+
+	// Send the results back.
+	err = bamboo_serialize(cdr(work), &chunk->results, &chunk->results_len);
+	IF_ERROR(err)
+		goto failed;
+
+	car(work) = nil;
+	cdr(work) = nil;
+	return;
+
+failed:
+	chunk->err = err;
+	_tcsncpy(chunk->msg, bamboo_ctx->error_msg, ERROR_MSG_STR_LEN);
+	car(work) = nil;
+	cdr(work) = nil;
+}
+
+/**
+ * Takes the next chunk from the front of the worker's own queue or steals one
+ * from the back of another worker's.
+ *
+ * @param  worker Worker looking for something to do.
+ * @param  index  Pointer that will hold the index of the chunk.
+ * @return        TRUE if a chunk was found.
+ */
+bool pmap_take(pmap_worker_t *worker, size_t *index) {
+	pmap_pool_t *pool = worker->pool;
+	pmap_deque_t *deque;
+	size_t i;
+
+	for (i = 0; i < pool->count; i++) {
+		deque = &pool->workers[(worker->index + i) % pool->count].deque;
+
+		pthread_mutex_lock(&deque->lock);
+		if (deque->head < deque->tail) {
+			*index = (i == 0) ? deque->head++ : --deque->tail;
+			pthread_mutex_unlock(&deque->lock);
+
+			return true;
+		}
+		pthread_mutex_unlock(&deque->lock);
+	}
+
+	return false;
+}
+#endif  // USE_PTHREADS
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                   Tasks                                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Makes an evaluation that isn't nested in another one the one taking turns
+ * with the spawned tasks, picking up with the task that was running when it
+ * last ran out of steps.
+ *
+ * @param state Evaluation that's about to run.
+ */
+void task_enter(bamboo_eval_t *state) {
+	bamboo_ctx->task_main = &state->task;
+	bamboo_ctx->task_current = (state->current != NULL) ? state->current :
+		&state->task;
+
+	// Our own code may have become ready while we were away.
+	if ((state->task.status == TASK_READY) && !task_run_remove(&state->task))
+		task_ready(&state->task, state->task.value);
+}
+
+/**
+ * Cleans up after an evaluation that isn't nested in another one has stopped
+ * running. If it failed, the task that was running is dropped.
+ *
+ * @param state Evaluation that has just stopped running.
+ * @param err   What the evaluation loop returned.
+ */
+void task_settle(bamboo_eval_t *state, bamboo_error_t err) {
+	task_t *task;
+
+	task = bamboo_ctx->task_current;
+	bamboo_ctx->task_current = NULL;
+	bamboo_ctx->task_main = NULL;
+
+	// Ran out of steps, so carry on with the same task later on.
+	if (err == BAMBOO_SUSPENDED) {
+		state->current = task;
+
+		// Nobody else should pick up our code in the meantime.
+		if (state->task.status == TASK_READY)
+			task_run_remove(&state->task);
+		return;
+	}
+
+	// Our own code has either finished or failed.
+	state->current = NULL;
+	IF_ERROR(err) {
+		if ((task != NULL) && (task != &state->task))
+			task_free(task);
+		task_unqueue(&state->task);
+	}
+}
+
+/**
+ * Checks if the built-in function that's currently running was called by an
+ * evaluation that can switch to another task.
+ *
+ * @return TRUE if the running task is able to wait.
+ */
+bool task_can_wait(void) {
+	return (bamboo_ctx->task_current != NULL) &&
+		(bamboo_ctx->eval_roots != NULL) &&
+		(bamboo_ctx->eval_roots->prev == NULL);
+}
+
+/**
+ * Puts a task at the end of the run queue.
+ *
+ * @param task  Task that is ready to carry on.
+ * @param value Value returned by the built-in function it was waiting on.
+ */
+void task_ready(task_t *task, atom_t value) {
+	task->status = TASK_READY;
+	task->value = value;
+	task->channel = nil;
+
+	// The code of evaluations that aren't running waits for them to come back.
+	if (!task->spawned && (task != bamboo_ctx->task_main))
+		return;
+
+	task->next = NULL;
+	if (bamboo_ctx->run_tail != NULL) {
+		bamboo_ctx->run_tail->next = task;
+	} else {
+		bamboo_ctx->run_head = task;
+	}
+	bamboo_ctx->run_tail = task;
+}
+
+/**
+ * Takes a task out of the run queue.
+ *
+ * @param  task Task to be taken out.
+ * @return      TRUE if the task was in the run queue.
+ */
+bool task_run_remove(task_t *task) {
+	task_t **tmp;
+	task_t *prev;
+
+	prev = NULL;
+	for (tmp = &bamboo_ctx->run_head; *tmp != NULL; tmp = &(*tmp)->next) {
+		if (*tmp == task) {
+			*tmp = task->next;
+			if (bamboo_ctx->run_tail == task)
+				bamboo_ctx->run_tail = prev;
+			task->next = NULL;
+
+			return true;
+		}
+
+		prev = *tmp;
+	}
+
+	return false;
+}
+
+/**
+ * Takes a task out of whatever queue it's waiting in.
+ *
+ * @param task Task to be taken out.
+ */
+void task_unqueue(task_t *task) {
+	if (task->status == TASK_READY) {
+		task_run_remove(task);
+	} else if (task->status != TASK_RUNNING) {
+		channel_unwait(task->channel, task);
+	}
+
+	task->status = TASK_RUNNING;
+	task->channel = nil;
+}
+
+/**
+ * Gets rid of a spawned task.
+ *
+ * @param task Task to be freed.
+ */
+void task_free(task_t *task) {
+	task_unqueue(task);
+
+	if (task->prev_task != NULL) {
+		task->prev_task->next_task = task->next_task;
+	} else {
+		bamboo_ctx->tasks = task->next_task;
+	}
+	if (task->next_task != NULL)
+		task->next_task->prev_task = task->prev_task;
+
+	free(task);
+}
+
+/**
+ * Parks the running task according to what it asked to wait for and switches
+ * to the next one in line.
+ *
+ * @param  stack  Pointer to the stack of the running task, which will be
+ *                replaced by the one of the next task.
+ * @param  result Pointer to the value that the next task carries on with.
+ * @return        BAMBOO_OK if there was another task to switch to.
+ */
+bamboo_error_t task_wait(frame_t *stack, atom_t *result) {
+	task_wait_t *wait;
+	task_t *task;
+
+	// Only evaluations that aren't nested in another one can switch.
+	task = bamboo_ctx->task_current;
+	if (task == NULL) {
+		return bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Tasks can only wait at ")
+			_T("the top level of an evaluation"));
+	}
+
+	// Put it in the right queue.
+	wait = &bamboo_ctx->task_wait;
+	task->stack = *stack;
+	if (wait->status == TASK_READY) {
+		task_ready(task, nil);
+	} else {
+		task->status = wait->status;
+		task->value = wait->value;
+		task->channel = wait->channel;
+		channel_wait(wait->channel, task);
+	}
+
+	return task_switch(stack, result);
+}
+
+/**
+ * Reports that every task is waiting on a channel, along with what each of
+ * them is waiting for.
+ *
+ * @return BAMBOO_ERROR_DEADLOCK.
+ */
+bamboo_error_t task_deadlock(void) {
+	TCHAR msg[ERROR_MSG_STR_LEN + 1];
+	task_t *task;
+	size_t len;
+
+	// Start with the main task and follow with the spawned ones.
+	len = (size_t)_sntprintf(msg, ERROR_MSG_STR_LEN, _T("Every task is ")
+		_T("waiting on a channel:"));
+	if (bamboo_ctx->task_main != NULL)
+		len = task_deadlock_append(msg, len, bamboo_ctx->task_main);
+	for (task = bamboo_ctx->tasks; task != NULL; task = task->next_task)
+		len = task_deadlock_append(msg, len, task);
+
+	return bamboo_error(BAMBOO_ERROR_DEADLOCK, msg);
+}
+
+/**
+ * Appends what a task is waiting for to a deadlock error message. Spawned
+ * tasks are numbered in the order they were spawned.
+ *
+ * @param  msg  Error message being built.
+ * @param  len  Current length of the message.
+ * @param  task Task to be described.
+ * @return      New length of the message.
+ */
+size_t task_deadlock_append(TCHAR *msg, size_t len, const task_t *task) {
+	TCHAR who[STRBUF_NUM_MAX_LEN];
+	int n;
+
+	// Only the tasks that are actually waiting on something matter.
+	if ((task->status != TASK_SENDING) && (task->status != TASK_RECEIVING))
+		return len;
+
+	// Put the description at the end of the message if it still fits.
+	if (task->spawned) {
+		_sntprintf(who, STRBUF_NUM_MAX_LEN, _T("task %lu"), task->id);
+	} else {
+		_sntprintf(who, STRBUF_NUM_MAX_LEN, _T("main"));
+	}
+	n = _sntprintf(msg + len, ERROR_MSG_STR_LEN - len, SPEC_STR _T(" ")
+		SPEC_STR _T(" ") SPEC_STR _T(" #<CHANNEL:%p>"),
+		(msg[len - 1] == _T(':')) ? _T("") : _T(","), who,
+		(task->status == TASK_SENDING) ? _T("sends to") : _T("receives from"),
+		(void *)task->channel.value.pair);
+	if ((n < 0) || ((len + n) >= ERROR_MSG_STR_LEN)) {
+		msg[ERROR_MSG_STR_LEN] = _T('\0');
+		return ERROR_MSG_STR_LEN;
+	}
+
+	return len + n;
+}
+
+/**
+ * Switches to the next task in the run queue.
+ *
+ * @param  stack  Pointer to the stack of the task that will run.
+ * @param  result Pointer to the value that the task carries on with.
+ * @return        BAMBOO_OK if there was a task ready to run.
+ */
+bamboo_error_t task_switch(frame_t *stack, atom_t *result) {
+	task_t *task;
+
+	// Is there anyone ready to run?
+	task = bamboo_ctx->run_head;
+	if (task == NULL)
+		return task_deadlock();
+
+	// Take it out of the queue.
+	bamboo_ctx->run_head = task->next;
+	if (bamboo_ctx->run_head == NULL)
+		bamboo_ctx->run_tail = NULL;
+	task->next = NULL;
+	task->status = TASK_RUNNING;
+	bamboo_ctx->task_current = task;
+
+	// Swap its state in.
+	*stack = task->stack;
+	*result = task->value;
+	task->stack = nil;
+	task->value = nil;
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Gets rid of the spawned task that has just finished running and switches to
+ * the next one in line.
+ *
+ * @param  stack  Pointer to the stack of the task that will run.
+ * @param  result Pointer to the value that the task carries on with.
+ * @return        BAMBOO_OK if there was a task ready to run.
+ */
+bamboo_error_t task_exit(frame_t *stack, atom_t *result) {
+	task_free(bamboo_ctx->task_current);
+	bamboo_ctx->task_current = NULL;
+
+	return task_switch(stack, result);
+}
+
+/**
+ * Creates a new channel.
+ *
+ * @param  capacity Number of values it holds before senders have to wait.
+ * @return          Channel atom.
+ */
+atom_t channel_new(int64_t capacity) {
+	atom_t channel;
+
+	channel = cons(nil /* items */, cons(nil /* last */, cons(bamboo_int(0),
+		cons(bamboo_int(capacity), cons(nil /* wait-head */,
+		cons(nil /* wait-tail */, nil))))));
+	channel.type = ATOM_TYPE_CHANNEL;
+
+	return channel;
+}
+
+/**
+ * Gets the channel that built-in functions expect as their first argument,
+ * making sure that it can be used.
+ *
+ * @param  args    Arguments passed to the built-in function.
+ * @param  argc    Number of arguments that it expects.
+ * @param  channel Pointer to the channel.
+ * @return         BAMBOO_OK if the arguments are valid.
+ */
+bamboo_error_t channel_arg(atom_t args, uint16_t argc, atom_t *channel) {
+	TCHAR msg[ERROR_MSG_STR_LEN + 1];
+
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != argc) {
+		_sntprintf(msg, ERROR_MSG_STR_LEN, _T("This function expects %u ")
+			_T("arguments"), argc);
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS, msg);
+	}
+
+	// Check if it's a channel that can be changed.
+	*channel = car(args);
+	if (channel->type != ATOM_TYPE_CHANNEL) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Argument 0 should be a channel"));
+	}
+	if (gc_frozen_p(*channel)) {
+		return bamboo_error(BAMBOO_ERROR_READ_ONLY,
+			_T("Can't use a read-only channel"));
+	}
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Appends a value to the ones held by a channel.
+ *
+ * @param channel Channel to hold the value.
+ * @param value   Value to be appended.
+ */
+void channel_push(atom_t channel, atom_t value) {
+	atom_t cell;
+	atom_t last;
+
+	cell = cons(value, nil);
+	last = bamboo_list_ref(channel, CHANNEL_LAST_INDEX);
+	if (nilp(last)) {
+		bamboo_list_set(channel, CHANNEL_ITEMS_INDEX, cell);
+	} else {
+		cdr(last) = cell;
+	}
+	bamboo_list_set(channel, CHANNEL_LAST_INDEX, cell);
+	bamboo_list_set(channel, CHANNEL_COUNT_INDEX, bamboo_int(
+		bamboo_list_ref(channel, CHANNEL_COUNT_INDEX).value.integer + 1));
+}
+
+/**
+ * Takes the oldest value held by a channel out of it.
+ *
+ * @param  channel Channel holding at least one value.
+ * @return         Oldest value in the channel.
+ */
+atom_t channel_pop(atom_t channel) {
+	atom_t items;
+
+	items = bamboo_list_ref(channel, CHANNEL_ITEMS_INDEX);
+	bamboo_list_set(channel, CHANNEL_ITEMS_INDEX, cdr(items));
+	if (nilp(cdr(items)))
+		bamboo_list_set(channel, CHANNEL_LAST_INDEX, nil);
+	bamboo_list_set(channel, CHANNEL_COUNT_INDEX, bamboo_int(
+		bamboo_list_ref(channel, CHANNEL_COUNT_INDEX).value.integer - 1));
+
+	return car(items);
+}
+
+/**
+ * Puts a task at the end of the queue of tasks waiting on a channel.
+ *
+ * @param channel Channel to wait on.
+ * @param task    Task that will wait.
+ */
+void channel_wait(atom_t channel, task_t *task) {
+	atom_t tail;
+
+	task->next = NULL;
+	tail = bamboo_list_ref(channel, CHANNEL_WAIT_TAIL_INDEX);
+	if (nilp(tail)) {
+		bamboo_list_set(channel, CHANNEL_WAIT_HEAD_INDEX,
+			bamboo_pointer(task));
+	} else {
+		((task_t *)tail.value.pointer)->next = task;
+	}
+	bamboo_list_set(channel, CHANNEL_WAIT_TAIL_INDEX, bamboo_pointer(task));
+}
+
+/**
+ * Gets the task that has been waiting on a channel the longest, if it's
+ * waiting to do a given operation.
+ *
+ * @param  channel Channel to check.
+ * @param  status  What the task should be waiting for.
+ * @return         Waiting task or NULL if there's none.
+ */
+task_t *channel_waiter(atom_t channel, task_status_t status) {
+	atom_t head;
+
+	head = bamboo_list_ref(channel, CHANNEL_WAIT_HEAD_INDEX);
+	if (nilp(head) || (((task_t *)head.value.pointer)->status != status))
+		return NULL;
+
+	return (task_t *)head.value.pointer;
+}
+
+/**
+ * Takes a task out of the queue of tasks waiting on a channel.
+ *
+ * @param channel Channel the task is waiting on.
+ * @param task    Task to be taken out.
+ */
+void channel_unwait(atom_t channel, task_t *task) {
+	task_t *prev;
+	task_t *cur;
+	atom_t head;
+
+	// Find it in the queue.
+	prev = NULL;
+	head = bamboo_list_ref(channel, CHANNEL_WAIT_HEAD_INDEX);
+	cur = nilp(head) ? NULL : (task_t *)head.value.pointer;
+	while ((cur != NULL) && (cur != task)) {
+		prev = cur;
+		cur = cur->next;
+	}
+	if (cur == NULL)
+		return;
+
+	// Unlink it.
+	if (prev != NULL) {
+		prev->next = task->next;
+	} else {
+		bamboo_list_set(channel, CHANNEL_WAIT_HEAD_INDEX, (task->next != NULL) ?
+			bamboo_pointer(task->next) : nil);
+	}
+	if (task->next == NULL) {
+		bamboo_list_set(channel, CHANNEL_WAIT_TAIL_INDEX, (prev != NULL) ?
+			bamboo_pointer(prev) : nil);
+	}
+	task->next = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                 Debugging                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Sets up a sink that writes to the standard output, or to the string that's
+ * currently capturing it.
+ *
+ * @param sink Sink to be set up.
+ */
+void sink_stdout(sink_t *sink) {
+	sink->sb = bamboo_ctx->output_capture;
+	sink->fh = stdout;
+}
+
+/**
+ * Writes characters to a sink.
+ *
+ * @param sink Sink to write to.
+ * @param str  Characters to be written.
+ * @param len  Number of characters to write.
+ */
+void sink_write(sink_t *sink, const TCHAR *str, size_t len) {
+	size_t i;
+
+	// Append to the string builder.
+	if (sink->sb != NULL) {
+		IF_ERROR(strbuf_append(sink->sb, str, len)) {
+			fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+				_T("string to represent atom"));
+		}
+
+		return;
+	}
+
+	// Write straight to the stream.
+	for (i = 0; i < len; i++)
+		_puttc(str[i], sink->fh);
+}
+
+/**
+ * Writes a terminated string to a sink.
+ *
+ * @param sink Sink to write to.
+ * @param str  String to be written.
+ */
+void sink_puts(sink_t *sink, const TCHAR *str) {
+	sink_write(sink, str, _tcslen(str));
+}
+
+/**
+ * Writes a string to a sink as a literal that can be read back in, escaping
+ * quotes and backslashes.
+ *
+ * @param sink   Sink to write to.
+ * @param string String to be written.
+ */
+void print_string(sink_t *sink, const string_t *string) {
+	const TCHAR *start = string->chars;
+	const TCHAR *end = start + string->len;
+	const TCHAR *tmp;
+
+	sink_write(sink, _T("\""), 1);
+	for (tmp = start; tmp < end; tmp++) {
+		if ((*tmp != _T('\"')) && (*tmp != _T('\\')))
+			continue;
+
+		// Flush what we have so far and escape the character.
+		sink_write(sink, start, tmp - start);
+		sink_write(sink, _T("\\"), 1);
+		start = tmp;
+	}
+	sink_write(sink, start, end - start);
+	sink_write(sink, _T("\""), 1);
+}
+
+/**
+ * Writes the representation of an atom to a sink. Whatever is left to print of
+ * the enclosing lists and functions is kept in a stack of our own, so deeply
+ * nested data doesn't use up the C stack.
+ *
+ * @param sink    Sink to write to.
+ * @param atom    Atom to be printed.
+ * @param display Print strings without quotes, like display does?
+ */
+void print_atom(sink_t *sink, atom_t atom, bool display) {
+	print_frame_t local[PRINT_FRAMES_LOCAL];
+	print_frame_t *frames;
+	print_frame_t *frame;
+	TCHAR num[STRBUF_NUM_MAX_LEN];
+	TCHAR *tmp;
+	size_t depth;
+	size_t cap;
+	size_t i;
+
+	frames = local;
+	depth = 0;
+	cap = PRINT_FRAMES_LOCAL;
+
+print:
+	// Make sure we have room for another frame.
+	if (depth == cap) {
+		frame = (frames == local) ?
+			(print_frame_t *)malloc(cap * 2 * sizeof(print_frame_t)) :
+			(print_frame_t *)realloc(frames, cap * 2 * sizeof(print_frame_t));
+		if (frame == NULL) {
+			fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate printer ")
+				_T("frames"));
+		}
+		if (frames == local)
+			memcpy(frame, local, sizeof(local));
+
+		frames = frame;
+		cap *= 2;
+	}
+
+	switch (atom.type) {
+	case ATOM_TYPE_NIL:
+		sink_write(sink, _T("nil"), 3);
+		break;
+	case ATOM_TYPE_SYMBOL:
+		sink_puts(sink, *atom.value.symbol);
+		break;
+	case ATOM_TYPE_INTEGER:
+		sink_write(sink, num, format_int(num, atom.value.integer));
+		break;
+	case ATOM_TYPE_BIGNUM:
+		tmp = bignum_str(*atom.value.bignum);
+		sink_puts(sink, tmp);
+		free(tmp);
+		break;
+	case ATOM_TYPE_FLOAT:
+		sink_write(sink, num, format_float(num, atom.value.dfloat));
+		break;
+	case ATOM_TYPE_BOOLEAN:
+		sink_write(sink, (atom.value.boolean) ? _T("#t") : _T("#f"), 2);
+		break;
+	case ATOM_TYPE_STRING:
+		if (display) {
+			sink_write(sink, (*atom.value.str)->chars, (*atom.value.str)->len);
+		} else {
+			print_string(sink, *atom.value.str);
+		}
+		break;
+	case ATOM_TYPE_PAIR:
+		// Print the first item and leave the rest of the list for later.
+		sink_write(sink, _T("("), 1);
+		frames[depth].kind = PRINT_FRAME_LIST;
+		frames[depth++].rest = cdr(atom);
+		atom = car(atom);
+		goto print;
+	case ATOM_TYPE_BUILTIN:
+		_sntprintf(num, STRBUF_NUM_MAX_LEN, _T("#<BUILTIN:%p>"),
+			atom.value.builtin);
+		sink_puts(sink, num);
+		break;
+	case ATOM_TYPE_CLOSURE:
+	case ATOM_TYPE_MACRO:
+		sink_puts(sink, (atom.type == ATOM_TYPE_CLOSURE) ?
+			_T("#<FUNCTION:") : _T("#<MACRO:"));
+
+		// Print the arguments, if we have any, and leave the body for later.
+		frames[depth].kind = PRINT_FRAME_FUNC_BODY;
+		frames[depth++].rest = cdr(cdr(atom));
+		if (!nilp(car(cdr(atom)))) {
+			atom = car(cdr(atom));
+			goto print;
+		}
+		break;
+	case ATOM_TYPE_POINTER:
+		_sntprintf(num, STRBUF_NUM_MAX_LEN, _T("#<POINTER:%p>"),
+			atom.value.pointer);
+		sink_puts(sink, num);
+		break;
+	case ATOM_TYPE_AUTOLOAD:
+		sink_puts(sink, _T("#<AUTOLOAD>"));
+		break;
+	case ATOM_TYPE_CHANNEL:
+		_sntprintf(num, STRBUF_NUM_MAX_LEN, _T("#<CHANNEL:%p>"),
+			(void *)atom.value.pair);
+		sink_puts(sink, num);
+		break;
+	case ATOM_TYPE_VECTOR:
+		switch ((*atom.value.vector)->type) {
+		case VECTOR_TYPE_F64:
+			sink_write(sink, _T("#f64("), 5);
+			break;
+		case VECTOR_TYPE_I64:
+			sink_write(sink, _T("#i64("), 5);
+			break;
+		case VECTOR_TYPE_F32:
+			sink_write(sink, _T("#f32("), 5);
+			break;
+		}
+
+		// Append each of the elements.
+		for (i = 0; i < (*atom.value.vector)->len; i++) {
+			if (i > 0)
+				sink_write(sink, _T(" "), 1);
+			print_atom(sink, vector_elem(*atom.value.vector, i), display);
+		}
+
+		sink_write(sink, _T(")"), 1);
+		break;
+	default:
+		sink_puts(sink, _T("Unknown type. Don't know how to display this"));
+	}
+
+	// Carry on with whatever the enclosing atoms have left to print.
+	while (depth > 0) {
+		frame = &frames[depth - 1];
+		switch (frame->kind) {
+		case PRINT_FRAME_LIST:
+			// Next item in the list.
+			if (frame->rest.type == ATOM_TYPE_PAIR) {
+				sink_write(sink, _T(" "), 1);
+				atom = car(frame->rest);
+				frame->rest = cdr(frame->rest);
+				goto print;
+			}
+
+			// It was just a simple pair.
+			if (!nilp(frame->rest)) {
+				sink_write(sink, _T(" . "), 3);
+				atom = frame->rest;
+				frame->rest = nil;
+				goto print;
+			}
+
+			sink_write(sink, _T(")"), 1);
+			break;
+		case PRINT_FRAME_FUNC_BODY:
+			// Append the body.
+			sink_write(sink, _T(" "), 1);
+			atom = frame->rest;
+			frame->kind = PRINT_FRAME_FUNC_END;
+			goto print;
+		case PRINT_FRAME_FUNC_END:
+			sink_write(sink, _T(">"), 1);
+			break;
+		}
+
+		depth--;
+	}
+
+	if (frames != local)
+		free(frames);
+}
+
+/**
+ * Writes the human-readable representation of an atom, as used by concat and
+ * display, to a sink.
+ *
+ * @param sink Sink to write to.
+ * @param atom Atom to be printed.
+ */
+void print_display(sink_t *sink, atom_t atom) {
+	switch (atom.type) {
+	case ATOM_TYPE_NIL:
+		break;
+	case ATOM_TYPE_BOOLEAN:
+		sink_puts(sink, (atom.value.boolean) ? _T("TRUE") : _T("FALSE"));
+		break;
+	default:
+		print_atom(sink, atom, true);
+	}
+}
+
+/**
+ * Gets the string representation of the contents of an atom.
+ *
+ * @param buf  Pointer to a string that will be allocated by this function which
+ *             will return the atom representation string. NOTE: Remember that
+ *             you're responsible for freeing this pointer later.
+ * @param atom Atom to have its contents represented.
+ */
+void bamboo_expr_str(TCHAR **buf, atom_t atom) {
+	strbuf_t sb;
+	sink_t sink;
+
+	IF_ERROR(strbuf_init(&sb, 0)) {
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+			_T("string to represent atom"));
+		*buf = NULL;
+		return;
+	}
+
+	// Print the atom into our string builder and hand its buffer over.
+	sink.sb = &sb;
+	sink.fh = NULL;
+	print_atom(&sink, atom, false);
+	*buf = sb.buf;
+}
+
+/**
+ * Prints the contents of an atom in a standard way.
+ *
+ * @param atom Atom to have its contents printed.
+ */
+void bamboo_print_expr(atom_t atom) {
+	sink_t sink;
+
+	sink_stdout(&sink);
+	print_atom(&sink, atom, false);
+}
+
+/**
+ * Prints the contents of an atom in a standard way to a stream.
+ *
+ * @param fh   Stream to print to.
+ * @param atom Atom to have its contents printed.
+ */
+void bamboo_fprint_expr(FILE *fh, atom_t atom) {
+	sink_t sink;
+
+	sink.sb = NULL;
+	sink.fh = fh;
+	print_atom(&sink, atom, false);
+}
+
+/**
+ * Gets the error type string given an error code.
+ *
+ * @param buf Pointer to a string that will be allocated by this function which
+ *            will return the error type string. NOTE: Remember that you're
+ *            responsible for freeing this pointer later.
+ * @param err Error code.
+ */
+void bamboo_error_type_str(TCHAR **buf, bamboo_error_t err) {
+	// Get the error type string.
+	switch (err) {
+	case BAMBOO_OK:
+		*buf = _tcsdup(_T("OK"));
+		break;
+	case BAMBOO_SUSPENDED:
+		*buf = _tcsdup(_T("EVALUATION SUSPENDED"));
+		break;
+	case BAMBOO_PAREN_END:
+		*buf = _tcsdup(_T("PARENTHESIS ENDED"));
+		break;
+	case BAMBOO_ERROR_SYNTAX:
+		*buf = _tcsdup(_T("SYNTAX ERROR"));
+		break;
+	case BAMBOO_ERROR_EMPTY:
+		*buf = _tcsdup(_T("EMPTY STATEMENT"));
+		break;
+	case BAMBOO_ERROR_UNBOUND:
+		*buf = _tcsdup(_T("UNBOUND SYMBOL ERROR"));
+		break;
+	case BAMBOO_ERROR_ARGUMENTS:
+		*buf = _tcsdup(_T("INCORRECT ARGUMENT ERROR"));
+		break;
+	case BAMBOO_ERROR_WRONG_TYPE:
+		*buf = _tcsdup(_T("WRONG TYPE ERROR"));
+		break;
+	case BAMBOO_ERROR_NUM_OVERFLOW:
+		*buf = _tcsdup(_T("NUMERIC OVERFLOW ERROR"));
+		break;
+	case BAMBOO_ERROR_NUM_UNDERFLOW:
+		*buf = _tcsdup(_T("NUMERIC UNDERFLOW ERROR"));
+		break;
+	case BAMBOO_ERROR_ALLOCATION:
+		*buf = _tcsdup(_T("MEMORY ALLOCATION ERROR"));
+		break;
+	case BAMBOO_ERROR_READ_ONLY:
+		*buf = _tcsdup(_T("READ-ONLY ERROR"));
+		break;
+	case BAMBOO_ERROR_DEADLOCK:
+		*buf = _tcsdup(_T("DEADLOCK ERROR"));
+		break;
+	case BAMBOO_ERROR_UNKNOWN:
+		*buf = _tcsdup(_T("UNKNOWN ERROR"));
+		break;
+	default:
+		*buf = _tcsdup(_T("I have no clue why you're here, because you ")
+			_T("shouldn't"));
+		break;
+	}
+}
+
+/**
+ * Prints the appropriate error message for a given error code.
+ *
+ * @param err Error code to print the message.
+ */
+void bamboo_print_error(bamboo_error_t err) {
+	TCHAR *err_type = NULL;
+
+	// Get the error type string and print it out.
+	bamboo_error_type_str(&err_type, err);
+	putstrerr(err_type);
+	putstrerr(_T(": "));
+
+	// Print the error detail string and a line break.
+	putstrerr(bamboo_error_detail());
+	putstrerr(LINEBREAK);
+
+	// Free up our temporary buffer.
+	free(err_type);
+}
+
+/**
+ * Prints all of the tokens found in a string.
+ *
+ * @param str String to debug tokens in.
+ */
+void bamboo_print_tokens(const TCHAR *str) {
+	token_t token;
+	bamboo_error_t err;
+
+	// Go through tokens in string.
+	token.end = str;
+	while (!(err = lex(token.end, &token))) {
+		TCHAR *buf;
+		int i;
+
+		// Allocate string for the token string.
+		buf = (TCHAR *)malloc(((token.end - token.start) + 1) * sizeof(TCHAR));
+		if (buf == NULL) {
+			fatal_error(BAMBOO_ERROR_ALLOCATION,
+				_T("Can't allocate string for token printing"));
+			return;
+		}
+
+		// Get the token string from the token structure.
+		for (i = 0; i < (token.end - token.start); i++) {
+			buf[i] = token.start[i];
+		}
+		buf[i] = _T('\0');
+
+		// Print the token and free the string.
+		_tprintf(_T("'") SPEC_STR _T("' "), buf);
+		free(buf);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                               Error Handling                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Gets the last detailed error message from the interpreter.
+ *
+ * @return Last detailed error message.
+ */
+const TCHAR* bamboo_error_detail(void) {
+	return bamboo_ctx->error_msg;
+}
+
+/**
+ * Sets the internal error message variable.
+ *
+ * @param msg Error message to be set.
+ */
+void set_error_msg(const TCHAR *msg) {
+	_tcsncpy(bamboo_ctx->error_msg, msg, ERROR_MSG_STR_LEN);
+}
+
+/**
+ * Sets the internal error message variable and returns the specified error
+ * code.
+ *
+ * @param  err Error code to be returned.
+ * @param  msg Error message to be set.
+ * @return     Error code passed in 'err'.
+ */
+bamboo_error_t bamboo_error(bamboo_error_t err, const TCHAR *msg) {
+	set_error_msg(msg);
+	return err;
+}
+
+/**
+ * Handles a fatal error where the program is required to exit immediately,
+ * since it's unrecoverable.
+ *
+ * @param err Error code to be returned.
+ * @param msg Error message to be set.
+ */
+void fatal_error(bamboo_error_t err, const TCHAR *msg) {
+	// Print the error message.
+	set_error_msg(msg);
+	bamboo_print_error(err);
+
+	// Bye guys!
+	exit(err);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                              Numeric Vectors                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Gets the size in bytes of a single element of a numeric vector.
+ *
+ * @param  type Type of the elements of the vector.
+ * @return      Size of a single element in bytes.
+ */
+size_t vector_elem_size(vector_type_t type) {
+	switch (type) {
+	case VECTOR_TYPE_F64:
+		return sizeof(double);
+	case VECTOR_TYPE_I64:
+		return sizeof(int64_t);
+	case VECTOR_TYPE_F32:
+		return sizeof(float);
+	}
+
+	return 0;
+}
+
+/**
+ * Boxes an element of a numeric vector into an atom.
+ *
+ * @param  vec   Vector to get the element from.
+ * @param  index Index of the element.
+ * @return       Numeric atom with the value of the element.
+ */
+atom_t vector_elem(const vector_t *vec, size_t index) {
+	switch (vec->type) {
+	case VECTOR_TYPE_F64:
+		return bamboo_float((bamboo_float_t)vec->data.f64[index]);
+	case VECTOR_TYPE_I64:
+		return bamboo_int(vec->data.i64[index]);
+	case VECTOR_TYPE_F32:
+		return bamboo_float((bamboo_float_t)vec->data.f32[index]);
+	}
+
+	return nil;
+}
+
+/**
+ * Stores a numeric atom into an element of a numeric vector.
+ *
+ * @param  vec   Vector to store the element into.
+ * @param  index Index of the element.
+ * @param  value Numeric atom to be stored.
+ * @return       BAMBOO_OK if the value was stored.
+ */
+bamboo_error_t vector_elem_set(vector_t *vec, size_t index, atom_t value) {
+	// Integer vectors only accept integers.
+	if (vec->type == VECTOR_TYPE_I64) {
+		if (value.type != ATOM_TYPE_INTEGER) {
+			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+				_T("Integer vectors can only hold integers"));
+		}
+
+		vec->data.i64[index] = value.value.integer;
+		return BAMBOO_OK;
+	}
+
+	// Floating-point vectors accept any numeric.
+	switch (value.type) {
+	case ATOM_TYPE_INTEGER:
+		if (vec->type == VECTOR_TYPE_F64) {
+			vec->data.f64[index] = (double)value.value.integer;
+		} else {
+			vec->data.f32[index] = (float)value.value.integer;
+		}
+		break;
+	case ATOM_TYPE_FLOAT:
+		if (vec->type == VECTOR_TYPE_F64) {
+			vec->data.f64[index] = (double)value.value.dfloat;
+		} else {
+			vec->data.f32[index] = (float)value.value.dfloat;
+		}
+		break;
+	default:
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Vectors can only hold numerics"));
+	}
+
+	return BAMBOO_OK;
+}
+
+/*
+ * Scalar kernels. These are always available and used as the fallback for
+ * platforms without SIMD support.
+ */
+
+static void vk_add_scalar(double *dst, const double *a, const double *b,
+						  size_t len) {
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		dst[i] = a[i] + b[i];
+}
+
+static void vk_mul_scalar(double *dst, const double *a, const double *b,
+						  size_t len) {
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		dst[i] = a[i] * b[i];
+}
+
+static void vk_affine_scalar(double *dst, const double *src, double a,
+							 double b, size_t len) {
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		dst[i] = (a * src[i]) + b;
+}
+
+static double vk_sum_scalar(const double *src, size_t len) {
+	double sum = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		sum += src[i];
+
+	return sum;
+}
+
+static double vk_dot_scalar(const double *a, const double *b, size_t len) {
+	double sum = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		sum += a[i] * b[i];
+
+	return sum;
+}
+
+static double vk_min_scalar(const double *src, size_t len) {
+	double min = src[0];
+	size_t i;
+
+	for (i = 1; i < len; i++) {
+		if (src[i] < min)
+			min = src[i];
+	}
+
+	return min;
+}
+
+static double vk_max_scalar(const double *src, size_t len) {
+	double max = src[0];
+	size_t i;
+
+	for (i = 1; i < len; i++) {
+		if (src[i] > max)
+			max = src[i];
+	}
+
+	return max;
+}
+
+#ifdef USE_SIMD_X86
+/*
+ * SSE2 kernels. Process 2 doubles per iteration and leave the tail to the
+ * scalar loop.
+ */
+
+__attribute__((target("sse2")))
+static void vk_add_sse2(double *dst, const double *a, const double *b,
+						size_t len) {
+	size_t i;
+
+	for (i = 0; (i + 2) <= len; i += 2) {
+		_mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(a + i),
+			_mm_loadu_pd(b + i)));
+	}
+	vk_add_scalar(dst + i, a + i, b + i, len - i);
+}
+
+__attribute__((target("sse2")))
+static void vk_mul_sse2(double *dst, const double *a, const double *b,
+						size_t len) {
+	size_t i;
+
+	for (i = 0; (i + 2) <= len; i += 2) {
+		_mm_storeu_pd(dst + i, _mm_mul_pd(_mm_loadu_pd(a + i),
+			_mm_loadu_pd(b + i)));
+	}
+	vk_mul_scalar(dst + i, a + i, b + i, len - i);
+}
+
+__attribute__((target("sse2")))
+static void vk_affine_sse2(double *dst, const double *src, double a, double b,
+						   size_t len) {
+	__m128d va = _mm_set1_pd(a);
+	__m128d vb = _mm_set1_pd(b);
+	size_t i;
+
+	for (i = 0; (i + 2) <= len; i += 2) {
+		_mm_storeu_pd(dst + i, _mm_add_pd(_mm_mul_pd(va,
+			_mm_loadu_pd(src + i)), vb));
+	}
+	vk_affine_scalar(dst + i, src + i, a, b, len - i);
+}
+
+__attribute__((target("sse2")))
+static double vk_sum_sse2(const double *src, size_t len) {
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	double lanes[2];
+	size_t i;
+
+	for (i = 0; (i + 4) <= len; i += 4) {
+		acc0 = _mm_add_pd(acc0, _mm_loadu_pd(src + i));
+		acc1 = _mm_add_pd(acc1, _mm_loadu_pd(src + i + 2));
+	}
+	_mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+
+	return lanes[0] + lanes[1] + vk_sum_scalar(src + i, len - i);
+}
+
+__attribute__((target("sse2")))
+static double vk_dot_sse2(const double *a, const double *b, size_t len) {
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	double lanes[2];
+	size_t i;
+
+	for (i = 0; (i + 4) <= len; i += 4) {
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i),
+			_mm_loadu_pd(b + i)));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2),
+			_mm_loadu_pd(b + i + 2)));
+	}
+	_mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+
+	return lanes[0] + lanes[1] + vk_dot_scalar(a + i, b + i, len - i);
+}
+
+__attribute__((target("sse2")))
+static double vk_min_sse2(const double *src, size_t len) {
+	__m128d acc;
+	double lanes[2];
+	size_t i;
+
+	if (len < 2)
+		return vk_min_scalar(src, len);
+
+	acc = _mm_loadu_pd(src);
+	for (i = 2; (i + 2) <= len; i += 2)
+		acc = _mm_min_pd(acc, _mm_loadu_pd(src + i));
+	_mm_storeu_pd(lanes, acc);
+
+	if (lanes[1] < lanes[0])
+		lanes[0] = lanes[1];
+	if (i < len) {
+		lanes[1] = vk_min_scalar(src + i, len - i);
+		if (lanes[1] < lanes[0])
+			lanes[0] = lanes[1];
+	}
+
+	return lanes[0];
+}
+
+__attribute__((target("sse2")))
+static double vk_max_sse2(const double *src, size_t len) {
+	__m128d acc;
+	double lanes[2];
+	size_t i;
+
+	if (len < 2)
+		return vk_max_scalar(src, len);
+
+	acc = _mm_loadu_pd(src);
+	for (i = 2; (i + 2) <= len; i += 2)
+		acc = _mm_max_pd(acc, _mm_loadu_pd(src + i));
+	_mm_storeu_pd(lanes, acc);
+
+	if (lanes[1] > lanes[0])
+		lanes[0] = lanes[1];
+	if (i < len) {
+		lanes[1] = vk_max_scalar(src + i, len - i);
+		if (lanes[1] > lanes[0])
+			lanes[0] = lanes[1];
+	}
+
+	return lanes[0];
+}
+
+/*
+ * AVX2 kernels. Process 4 doubles per iteration and hand the tail over to the
+ * SSE2 kernels.
+ */
+
+__attribute__((target("avx2")))
+static void vk_add_avx2(double *dst, const double *a, const double *b,
+						size_t len) {
+	size_t i;
+
+	for (i = 0; (i + 4) <= len; i += 4) {
+		_mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_loadu_pd(a + i),
+			_mm256_loadu_pd(b + i)));
+	}
+	vk_add_sse2(dst + i, a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static void vk_mul_avx2(double *dst, const double *a, const double *b,
+						size_t len) {
+	size_t i;
+
+	for (i = 0; (i + 4) <= len; i += 4) {
+		_mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+			_mm256_loadu_pd(b + i)));
+	}
+	vk_mul_sse2(dst + i, a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static void vk_affine_avx2(double *dst, const double *src, double a, double b,
+						   size_t len) {
+	__m256d va = _mm256_set1_pd(a);
+	__m256d vb = _mm256_set1_pd(b);
+	size_t i;
+
+	for (i = 0; (i + 4) <= len; i += 4) {
+		_mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_mul_pd(va,
+			_mm256_loadu_pd(src + i)), vb));
+	}
+	vk_affine_sse2(dst + i, src + i, a, b, len - i);
+}
+
+__attribute__((target("avx2")))
+static double vk_sum_avx2(const double *src, size_t len) {
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	double lanes[4];
+	size_t i;
+
+	for (i = 0; (i + 8) <= len; i += 8) {
+		acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(src + i));
+		acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(src + i + 4));
+	}
+	_mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) +
+		vk_sum_sse2(src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static double vk_dot_avx2(const double *a, const double *b, size_t len) {
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	double lanes[4];
+	size_t i;
+
+	for (i = 0; (i + 8) <= len; i += 8) {
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+			_mm256_loadu_pd(b + i)));
+		acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4),
+			_mm256_loadu_pd(b + i + 4)));
+	}
+	_mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) +
+		vk_dot_sse2(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static double vk_min_avx2(const double *src, size_t len) {
+	__m256d acc;
+	double lanes[4];
+	double min;
+	size_t i;
+
+	if (len < 4)
+		return vk_min_sse2(src, len);
+
+	acc = _mm256_loadu_pd(src);
+	for (i = 4; (i + 4) <= len; i += 4)
+		acc = _mm256_min_pd(acc, _mm256_loadu_pd(src + i));
+	_mm256_storeu_pd(lanes, acc);
+
+	min = vk_min_scalar(lanes, 4);
+	if (i < len) {
+		lanes[0] = vk_min_sse2(src + i, len - i);
+		if (lanes[0] < min)
+			min = lanes[0];
+	}
+
+	return min;
+}
+
+__attribute__((target("avx2")))
+static double vk_max_avx2(const double *src, size_t len) {
+	__m256d acc;
+	double lanes[4];
+	double max;
+	size_t i;
+
+	if (len < 4)
+		return vk_max_sse2(src, len);
+
+	acc = _mm256_loadu_pd(src);
+	for (i = 4; (i + 4) <= len; i += 4)
+		acc = _mm256_max_pd(acc, _mm256_loadu_pd(src + i));
+	_mm256_storeu_pd(lanes, acc);
+
+	max = vk_max_scalar(lanes, 4);
+	if (i < len) {
+		lanes[0] = vk_max_sse2(src + i, len - i);
+		if (lanes[0] > max)
+			max = lanes[0];
+	}
+
+	return max;
+}
+#endif  // USE_SIMD_X86
+
+/**
+ * Selects the fastest set of vector kernels supported by the CPU we are
+ * currently running on.
+ */
+void vector_kernels_init(void) {
+	// Start with the scalar fallbacks.
+	bamboo_vkernels.add = vk_add_scalar;
+	bamboo_vkernels.mul = vk_mul_scalar;
+	bamboo_vkernels.affine = vk_affine_scalar;
+	bamboo_vkernels.sum = vk_sum_scalar;
+	bamboo_vkernels.dot = vk_dot_scalar;
+	bamboo_vkernels.min = vk_min_scalar;
+	bamboo_vkernels.max = vk_max_scalar;
+
+#ifdef USE_SIMD_X86
+	__builtin_cpu_init();
+
+	// Upgrade to SSE2 if we can.
+	if (__builtin_cpu_supports("sse2")) {
+		bamboo_vkernels.add = vk_add_sse2;
+		bamboo_vkernels.mul = vk_mul_sse2;
+		bamboo_vkernels.affine = vk_affine_sse2;
+		bamboo_vkernels.sum = vk_sum_sse2;
+		bamboo_vkernels.dot = vk_dot_sse2;
+		bamboo_vkernels.min = vk_min_sse2;
+		bamboo_vkernels.max = vk_max_sse2;
+	} else {
+		return;
+	}
+
+	// Upgrade to AVX2 if we can.
+	if (__builtin_cpu_supports("avx2")) {
+		bamboo_vkernels.add = vk_add_avx2;
+		bamboo_vkernels.mul = vk_mul_avx2;
+		bamboo_vkernels.affine = vk_affine_avx2;
+		bamboo_vkernels.sum = vk_sum_avx2;
+		bamboo_vkernels.dot = vk_dot_avx2;
+		bamboo_vkernels.min = vk_min_avx2;
+		bamboo_vkernels.max = vk_max_avx2;
+	}
+#endif  // USE_SIMD_X86
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                Big Integers                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Adds two integers checking for overflows. Used when the compiler doesn't
+ * provide us with the overflow checking built-ins.
+ *
+ * @param  a Left hand side operand.
+ * @param  b Right hand side operand.
+ * @param  r Pointer to the result of the operation if no overflow occured.
+ * @return   TRUE if the operation overflowed.
+ */
+bool int_add_overflow(int64_t a, int64_t b, int64_t *r) {
+	if (((b > 0) && (a > (INT64_MAX - b))) ||
+			((b < 0) && (a < (INT64_MIN - b)))) {
+		return true;
+	}
+
+	*r = a + b;
+	return false;
+}
+
+/**
+ * Subtracts two integers checking for overflows. Used when the compiler doesn't
+ * provide us with the overflow checking built-ins.
+ *
+ * @param  a Left hand side operand.
+ * @param  b Right hand side operand.
+ * @param  r Pointer to the result of the operation if no overflow occured.
+ * @return   TRUE if the operation overflowed.
+ */
+bool int_sub_overflow(int64_t a, int64_t b, int64_t *r) {
+	if (((b < 0) && (a > (INT64_MAX + b))) ||
+			((b > 0) && (a < (INT64_MIN + b)))) {
+		return true;
+	}
+
+	*r = a - b;
+	return false;
+}
+
+/**
+ * Multiplies two integers checking for overflows. Used when the compiler
+ * doesn't provide us with the overflow checking built-ins.
+ *
+ * @param  a Left hand side operand.
+ * @param  b Right hand side operand.
+ * @param  r Pointer to the result of the operation if no overflow occured.
+ * @return   TRUE if the operation overflowed.
+ */
+bool int_mul_overflow(int64_t a, int64_t b, int64_t *r) {
+	if ((a != 0) && (b != 0)) {
+		if (a > 0) {
+			if (((b > 0) && (a > (INT64_MAX / b))) ||
+					((b < 0) && (b < (INT64_MIN / a)))) {
+				return true;
+			}
+		} else {
+			if (((b > 0) && (a < (INT64_MIN / b))) ||
+					((b < 0) && (a < (INT64_MAX / b)))) {
+				return true;
+			}
+		}
+	}
+
+	*r = a * b;
+	return false;
+}
+
+/**
+ * Gets the number of significant limbs in a magnitude.
+ *
+ * @param  a   Magnitude limbs.
+ * @param  len Number of limbs in the magnitude.
+ * @return     Number of limbs without the leading zeros.
+ */
+size_t mag_trim(const uint32_t *a, size_t len) {
+	while ((len > 0) && (a[len - 1] == 0))
+		len--;
+
+	return len;
+}
+
+/**
+ * Compares two magnitudes.
+ *
+ * @param  a    First magnitude.
+ * @param  alen Number of limbs in the first magnitude.
+ * @param  b    Second magnitude.
+ * @param  blen Number of limbs in the second magnitude.
+ * @return      Negative if a < b, zero if they are equal, positive if a > b.
+ */
+int mag_cmp(const uint32_t *a, size_t alen, const uint32_t *b, size_t blen) {
+	alen = mag_trim(a, alen);
+	blen = mag_trim(b, blen);
+
+	// Longer is always bigger.
+	if (alen != blen)
+		return (alen > blen) ? 1 : -1;
+
+	// Compare limb by limb from the most significant one.
+	while (alen-- > 0) {
+		if (a[alen] != b[alen])
+			return (a[alen] > b[alen]) ? 1 : -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Adds two magnitudes.
+ *
+ * @param  r    Result magnitude with room for max(alen, blen) + 1 limbs.
+ * @param  a    First magnitude.
+ * @param  alen Number of limbs in the first magnitude.
+ * @param  b    Second magnitude.
+ * @param  blen Number of limbs in the second magnitude.
+ * @return      Number of significant limbs in the result.
+ */
+size_t mag_add(uint32_t *r, const uint32_t *a, size_t alen, const uint32_t *b,
+			   size_t blen) {
+	uint64_t carry = 0;
+	size_t i;
+
+	// Make sure A is always the longest one.
+	if (alen < blen) {
+		const uint32_t *tmp = a;
+		size_t tmplen = alen;
+
+		a = b;
+		alen = blen;
+		b = tmp;
+		blen = tmplen;
+	}
+
+	for (i = 0; i < blen; i++) {
+		carry += (uint64_t)a[i] + b[i];
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	for (; i < alen; i++) {
+		carry += a[i];
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	r[alen] = (uint32_t)carry;
+
+	return mag_trim(r, alen + 1);
+}
+
+/**
+ * Subtracts two magnitudes where A must be greater or equal to B.
+ *
+ * @param  r    Result magnitude with room for alen limbs.
+ * @param  a    First magnitude.
+ * @param  alen Number of limbs in the first magnitude.
+ * @param  b    Second magnitude.
+ * @param  blen Number of limbs in the second magnitude.
+ * @return      Number of significant limbs in the result.
+ */
+size_t mag_sub(uint32_t *r, const uint32_t *a, size_t alen, const uint32_t *b,
+			   size_t blen) {
+	int64_t borrow = 0;
+	size_t i;
+
+	for (i = 0; i < alen; i++) {
+		borrow += (int64_t)a[i] - ((i < blen) ? b[i] : 0);
+		r[i] = (uint32_t)borrow;
+		borrow = (borrow < 0) ? -1 : 0;
+	}
+
+	return mag_trim(r, alen);
+}
+
+/**
+ * Adds a magnitude into another one in place.
+ *
+ * @param r    Magnitude to be added to. Must have enough room for the result.
+ * @param rlen Number of limbs available in R.
+ * @param b    Magnitude to be added.
+ * @param blen Number of limbs in B.
+ */
+void mag_add_into(uint32_t *r, size_t rlen, const uint32_t *b, size_t blen) {
+	uint64_t carry = 0;
+	size_t i;
+
+	for (i = 0; (i < rlen) && ((i < blen) || (carry != 0)); i++) {
+		carry += (uint64_t)r[i] + ((i < blen) ? b[i] : 0);
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+}
+
+/**
+ * Subtracts a magnitude from another one in place, R must be greater or equal
+ * to B.
+ *
+ * @param r    Magnitude to be subtracted from.
+ * @param rlen Number of limbs in R.
+ * @param b    Magnitude to be subtracted.
+ * @param blen Number of limbs in B.
+ */
+void mag_sub_into(uint32_t *r, size_t rlen, const uint32_t *b, size_t blen) {
+	int64_t borrow = 0;
+	size_t i;
+
+	for (i = 0; (i < rlen) && ((i < blen) || (borrow != 0)); i++) {
+		borrow += (int64_t)r[i] - ((i < blen) ? b[i] : 0);
+		r[i] = (uint32_t)borrow;
+		borrow = (borrow < 0) ? -1 : 0;
+	}
+}
+
+/**
+ * Multiplies two magnitudes using the schoolbook method.
+ *
+ * @param r    Zeroed result magnitude with room for alen + blen limbs.
+ * @param a    First magnitude.
+ * @param alen Number of limbs in the first magnitude.
+ * @param b    Second magnitude.
+ * @param blen Number of limbs in the second magnitude.
+ */
+void mag_mul_school(uint32_t *r, const uint32_t *a, size_t alen,
+					const uint32_t *b, size_t blen) {
+	size_t i;
+	size_t j;
+
+	for (i = 0; i < alen; i++) {
+		uint64_t carry = 0;
+
+		if (a[i] == 0)
+			continue;
+
+		for (j = 0; j < blen; j++) {
+			carry += ((uint64_t)a[i] * b[j]) + r[i + j];
+			r[i + j] = (uint32_t)carry;
+			carry >>= 32;
+		}
+		r[i + blen] = (uint32_t)carry;
+	}
+}
+
+/**
+ * Multiplies two magnitudes using Karatsuba's algorithm for operands that are
+ * large enough, falling back to the schoolbook method for the small ones.
+ *
+ * @param r    Zeroed result magnitude with room for alen + blen limbs.
+ * @param a    First magnitude.
+ * @param alen Number of limbs in the first magnitude.
+ * @param b    Second magnitude.
+ * @param blen Number of limbs in the second magnitude.
+ */
+void mag_mul(uint32_t *r, const uint32_t *a, size_t alen, const uint32_t *b,
+			 size_t blen) {
+	uint32_t *tmp;
+	uint32_t *sa;
+	uint32_t *sb;
+	uint32_t *z1;
+	size_t salen;
+	size_t sblen;
+	size_t z1len;
+	size_t a0len;
+	size_t b0len;
+	size_t m;
+
+	// Make sure A is always the longest one.
+	if (alen < blen) {
+		const uint32_t *swp = a;
+		size_t swplen = alen;
+
+		a = b;
+		alen = blen;
+		b = swp;
+		blen = swplen;
+	}
+
+	// Small operands are faster with the good old schoolbook method.
+	if (blen < BIGNUM_KARATSUBA_THRESHOLD) {
+		mag_mul_school(r, a, alen, b, blen);
+		return;
+	}
+
+	// Very unbalanced operands are multiplied in chunks of B's size.
+	if ((blen * 2) <= alen) {
+		size_t off;
+
+		tmp = (uint32_t *)malloc(blen * 2 * sizeof(uint32_t));
+		if (tmp == NULL) {
+			fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+				_T("temporary buffer for big integer multiplication"));
+			return;
+		}
+
+		for (off = 0; off < alen; off += blen) {
+			size_t clen = ((alen - off) < blen) ? (alen - off) : blen;
+
+			memset(tmp, 0, (clen + blen) * sizeof(uint32_t));
+			mag_mul(tmp, a + off, clen, b, blen);
+			mag_add_into(r + off, alen + blen - off, tmp, clen + blen);
+		}
+
+		free(tmp);
+		return;
+	}
+
+	// Split the operands at M limbs: A = A1 * B^M + A0 and B = B1 * B^M + B0.
+	m = alen / 2;
+	a0len = mag_trim(a, m);
+	b0len = mag_trim(b, m);
+
+	// Z0 = A0 * B0 goes to the lower half and Z2 = A1 * B1 to the upper one.
+	mag_mul(r, a, a0len, b, b0len);
+	mag_mul(r + (m * 2), a + m, alen - m, b + m, blen - m);
+
+	// Allocate space for our sums and the middle term.
+	tmp = (uint32_t *)calloc(((alen - m) + 1) * 4, sizeof(uint32_t));
+	if (tmp == NULL) {
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+			_T("temporary buffer for big integer multiplication"));
+		return;
+	}
+	sa = tmp;
+	sb = sa + (alen - m) + 1;
+	z1 = sb + (alen - m) + 1;
+
+	// Z1 = (A0 + A1) * (B0 + B1) - Z0 - Z2.
+	salen = mag_add(sa, a, a0len, a + m, alen - m);
+	sblen = mag_add(sb, b, b0len, b + m, blen - m);
+	mag_mul(z1, sa, salen, sb, sblen);
+	z1len = mag_trim(z1, salen + sblen);
+	mag_sub_into(z1, z1len, r, mag_trim(r, m * 2));
+	mag_sub_into(z1, z1len, r + (m * 2),
+		mag_trim(r + (m * 2), alen + blen - (m * 2)));
+	z1len = mag_trim(z1, z1len);
+
+	// Put the middle term in its place.
+	mag_add_into(r + m, alen + blen - m, z1, z1len);
+
+	free(tmp);
+}
+
+/**
+ * Divides a magnitude by a small number in place.
+ *
+ * @param  a   Magnitude to be divided.
+ * @param  len Number of limbs in the magnitude.
+ * @param  d   Divisor.
+ * @return     Remainder of the division.
+ */
+uint32_t mag_divmod_small(uint32_t *a, size_t len, uint32_t d) {
+	uint64_t rem = 0;
+
+	while (len-- > 0) {
+		rem = (rem << 32) | a[len];
+		a[len] = (uint32_t)(rem / d);
+		rem %= d;
+	}
+
+	return (uint32_t)rem;
+}
+
+/**
+ * Multiplies a magnitude by a small number and adds another small number to it
+ * in place.
+ *
+ * @param  a   Magnitude to be operated on.
+ * @param  len Number of limbs in the magnitude.
+ * @param  m   Multiplier.
+ * @param  add Number to be added after the multiplication.
+ * @return     Carry limb that didn't fit in the magnitude.
+ */
+uint32_t mag_mul_small_add(uint32_t *a, size_t len, uint32_t m, uint32_t add) {
+	uint64_t carry = add;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		carry += (uint64_t)a[i] * m;
+		a[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+
+	return (uint32_t)carry;
+}
+
+/**
+ * Gets a view of the magnitude and sign of an integer or big integer atom.
+ *
+ * @param atom Integer or big integer atom.
+ * @param view Pointer to the view to be populated.
+ */
+void bignum_view(atom_t atom, bigview_t *view) {
+	uint64_t mag;
+
+	// Big integers are already in the right format.
+	if (atom.type == ATOM_TYPE_BIGNUM) {
+		view->negative = (*atom.value.bignum)->negative;
+		view->len = (*atom.value.bignum)->len;
+		view->limbs = (*atom.value.bignum)->limbs;
+
+		return;
+	}
+
+	// Split the integer into limbs.
+	view->negative = atom.value.integer < 0;
+	mag = (view->negative) ? (uint64_t)0 - (uint64_t)atom.value.integer :
+		(uint64_t)atom.value.integer;
+	view->buf[0] = (uint32_t)mag;
+	view->buf[1] = (uint32_t)(mag >> 32);
+	view->limbs = view->buf;
+	view->len = mag_trim(view->buf, 2);
+}
+
+/**
+ * Builds an integer atom from a magnitude, only allocating a big integer if
+ * the number doesn't fit in a regular integer.
+ *
+ * @param  limbs    Magnitude limbs.
+ * @param  len      Number of limbs in the magnitude.
+ * @param  negative Is this a negative number?
+ * @return          Integer or big integer atom.
+ */
+atom_t bignum_from_mag(const uint32_t *limbs, size_t len, bool negative) {
+	allocation_t *alloc;
+	bignum_t *num;
+	atom_t atom;
+
+	// Check if this number fits in a regular integer.
+	len = mag_trim(limbs, len);
+	if (len <= 2) {
+		uint64_t mag = 0;
+
+		if (len > 0)
+			mag = limbs[0];
+		if (len > 1)
+			mag |= (uint64_t)limbs[1] << 32;
+
+		if (!negative && (mag <= (uint64_t)INT64_MAX))
+			return bamboo_int((int64_t)mag);
+		if (negative && (mag <= ((uint64_t)INT64_MAX + 1))) {
+			return bamboo_int((mag == ((uint64_t)INT64_MAX + 1)) ? INT64_MIN :
+				-(int64_t)mag);
+		}
+	}
+
+	// Allocate the big integer header and its limbs in a single go.
+	num = (bignum_t *)malloc(sizeof(bignum_t) + (len * sizeof(uint32_t)));
+	if (num == NULL) {
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate big integer ")
+			_T("limbs"));
+		return nil;
+	}
+	num->negative = negative;
+	num->len = len;
+	num->limbs = (uint32_t *)(num + 1);
+	memcpy(num->limbs, limbs, len * sizeof(uint32_t));
+
+	// Create a new allocation.
+	alloc = (allocation_t *)malloc(sizeof(allocation_t));
+	if (alloc == NULL) {
+		free(num);
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate structure for ")
+			_T("garbage collector big integer allocation tracking"));
+		return nil;
+	}
+
+	// Fill up the new allocation and push the linked list forward.
+	alloc->mark = GC_TO_FREE;
+	alloc->type = ALLOCATION_TYPE_BIGNUM;
+	alloc->data.bignum = num;
+	alloc->next = bamboo_ctx->allocations;
+	bamboo_ctx->allocations = alloc;
+
+	// Create the new big integer atom.
+	atom.type = ATOM_TYPE_BIGNUM;
+	atom.value.bignum = &alloc->data.bignum;
+
+	return atom;
+}
+
+/**
+ * Compares two integer or big integer atoms.
+ *
+ * @param  a First integer atom.
+ * @param  b Second integer atom.
+ * @return   Negative if a < b, zero if they are equal, positive if a > b.
+ */
+int bignum_cmp(atom_t a, atom_t b) {
+	bigview_t va;
+	bigview_t vb;
+	int cmp;
+
+	bignum_view(a, &va);
+	bignum_view(b, &vb);
+
+	// Different signs are easy.
+	if (va.negative != vb.negative)
+		return (va.negative) ? -1 : 1;
+
+	// Same sign, so compare the magnitudes.
+	cmp = mag_cmp(va.limbs, va.len, vb.limbs, vb.len);
+	return (va.negative) ? -cmp : cmp;
+}
+
+/**
+ * Performs a binary arithmetic or comparison operation on two integer or big
+ * integer atoms without losing precision.
+ *
+ * @param  op     Operation to be performed.
+ * @param  a      Left hand side integer operand.
+ * @param  b      Right hand side integer operand.
+ * @param  result Pointer to the resulting integer or boolean atom.
+ * @return        BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t bignum_binop(numeric_op_t op, atom_t a, atom_t b,
+							atom_t *result) {
+	bigview_t va;
+	bigview_t vb;
+	uint32_t *r;
+	size_t rlen;
+	bool negative;
+
+	// Handle the comparisons.
+	switch (op) {
+	case NUMERIC_OP_EQ:
+		*result = bamboo_boolean(bignum_cmp(a, b) == 0);
+		return BAMBOO_OK;
+	case NUMERIC_OP_LT:
+		*result = bamboo_boolean(bignum_cmp(a, b) < 0);
+		return BAMBOO_OK;
+	case NUMERIC_OP_GT:
+		*result = bamboo_boolean(bignum_cmp(a, b) > 0);
+		return BAMBOO_OK;
+	default:
+		break;
+	}
+
+	// Get the magnitudes and allocate enough room for the result.
+	bignum_view(a, &va);
+	bignum_view(b, &vb);
+	rlen = (op == NUMERIC_OP_MULTIPLY) ? (va.len + vb.len) :
+		(((va.len > vb.len) ? va.len : vb.len) + 1);
+	r = (uint32_t *)calloc(rlen, sizeof(uint32_t));
+	if (r == NULL) {
+		*result = nil;
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+			_T("temporary buffer for big integer arithmetic"));
+	}
+
+	if (op == NUMERIC_OP_MULTIPLY) {
+		// Multiplication only cares about the signs at the end.
+		mag_mul(r, va.limbs, va.len, vb.limbs, vb.len);
+		negative = va.negative != vb.negative;
+	} else {
+		// Subtraction is just adding the negated operand.
+		if (op == NUMERIC_OP_SUBTRACT)
+			vb.negative = !vb.negative;
+
+		if (va.negative == vb.negative) {
+			// Same signs add up.
+			mag_add(r, va.limbs, va.len, vb.limbs, vb.len);
+			negative = va.negative;
+		} else if (mag_cmp(va.limbs, va.len, vb.limbs, vb.len) >= 0) {
+			// Different signs subtract, keeping the sign of the biggest one.
+			mag_sub(r, va.limbs, va.len, vb.limbs, vb.len);
+			negative = va.negative;
+		} else {
+			mag_sub(r, vb.limbs, vb.len, va.limbs, va.len);
+			negative = vb.negative;
+		}
+	}
+
+	// Build the resulting atom.
+	*result = bignum_from_mag(r, rlen, negative);
+	free(r);
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Divides two magnitudes using Knuth's algorithm D.
+ *
+ * @param q    Zeroed quotient magnitude with room for alen - blen + 1 limbs.
+ * @param r    Zeroed remainder magnitude with room for blen limbs.
+ * @param a    Dividend magnitude.
+ * @param alen Number of significant limbs in the dividend.
+ * @param b    Divisor magnitude. Must not be zero.
+ * @param blen Number of significant limbs in the divisor.
+ */
+void mag_divmod(uint32_t *q, uint32_t *r, const uint32_t *a, size_t alen,
+				const uint32_t *b, size_t blen) {
+	uint32_t *un;
+	uint32_t *vn;
+	uint8_t shift;
+	size_t i;
+	size_t j;
+
+	// Dividend smaller than the divisor is just the remainder.
+	if (mag_cmp(a, alen, b, blen) < 0) {
+		memcpy(r, a, alen * sizeof(uint32_t));
+		return;
+	}
+
+	// Single limb divisors are easy.
+	if (blen == 1) {
+		memcpy(q, a, alen * sizeof(uint32_t));
+		r[0] = mag_divmod_small(q, alen, b[0]);
+		return;
+	}
+
+	// Allocate space for the normalized operands.
+	un = (uint32_t *)calloc(alen + 1 + blen, sizeof(uint32_t));
+	if (un == NULL) {
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+			_T("temporary buffer for big integer division"));
+		return;
+	}
+	vn = un + alen + 1;
+
+	// Normalize the operands so that the divisor's top bit is set.
+	shift = 0;
+	while ((b[blen - 1] << shift) < 0x80000000UL)
+		shift++;
+	for (i = blen - 1; i > 0; i--) {
+		vn[i] = (b[i] << shift) |
+			((shift) ? (b[i - 1] >> (32 - shift)) : 0);
+	}
+	vn[0] = b[0] << shift;
+	un[alen] = (shift) ? (a[alen - 1] >> (32 - shift)) : 0;
+	for (i = alen - 1; i > 0; i--) {
+		un[i] = (a[i] << shift) |
+			((shift) ? (a[i - 1] >> (32 - shift)) : 0);
+	}
+	un[0] = a[0] << shift;
+
+	// Go through the dividend one limb at a time.
+	for (j = alen - blen + 1; j-- > 0;) {
+		uint64_t num;
+		uint64_t qhat;
+		uint64_t rhat;
+		uint64_t carry;
+		int64_t borrow;
+		int64_t t;
+
+		// Estimate the quotient limb.
+		num = ((uint64_t)un[j + blen] << 32) | un[j + blen - 1];
+		qhat = num / vn[blen - 1];
+		rhat = num % vn[blen - 1];
+		while ((qhat > 0xFFFFFFFFUL) ||
+				((qhat * vn[blen - 2]) > ((rhat << 32) | un[j + blen - 2]))) {
+			qhat--;
+			rhat += vn[blen - 1];
+			if (rhat > 0xFFFFFFFFUL)
+				break;
+		}
+
+		// Multiply and subtract.
+		carry = 0;
+		borrow = 0;
+		for (i = 0; i < blen; i++) {
+			uint64_t p = (qhat * vn[i]) + carry;
+
+			carry = p >> 32;
+			t = (int64_t)un[i + j] - borrow - (int64_t)(uint32_t)p;
+			un[i + j] = (uint32_t)t;
+			borrow = (t < 0) ? 1 : 0;
+		}
+		t = (int64_t)un[j + blen] - borrow - (int64_t)carry;
+		un[j + blen] = (uint32_t)t;
+		q[j] = (uint32_t)qhat;
+
+		// Our estimate was one too big, so add the divisor back.
+		if (t < 0) {
+			q[j]--;
+			carry = 0;
+			for (i = 0; i < blen; i++) {
+				carry += (uint64_t)un[i + j] + vn[i];
+				un[i + j] = (uint32_t)carry;
+				carry >>= 32;
+			}
+			un[j + blen] += (uint32_t)carry;
+		}
+	}
+
+	// Denormalize the remainder.
+	for (i = 0; i < blen; i++) {
+		r[i] = (un[i] >> shift) |
+			((shift) ? (un[i + 1] << (32 - shift)) : 0);
+	}
+
+	free(un);
+}
+
+/**
+ * Performs a truncating division on two integer or big integer atoms. Just like
+ * 'quotient' and 'remainder' in Scheme.
+ *
+ * @param  a    Dividend integer atom.
+ * @param  b    Divisor integer atom.
+ * @param  quot Pointer to the resulting quotient atom. Can be NULL.
+ * @param  rem  Pointer to the resulting remainder atom, which has the same sign
+ *              as the dividend. Can be NULL.
+ * @return      BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t bignum_divmod(atom_t a, atom_t b, atom_t *quot, atom_t *rem) {
+	bigview_t va;
+	bigview_t vb;
+	uint32_t *q;
+	uint32_t *r;
+
+	// Regular integers are handled natively, except for the one case that
+	// overflows.
+	if ((a.type == ATOM_TYPE_INTEGER) && (b.type == ATOM_TYPE_INTEGER) &&
+			(b.value.integer != 0) &&
+			!((a.value.integer == INT64_MIN) && (b.value.integer == -1))) {
+		if (quot != NULL)
+			*quot = bamboo_int(a.value.integer / b.value.integer);
+		if (rem != NULL)
+			*rem = bamboo_int(a.value.integer % b.value.integer);
+
+		return BAMBOO_OK;
+	}
+
+	// Get the magnitudes and make sure we aren't dividing by zero.
+	bignum_view(a, &va);
+	bignum_view(b, &vb);
+	if (vb.len == 0) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("Division by zero"));
+	}
+
+	// Allocate space for the quotient and the remainder.
+	q = (uint32_t *)calloc(va.len + vb.len + 1, sizeof(uint32_t));
+	if (q == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+			_T("temporary buffer for big integer division"));
+	}
+	r = q + va.len + 1;
+
+	// Divide and build the resulting atoms.
+	if (va.len > 0)
+		mag_divmod(q, r, va.limbs, va.len, vb.limbs, vb.len);
+	if (quot != NULL)
+		*quot = bignum_from_mag(q, va.len + 1, va.negative != vb.negative);
+	if (rem != NULL)
+		*rem = bignum_from_mag(r, vb.len, va.negative);
+	free(q);
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Calculates the integer square root of a non-negative integer or big integer
+ * atom using Newton's method.
+ *
+ * @param  x    Non-negative integer atom.
+ * @param  root Pointer to the resulting atom, which is the largest integer
+ *              whose square isn't bigger than x.
+ * @return      BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t bignum_isqrt(atom_t x, atom_t *root) {
+	bamboo_error_t err;
+	bigview_t view;
+	uint32_t *guess;
+	uint32_t top;
+	size_t bits;
+	size_t half;
+	atom_t next;
+	atom_t quot;
+
+	// Get the number of bits in the number.
+	bignum_view(x, &view);
+	if (view.len == 0) {
+		*root = bamboo_int(0);
+		return BAMBOO_OK;
+	}
+	bits = view.len * 32;
+	for (top = view.limbs[view.len - 1]; !(top & 0x80000000UL); top <<= 1)
+		bits--;
+
+	// Start from a power of two that's never smaller than the root.
+	half = (bits + 1) / 2;
+	guess = (uint32_t *)calloc((half / 32) + 1, sizeof(uint32_t));
+	if (guess == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+			_T("temporary buffer for big integer square root"));
+	}
+	guess[half / 32] = (uint32_t)1 << (half % 32);
+	*root = bignum_from_mag(guess, (half / 32) + 1, false);
+	free(guess);
+
+	// Newton's iterations only go down until they reach the root.
+	for (;;) {
+		err = bignum_divmod(x, *root, &quot, NULL);
+		IF_ERROR(err)
+			return err;
+		err = bignum_binop(NUMERIC_OP_SUM, *root, quot, &next);
+		IF_ERROR(err)
+			return err;
+		err = bignum_divmod(next, bamboo_int(2), &next, NULL);
+		IF_ERROR(err)
+			return err;
+
+		if (bignum_cmp(next, *root) >= 0)
+			break;
+		*root = next;
+	}
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Converts a big integer into a float.
+ *
+ * @param  num Big integer to be converted.
+ * @return     Closest floating-point representation of the number.
+ */
+bamboo_float_t bignum_to_float(const bignum_t *num) {
+	bamboo_float_t f = 0;
+	size_t i;
+
+	for (i = num->len; i > 0; i--)
+		f = (f * (bamboo_float_t)4294967296.0) + num->limbs[i - 1];
+
+	return (num->negative) ? -f : f;
+}
+
+/**
+ * Builds the decimal string representation of a big integer.
+ *
+ * @param  num Big integer to be represented.
+ * @return     Newly allocated string. NOTE: Remember that you're responsible
+ *             for freeing this pointer later.
+ */
+TCHAR *bignum_str(const bignum_t *num) {
+	uint32_t *tmp;
+	TCHAR *buf;
+	size_t buflen;
+	size_t pos;
+	size_t len;
+
+	// Each 32-bit limb takes less than 10 decimal digits.
+	buflen = (num->len * 10) + 2;
+	buf = (TCHAR *)malloc((buflen + 1) * sizeof(TCHAR));
+	tmp = (uint32_t *)malloc(num->len * sizeof(uint32_t));
+	if ((buf == NULL) || (tmp == NULL)) {
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate string to ")
+			_T("represent big integer atom"));
+		return NULL;
+	}
+	memcpy(tmp, num->limbs, num->len * sizeof(uint32_t));
+
+	// Extract the digits 9 at a time from the least significant end.
+	pos = buflen;
+	buf[pos] = _T('\0');
+	len = mag_trim(tmp, num->len);
+	while (len > 0) {
+		uint32_t rem;
+		uint8_t i;
+
+		rem = mag_divmod_small(tmp, len, 1000000000UL);
+		len = mag_trim(tmp, len);
+		for (i = 0; i < 9; i++) {
+			buf[--pos] = (TCHAR)(_T('0') + (rem % 10));
+			rem /= 10;
+
+			// Don't pad the most significant chunk with zeros.
+			if ((len == 0) && (rem == 0))
+				break;
+		}
+	}
+	if (num->negative)
+		buf[--pos] = _T('-');
+	free(tmp);
+
+	// Move the number to the beginning of the buffer.
+	memmove(buf, buf + pos, (buflen - pos + 1) * sizeof(TCHAR));
+	return buf;
+}
+
+/**
+ * Parses a decimal integer string that's too big to fit in a regular integer.
+ *
+ * @param  start Beginning of the number string.
+ * @param  end   End of the number string.
+ * @param  atom  Pointer to the resulting integer or big integer atom.
+ * @return       TRUE if the string was a valid decimal integer.
+ */
+bool bignum_parse(const TCHAR *start, const TCHAR *end, atom_t *atom) {
+	const TCHAR *tmp;
+	uint32_t *limbs;
+	size_t len;
+	bool negative;
+
+	// Get the sign.
+	negative = *start == _T('-');
+	if ((*start == _T('-')) || (*start == _T('+')))
+		start++;
+	if (start >= end)
+		return false;
+
+	// Make sure we only have decimal digits.
+	for (tmp = start; tmp < end; tmp++) {
+		if ((*tmp < _T('0')) || (*tmp > _T('9')))
+			return false;
+	}
+
+	// Every 9 decimal digits fit in less than a limb.
+	limbs = (uint32_t *)calloc(((end - start) / 9) + 2, sizeof(uint32_t));
+	if (limbs == NULL)
+		return false;
+
+	// Accumulate the digits 9 at a time.
+	len = 0;
+	while (start < end) {
+		uint32_t chunk = 0;
+		uint32_t mul = 1;
+		uint32_t carry;
+
+		for (tmp = start; (tmp < end) && ((tmp - start) < 9); tmp++) {
+			chunk = (chunk * 10) + (uint32_t)(*tmp - _T('0'));
+			mul *= 10;
+		}
+		start = tmp;
+
+		carry = mag_mul_small_add(limbs, len, mul, chunk);
+		if (carry != 0)
+			limbs[len++] = carry;
+	}
+
+	// Build the resulting atom.
+	*atom = bignum_from_mag(limbs, len, negative);
+	free(limbs);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                       Number Formatting and Parsing                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Initializes the tables used to format and parse numbers.
+ */
+void number_init(void) {
+	size_t i;
+
+	// Powers of ten that are exactly representable by our float type.
+	bamboo_pow10[0] = 1;
+	for (i = 1; i <= FLOAT_EXACT_POW10_MAX; i++)
+		bamboo_pow10[i] = bamboo_pow10[i - 1] * 10;
+
+#ifdef BAMBOO_USE_DOUBLE
+	pow5_table_init();
+#endif  // BAMBOO_USE_DOUBLE
+}
+
+/**
+ * Multiplies two 64-bit numbers into a 128-bit result.
+ *
+ * @param  a  First factor.
+ * @param  b  Second factor.
+ * @param  hi Pointer to the variable that will hold the upper 64 bits.
+ * @return    Lower 64 bits of the product.
+ */
+uint64_t mul_64x64(uint64_t a, uint64_t b, uint64_t *hi) {
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 r = (unsigned __int128)a * b;
+
+	*hi = (uint64_t)(r >> 64);
+	return (uint64_t)r;
+#else
+	uint64_t a_lo = a & 0xFFFFFFFFu;
+	uint64_t a_hi = a >> 32;
+	uint64_t b_lo = b & 0xFFFFFFFFu;
+	uint64_t b_hi = b >> 32;
+	uint64_t p0 = a_lo * b_lo;
+	uint64_t p1 = a_lo * b_hi;
+	uint64_t p2 = a_hi * b_lo;
+	uint64_t p3 = a_hi * b_hi;
+	uint64_t mid = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+
+	*hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+	return (mid << 32) | (p0 & 0xFFFFFFFFu);
+#endif  // __SIZEOF_INT128__
+}
+
+/**
+ * Converts a decimal number into a float if it can be done quickly and
+ * exactly.
+ *
+ * @param  mant  Significant digits of the number.
+ * @param  exp10 Power of ten that multiplies the significant digits.
+ * @param  num   Pointer to the variable that will hold the converted number.
+ * @return       TRUE if the number was converted. FALSE if the conversion has
+ *               to be done the slow way.
+ */
+bool float_from_decimal(uint64_t mant, int exp10, bamboo_float_t *num) {
+#ifdef BAMBOO_USE_DOUBLE
+	double dnum;
+#endif  // BAMBOO_USE_DOUBLE
+
+	// Zero is zero no matter the exponent.
+	if (mant == 0) {
+		*num = 0;
+		return true;
+	}
+
+	// Both the digits and the power of ten are exact, so a single rounding
+	// gives the correct result.
+	if ((mant <= FLOAT_EXACT_INT_MAX) && (exp10 >= -FLOAT_EXACT_POW10_MAX) &&
+			(exp10 <= FLOAT_EXACT_POW10_MAX)) {
+		if (exp10 < 0) {
+			*num = (bamboo_float_t)mant / bamboo_pow10[-exp10];
+		} else {
+			*num = (bamboo_float_t)mant * bamboo_pow10[exp10];
+		}
+
+		return true;
+	}
+
+#ifdef BAMBOO_USE_DOUBLE
+	// Try to get the correctly rounded result from the 128-bit product.
+	if (eisel_lemire(mant, exp10, &dnum)) {
+		*num = dnum;
+		return true;
+	}
+#endif  // BAMBOO_USE_DOUBLE
+
+	return false;
+}
+
+/**
+ * Parses a plain decimal integer or float without going through the C library.
+ * Anything that isn't a plain decimal number, or that can't be converted both
+ * quickly and exactly, is left for the C library to handle.
+ *
+ * @param  start Beginning of the number string.
+ * @param  end   End of the number string.
+ * @param  atom  Pointer to an atom structure that will hold the parsed number.
+ * @return       TRUE if the number was parsed.
+ */
+bool parse_decimal(const TCHAR *start, const TCHAR *end, atom_t *atom) {
+	const TCHAR *tmp = start;
+	const TCHAR *digits;
+	bamboo_float_t num;
+	uint64_t mant = 0;
+	uint8_t ndigits = 0;
+	bool negative = false;
+	bool is_float = false;
+	int exp10 = 0;
+
+	// Get the sign.
+	if ((*tmp == _T('+')) || (*tmp == _T('-'))) {
+		negative = *tmp == _T('-');
+		tmp++;
+	}
+
+	// Integral part.
+	digits = tmp;
+	for (; (tmp < end) && (*tmp >= _T('0')) && (*tmp <= _T('9')); tmp++) {
+		// Leading zeros aren't significant.
+		if ((mant == 0) && (*tmp == _T('0')))
+			continue;
+
+		// Too many digits to handle ourselves.
+		if (++ndigits > FLOAT_MAX_FAST_DIGITS)
+			return false;
+		mant = (mant * 10) + (uint64_t)(*tmp - _T('0'));
+	}
+
+	// Plain integer.
+	if (tmp == end) {
+		// Leave hexadecimal and octal integers, as well as lone signs, alone.
+		if ((tmp == digits) || ((*digits == _T('0')) && ((tmp - digits) > 1)))
+			return false;
+
+		// Check if it fits in a regular integer.
+		if (!negative && (mant <= (uint64_t)INT64_MAX)) {
+			*atom = bamboo_int((int64_t)mant);
+			return true;
+		} else if (negative && (mant <= ((uint64_t)INT64_MAX + 1))) {
+			*atom = bamboo_int((int64_t)(0 - mant));
+			return true;
+		}
+
+		// Too big for a regular integer, so let's try a big one.
+		return bignum_parse(start, end, atom);
+	}
+
+	// Fractional part.
+	if (*tmp == _T('.')) {
+		is_float = true;
+		for (tmp++; (tmp < end) && (*tmp >= _T('0')) && (*tmp <= _T('9'));
+				tmp++) {
+			exp10--;
+			if ((mant == 0) && (*tmp == _T('0')))
+				continue;
+
+			if (++ndigits > FLOAT_MAX_FAST_DIGITS)
+				return false;
+			mant = (mant * 10) + (uint64_t)(*tmp - _T('0'));
+		}
+
+		// We need at least a digit somewhere.
+		if ((tmp - digits) == 1)
+			return false;
+	}
+
+	// Exponent.
+	if ((tmp < end) && ((*tmp == _T('e')) || (*tmp == _T('E'))) &&
+			(tmp != digits)) {
+		bool exp_negative = false;
+		int exp = 0;
+
+		is_float = true;
+		tmp++;
+		if ((tmp < end) && ((*tmp == _T('+')) || (*tmp == _T('-')))) {
+			exp_negative = *tmp == _T('-');
+			tmp++;
+		}
+
+		// We need at least one digit in the exponent.
+		if ((tmp == end) || (*tmp < _T('0')) || (*tmp > _T('9')))
+			return false;
+		for (; (tmp < end) && (*tmp >= _T('0')) && (*tmp <= _T('9')); tmp++) {
+			exp = (exp * 10) + (*tmp - _T('0'));
+			if (exp > FLOAT_MAX_FAST_EXP)
+				return false;
+		}
+
+		exp10 += (exp_negative) ? -exp : exp;
+	}
+
+	// Make sure we've gone through the whole thing.
+	if ((tmp != end) || !is_float)
+		return false;
+
+	// Convert the number.
+	if (!float_from_decimal(mant, exp10, &num))
+		return false;
+	*atom = bamboo_float((negative) ? -num : num);
+
+	return true;
+}
+
+/**
+ * Gets the shortest sequence of decimal digits that converts back to the exact
+ * same float.
+ *
+ * @param  num    Positive, finite and non-zero number.
+ * @param  digits Buffer with room for at least STRBUF_NUM_MAX_LEN characters
+ *                that will hold the digits.
+ * @param  exp10  Pointer to the variable that will hold the power of ten of the
+ *                first digit.
+ * @return        Number of digits.
+ */
+size_t float_shortest(bamboo_float_t num, TCHAR *digits, int *exp10) {
+#ifdef BAMBOO_USE_DOUBLE
+	bamboo_float_t back;
+	uint64_t cand[2];
+	uint64_t mant;
+	int dec_exp;
+	size_t len;
+	size_t i;
+	int j;
+
+	len = grisu2(num, digits, &dec_exp);
+
+	// Grisu2 doesn't always find the shortest digits, so keep dropping the
+	// last one for as long as rounding what's left still reads back the same.
+	while (len > 1) {
+		mant = 0;
+		for (i = 0; i < (len - 1); i++)
+			mant = (mant * 10) + (uint64_t)(digits[i] - _T('0'));
+
+		// Try the closest rounding first.
+		cand[0] = (digits[len - 1] >= _T('5')) ? (mant + 1) : mant;
+		cand[1] = (digits[len - 1] >= _T('5')) ? mant : (mant + 1);
+		for (j = 0; j < 2; j++) {
+			if (float_from_decimal(cand[j], dec_exp + 1, &back) &&
+					(back == num)) {
+				break;
+			}
+		}
+		if (j == 2)
+			break;
+
+		// Use the shorter digits, which may have gained a carry.
+		len = format_int(digits, (int64_t)cand[j]);
+		dec_exp++;
+		while ((len > 1) && (digits[len - 1] == _T('0'))) {
+			len--;
+			dec_exp++;
+		}
+	}
+	*exp10 = dec_exp + (int)len - 1;
+
+	return len;
+#else
+	TCHAR buf[STRBUF_NUM_MAX_LEN];
+	bamboo_float_t back;
+	uint64_t mant;
+	size_t len = 0;
+	size_t i;
+	int prec;
+
+	// Find the least amount of digits that still round-trips.
+	for (prec = FLOAT_DIG; prec <= FLOAT_DECIMAL_DIG; prec++) {
+		// Get the digits and exponent out of the scientific notation.
+		_sntprintf(buf, STRBUF_NUM_MAX_LEN, FLOAT_EXP_SPEC, prec - 1, num);
+		len = 0;
+		for (i = 0; (buf[i] != _T('e')) && (buf[i] != _T('\0')); i++) {
+			if (buf[i] != _T('.'))
+				digits[len++] = buf[i];
+		}
+		*exp10 = 0;
+		if (buf[i] == _T('e')) {
+			bool negative = buf[++i] == _T('-');
+
+			for (i++; buf[i] != _T('\0'); i++)
+				*exp10 = (*exp10 * 10) + (buf[i] - _T('0'));
+			if (negative)
+				*exp10 = -*exp10;
+		}
+
+		// Trailing zeros aren't significant.
+		while ((len > 1) && (digits[len - 1] == _T('0')))
+			len--;
+
+		// Check if we can get the same number back.
+		if (prec == FLOAT_DECIMAL_DIG)
+			break;
+		mant = 0;
+		for (i = 0; (i < len) && (i < FLOAT_MAX_FAST_DIGITS); i++)
+			mant = (mant * 10) + (uint64_t)(digits[i] - _T('0'));
+		if ((len <= FLOAT_MAX_FAST_DIGITS) &&
+				float_from_decimal(mant, *exp10 - (int)len + 1, &back)) {
+			if (back == num)
+				break;
+#ifdef _tcstofloat
+		} else if (_tcstofloat(buf, NULL) == num) {
+			break;
+#endif  // _tcstofloat
+		}
+	}
+
+	return len;
+#endif  // BAMBOO_USE_DOUBLE
+}
+
+/**
+ * Formats the decimal representation of an integer.
+ *
+ * @param  buf Buffer with room for at least STRBUF_NUM_MAX_LEN characters.
+ * @param  num Number to be formatted.
+ * @return     Length of the terminated string written to the buffer.
+ */
+size_t format_int(TCHAR *buf, int64_t num) {
+	uint64_t mag;
+	size_t len;
+	size_t i;
+
+	// Work with the magnitude so that INT64_MIN doesn't bite us.
+	mag = (num < 0) ? (0 - (uint64_t)num) : (uint64_t)num;
+
+	// Write the digits backwards and then flip them around.
+	len = 0;
+	do {
+		buf[len++] = (TCHAR)(_T('0') + (mag % 10));
+		mag /= 10;
+	} while (mag > 0);
+	if (num < 0)
+		buf[len++] = _T('-');
+	for (i = 0; i < (len / 2); i++) {
+		TCHAR c = buf[i];
+		buf[i] = buf[len - i - 1];
+		buf[len - i - 1] = c;
+	}
+
+	buf[len] = _T('\0');
+	return len;
+}
+
+/**
+ * Formats the shortest representation of a floating-point number that reads
+ * back as the exact same float, so it always has either a decimal point or an
+ * exponent.
+ *
+ * @param  buf Buffer with room for at least STRBUF_NUM_MAX_LEN characters.
+ * @param  num Number to be formatted.
+ * @return     Length of the terminated string written to the buffer.
+ */
+size_t format_float(TCHAR *buf, bamboo_float_t num) {
+	TCHAR digits[STRBUF_NUM_MAX_LEN];
+	size_t ndigits;
+	size_t len = 0;
+	size_t i;
+	int exp10;
+
+	// Special values.
+	if (num != num) {
+		_tcsncpy(buf, _T("nan"), 4);
+		return 3;
+	}
+	if ((num < 0) || ((num == 0) && ((1 / num) < 0))) {
+		buf[len++] = _T('-');
+		num = -num;
+	}
+	if (num == FLOAT_HUGE_VAL) {
+		_tcsncpy(buf + len, _T("inf"), 4);
+		return len + 3;
+	}
+	if (num == 0) {
+		_tcsncpy(buf + len, _T("0.0"), 4);
+		return len + 3;
+	}
+
+	ndigits = float_shortest(num, digits, &exp10);
+	if ((exp10 < FLOAT_FIXED_MIN_EXP) || (exp10 >= FLOAT_DECIMAL_DIG)) {
+		// Scientific notation.
+		buf[len++] = digits[0];
+		if (ndigits > 1) {
+			buf[len++] = _T('.');
+			for (i = 1; i < ndigits; i++)
+				buf[len++] = digits[i];
+		}
+
+		buf[len++] = _T('e');
+		buf[len++] = (exp10 < 0) ? _T('-') : _T('+');
+		if ((exp10 > -10) && (exp10 < 10))
+			buf[len++] = _T('0');
+		len += format_int(buf + len, (exp10 < 0) ? -exp10 : exp10);
+	} else if (exp10 < 0) {
+		// Number smaller than one.
+		buf[len++] = _T('0');
+		buf[len++] = _T('.');
+		for (i = 1; i < (size_t)-exp10; i++)
+			buf[len++] = _T('0');
+		for (i = 0; i < ndigits; i++)
+			buf[len++] = digits[i];
+	} else {
+		// Number with an integral part.
+		for (i = 0; (i < ndigits) || (i <= (size_t)exp10); i++) {
+			if (i == ((size_t)exp10 + 1))
+				buf[len++] = _T('.');
+			buf[len++] = (i < ndigits) ? digits[i] : _T('0');
+		}
+
+		// Whole numbers still need to read back as floats.
+		if (ndigits <= ((size_t)exp10 + 1)) {
+			buf[len++] = _T('.');
+			buf[len++] = _T('0');
+		}
+	}
+
+	buf[len] = _T('\0');
+	return len;
+}
+
+#ifdef BAMBOO_USE_DOUBLE
+/**
+ * Builds the table of 128-bit approximations of powers of five used by the
+ * Eisel-Lemire algorithm.
+ */
+void pow5_table_init(void) {
+	uint32_t pow5[POW5_MAX_LIMBS];
+	uint32_t num[2 * POW5_MAX_LIMBS + 8];
+	uint32_t quot[2 * POW5_MAX_LIMBS + 8];
+	uint32_t rem[POW5_MAX_LIMBS];
+	size_t len;
+	size_t nlen;
+	size_t bits;
+	int q;
+
+	// Positive powers are just truncated.
+	pow5[0] = 1;
+	len = 1;
+	for (q = 0; q <= POW5_MAX_EXP; q++) {
+		mag_top128(pow5, len, &bamboo_pow5[2 * (q - POW5_MIN_EXP)]);
+
+		pow5[len] = mag_mul_small_add(pow5, len, 5, 0);
+		if (pow5[len] != 0)
+			len++;
+	}
+
+	// Negative powers are the truncated reciprocal plus one.
+	pow5[0] = 1;
+	len = 1;
+	for (q = -1; q >= POW5_MIN_EXP; q--) {
+		pow5[len] = mag_mul_small_add(pow5, len, 5, 0);
+		if (pow5[len] != 0)
+			len++;
+
+		// Figure out the power of two we need to divide.
+		bits = (len * 32) - mag_clz(pow5[len - 1]);
+		bits = (q >= -27) ? (bits + 127) : ((2 * bits) + 128);
+
+		// Divide it and add one to the quotient.
+		nlen = (bits / 32) + 1;
+		memset(num, 0, sizeof(num));
+		memset(quot, 0, sizeof(quot));
+		memset(rem, 0, sizeof(rem));
+		num[bits / 32] = (uint32_t)1 << (bits % 32);
+		mag_divmod(quot, rem, num, nlen, pow5, len);
+		nlen = mag_trim(quot, nlen - len + 1);
+		quot[nlen] = mag_mul_small_add(quot, nlen, 1, 1);
+		if (quot[nlen] != 0)
+			nlen++;
+
+		mag_top128(quot, nlen, &bamboo_pow5[2 * (q - POW5_MIN_EXP)]);
+	}
+}
+
+/**
+ * Counts the leading zero bits of a 32-bit limb.
+ *
+ * @param  limb Limb to be checked. Must not be zero.
+ * @return      Number of leading zero bits.
+ */
+uint8_t mag_clz(uint32_t limb) {
+	uint8_t n = 0;
+
+	while ((limb & 0x80000000u) == 0) {
+		limb <<= 1;
+		n++;
+	}
+
+	return n;
+}
+
+/**
+ * Gets the 128 most significant bits of a magnitude, truncating the rest or
+ * padding it with zeros.
+ *
+ * @param a   Magnitude.
+ * @param len Number of significant limbs in the magnitude.
+ * @param r   Array of two 64-bit words that will hold the upper and lower
+ *            halves of the result.
+ */
+void mag_top128(const uint32_t *a, size_t len, uint64_t *r) {
+	ptrdiff_t bit;
+	size_t i;
+
+	r[0] = 0;
+	r[1] = 0;
+	bit = (ptrdiff_t)((len * 32) - mag_clz(a[len - 1])) - 1;
+	for (i = 0; i < 128; i++, bit--) {
+		uint64_t b = 0;
+
+		if (bit >= 0)
+			b = (a[bit / 32] >> (bit % 32)) & 1;
+		r[i / 64] |= b << (63 - (i % 64));
+	}
+}
+
+/**
+ * Converts a decimal number into a double using the Eisel-Lemire algorithm.
+ *
+ * @param  mant  Significant digits of the number. At most 19 digits and not
+ *               zero.
+ * @param  exp10 Power of ten that multiplies the significant digits.
+ * @param  num   Pointer to the variable that will hold the converted number.
+ * @return       TRUE if the conversion was successful. FALSE if the number
+ *               would overflow or be subnormal.
+ */
+bool eisel_lemire(uint64_t mant, int exp10, double *num) {
+	const uint64_t *pow5;
+	uint64_t bits;
+	uint64_t hi;
+	uint64_t lo;
+	uint8_t upper;
+	uint8_t lz;
+	int power2;
+
+	// Make sure we are within the range of our table.
+	if ((exp10 < POW5_MIN_EXP) || (exp10 > POW5_MAX_EXP))
+		return false;
+
+	// Normalize the digits and multiply them by the power of five.
+	for (lz = 0; (mant & ((uint64_t)1 << 63)) == 0; lz++)
+		mant <<= 1;
+	pow5 = &bamboo_pow5[2 * (exp10 - POW5_MIN_EXP)];
+	lo = mul_64x64(mant, pow5[0], &hi);
+	if ((hi & 0x1FF) == 0x1FF) {
+		uint64_t hi2;
+
+		// Not enough precision, use the lower half of the power as well.
+		mul_64x64(mant, pow5[1], &hi2);
+		lo += hi2;
+		if (hi2 > lo)
+			hi++;
+	}
+
+	// Get the 54 most significant bits and the binary exponent.
+	upper = (uint8_t)(hi >> 63);
+	bits = hi >> (upper + 9);
+	power2 = (exp10 >= 0) ? ((217706 * exp10) >> 16) :
+		-((-217706 * exp10 + 65535) >> 16);
+	power2 += 63 + upper - lz + 1023;
+	if (power2 <= 0)
+		return false;
+
+	// Round to nearest, ties to even, taking care with exact halfway cases.
+	if ((lo <= 1) && (exp10 >= -4) && (exp10 <= 23) && ((bits & 3) == 1) &&
+			((bits << (upper + 9)) == hi)) {
+		bits &= ~(uint64_t)1;
+	}
+	bits += bits & 1;
+	bits >>= 1;
+	if (bits >= ((uint64_t)2 << 52)) {
+		bits = (uint64_t)1 << 52;
+		power2++;
+	}
+	if (power2 >= 0x7FF)
+		return false;
+
+	// Assemble the double.
+	bits &= ~((uint64_t)1 << 52);
+	bits |= (uint64_t)power2 << 52;
+	memcpy(num, &bits, sizeof(double));
+
+	return true;
+}
+
+/**
+ * Multiplies two extended floats, rounding the result.
+ *
+ * @param  x First factor.
+ * @param  y Second factor.
+ * @return   Product of both numbers.
+ */
+diyfp_t diyfp_mul(diyfp_t x, diyfp_t y) {
+	diyfp_t r;
+	uint64_t lo;
+
+	lo = mul_64x64(x.f, y.f, &r.f);
+	r.f += lo >> 63;
+	r.e = x.e + y.e + 64;
+
+	return r;
+}
+
+/**
+ * Shifts an extended float so that its most significant bit is set.
+ *
+ * @param  x Extended float to be normalized.
+ * @return   Normalized extended float.
+ */
+diyfp_t diyfp_normalize(diyfp_t x) {
+	while ((x.f >> 63) == 0) {
+		x.f <<= 1;
+		x.e--;
+	}
+
+	return x;
+}
+
+/**
+ * Generates the shortest digits within the boundaries of a number, as part of
+ * the Grisu2 algorithm.
+ *
+ * @param  digits  Buffer that will hold the digits.
+ * @param  dec_exp Pointer to the decimal exponent to be adjusted.
+ * @param  low     Scaled lower boundary.
+ * @param  w       Scaled number.
+ * @param  high    Scaled upper boundary.
+ * @return         Number of digits generated.
+ */
+size_t grisu2_digits(TCHAR *digits, int *dec_exp, diyfp_t low, diyfp_t w,
+					 diyfp_t high) {
+	uint64_t delta = high.f - low.f;
+	uint64_t dist = high.f - w.f;
+	uint64_t one = (uint64_t)1 << -high.e;
+	uint64_t rest;
+	uint64_t unit;
+	uint32_t p1 = (uint32_t)(high.f >> -high.e);
+	uint64_t p2 = high.f & (one - 1);
+	uint32_t pow10;
+	size_t len = 0;
+	int n;
+
+	// Find the largest power of ten that fits the integral part.
+	for (n = 1, pow10 = 1; (n < 10) && ((pow10 * 10) <= p1); n++)
+		pow10 *= 10;
+
+	// Generate the digits of the integral part.
+	while (n > 0) {
+		digits[len++] = (TCHAR)(_T('0') + (p1 / pow10));
+		p1 %= pow10;
+		n--;
+
+		// Are we within the boundaries already?
+		rest = ((uint64_t)p1 << -high.e) + p2;
+		if (rest <= delta) {
+			*dec_exp += n;
+			unit = (uint64_t)pow10 << -high.e;
+			goto round;
+		}
+
+		pow10 /= 10;
+	}
+
+	// Generate the digits of the fractional part.
+	n = 0;
+	for (;;) {
+		p2 *= 10;
+		digits[len++] = (TCHAR)(_T('0') + (p2 >> -high.e));
+		p2 &= one - 1;
+		n++;
+
+		delta *= 10;
+		dist *= 10;
+		if (p2 <= delta)
+			break;
+	}
+	*dec_exp -= n;
+	rest = p2;
+	unit = one;
+
+round:
+	// Move the last digit closer to the actual number.
+	while ((rest < dist) && ((delta - rest) >= unit) &&
+			(((rest + unit) < dist) || ((dist - rest) > (rest + unit - dist)))) {
+		digits[len - 1]--;
+		rest += unit;
+	}
+
+	return len;
+}
+
+/**
+ * Gets the shortest digits of a double using the Grisu2 algorithm, which
+ * always round-trips and is the shortest in the vast majority of cases.
+ *
+ * @param  value   Positive, finite and non-zero number.
+ * @param  digits  Buffer that will hold the digits.
+ * @param  dec_exp Pointer to the variable that will hold the power of ten that
+ *                 multiplies the digits.
+ * @return         Number of digits.
+ */
+size_t grisu2(double value, TCHAR *digits, int *dec_exp) {
+	const cached_pow_t *cached;
+	diyfp_t v;
+	diyfp_t plus;
+	diyfp_t minus;
+	diyfp_t c;
+	uint64_t bits;
+	uint64_t frac;
+	int exp;
+	int k;
+
+	// Decompose the double.
+	memcpy(&bits, &value, sizeof(double));
+	exp = (int)(bits >> 52);
+	frac = bits & (((uint64_t)1 << 52) - 1);
+	if (exp == 0) {
+		v.f = frac;
+		v.e = 1 - 1075;
+	} else {
+		v.f = frac | ((uint64_t)1 << 52);
+		v.e = exp - 1075;
+	}
+
+	// Get the boundaries halfway to the neighbouring doubles.
+	plus.f = (2 * v.f) + 1;
+	plus.e = v.e - 1;
+	plus = diyfp_normalize(plus);
+	if ((frac == 0) && (exp > 1)) {
+		minus.f = (4 * v.f) - 1;
+		minus.e = v.e - 2;
+	} else {
+		minus.f = (2 * v.f) - 1;
+		minus.e = v.e - 1;
+	}
+	minus.f <<= minus.e - plus.e;
+	minus.e = plus.e;
+	v = diyfp_normalize(v);
+
+	// Get a cached power of ten that brings the exponent within range.
+	k = GRISU_ALPHA - plus.e - 1;
+	k = ((k * 78913) / (1 << 18)) + (k > 0);
+	cached = &bamboo_grisu_pows[(GRISU_CACHED_MIN_EXP10 + k + 7) / 8];
+	c.f = cached->f;
+	c.e = cached->e;
+
+	// Scale everything and generate the digits.
+	v = diyfp_mul(v, c);
+	minus = diyfp_mul(minus, c);
+	plus = diyfp_mul(plus, c);
+	minus.f++;
+	plus.f--;
+	*dec_exp = -cached->k;
+
+	return grisu2_digits(digits, dec_exp, minus, v, plus);
+}
+#endif  // BAMBOO_USE_DOUBLE
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                  Strings                                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Wraps a string structure in a garbage collected atom.
+ *
+ * @param  string String structure to be owned by the garbage collector.
+ * @return        String atom.
+ */
+atom_t string_atom(string_t *string) {
+	allocation_t *alloc;
+	atom_t atom;
+
+	// Create a new allocation.
+	alloc = (allocation_t *)malloc(sizeof(allocation_t));
+	if (alloc == NULL) {
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate structure for ")
+			_T("garbage collector string allocation tracking"));
+		return nil;
+	}
+
+	// Fill up the new allocation and push the linked list forward.
+	alloc->mark = GC_TO_FREE;
+	alloc->type = ALLOCATION_TYPE_STRING;
+	alloc->data.string = string;
+	alloc->next = bamboo_ctx->allocations;
+	bamboo_ctx->allocations = alloc;
+
+	// Create the new string atom.
+	atom.type = ATOM_TYPE_STRING;
+	atom.value.str = &alloc->data.string;
+
+	return atom;
+}
+
+/**
+ * Allocates a string structure with its characters stored right after the
+ * header, so that the whole thing takes a single allocation.
+ *
+ * @param  len Number of characters the string will hold.
+ * @return     String structure with its characters ready to be filled in and
+ *             already terminated, or NULL if the allocation failed.
+ */
+string_t *string_alloc(size_t len) {
+	string_t *string;
+	TCHAR *chars;
+
+	string = (string_t *)malloc(sizeof(string_t) + ((len + 1) * sizeof(TCHAR)));
+	if (string == NULL)
+		return NULL;
+
+	chars = (TCHAR *)(string + 1);
+	chars[len] = _T('\0');
+	string->chars = chars;
+	string->len = len;
+	string->hash = 0;
+	string->parent = NULL;
+	string->buf = NULL;
+
+	return string;
+}
+
+/**
+ * Builds a string atom that takes ownership of an already allocated buffer,
+ * avoiding a copy.
+ *
+ * @param  buf Terminated string buffer allocated with malloc. Will be free'd
+ *             by the garbage collector.
+ * @param  len Length of the string in characters.
+ * @return     String atom.
+ */
+atom_t string_take(TCHAR *buf, size_t len) {
+	string_t *string;
+
+	// Allocate the string header.
+	string = (string_t *)calloc(1, sizeof(string_t));
+	if (string == NULL) {
+		free(buf);
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate string ")
+			_T("header"));
+		return nil;
+	}
+	string->chars = buf;
+	string->len = len;
+	string->buf = buf;
+
+	return string_atom(string);
+}
+
+/**
+ * Builds a string atom that references a slice of the characters of another
+ * string without copying them.
+ *
+ * @param  atom  String atom to take the slice from.
+ * @param  start Index of the first character of the slice.
+ * @param  len   Length of the slice in characters.
+ * @return       String atom of the slice.
+ */
+atom_t string_view(atom_t atom, size_t start, size_t len) {
+	string_t *parent = *atom.value.str;
+	string_t *string;
+
+	// Slicing the whole thing is the same as the string itself.
+	if ((start == 0) && (len == parent->len))
+		return atom;
+
+	// Allocate the string header.
+	string = (string_t *)calloc(1, sizeof(string_t));
+	if (string == NULL) {
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate substring ")
+			_T("header"));
+		return nil;
+	}
+	string->chars = parent->chars + start;
+	string->len = len;
+
+	// Always reference the string that actually owns the characters.
+	string->parent = (parent->parent != NULL) ? parent->parent : atom.value.str;
+
+	return string_atom(string);
+}
+
+/**
+ * Gets the value of a hexadecimal digit.
+ *
+ * @param  c Character to be converted.
+ * @return   Value of the digit or -1 if it isn't a hexadecimal digit.
+ */
+int hex_digit(TCHAR c) {
+	if ((c >= _T('0')) && (c <= _T('9')))
+		return c - _T('0');
+	if ((c >= _T('a')) && (c <= _T('f')))
+		return c - _T('a') + 10;
+	if ((c >= _T('A')) && (c <= _T('F')))
+		return c - _T('A') + 10;
+
+	return -1;
+}
+
+/**
+ * Encodes a Unicode code point in the native character encoding, which is
+ * UTF-8 for narrow strings and UTF-16 or UTF-32 for wide ones.
+ *
+ * @param  buf Buffer that will hold the encoded code point. Must have room for
+ *             4 narrow or 2 wide characters.
+ * @param  cp  Code point to be encoded.
+ * @return     Number of characters written to the buffer.
+ */
+size_t encode_codepoint(TCHAR *buf, uint32_t cp) {
+#ifdef UNICODE
+	// Use a surrogate pair when the code point doesn't fit.
+	if ((sizeof(TCHAR) == 2) && (cp > 0xFFFF)) {
+		cp -= 0x10000;
+		buf[0] = (TCHAR)(0xD800 | (cp >> 10));
+		buf[1] = (TCHAR)(0xDC00 | (cp & 0x3FF));
+
+		return 2;
+	}
+
+	buf[0] = (TCHAR)cp;
+	return 1;
+#else
+	if (cp < 0x80) {
+		buf[0] = (TCHAR)cp;
+		return 1;
+	} else if (cp < 0x800) {
+		buf[0] = (TCHAR)(0xC0 | (cp >> 6));
+		buf[1] = (TCHAR)(0x80 | (cp & 0x3F));
+		return 2;
+	} else if (cp < 0x10000) {
+		buf[0] = (TCHAR)(0xE0 | (cp >> 12));
+		buf[1] = (TCHAR)(0x80 | ((cp >> 6) & 0x3F));
+		buf[2] = (TCHAR)(0x80 | (cp & 0x3F));
+		return 3;
+	}
+
+	buf[0] = (TCHAR)(0xF0 | (cp >> 18));
+	buf[1] = (TCHAR)(0x80 | ((cp >> 12) & 0x3F));
+	buf[2] = (TCHAR)(0x80 | ((cp >> 6) & 0x3F));
+	buf[3] = (TCHAR)(0x80 | (cp & 0x3F));
+	return 4;
+#endif  // UNICODE
+}
+
+/**
+ * Gets the hash of a string, calculating it only the first time around.
+ *
+ * @param  string String to get the hash of.
+ * @return        FNV-1a hash of the characters of the string. Never zero.
+ */
+uint32_t string_hash(string_t *string) {
+	uint32_t hash;
+	size_t i;
+
+	// Have we calculated this before?
+	if (string->hash != 0)
+		return string->hash;
+
+	hash = 2166136261u;
+	for (i = 0; i < string->len; i++) {
+		hash ^= (uint32_t)string->chars[i];
+		hash *= 16777619u;
+	}
+
+	// Zero means we haven't calculated the hash yet.
+	string->hash = (hash != 0) ? hash : 1;
+	return string->hash;
+}
+
+/**
+ * Checks if two strings have the same characters.
+ *
+ * @param  a First string.
+ * @param  b Second string.
+ * @return   TRUE if both strings are equal.
+ */
+bool string_equal(string_t *a, string_t *b) {
+	// Try to get away without comparing any characters.
+	if (a->len != b->len)
+		return false;
+	if ((a->chars == b->chars) || (a->len == 0))
+		return true;
+	if ((a->hash != 0) && (b->hash != 0) && (a->hash != b->hash))
+		return false;
+
+	return memcmp(a->chars, b->chars, a->len * sizeof(TCHAR)) == 0;
+}
+
+/**
+ * Gets a terminated C string of a string atom. Substring views that aren't
+ * terminated get their characters copied over the first time around.
+ *
+ * @param  atom String atom.
+ * @return      Terminated string, or NULL if the atom isn't a string.
+ */
+const TCHAR *bamboo_string_cstr(atom_t atom) {
+	string_t *string;
+	TCHAR *buf;
+
+	// Make sure we are dealing with a string.
+	if (atom.type != ATOM_TYPE_STRING)
+		return NULL;
+
+	// Owned characters and views that go to the end are already terminated.
+	string = *atom.value.str;
+	if (string->chars[string->len] == _T('\0'))
+		return string->chars;
+
+	// Detach the view from its parent.
+	buf = (TCHAR *)malloc((string->len + 1) * sizeof(TCHAR));
+	if (buf == NULL) {
+		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate terminated ")
+			_T("copy of substring"));
+		return NULL;
+	}
+	memcpy(buf, string->chars, string->len * sizeof(TCHAR));
+	buf[string->len] = _T('\0');
+	string->chars = buf;
+	string->buf = buf;
+	string->parent = NULL;
+
+	return buf;
+}
+
+/**
+ * Gets a character index from an atom and checks if it's within bounds.
+ *
+ * @param  atom  Integer atom with the index.
+ * @param  max   Maximum value that the index is allowed to have.
+ * @param  index Pointer to the variable that will hold the index.
+ * @return       BAMBOO_OK if the index is valid.
+ */
+bamboo_error_t string_index_arg(atom_t atom, size_t max, size_t *index) {
+	if (atom.type != ATOM_TYPE_INTEGER) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("String indexes must be integers"));
+	}
+	if ((atom.value.integer < 0) || ((uint64_t)atom.value.integer > max)) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("String index out of bounds"));
+	}
+
+	*index = (size_t)atom.value.integer;
+	return BAMBOO_OK;
+}
+
+/**
+ * Initializes a string builder.
+ *
+ * @param  sb  String builder to be initialized.
+ * @param  cap Initial capacity in characters, excluding the terminator.
+ * @return     BAMBOO_OK if the buffer was allocated.
+ */
+bamboo_error_t strbuf_init(strbuf_t *sb, size_t cap) {
+	sb->len = 0;
+	sb->cap = (cap > 0) ? cap : STRBUF_MIN_CAP;
+	sb->buf = (TCHAR *)malloc((sb->cap + 1) * sizeof(TCHAR));
+	if (sb->buf == NULL) {
+		sb->cap = 0;
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+			_T("string builder buffer"));
+	}
+
+	sb->buf[0] = _T('\0');
+	return BAMBOO_OK;
+}
+
+/**
+ * Makes sure a string builder has room for a number of extra characters,
+ * growing it geometrically so that appending stays linear.
+ *
+ * @param  sb    String builder.
+ * @param  extra Number of characters that are about to be appended.
+ * @return       BAMBOO_OK if there's enough room.
+ */
+bamboo_error_t strbuf_reserve(strbuf_t *sb, size_t extra) {
+	TCHAR *buf;
+	size_t cap;
+
+	// Do we have enough room already?
+	if ((sb->len + extra) <= sb->cap)
+		return BAMBOO_OK;
+
+	// Grow the buffer.
+	cap = (sb->cap > 0) ? sb->cap : STRBUF_MIN_CAP;
+	while (cap < (sb->len + extra))
+		cap *= 2;
+	buf = (TCHAR *)realloc(sb->buf, (cap + 1) * sizeof(TCHAR));
+	if (buf == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't grow ")
+			_T("string builder buffer"));
+	}
+
+	sb->buf = buf;
+	sb->cap = cap;
+	return BAMBOO_OK;
+}
+
+/**
+ * Appends characters to a string builder.
+ *
+ * @param  sb  String builder.
+ * @param  str Characters to be appended.
+ * @param  len Number of characters to append.
+ * @return     BAMBOO_OK if everything went fine.
+ */
+bamboo_error_t strbuf_append(strbuf_t *sb, const TCHAR *str, size_t len) {
+	bamboo_error_t err;
+
+	err = strbuf_reserve(sb, len);
+	IF_ERROR(err)
+		return err;
+
+	memcpy(sb->buf + sb->len, str, len * sizeof(TCHAR));
+	sb->len += len;
+	sb->buf[sb->len] = _T('\0');
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Hands the contents of a string builder over to a new string atom. The
+ * builder must not be used afterwards.
+ *
+ * @param  sb String builder.
+ * @return    String atom with the contents of the builder.
+ */
+atom_t strbuf_to_string(strbuf_t *sb) {
+	atom_t atom;
+
+	// Give back any excess capacity before handing the buffer over.
+	if (sb->cap > (sb->len * 2)) {
+		TCHAR *buf = (TCHAR *)realloc(sb->buf, (sb->len + 1) * sizeof(TCHAR));
+		if (buf != NULL)
+			sb->buf = buf;
+	}
+
+	atom = string_take(sb->buf, sb->len);
+	sb->buf = NULL;
+	sb->len = 0;
+	sb->cap = 0;
+
+	return atom;
+}
+
+/**
+ * Frees up the contents of a string builder.
+ *
+ * @param sb String builder.
+ */
+void strbuf_free(strbuf_t *sb) {
+	free(sb->buf);
+	sb->buf = NULL;
+	sb->len = 0;
+	sb->cap = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                             Built-in Functions                             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// (car pair) -> atom
+bamboo_error_t builtin_car(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
+
+	// Get the first element of a pair otherwise just return nil.
+	if (car(args).type == ATOM_TYPE_PAIR) {
+		*result = car(car(args));
+	} else {
+		*result = nil;
+	}
+
+	return BAMBOO_OK;
+}
+
+// (cdr pair) -> atom
+bamboo_error_t builtin_cdr(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
+
+	// Get the second element of a pair otherwise just return nil.
+	if (car(args).type == ATOM_TYPE_PAIR) {
+		*result = cdr(car(args));
+	} else {
+		*result = nil;
+	}
+
+	return BAMBOO_OK;
+}
+
+// (cons car cdr) -> pair
+bamboo_error_t builtin_cons(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 2 arguments"));
+	}
+
+	// Create the pair.
+	*result = cons(car(args), car(cdr(args)));
+	return BAMBOO_OK;
+}
+
+// (+ nums...) -> num
+bamboo_error_t builtin_sum(atom_t args, atom_t *result) {
+	return numeric_fold(NUMERIC_OP_SUM, args, result);
+}
+
+// (- nums...) -> num
+bamboo_error_t builtin_subtract(atom_t args, atom_t *result) {
+	return numeric_fold(NUMERIC_OP_SUBTRACT, args, result);
+}
+
+// (* nums...) -> num
+bamboo_error_t builtin_multiply(atom_t args, atom_t *result) {
+	return numeric_fold(NUMERIC_OP_MULTIPLY, args, result);
+}
+
+// (/ nums...) -> num
+bamboo_error_t builtin_divide(atom_t args, atom_t *result) {
+	bamboo_float_t num;
+	bamboo_float_t divisor;
+
+	// Check if we have the right number of arguments.
+	if (nilp(args) || nilp(cdr(args))) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects at least 2 arguments"));
+	}
+
+	// Get the dividend.
+	if (!atom_float_val(car(args), &num))
+		goto wrong_type;
+	args = cdr(args);
+
+	// Iterate through the arguments dividing them.
+	while (!nilp(args)) {
+		if (!atom_float_val(car(args), &divisor))
+			goto wrong_type;
+		num /= divisor;
+
+		// Go to the next argument.
+		args = cdr(args);
+	}
+
+	// Return the result atom.
+	*result = bamboo_float(num);
+	return BAMBOO_OK;
+
+wrong_type:
+	// Non-numeric argument.
+	return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+		_T("Invalid type of argument. This function only accepts ")
+		_T("numerics"));
+}
+
+// (expt x y) -> num
+bamboo_error_t builtin_expt(atom_t args, atom_t *result) {
+	bamboo_float_t nx;
+	bamboo_float_t ny;
+
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 2 arguments"));
+	}
+
+	// Integer powers stay exact, squaring and multiplying as we go.
+	if (INTEGRAL_P(car(args)) &&
+			(car(cdr(args)).type == ATOM_TYPE_INTEGER) &&
+			(car(cdr(args)).value.integer >= 0)) {
+		bamboo_error_t err;
+		atom_t base;
+		int64_t exp;
+
+		base = car(args);
+		exp = car(cdr(args)).value.integer;
+		*result = bamboo_int(1);
+		while (exp > 0) {
+			if (exp & 1) {
+				err = numeric_binop(NUMERIC_OP_MULTIPLY, *result, base, result);
+				IF_ERROR(err)
+					return err;
+			}
+
+			exp >>= 1;
+			if (exp > 0) {
+				err = numeric_binop(NUMERIC_OP_MULTIPLY, base, base, &base);
+				IF_ERROR(err)
+					return err;
+			}
+		}
+
+		return BAMBOO_OK;
+	}
+
+	// Get the arguments.
+	if (!atom_float_val(car(args), &nx) ||
+			!atom_float_val(car(cdr(args)), &ny)) {
+		// Doesn't look like a numeric to me...
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts ")
+			_T("numerics"));
+	}
+
+	// Set the result atom.
+	*result = bamboo_float(FLOAT_POW(nx, ny));
+	return BAMBOO_OK;
+}
+
+// (modulo x y) -> num
+bamboo_error_t builtin_modulo(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	atom_t zero;
+	atom_t y;
+
+	// Get the remainder, which has the sign of the dividend.
+	err = builtin_remainder(args, result);
+	IF_ERROR(err)
+		return err;
+
+	// Make the result have the same sign as the divisor.
+	y = car(cdr(args));
+	zero = bamboo_int(0);
+	if (result->type == ATOM_TYPE_FLOAT) {
+		bamboo_float_t fy;
+
+		(void)atom_float_val(y, &fy);
+		if ((result->value.dfloat != 0) &&
+				((result->value.dfloat < 0) != (fy < 0))) {
+			result->value.dfloat += fy;
+		}
+	} else if ((bignum_cmp(*result, zero) != 0) &&
+			((bignum_cmp(*result, zero) < 0) != (bignum_cmp(y, zero) < 0))) {
+		return numeric_binop(NUMERIC_OP_SUM, *result, y, result);
+	}
+
+	return BAMBOO_OK;
+}
+
+// (quotient x y) -> num
+bamboo_error_t builtin_quotient(atom_t args, atom_t *result) {
+	bamboo_float_t fx;
+	bamboo_float_t fy;
+
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 2 arguments"));
+	}
+
+	// Integers stay exact.
+	if (INTEGRAL_P(car(args)) && INTEGRAL_P(car(cdr(args))))
+		return bignum_divmod(car(args), car(cdr(args)), result, NULL);
+
+	// Do it with floats then.
+	if (!atom_float_val(car(args), &fx) ||
+			!atom_float_val(car(cdr(args)), &fy)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts ")
+			_T("numerics"));
+	}
+	*result = bamboo_float(FLOAT_TRUNC(fx / fy));
+
+	return BAMBOO_OK;
+}
+
+// (mod x y) -> num
+// (remainder x y) -> num
+bamboo_error_t builtin_remainder(atom_t args, atom_t *result) {
+	bamboo_float_t fx;
+	bamboo_float_t fy;
+
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 2 arguments"));
+	}
+
+	// Integers stay exact.
+	if (INTEGRAL_P(car(args)) && INTEGRAL_P(car(cdr(args))))
+		return bignum_divmod(car(args), car(cdr(args)), NULL, result);
+
+	// Do it with floats then.
+	if (!atom_float_val(car(args), &fx) ||
+			!atom_float_val(car(cdr(args)), &fy)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts ")
+			_T("numerics"));
+	}
+	*result = bamboo_float(FLOAT_FMOD(fx, fy));
+
+	return BAMBOO_OK;
+}
+
+// (gcd ints...) -> int
+bamboo_error_t builtin_gcd(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+
+	// The greatest common divisor of nothing is zero.
+	*result = bamboo_int(0);
+
+	// Go through the arguments using Euclid's algorithm.
+	while (!nilp(args)) {
+		atom_t a = *result;
+		atom_t b = car(args);
+
+		if (!INTEGRAL_P(b)) {
+			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+				_T("Invalid type of argument. This function only accepts ")
+				_T("integers"));
+		}
+
+		while (bignum_cmp(b, bamboo_int(0)) != 0) {
+			atom_t rem;
+
+			err = bignum_divmod(a, b, NULL, &rem);
+			IF_ERROR(err)
+				return err;
+
+			a = b;
+			b = rem;
+		}
+		*result = a;
+
+		args = cdr(args);
+	}
+
+	// Make sure we always return a positive number.
+	return number_abs(*result, result);
+}
+
+// (lcm ints...) -> int
+bamboo_error_t builtin_lcm(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+
+	// The least common multiple of nothing is one.
+	*result = bamboo_int(1);
+
+	// Go through the arguments accumulating them.
+	while (!nilp(args)) {
+		atom_t gcd;
+		atom_t b;
+
+		// Get the absolute value of the argument.
+		if (!INTEGRAL_P(car(args))) {
+			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+				_T("Invalid type of argument. This function only accepts ")
+				_T("integers"));
+		}
+		err = number_abs(car(args), &b);
+		IF_ERROR(err)
+			return err;
+
+		// Anything with a zero in it is zero.
+		if (bignum_cmp(b, bamboo_int(0)) == 0) {
+			*result = b;
+			return BAMBOO_OK;
+		}
+
+		// lcm(a, b) = (a / gcd(a, b)) * b
+		err = builtin_gcd(cons(*result, cons(b, nil)), &gcd);
+		IF_ERROR(err)
+			return err;
+		err = bignum_divmod(*result, gcd, result, NULL);
+		IF_ERROR(err)
+			return err;
+		err = numeric_binop(NUMERIC_OP_MULTIPLY, *result, b, result);
+		IF_ERROR(err)
+			return err;
+
+		args = cdr(args);
+	}
+
+	return BAMBOO_OK;
+}
+
+// (abs x) -> num
+bamboo_error_t builtin_abs(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
+
+	return number_abs(car(args), result);
+}
+
+// (min nums...) -> num
+bamboo_error_t builtin_min(atom_t args, atom_t *result) {
+	return numeric_extreme(NUMERIC_OP_LT, args, result);
+}
+
+// (max nums...) -> num
+bamboo_error_t builtin_max(atom_t args, atom_t *result) {
+	return numeric_extreme(NUMERIC_OP_GT, args, result);
+}
+
+// (exact->inexact x) -> float
+bamboo_error_t builtin_exact_inexact(atom_t args, atom_t *result) {
+	return float_func(args, FLOAT_FUNC_IDENTITY, result);
+}
+
+// (sqrt x) -> num
+bamboo_error_t builtin_sqrt(atom_t args, atom_t *result) {
+	// Perfect squares of integers stay exact.
+	if (!nilp(args) && (car(args).type == ATOM_TYPE_INTEGER) &&
+			(car(args).value.integer >= 0) && nilp(cdr(args))) {
+		int64_t x = car(args).value.integer;
+		int64_t root = (int64_t)FLOAT_SQRT((bamboo_float_t)x);
+
+		// Correct any rounding errors from the float square root.
+		while ((root > 0) && (root > (x / root)))
+			root--;
+		while (((root + 1) <= (x / (root + 1))))
+			root++;
+
+		if ((root * root) == x) {
+			*result = bamboo_int(root);
+			return BAMBOO_OK;
+		}
+	}
+
+	// So do perfect squares of big integers.
+	if (!nilp(args) && (car(args).type == ATOM_TYPE_BIGNUM) &&
+			!(*car(args).value.bignum)->negative && nilp(cdr(args))) {
+		bamboo_error_t err;
+		atom_t square;
+		atom_t root;
+
+		err = bignum_isqrt(car(args), &root);
+		IF_ERROR(err)
+			return err;
+		err = bignum_binop(NUMERIC_OP_MULTIPLY, root, root, &square);
+		IF_ERROR(err)
+			return err;
+
+		if (bignum_cmp(square, car(args)) == 0) {
+			*result = root;
+			return BAMBOO_OK;
+		}
+	}
+
+	return float_func(args, FLOAT_FUNC_SQRT, result);
+}
+
+// (exp x) -> float
+bamboo_error_t builtin_exp(atom_t args, atom_t *result) {
+	return float_func(args, FLOAT_FUNC_EXP, result);
+}
+
+// (log x [base]) -> float
+bamboo_error_t builtin_log(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	bamboo_float_t base;
+
+	// Natural logarithm.
+	if (nilp(args) || nilp(cdr(args)))
+		return float_func(args, FLOAT_FUNC_LOG, result);
+
+	// Check if we have the right number of arguments.
+	if (!nilp(cdr(cdr(args)))) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 or 2 arguments"));
+	}
+
+	// Logarithm in an arbitrary base.
+	err = float_func(cons(car(args), nil), FLOAT_FUNC_LOG, result);
+	IF_ERROR(err)
+		return err;
+	if (!atom_float_val(car(cdr(args)), &base)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts ")
+			_T("numerics"));
+	}
+	result->value.dfloat /= FLOAT_LOG(base);
+
+	return BAMBOO_OK;
+}
+
+// (sin x) -> float
+bamboo_error_t builtin_sin(atom_t args, atom_t *result) {
+	return float_func(args, FLOAT_FUNC_SIN, result);
+}
+
+// (cos x) -> float
+bamboo_error_t builtin_cos(atom_t args, atom_t *result) {
+	return float_func(args, FLOAT_FUNC_COS, result);
+}
+
+// (atan y [x]) -> float
+bamboo_error_t builtin_atan(atom_t args, atom_t *result) {
+	bamboo_float_t y;
+	bamboo_float_t x;
+
+	// Single argument arc tangent.
+	if (nilp(args) || nilp(cdr(args)))
+		return float_func(args, FLOAT_FUNC_ATAN, result);
+
+	// Check if we have the right number of arguments.
+	if (!nilp(cdr(cdr(args)))) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 or 2 arguments"));
+	}
+
+	// Arc tangent of y/x using the signs to determine the quadrant.
+	if (!atom_float_val(car(args), &y) ||
+			!atom_float_val(car(cdr(args)), &x)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts ")
+			_T("numerics"));
+	}
+	*result = bamboo_float(FLOAT_ATAN2(y, x));
+
+	return BAMBOO_OK;
+}
+
+// (floor x) -> int
+bamboo_error_t builtin_floor(atom_t args, atom_t *result) {
+	*result = nil;
+
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
+
+	// Round the number.
+	result->type = ATOM_TYPE_INTEGER;
+	if (INTEGRAL_P(car(args))) {
+		// Number is already an integer.
+		*result = car(args);
+		return BAMBOO_OK;
+	} else if (car(args).type == ATOM_TYPE_FLOAT) {
+		// Number is an float.
+		result->value.integer = (int64_t)FLOAT_FLOOR(car(args).value.dfloat);
+		return BAMBOO_OK;
+	}
+
+	// Doesn't look like a numeric to me...
+	*result = nil;
+	return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+		_T("Invalid type of argument. This function only accepts ")
+		_T("numerics"));
+}
+
+// (round x) -> int
+bamboo_error_t builtin_round(atom_t args, atom_t *result) {
+	*result = nil;
+
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
+
+	// Round the number.
+	result->type = ATOM_TYPE_INTEGER;
+	if (INTEGRAL_P(car(args))) {
+		// Number is already an integer.
+		*result = car(args);
+		return BAMBOO_OK;
+	} else if (car(args).type == ATOM_TYPE_FLOAT) {
+		// Number is an float.
+		result->value.integer = (int64_t)FLOAT_ROUND(car(args).value.dfloat);
+		return BAMBOO_OK;
+	}
+
+	// Doesn't look like a numeric to me...
+	*result = nil;
+	return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+		_T("Invalid type of argument. This function only accepts ")
+		_T("numerics"));
+}
+
+// (ceil x) -> int
+bamboo_error_t builtin_ceil(atom_t args, atom_t *result) {
+	*result = nil;
+
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
+
+	// Round the number.
+	result->type = ATOM_TYPE_INTEGER;
+	if (INTEGRAL_P(car(args))) {
+		// Number is already an integer.
+		*result = car(args);
+		return BAMBOO_OK;
+	} else if (car(args).type == ATOM_TYPE_FLOAT) {
+		// Number is an float.
+		result->value.integer = (int64_t)FLOAT_CEIL(car(args).value.dfloat);
+		return BAMBOO_OK;
+	}
+
+	// Doesn't look like a numeric to me...
+	*result = nil;
+	return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+		_T("Invalid type of argument. This function only accepts ")
+		_T("numerics"));
+}
+
+// (not bool) -> bool
+bamboo_error_t builtin_not(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects exactly 1 argument"));
+	}
+
+	// Populate the result atom.
+	result->type = ATOM_TYPE_BOOLEAN;
+	result->value.boolean = !atom_boolean_val(car(args));
+
+	return BAMBOO_OK;
+}
+
+// (and bool...) -> bool
+bamboo_error_t builtin_and(atom_t args, atom_t *result) {
+	atom_t prev_atom;
+
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) < 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects at least 2 arguments"));
+	}
+
+	// Iterate through the arguments checking them.
+	prev_atom = car(args);
+	args = cdr(args);
+	while (!nilp(args)) {
+		// We only need a single false value.
+		if (atom_boolean_val(prev_atom) != atom_boolean_val(car(args))) {
+			*result = bamboo_boolean(false);
+			return BAMBOO_OK;
+		}
+
+		// Go to the next argument.
+		prev_atom = car(args);
+		args = cdr(args);
+	}
+
+	// Looks like they were all true all along.
+	*result = bamboo_boolean(true);
+	return BAMBOO_OK;
+}
+
+// (or bool...) -> bool
+bamboo_error_t builtin_or(atom_t args, atom_t *result) {
+	atom_t prev_atom;
+
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) < 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects at least 2 arguments"));
+	}
+
+	// Iterate through the arguments checking them.
+	prev_atom = car(args);
+	args = cdr(args);
+	while (!nilp(args)) {
+		// We only need a single true value.
+		if (atom_boolean_val(prev_atom) || atom_boolean_val(car(args))) {
+			*result = bamboo_boolean(true);
+			return BAMBOO_OK;
+		}
+
+		// Go to the next argument.
+		prev_atom = car(args);
+		args = cdr(args);
+	}
+
+	// Looks like they were all false all along.
+	*result = bamboo_boolean(false);
+	return BAMBOO_OK;
+}
+
+// (= nums...) -> bool
+bamboo_error_t builtin_numeq(atom_t args, atom_t *result) {
+	return numeric_compare_chain(NUMERIC_OP_EQ, args, result);
+}
+
+// (< nums...) -> bool
+bamboo_error_t builtin_lt(atom_t args, atom_t *result) {
+	return numeric_compare_chain(NUMERIC_OP_LT, args, result);
+}
+
+// (> nums...) -> bool
+bamboo_error_t builtin_gt(atom_t args, atom_t *result) {
+	return numeric_compare_chain(NUMERIC_OP_GT, args, result);
+}
+
+// (eq? a b) -> boolean
+bamboo_error_t builtin_eq(atom_t args, atom_t *result) {
+	atom_t a;
+	atom_t b;
+
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 2 arguments"));
+	}
+
+	// Get the two atoms to be tested.
+	a = car(args);
+	b = car(cdr(args));
+
+	// If the types are different then it's instantly different.
+	if (a.type != b.type) {
+		*result = bamboo_boolean(false);
+		return BAMBOO_OK;
+	}
+
+	// Check for more equality.
+	switch (a.type) {
+	case ATOM_TYPE_NIL:
+		*result = bamboo_boolean(true);
+		break;
+	case ATOM_TYPE_PAIR:
+	case ATOM_TYPE_CLOSURE:
+	case ATOM_TYPE_MACRO:
+	case ATOM_TYPE_CHANNEL:
+		*result = bamboo_boolean(a.value.pair == b.value.pair);
+		break;
+	case ATOM_TYPE_SYMBOL:
+		*result = bamboo_boolean(*a.value.symbol == *b.value.symbol);
+		break;
+	case ATOM_TYPE_STRING:
+		*result = bamboo_boolean(string_equal(*a.value.str, *b.value.str));
+		break;
+	case ATOM_TYPE_BOOLEAN:
+		*result = bamboo_boolean(a.value.boolean == b.value.boolean);
+		break;
+	case ATOM_TYPE_INTEGER:
+		*result = bamboo_boolean(a.value.integer == b.value.integer);
+		break;
+	case ATOM_TYPE_FLOAT:
+		*result = bamboo_boolean(a.value.dfloat == b.value.dfloat);
+		break;
+	case ATOM_TYPE_BUILTIN:
+		*result = bamboo_boolean(a.value.builtin == b.value.builtin);
+		break;
+	case ATOM_TYPE_POINTER:
+	case ATOM_TYPE_AUTOLOAD:
+		*result = bamboo_boolean(a.value.pointer == b.value.pointer);
+		break;
+	case ATOM_TYPE_VECTOR:
+		*result = bamboo_boolean(*a.value.vector == *b.value.vector);
+		break;
+	case ATOM_TYPE_BIGNUM:
+		*result = bamboo_boolean(bignum_cmp(a, b) == 0);
+		break;
+	}
+
+	return BAMBOO_OK;
+}
+
+// (nil? atom) -> boolean
+bamboo_error_t builtin_nilp(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
+
+	*result = bamboo_boolean(car(args).type == ATOM_TYPE_NIL);
+	return BAMBOO_OK;
+}
+
+// (pair? atom) -> boolean
+bamboo_error_t builtin_pairp(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
+
+	*result = bamboo_boolean(car(args).type == ATOM_TYPE_PAIR);
+	return BAMBOO_OK;
+}
+
+// (symbol? atom) -> boolean
+bamboo_error_t builtin_symbolp(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
+
+	*result = bamboo_boolean(car(args).type == ATOM_TYPE_SYMBOL);
+	return BAMBOO_OK;
+}
+
+// (integer? atom) -> boolean
+bamboo_error_t builtin_integerp(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
+
+	*result = bamboo_boolean(INTEGRAL_P(car(args)));
+	return BAMBOO_OK;
+}
+
+// (float? atom) -> boolean
+bamboo_error_t builtin_floatp(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
+
+	*result = bamboo_boolean(car(args).type == ATOM_TYPE_FLOAT);
+	return BAMBOO_OK;
+}
+
+// (numeric? atom) -> boolean
+bamboo_error_t builtin_numericp(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
+
+	*result = bamboo_boolean(INTEGRAL_P(car(args)) ||
+		(car(args).type == ATOM_TYPE_FLOAT));
+	return BAMBOO_OK;
+}
+
+// (boolean? atom) -> boolean
+bamboo_error_t builtin_booleanp(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
+
+	*result = bamboo_boolean(car(args).type == ATOM_TYPE_BOOLEAN);
+	return BAMBOO_OK;
+}
+
+// (builtin? atom) -> boolean
+bamboo_error_t builtin_builtinp(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
+
+	*result = bamboo_boolean(car(args).type == ATOM_TYPE_BUILTIN);
+	return BAMBOO_OK;
+}
+
+// (closure? atom) -> boolean
+bamboo_error_t builtin_closurep(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
+
+	*result = bamboo_boolean(car(args).type == ATOM_TYPE_CLOSURE);
+	return BAMBOO_OK;
+}
+
+// (macro? atom) -> boolean
+bamboo_error_t builtin_macrop(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
+
+	*result = bamboo_boolean(car(args).type == ATOM_TYPE_MACRO);
+	return BAMBOO_OK;
+}
+
+// (display any...) -> string
+// Since the printed text is also returned, all of it is built in memory as a
+// single string before being written out.
+bamboo_error_t builtin_display(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	sink_t sink;
+
+	// Build the concatenated string in a single pass.
+	err = builtin_concat(args, result);
+	IF_ERROR(err)
+		return err;
+
+	// Write it out in one go.
+	sink_stdout(&sink);
+	sink_write(&sink, (*result->value.str)->chars, (*result->value.str)->len);
+	sink_puts(&sink, LINEBREAK);
+
+	return BAMBOO_OK;
+}
+
+// (concat any...) -> string
+bamboo_error_t builtin_concat(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	sink_t sink;
+	strbuf_t sb;
+	atom_t arg;
+	size_t len;
+
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) < 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects at least 1 argument"));
+	}
+
+	// Estimate the length of the resulting string.
+	len = 0;
+	for (arg = args; !nilp(arg); arg = cdr(arg)) {
+		if (car(arg).type == ATOM_TYPE_STRING) {
+			len += (*car(arg).value.str)->len;
+		} else if (!nilp(car(arg))) {
+			len += STRBUF_NUM_MAX_LEN;
+		}
+	}
+
+	// Build up the string.
+	err = strbuf_init(&sb, len);
+	IF_ERROR(err)
+		return err;
+	sink.sb = &sb;
+	sink.fh = NULL;
+	for (arg = args; !nilp(arg); arg = cdr(arg))
+		print_display(&sink, car(arg));
+
+	*result = strbuf_to_string(&sb);
+	return BAMBOO_OK;
+}
+
+// (newline) -> nil
+bamboo_error_t builtin_newline(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 0) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects no arguments"));
+	}
+
+	// Print the newline string.
+	putstr(LINEBREAK);
+
+	*result = nil;
+	return BAMBOO_OK;
+}
+
+// (string-length str) -> integer
+bamboo_error_t builtin_string_length(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
+
+	// Check the argument type.
+	if (car(args).type != ATOM_TYPE_STRING) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("This function only accepts strings"));
+	}
+
+	*result = bamboo_int((int64_t)(*car(args).value.str)->len);
+	return BAMBOO_OK;
+}
+
+// (substring str start [end]) -> string
+bamboo_error_t builtin_substring(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	size_t start;
+	size_t end;
+	size_t len;
+
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if ((bamboo_list_count(args) < 2) || (bamboo_list_count(args) > 3)) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a string, a start and an optional end"));
+	}
+
+	// Check the argument types.
+	if (car(args).type != ATOM_TYPE_STRING) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("This function only accepts strings"));
+	}
+	len = (*car(args).value.str)->len;
+
+	// Get the range of the substring.
+	end = len;
+	err = string_index_arg(car(cdr(args)), len, &start);
+	IF_ERROR(err)
+		return err;
+	if (!nilp(cdr(cdr(args)))) {
+		err = string_index_arg(car(cdr(cdr(args))), len, &end);
+		IF_ERROR(err)
+			return err;
+	}
+	if (start > end) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("Substring start can't come after its end"));
+	}
+
+	*result = string_view(car(args), start, end - start);
+	return BAMBOO_OK;
+}
+
+// (string-ref str index) -> string
+bamboo_error_t builtin_string_ref(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	size_t index;
+	size_t len;
+
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 2 arguments"));
+	}
+
+	// Check the argument types.
+	if (car(args).type != ATOM_TYPE_STRING) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("This function only accepts strings"));
+	}
+	len = (*car(args).value.str)->len;
+
+	// Get the character as a single character string.
+	err = string_index_arg(car(cdr(args)), len, &index);
+	IF_ERROR(err)
+		return err;
+	if (index == len) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("String index out of bounds"));
+	}
+
+	*result = string_view(car(args), index, 1);
+	return BAMBOO_OK;
+}
+
+// (string=? str1 str2 ...) -> boolean
+bamboo_error_t builtin_string_eq(atom_t args, atom_t *result) {
+	atom_t first;
+
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) < 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects at least 2 arguments"));
+	}
 
-		// Take advantage of the fact we can't have different symbols with same
-		// name to compare them by pointer instead of having to do strcmp.
-		if (*car(item).value.symbol == *symbol.value.symbol) {
-			*atom = cdr(item);
-			return BAMBOO_OK;
+	// Compare every string with the first one.
+	*result = bamboo_boolean(true);
+	for (first = car(args); !nilp(args); args = cdr(args)) {
+		if (car(args).type != ATOM_TYPE_STRING) {
+			*result = nil;
+			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+				_T("This function only accepts strings"));
 		}
 
-		// Check the next symbol in the list.
-		current = cdr(current);
+		if (!string_equal(*first.value.str, *car(args).value.str))
+			*result = bamboo_boolean(false);
 	}
 
-	// Check if we've reached the end of our parent environments to search for.
-	if (nilp(parent)) {
-		TCHAR msg[ERROR_MSG_STR_LEN + 1];
+	return BAMBOO_OK;
+}
+
+// (string-append str...) -> string
+bamboo_error_t builtin_string_append(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	strbuf_t sb;
+	atom_t arg;
+	size_t len;
 
-		// Build the error string.
-		_sntprintf(msg, ERROR_MSG_STR_LEN, _T("Symbol '") SPEC_STR _T("' not ")
-			_T("found in any of the environments"), *symbol.value.symbol);
-		return bamboo_error(BAMBOO_ERROR_UNBOUND, msg);
+	// Calculate the exact length of the resulting string.
+	*result = nil;
+	len = 0;
+	for (arg = args; !nilp(arg); arg = cdr(arg)) {
+		if (car(arg).type != ATOM_TYPE_STRING) {
+			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+				_T("This function only accepts strings"));
+		}
+
+		len += (*car(arg).value.str)->len;
 	}
 
-	// Search for the symbol in the parent.
-	return bamboo_env_get(parent, symbol, atom);
+	// Copy everything over in a single go.
+	err = strbuf_init(&sb, len);
+	IF_ERROR(err)
+		return err;
+	for (arg = args; !nilp(arg); arg = cdr(arg))
+		strbuf_append(&sb, (*car(arg).value.str)->chars,
+			(*car(arg).value.str)->len);
+
+	*result = strbuf_to_string(&sb);
+	return BAMBOO_OK;
 }
 
-/**
- * Creates a new symbol inside an environment or changes it if it already
- * exists in the specified environment.
- *
- * @param  env    Parent environment where the symbol resides.
- * @param  symbol Symbol to be created or edited.
- * @param  value  Value attributed to the symbol.
- * @return        BAMBOO_OK if the operation was successful.
- */
-bamboo_error_t bamboo_env_set(env_t env, atom_t symbol, atom_t value) {
-	env_t current = cdr(env);
-	atom_t item = nil;
+// (string-join strs [separator]) -> string
+bamboo_error_t builtin_string_join(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	const string_t *sep = NULL;
+	strbuf_t sb;
+	atom_t list;
+	size_t len;
 
-	// Iterate over the symbols in the environment list checking if the symbol
-	// already exists in the current environment.
-	while (!nilp(current)) {
-		// Get a symbol from the list.
-		item = car(current);
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if ((bamboo_list_count(args) < 1) || (bamboo_list_count(args) > 2)) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a list of strings and an optional ")
+			_T("separator"));
+	}
 
-		// Check if the symbol matches another one in the environment.
-		if (*car(item).value.symbol == *symbol.value.symbol) {
-			cdr(item) = value;
-			return BAMBOO_OK;
+	// Get the separator.
+	if (!nilp(cdr(args))) {
+		if (car(cdr(args)).type != ATOM_TYPE_STRING) {
+			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+				_T("Separator must be a string"));
 		}
 
-		// Go to the next symbol.
-		current = cdr(current);
+		sep = *car(cdr(args)).value.str;
 	}
 
-	// Looks like this is a new symbol definition. Create it then...
-	item = cons(symbol, value);
-	cdr(env) = cons(item, cdr(env));
+	// Calculate the exact length of the resulting string.
+	len = 0;
+	for (list = car(args); !nilp(list); list = cdr(list)) {
+		if ((list.type != ATOM_TYPE_PAIR) ||
+				(car(list).type != ATOM_TYPE_STRING)) {
+			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+				_T("This function expects a list of strings"));
+		}
+
+		len += (*car(list).value.str)->len;
+		if ((sep != NULL) && !nilp(cdr(list)))
+			len += sep->len;
+	}
+
+	// Copy everything over in a single go.
+	err = strbuf_init(&sb, len);
+	IF_ERROR(err)
+		return err;
+	for (list = car(args); !nilp(list); list = cdr(list)) {
+		strbuf_append(&sb, (*car(list).value.str)->chars,
+			(*car(list).value.str)->len);
+		if ((sep != NULL) && !nilp(cdr(list)))
+			strbuf_append(&sb, sep->chars, sep->len);
+	}
 
+	*result = strbuf_to_string(&sb);
 	return BAMBOO_OK;
 }
 
-/**
- * Creates a new built-in function symbol inside an environment or changes it if
- * it already exists in the specified environment.
- *
- * @param  env  Parent environment where the built-in function symbol resides.
- * @param  name Name of the symbol for the built-in function.
- * @param  func Built-in function that will be called for this symbol.
- * @return      BAMBOO_OK if the operation was successful.
- */
-bamboo_error_t bamboo_env_set_builtin(env_t env, const TCHAR *name,
-									  builtin_func_t func) {
-	return bamboo_env_set(env, bamboo_symbol(name), bamboo_builtin(func));
-}
+// (with-output-to-string thunk) -> string
+bamboo_error_t builtin_with_output_to_string(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	strbuf_t *prev;
+	strbuf_t sb;
+	atom_t ret;
 
-/**
- * Gets the root environment current in use by the interpreter.
- *
- * @return Pointer to the current root environment.
- */
-env_t *bamboo_get_root_env(void) {
-	return bamboo_root_env;
-}
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a function without arguments"));
+	}
 
-////////////////////////////////////////////////////////////////////////////////
-//                                                                            //
-//                             Garbage Collection                             //
-//                                                                            //
-////////////////////////////////////////////////////////////////////////////////
+	// Capture everything that gets printed while calling the function.
+	err = strbuf_init(&sb, 0);
+	IF_ERROR(err)
+		return err;
+	prev = bamboo_ctx->output_capture;
+	bamboo_ctx->output_capture = &sb;
+	err = apply(car(args), nil, &ret);
+	bamboo_ctx->output_capture = prev;
+	IF_ERROR(err) {
+		strbuf_free(&sb);
+		return err;
+	}
 
-/**
- * Marks a whole tree of pairs as "in use" so that the garbage collector won't
- * free them up.
- *
- * @param root Root of the pair tree to be marked as "in use".
- */
-void gc_mark(atom_t root) {
-	allocation_t *alloc;
+	*result = strbuf_to_string(&sb);
+	return BAMBOO_OK;
+}
 
-	//  Get the allocation from the atom.
-	switch (root.type) {
-	case ATOM_TYPE_PAIR:
-	case ATOM_TYPE_CLOSURE:
-	case ATOM_TYPE_MACRO:
-		alloc = (allocation_t *)((size_t)root.value.pair -
-			offsetof(allocation_t, pair));
-		break;
-	case ATOM_TYPE_SYMBOL:
-		alloc = (allocation_t *)((size_t)root.value.symbol -
-			offsetof(allocation_t, str));
-		break;
-	case ATOM_TYPE_STRING:
-		alloc = (allocation_t *)((size_t)root.value.str -
-			offsetof(allocation_t, str));
-		break;
-	default:
-		// Ignore non-"garbage collectable" types.
-		return;
+// (display-env) -> nil
+bamboo_error_t builtin_display_env(atom_t args, atom_t *result) {
+	env_t current;
+
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 0) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects no arguments"));
 	}
 
-	// If it's already marked, then there's nothing to do.
-	if (alloc->mark == GC_IN_USE)
-		return;
+	// Grab our root environment.
+	current = cdr(*bamboo_ctx->root_env);
 
-	// Mark it as "in use".
-	alloc->mark = GC_IN_USE;
+	// Iterate over the symbols in the environment filtering out built-ins.
+	putstr(_T("symbol\t\tvalue") LINEBREAK);
+	while (!nilp(current)) {
+		atom_t item = car(current);
+
+		// Filter out any built-ins.
+		if (cdr(item).type == ATOM_TYPE_BUILTIN)
+			goto next_item;
+
+		// Print out the symbol name and its value.
+		_tprintf(SPEC_STR _T("\t\t"), *car(item).value.symbol);
+		bamboo_print_expr(cdr(item));
+		putstr(LINEBREAK);
+
+next_item:
+		// Go to the next item.
+		current = cdr(current);
+	}
 
-	// Traverse the pair marking everything as "in use".
-	gc_mark(car(root));
-	gc_mark(cdr(root));
+	*result = nil;
+	return BAMBOO_OK;
 }
 
 /**
- * Go through the allocation linked list collecting the garbage.
+ * Builds a numeric vector out of a list of numeric atoms.
  *
- * @param respect_marks Should we respect the "in use" marks in allocations? If
- *                      set to FALSE this will deallocate everything.
+ * @param  type   Type of the elements of the vector.
+ * @param  list   List of numeric atoms.
+ * @param  result Pointer to the resulting vector atom.
+ * @return        BAMBOO_OK if the vector was built.
  */
-void gc(bool respect_marks) {
-	allocation_t *alloc;
-	allocation_t **tmp;
-
-	// Make sure we don't trash our global symbols list.
-	if (respect_marks)
-		gc_mark(bamboo_symbol_table);
-
-	// Free up all unmarked allocations.
-	tmp = &bamboo_allocations;
-	while (*tmp != NULL) {
-		alloc = *tmp;
+bamboo_error_t list_to_vector(vector_type_t type, atom_t list,
+							  atom_t *result) {
+	bamboo_error_t err;
+	vector_t *vec;
+	size_t i;
 
-		// Check if it's marked to be freed.
-		if ((alloc->mark == GC_TO_FREE) | !respect_marks) {
-			// Free it up!
-			*tmp = alloc->next;
-			if (alloc->type == ALLOCATION_TYPE_STRING)
-				free(alloc->str);
-			free(alloc);
+	// Check if we actually have a proper list.
+	if (!listp(list)) {
+		*result = nil;
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Vectors can only be built from proper lists"));
+	}
 
-			continue;
+	// Populate the vector.
+	*result = bamboo_vector(type, bamboo_list_count(list));
+	vec = *result->value.vector;
+	for (i = 0; !nilp(list); i++) {
+		err = vector_elem_set(vec, i, car(list));
+		IF_ERROR(err) {
+			*result = nil;
+			return err;
 		}
 
-		// Let's go to the next item in the allocation list.
-		tmp = &alloc->next;
+		list = cdr(list);
 	}
 
-	// Clear all the marks for the next round.
-	alloc = bamboo_allocations;
-	while (alloc != NULL) {
-		alloc->mark = GC_TO_FREE;
-		alloc = alloc->next;
-	}
+	return BAMBOO_OK;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-//                                                                            //
-//                                 Debugging                                  //
-//                                                                            //
-////////////////////////////////////////////////////////////////////////////////
-
 /**
- * Gets the string representation of the contents of an atom.
+ * Gets a double-precision vector from an atom checking its type.
  *
- * @param buf  Pointer to a string that will be allocated by this function which
- *             will return the atom representation string. NOTE: Remember that
- *             you're responsible for freeing this pointer later.
- * @param atom Atom to have its contents represented.
+ * @param  atom Atom that should be a double-precision vector.
+ * @param  vec  Pointer to the vector structure of the atom.
+ * @return      BAMBOO_OK if the atom was a double-precision vector.
  */
-void bamboo_expr_str(TCHAR **buf, atom_t atom) {
-	TCHAR *tmp;
-	size_t buflen = 0;
+bamboo_error_t f64vector_arg(atom_t atom, vector_t **vec) {
+	if ((atom.type != ATOM_TYPE_VECTOR) ||
+			((*atom.value.vector)->type != VECTOR_TYPE_F64)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts ")
+			_T("f64vectors"));
+	}
 
-	switch (atom.type) {
-	case ATOM_TYPE_NIL:
-		// nil
-		*buf = _tcsdup(_T("nil"));
-		break;
-	case ATOM_TYPE_SYMBOL:
-		// Symbol
-		*buf = _tcsdup(*atom.value.symbol);
-		break;
-	case ATOM_TYPE_INTEGER:
-		// Integer
-#if defined(_MSC_VER) && (_MSC_VER <= 1400)
-		buflen = I64_MAX_DIGITS;
-#else
-		buflen = _sntprintf(NULL, 0, _T("%lld"), atom.value.integer);
-#endif  // _MSC_VER
+	*vec = *atom.value.vector;
+	return BAMBOO_OK;
+}
 
-		*buf = (TCHAR *)malloc((buflen + 1) * sizeof(TCHAR));
-		if (*buf == NULL) {
-			fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-				_T("string to represent integer atom"));
-		}
+// (f64vector nums...) -> f64vector
+bamboo_error_t builtin_f64vector(atom_t args, atom_t *result) {
+	return list_to_vector(VECTOR_TYPE_F64, args, result);
+}
 
-#if defined(_MSC_VER) && (_MSC_VER <= 1400)
-		_sntprintf(*buf, buflen + 1, _T("%I64d"), atom.value.integer);
-#else
-		_sntprintf(*buf, buflen + 1, _T("%lld"), atom.value.integer);
-#endif  // _MSC_VER
-		break;
-	case ATOM_TYPE_FLOAT:
-		// Float
-#if defined(_MSC_VER) && (_MSC_VER <= 1400)
-		buflen = LONGDOUBLE_MAX_DIGITS;
-#else
-		buflen = _sntprintf(NULL, 0, _T("%Lg"), atom.value.dfloat);
-#endif  // _MSC_VER
+// (i64vector ints...) -> i64vector
+bamboo_error_t builtin_i64vector(atom_t args, atom_t *result) {
+	return list_to_vector(VECTOR_TYPE_I64, args, result);
+}
 
-		*buf = (TCHAR *)malloc((buflen + 1) * sizeof(TCHAR));
-		if (*buf == NULL) {
-			fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-				_T("string to represent float atom"));
-		}
+// (f32vector nums...) -> f32vector
+bamboo_error_t builtin_f32vector(atom_t args, atom_t *result) {
+	return list_to_vector(VECTOR_TYPE_F32, args, result);
+}
 
-		_sntprintf(*buf, buflen + 1, _T("%Lg"), atom.value.dfloat);
-		break;
-	case ATOM_TYPE_BOOLEAN:
-		// Boolean
-		buflen = 2;
-		*buf = (TCHAR *)malloc((buflen + 1) * sizeof(TCHAR));
-		if (*buf == NULL) {
-			fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-				_T("string to represent boolean atom"));
-		}
+// (list->f64vector list) -> f64vector
+bamboo_error_t builtin_list_to_f64vector(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
 
-		tmp = *buf;
-		tmp[0] = _T('#');
-		tmp[1] = (atom.value.boolean) ? _T('t') : _T('f');
-		tmp[2] = _T('\0');
-		break;
-	case ATOM_TYPE_STRING:
-		// String
-		buflen = _tcslen(*atom.value.str) + 2;
-		*buf = (TCHAR *)malloc((buflen + 1) * sizeof(TCHAR));
-		if (*buf == NULL) {
-			fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-				_T("string to represent string atom"));
-		}
+	return list_to_vector(VECTOR_TYPE_F64, car(args), result);
+}
 
-		_sntprintf(*buf, buflen + 1, _T("\"") SPEC_STR _T("\""),
-			*atom.value.str);
-		break;
-	case ATOM_TYPE_PAIR:
-		// Pair
-		buflen = 3;
-
-		// Start by allocating the basic string and adding the leading paren.
-		*buf = (TCHAR *)malloc(buflen * sizeof(TCHAR));
-		if (*buf == NULL)
-			goto err_alloc_pair_str;
-		(*buf)[0] = _T('(');
-		(*buf)[1] = _T('\0');
-
-		// Grab the first item of the pair and append it to the string.
-		bamboo_expr_str(&tmp, car(atom));
-		buflen += _tcslen(tmp);
-		*buf = (TCHAR *)realloc(*buf, buflen * sizeof(TCHAR));
-		if (*buf == NULL)
-			goto err_alloc_pair_str;
-		_tcscat(*buf, tmp);
-		free(tmp);
+// (vector? atom) -> boolean
+bamboo_error_t builtin_vectorp(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 1 argument"));
+	}
 
-		// Iterate over the right-hand side of the pair since it may be a list.
-		atom = cdr(atom);
-		while (!nilp(atom)) {
-			// Check if we are in a list.
-			if (atom.type == ATOM_TYPE_PAIR) {
-				bamboo_expr_str(&tmp, car(atom));
+	*result = bamboo_boolean(car(args).type == ATOM_TYPE_VECTOR);
+	return BAMBOO_OK;
+}
+
+// (vector-length vec) -> int
+bamboo_error_t builtin_vector_length(atom_t args, atom_t *result) {
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
+
+	// Check if we have a vector.
+	if (car(args).type != ATOM_TYPE_VECTOR) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts vectors"));
+	}
+
+	*result = bamboo_int((int64_t)(*car(args).value.vector)->len);
+	return BAMBOO_OK;
+}
 
-				buflen += _tcslen(tmp) + 1;
-				*buf = (TCHAR *)realloc(*buf, buflen * sizeof(TCHAR));
-				if (*buf == NULL)
-					goto err_alloc_pair_str;
+// (vector-ref vec index) -> num
+bamboo_error_t builtin_vector_ref(atom_t args, atom_t *result) {
+	vector_t *vec;
+	atom_t index;
 
-				_tcscat(*buf, _T(" "));
-				_tcscat(*buf, tmp);
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 2 arguments"));
+	}
 
-				free(tmp);
-				atom = cdr(atom);
-			} else {
-				// It was just a simple pair.
-				bamboo_expr_str(&tmp, atom);
+	// Check the argument types.
+	index = car(cdr(args));
+	if ((car(args).type != ATOM_TYPE_VECTOR) ||
+			(index.type != ATOM_TYPE_INTEGER)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("This function expects a vector and an integer index"));
+	}
 
-				buflen += _tcslen(tmp) + 3;
-				*buf = (TCHAR *)realloc(*buf, buflen * sizeof(TCHAR));
-				if (*buf == NULL)
-					goto err_alloc_pair_str;
+	// Check if the index is within bounds.
+	vec = *car(args).value.vector;
+	if ((index.value.integer < 0) || ((size_t)index.value.integer >= vec->len)) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("Vector index out of bounds"));
+	}
 
-				_tcscat(*buf, _T(" . "));
-				_tcscat(*buf, tmp);
+	*result = vector_elem(vec, (size_t)index.value.integer);
+	return BAMBOO_OK;
+}
 
-				free(tmp);
-				break;
-			}
-		}
+// (vector-set! vec index num) -> num
+bamboo_error_t builtin_vector_set(atom_t args, atom_t *result) {
+	vector_t *vec;
+	atom_t index;
 
-		// Append the last paren and terminate the string.
-		_tcscat(*buf, _T(")"));
-		break;
-err_alloc_pair_str:
-		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-			_T("string to represent pair atom"));
-		break;
-	case ATOM_TYPE_BUILTIN:
-		// Built-in Function
-#if defined(_MSC_VER) && (_MSC_VER <= 1400)
-		buflen = 32;
-#else
-		buflen = _sntprintf(NULL, 0, _T("#<BUILTIN:%p>"), atom.value.builtin);
-#endif  // _MSC_VER
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 3) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 3 arguments"));
+	}
 
-		*buf = (TCHAR *)malloc((buflen + 1) * sizeof(TCHAR));
-		if (*buf == NULL) {
-			fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-				_T("string to represent built-in function atom"));
-		}
+	// Check the argument types.
+	index = car(cdr(args));
+	if ((car(args).type != ATOM_TYPE_VECTOR) ||
+			(index.type != ATOM_TYPE_INTEGER)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("This function expects a vector and an integer index"));
+	}
 
-		_sntprintf(*buf, buflen + 1, _T("#<BUILTIN:%p>"), atom.value.builtin);
-		break;
-	case ATOM_TYPE_CLOSURE:
-		// Closure
-		buflen = 14;
+	// Check if the vector can be changed.
+	if (gc_frozen_p(car(args))) {
+		return bamboo_error(BAMBOO_ERROR_READ_ONLY,
+			_T("Can't change a read-only vector"));
+	}
 
-		// Allocate the string and begin with the type identifier.
-		*buf = (TCHAR *)malloc(buflen * sizeof(TCHAR));
-		if (*buf == NULL)
-			goto err_alloc_closure_str;
-		(*buf)[0] = _T('\0');
-		_tcscat(*buf, _T("#<FUNCTION:"));
+	// Check if the index is within bounds.
+	vec = *car(args).value.vector;
+	if ((index.value.integer < 0) || ((size_t)index.value.integer >= vec->len)) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("Vector index out of bounds"));
+	}
 
-		// Do we have arguments?
-		if (!nilp(car(cdr(atom)))) {
-			bamboo_expr_str(&tmp, car(cdr(atom)));
+	*result = car(cdr(cdr(args)));
+	return vector_elem_set(vec, (size_t)index.value.integer, *result);
+}
 
-			buflen += _tcslen(tmp);
-			*buf = (TCHAR *)realloc(*buf, buflen * sizeof(TCHAR));
-			if (*buf == NULL)
-				goto err_alloc_closure_str;
+// (vector->list vec) -> list
+bamboo_error_t builtin_vector_to_list(atom_t args, atom_t *result) {
+	vector_t *vec;
+	size_t i;
 
-			_tcscat(*buf, tmp);
-			free(tmp);
-		}
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
 
-		// Append the closure body.
-		_tcscat(*buf, _T(" "));
-		bamboo_expr_str(&tmp, cdr(cdr(atom)));
-		buflen += _tcslen(tmp);
-		*buf = (TCHAR *)realloc(*buf, buflen * sizeof(TCHAR));
-		if (*buf == NULL)
-			goto err_alloc_closure_str;
-		_tcscat(*buf, tmp);
-		free(tmp);
+	// Check if we have a vector.
+	if (car(args).type != ATOM_TYPE_VECTOR) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts vectors"));
+	}
 
-		// Finalize the string.
-		_tcscat(*buf, _T(">"));
-		break;
-err_alloc_closure_str:
-		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-				_T("string to represent closure atom"));
-		break;
-	case ATOM_TYPE_MACRO:
-		// Macro
-		buflen = 11;
+	// Build the list backwards so that we don't have to reverse it.
+	vec = *car(args).value.vector;
+	for (i = vec->len; i > 0; i--)
+		*result = cons(vector_elem(vec, i - 1), *result);
 
-		// Allocate the string and begin with the type identifier.
-		*buf = (TCHAR *)malloc(buflen * sizeof(TCHAR));
-		if (*buf == NULL)
-			goto err_alloc_macro_str;
-		(*buf)[0] = _T('\0');
-		_tcscat(*buf, _T("#<MACRO:"));
+	return BAMBOO_OK;
+}
 
-		// Do we have arguments?
-		if (!nilp(car(cdr(atom)))) {
-			bamboo_expr_str(&tmp, car(cdr(atom)));
+/**
+ * Gets the two double-precision vectors of the same length used by element-wise
+ * operations.
+ *
+ * @param  args Arguments passed to the built-in function.
+ * @param  a    Pointer to the first vector.
+ * @param  b    Pointer to the second vector.
+ * @return      BAMBOO_OK if both arguments are valid.
+ */
+bamboo_error_t f64vector_pair_args(atom_t args, vector_t **a, vector_t **b) {
+	bamboo_error_t err;
 
-			buflen += _tcslen(tmp);
-			*buf = (TCHAR *)realloc(*buf, buflen * sizeof(TCHAR));
-			if (*buf == NULL)
-				goto err_alloc_macro_str;
+	// Check if we have the right number of arguments.
+	if (bamboo_list_count(args) != 2) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects 2 arguments"));
+	}
 
-			_tcscat(*buf, tmp);
-			free(tmp);
-		}
+	// Get the vectors.
+	err = f64vector_arg(car(args), a);
+	IF_ERROR(err)
+		return err;
+	err = f64vector_arg(car(cdr(args)), b);
+	IF_ERROR(err)
+		return err;
 
-		// Append the macro body.
-		_tcscat(*buf, _T(" "));
-		bamboo_expr_str(&tmp, cdr(cdr(atom)));
-		buflen += _tcslen(tmp);
-		*buf = (TCHAR *)realloc(*buf, buflen * sizeof(TCHAR));
-		if (*buf == NULL)
-			goto err_alloc_macro_str;
-		_tcscat(*buf, tmp);
-		free(tmp);
+	// Check if their lengths match.
+	if ((*a)->len != (*b)->len) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("Vectors must have the same length"));
+	}
 
-		// Finalize the string.
-		_tcscat(*buf, _T(">"));
-		break;
-err_alloc_macro_str:
-		fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-				_T("string to represent macro atom"));
-		break;
-	case ATOM_TYPE_POINTER:
-		// Pointer
-#if defined(_MSC_VER) && (_MSC_VER <= 1400)
-		buflen = 32;
-#else
-		buflen = _sntprintf(NULL, 0, _T("#<POINTER:%p>"), atom.value.pointer);
-#endif  // _MSC_VER
+	return BAMBOO_OK;
+}
 
-		*buf = (TCHAR *)malloc((buflen + 1) * sizeof(TCHAR));
-		if (*buf == NULL) {
-			fatal_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-				_T("string to represent pointer atom"));
-		}
+/**
+ * Starts iterating over the numbers stored in either a list or a numeric
+ * vector.
+ *
+ * @param  iter Pointer to the iterator to be initialized.
+ * @param  seq  List or numeric vector to iterate over.
+ * @return      BAMBOO_OK if the sequence can be iterated over.
+ */
+bamboo_error_t numiter_init(numiter_t *iter, atom_t seq) {
+	iter->list = nil;
+	iter->vec = NULL;
+	iter->index = 0;
 
-		_sntprintf(*buf, buflen + 1, _T("#<POINTER:%p>"), atom.value.pointer);
+	switch (seq.type) {
+	case ATOM_TYPE_NIL:
+	case ATOM_TYPE_PAIR:
+		iter->list = seq;
+		break;
+	case ATOM_TYPE_VECTOR:
+		iter->vec = *seq.value.vector;
 		break;
 	default:
-		// Unknown
-		*buf = _tcsdup(_T("Unknown type. Don't know how to display this"));
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts lists ")
+			_T("or numeric vectors"));
 	}
+
+	return BAMBOO_OK;
 }
 
 /**
- * Prints the contents of an atom in a standard way.
+ * Gets the next number from a sequence iterator. Numbers are widened to the
+ * float type used by atoms, which holds every 64-bit integer exactly unless
+ * BAMBOO_USE_DOUBLE is defined. Bignums past that precision get rounded.
  *
- * @param atom Atom to have its contents printed.
+ * @param  iter Pointer to the iterator.
+ * @param  num  Pointer to where the number will be stored.
+ * @param  err  Pointer to where an error will be stored if one occurs. Set to
+ *              BAMBOO_OK once the end of the sequence is reached.
+ * @return      TRUE if a number was fetched. FALSE if we've reached the end of
+ *              the sequence or an error occured.
  */
-void bamboo_print_expr(atom_t atom) {
-	TCHAR *buf;
+bool numiter_next(numiter_t *iter, bamboo_float_t *num,
+	bamboo_error_t *err) {
+	*err = BAMBOO_OK;
 
-	// Get the atom content as a string and print it.
-	bamboo_expr_str(&buf, atom);
-	putstr(buf);
+	// Numeric vectors.
+	if (iter->vec != NULL) {
+		if (iter->index >= iter->vec->len)
+			return false;
 
-	// Free up the allocated string.
-	free(buf);
+		switch (iter->vec->type) {
+		case VECTOR_TYPE_F64:
+			*num = iter->vec->data.f64[iter->index];
+			break;
+		case VECTOR_TYPE_I64:
+			*num = (bamboo_float_t)iter->vec->data.i64[iter->index];
+			break;
+		case VECTOR_TYPE_F32:
+			*num = (bamboo_float_t)iter->vec->data.f32[iter->index];
+			break;
+		}
+
+		iter->index++;
+		return true;
+	}
+
+	// Lists.
+	if (nilp(iter->list))
+		return false;
+	if (iter->list.type != ATOM_TYPE_PAIR) {
+		*err = bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Sequence must be a proper list"));
+		return false;
+	}
+	if (!atom_float_val(car(iter->list), num)) {
+		*err = bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Sequence must only contain numerics"));
+		return false;
+	}
+
+	iter->list = cdr(iter->list);
+	return true;
 }
 
 /**
- * Gets the error type string given an error code.
+ * Partially sorts an array so that the element at index K ends up where it
+ * would be if the array was sorted, with no bigger elements before it and no
+ * smaller ones after it. Hoare's selection algorithm.
  *
- * @param buf Pointer to a string that will be allocated by this function which
- *            will return the error type string. NOTE: Remember that you're
- *            responsible for freeing this pointer later.
- * @param err Error code.
+ * @param  data Array to be partially sorted.
+ * @param  len  Number of elements in the array.
+ * @param  k    Index of the element to be selected.
+ * @return      Value of the K-th smallest element.
  */
-void bamboo_error_type_str(TCHAR **buf, bamboo_error_t err) {
-	// Get the error type string.
-	switch (err) {
-	case BAMBOO_OK:
-		*buf = _tcsdup(_T("OK"));
-		break;
-	case BAMBOO_PAREN_END:
-		*buf = _tcsdup(_T("PARENTHESIS ENDED"));
-		break;
-	case BAMBOO_ERROR_SYNTAX:
-		*buf = _tcsdup(_T("SYNTAX ERROR"));
-		break;
-	case BAMBOO_ERROR_EMPTY:
-		*buf = _tcsdup(_T("EMPTY STATEMENT"));
-		break;
-	case BAMBOO_ERROR_UNBOUND:
-		*buf = _tcsdup(_T("UNBOUND SYMBOL ERROR"));
-		break;
-	case BAMBOO_ERROR_ARGUMENTS:
-		*buf = _tcsdup(_T("INCORRECT ARGUMENT ERROR"));
-		break;
-	case BAMBOO_ERROR_WRONG_TYPE:
-		*buf = _tcsdup(_T("WRONG TYPE ERROR"));
-		break;
-	case BAMBOO_ERROR_NUM_OVERFLOW:
-		*buf = _tcsdup(_T("NUMERIC OVERFLOW ERROR"));
-		break;
-	case BAMBOO_ERROR_NUM_UNDERFLOW:
-		*buf = _tcsdup(_T("NUMERIC UNDERFLOW ERROR"));
-		break;
-	case BAMBOO_ERROR_ALLOCATION:
-		*buf = _tcsdup(_T("MEMORY ALLOCATION ERROR"));
-		break;
-	case BAMBOO_ERROR_UNKNOWN:
-		*buf = _tcsdup(_T("UNKNOWN ERROR"));
-		break;
-	default:
-		*buf = _tcsdup(_T("I have no clue why you're here, because you ")
-			_T("shouldn't"));
-		break;
+bamboo_float_t select_nth(bamboo_float_t *data, size_t len, size_t k) {
+	ptrdiff_t lo = 0;
+	ptrdiff_t hi = (ptrdiff_t)len - 1;
+	ptrdiff_t target = (ptrdiff_t)k;
+
+	while (lo < hi) {
+		ptrdiff_t mid = lo + ((hi - lo) / 2);
+		ptrdiff_t i = lo;
+		ptrdiff_t j = hi;
+		bamboo_float_t pivot;
+		bamboo_float_t tmp;
+
+		// Use the median of the first, middle and last elements as the pivot.
+		if (data[mid] < data[lo]) {
+			tmp = data[mid];
+			data[mid] = data[lo];
+			data[lo] = tmp;
+		}
+		if (data[hi] < data[lo]) {
+			tmp = data[hi];
+			data[hi] = data[lo];
+			data[lo] = tmp;
+		}
+		if (data[hi] < data[mid]) {
+			tmp = data[hi];
+			data[hi] = data[mid];
+			data[mid] = tmp;
+		}
+		pivot = data[mid];
+
+		// Partition the array around the pivot.
+		while (i <= j) {
+			while (data[i] < pivot)
+				i++;
+			while (data[j] > pivot)
+				j--;
+
+			if (i <= j) {
+				tmp = data[i];
+				data[i] = data[j];
+				data[j] = tmp;
+				i++;
+				j--;
+			}
+		}
+
+		// Only keep going on the side that has our element.
+		if (target <= j) {
+			hi = j;
+		} else if (target >= i) {
+			lo = i;
+		} else {
+			break;
+		}
 	}
+
+	return data[k];
 }
 
 /**
- * Prints the appropriate error message for a given error code.
+ * Pushes a key-value pair to the front of an association list.
  *
- * @param err Error code to print the message.
+ * @param  alist Association list.
+ * @param  key   Name of the symbol used as the key.
+ * @param  value Value associated with the key.
+ * @return       New association list.
  */
-void bamboo_print_error(bamboo_error_t err) {
-	TCHAR *err_type = NULL;
+atom_t alist_push(atom_t alist, const TCHAR *key, atom_t value) {
+	return cons(cons(bamboo_symbol(key), value), alist);
+}
 
-	// Get the error type string and print it out.
-	bamboo_error_type_str(&err_type, err);
-	putstrerr(err_type);
-	putstrerr(_T(": "));
+// (f64v+ a b) -> f64vector
+bamboo_error_t builtin_f64v_add(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	vector_t *a;
+	vector_t *b;
 
-	// Print the error detail string and a line break.
-	putstrerr(bamboo_error_detail());
-	putstrerr(LINEBREAK);
+	// Get the arguments.
+	*result = nil;
+	err = f64vector_pair_args(args, &a, &b);
+	IF_ERROR(err)
+		return err;
 
-	// Free up our temporary buffer.
-	free(err_type);
+	// Perform the operation.
+	*result = bamboo_vector(VECTOR_TYPE_F64, a->len);
+	bamboo_vkernels.add((*result->value.vector)->data.f64, a->data.f64,
+		b->data.f64, a->len);
+
+	return BAMBOO_OK;
 }
 
-/**
- * Prints all of the tokens found in a string.
- *
- * @param str String to debug tokens in.
- */
-void bamboo_print_tokens(const TCHAR *str) {
-	token_t token;
+// (f64v* a b) -> f64vector
+bamboo_error_t builtin_f64v_mul(atom_t args, atom_t *result) {
 	bamboo_error_t err;
+	vector_t *a;
+	vector_t *b;
 
-	// Go through tokens in string.
-	token.end = str;
-	while (!(err = lex(token.end, &token))) {
-		TCHAR *buf;
-		int i;
+	// Get the arguments.
+	*result = nil;
+	err = f64vector_pair_args(args, &a, &b);
+	IF_ERROR(err)
+		return err;
 
-		// Allocate string for the token string.
-		buf = (TCHAR *)malloc(((token.end - token.start) + 1) * sizeof(TCHAR));
-		if (buf == NULL) {
-			fatal_error(BAMBOO_ERROR_ALLOCATION,
-				_T("Can't allocate string for token printing"));
-			return;
-		}
+	// Perform the operation.
+	*result = bamboo_vector(VECTOR_TYPE_F64, a->len);
+	bamboo_vkernels.mul((*result->value.vector)->data.f64, a->data.f64,
+		b->data.f64, a->len);
 
-		// Get the token string from the token structure.
-		for (i = 0; i < (token.end - token.start); i++) {
-			buf[i] = token.start[i];
-		}
-		buf[i] = _T('\0');
+	return BAMBOO_OK;
+}
 
-		// Print the token and free the string.
-		_tprintf(_T("'") SPEC_STR _T("' "), buf);
-		free(buf);
+// (f64v-sum vec) -> float
+bamboo_error_t builtin_f64v_sum(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	vector_t *vec;
+
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
+
+	// Get the vector and perform the reduction.
+	err = f64vector_arg(car(args), &vec);
+	IF_ERROR(err)
+		return err;
+	*result = bamboo_float((bamboo_float_t)bamboo_vkernels.sum(vec->data.f64,
+		vec->len));
+
+	return BAMBOO_OK;
+}
+
+// (f64v-dot a b) -> float
+bamboo_error_t builtin_f64v_dot(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	vector_t *a;
+	vector_t *b;
+
+	// Get the arguments.
+	*result = nil;
+	err = f64vector_pair_args(args, &a, &b);
+	IF_ERROR(err)
+		return err;
+
+	// Perform the reduction.
+	*result = bamboo_float((bamboo_float_t)bamboo_vkernels.dot(a->data.f64,
+		b->data.f64, a->len));
+
+	return BAMBOO_OK;
+}
+
+// (f64v-min vec) -> float
+bamboo_error_t builtin_f64v_min(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	vector_t *vec;
+
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
+
+	// Get the vector and make sure it isn't empty.
+	err = f64vector_arg(car(args), &vec);
+	IF_ERROR(err)
+		return err;
+	if (vec->len == 0) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("Can't get the minimum of an empty vector"));
 	}
-}
 
-////////////////////////////////////////////////////////////////////////////////
-//                                                                            //
-//                               Error Handling                               //
-//                                                                            //
-////////////////////////////////////////////////////////////////////////////////
+	// Perform the reduction.
+	*result = bamboo_float((bamboo_float_t)bamboo_vkernels.min(vec->data.f64,
+		vec->len));
 
-/**
- * Gets the last detailed error message from the interpreter.
- *
- * @return Last detailed error message.
- */
-const TCHAR* bamboo_error_detail(void) {
-	return bamboo_error_msg;
+	return BAMBOO_OK;
 }
 
-/**
- * Sets the internal error message variable.
- *
- * @param msg Error message to be set.
- */
-void set_error_msg(const TCHAR *msg) {
-	_tcsncpy(bamboo_error_msg, msg, ERROR_MSG_STR_LEN);
-}
+// (f64v-max vec) -> float
+bamboo_error_t builtin_f64v_max(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	vector_t *vec;
 
-/**
- * Sets the internal error message variable and returns the specified error
- * code.
- *
- * @param  err Error code to be returned.
- * @param  msg Error message to be set.
- * @return     Error code passed in 'err'.
- */
-bamboo_error_t bamboo_error(bamboo_error_t err, const TCHAR *msg) {
-	set_error_msg(msg);
-	return err;
-}
+	// Check if we have the right number of arguments.
+	*result = nil;
+	if (bamboo_list_count(args) != 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects a single argument"));
+	}
 
-/**
- * Handles a fatal error where the program is required to exit immediately,
- * since it's unrecoverable.
- *
- * @param err Error code to be returned.
- * @param msg Error message to be set.
- */
-void fatal_error(bamboo_error_t err, const TCHAR *msg) {
-	// Print the error message.
-	set_error_msg(msg);
-	bamboo_print_error(err);
+	// Get the vector and make sure it isn't empty.
+	err = f64vector_arg(car(args), &vec);
+	IF_ERROR(err)
+		return err;
+	if (vec->len == 0) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("Can't get the maximum of an empty vector"));
+	}
 
-	// Bye guys!
-	exit(err);
+	// Perform the reduction.
+	*result = bamboo_float((bamboo_float_t)bamboo_vkernels.max(vec->data.f64,
+		vec->len));
+
+	return BAMBOO_OK;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-//                                                                            //
-//                             Built-in Functions                             //
-//                                                                            //
-////////////////////////////////////////////////////////////////////////////////
+// (f64v-map-affine vec a b) -> f64vector
+bamboo_error_t builtin_f64v_map_affine(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	vector_t *vec;
+	double a;
+	double b;
 
-// (car pair) -> atom
-bamboo_error_t builtin_car(atom_t args, atom_t *result) {
 	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
+	*result = nil;
+	if (bamboo_list_count(args) != 3) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects a single argument"));
+			_T("This function expects 3 arguments"));
 	}
 
-	// Get the first element of a pair otherwise just return nil.
-	if (car(args).type == ATOM_TYPE_PAIR) {
-		*result = car(car(args));
-	} else {
-		*result = nil;
+	// Get the arguments.
+	err = f64vector_arg(car(args), &vec);
+	IF_ERROR(err)
+		return err;
+	if (!atom_numeric_val(car(cdr(args)), &a) ||
+			!atom_numeric_val(car(cdr(cdr(args))), &b)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Affine coefficients must be numerics"));
 	}
 
+	// Perform the operation.
+	*result = bamboo_vector(VECTOR_TYPE_F64, vec->len);
+	bamboo_vkernels.affine((*result->value.vector)->data.f64, vec->data.f64,
+		a, b, vec->len);
+
 	return BAMBOO_OK;
 }
 
-// (cdr pair) -> atom
-bamboo_error_t builtin_cdr(atom_t args, atom_t *result) {
+// (stats-summary seq) -> alist
+bamboo_error_t builtin_stats_summary(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	numiter_t iter;
+	bamboo_float_t mean;
+	bamboo_float_t m2;
+	bamboo_float_t min;
+	bamboo_float_t max;
+	bamboo_float_t x;
+	size_t n;
+
 	// Check if we have the right number of arguments.
+	*result = nil;
 	if (bamboo_list_count(args) != 1) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
 			_T("This function expects a single argument"));
 	}
 
-	// Get the second element of a pair otherwise just return nil.
-	if (car(args).type == ATOM_TYPE_PAIR) {
-		*result = cdr(car(args));
-	} else {
-		*result = nil;
+	// Go through the sequence using Welford's online algorithm.
+	err = numiter_init(&iter, car(args));
+	IF_ERROR(err)
+		return err;
+	n = 0;
+	mean = m2 = min = max = 0;
+	while (numiter_next(&iter, &x, &err)) {
+		bamboo_float_t delta = x - mean;
+
+		n++;
+		mean += delta / (bamboo_float_t)n;
+		m2 += delta * (x - mean);
+
+		if ((n == 1) || (x < min))
+			min = x;
+		if ((n == 1) || (x > max))
+			max = x;
+	}
+	IF_ERROR(err)
+		return err;
+
+	// Build the summary, which is just the count for empty sequences.
+	if (n > 0) {
+		*result = alist_push(*result, _T("MAX"), bamboo_float(max));
+		*result = alist_push(*result, _T("MIN"), bamboo_float(min));
+		*result = alist_push(*result, _T("VARIANCE"),
+			bamboo_float((n > 1) ? (m2 / (bamboo_float_t)(n - 1)) : 0));
+		*result = alist_push(*result, _T("MEAN"), bamboo_float(mean));
 	}
+	*result = alist_push(*result, _T("COUNT"), bamboo_int((int64_t)n));
 
 	return BAMBOO_OK;
 }
 
-// (cons car cdr) -> pair
-bamboo_error_t builtin_cons(atom_t args, atom_t *result) {
+// (histogram seq bins [lo hi]) -> alist
+bamboo_error_t builtin_histogram(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	numiter_t iter;
+	vector_t *counts;
+	atom_t hist;
+	atom_t seq;
+	atom_t bins;
+	bamboo_float_t width;
+	bamboo_float_t lo;
+	bamboo_float_t hi;
+	bamboo_float_t x;
+	size_t nargs;
+
 	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 2) {
+	*result = nil;
+	nargs = bamboo_list_count(args);
+	if ((nargs != 2) && (nargs != 4)) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 2 arguments"));
+			_T("This function expects 2 or 4 arguments"));
 	}
 
-	// Create the pair.
-	*result = cons(car(args), car(cdr(args)));
+	// Get the number of bins.
+	seq = car(args);
+	bins = car(cdr(args));
+	if ((bins.type != ATOM_TYPE_INTEGER) || (bins.value.integer < 1)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Number of bins must be a positive integer"));
+	}
+
+	// Get the range of the bins.
+	if (nargs == 4) {
+		if (!atom_float_val(car(cdr(cdr(args))), &lo) ||
+				!atom_float_val(car(cdr(cdr(cdr(args)))), &hi)) {
+			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+				_T("Range of the bins must be numerics"));
+		}
+	} else {
+		bool first = true;
+
+		// Range wasn't supplied, so we need an extra pass to find it.
+		lo = hi = 0;
+		err = numiter_init(&iter, seq);
+		IF_ERROR(err)
+			return err;
+		while (numiter_next(&iter, &x, &err)) {
+			if (first || (x < lo))
+				lo = x;
+			if (first || (x > hi))
+				hi = x;
+			first = false;
+		}
+		IF_ERROR(err)
+			return err;
+	}
+	if (hi < lo) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("Upper bound of the bins must not be less than the lower one"));
+	}
+
+	// Count the numbers in each bin, ignoring anything out of range.
+	hist = bamboo_vector(VECTOR_TYPE_I64, (size_t)bins.value.integer);
+	counts = *hist.value.vector;
+	width = (hi - lo) / (bamboo_float_t)counts->len;
+	err = numiter_init(&iter, seq);
+	IF_ERROR(err)
+		return err;
+	while (numiter_next(&iter, &x, &err)) {
+		size_t bin;
+
+		if (!((x >= lo) && (x <= hi)))
+			continue;
+
+		bin = (width > 0) ? (size_t)((x - lo) / width) : 0;
+		if (bin >= counts->len)
+			bin = counts->len - 1;
+		counts->data.i64[bin]++;
+	}
+	IF_ERROR(err)
+		return err;
+
+	// Build the result.
+	*result = alist_push(nil, _T("COUNTS"), hist);
+	*result = alist_push(*result, _T("WIDTH"), bamboo_float(width));
+	*result = alist_push(*result, _T("MAX"), bamboo_float(hi));
+	*result = alist_push(*result, _T("MIN"), bamboo_float(lo));
+
 	return BAMBOO_OK;
 }
 
-// (+ nums...) -> num
-bamboo_error_t builtin_sum(atom_t args, atom_t *result) {
-	atom_t num;
-
-	// Initialize the result atom.
-	num.type = ATOM_TYPE_INTEGER;
-	num.value.integer = 0;
+// (quantiles seq q) -> float
+// (quantiles seq qs) -> list
+bamboo_error_t builtin_quantiles(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	numiter_t iter;
+	atom_t qs;
+	atom_t tail;
+	bamboo_float_t *data;
+	bamboo_float_t x;
+	size_t len;
+	size_t n;
 
 	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) < 2) {
+	*result = nil;
+	if (bamboo_list_count(args) != 2) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects at least 2 arguments"));
+			_T("This function expects 2 arguments"));
 	}
 
-	// Iterate through the arguments summing them.
-	while (!nilp(args)) {
-		if (car(args).type == ATOM_TYPE_INTEGER) {
-			// Integer argument.
-			switch (num.type) {
-			case ATOM_TYPE_INTEGER:
-				num.value.integer += car(args).value.integer;
-				break;
-			case ATOM_TYPE_FLOAT:
-				num.value.dfloat += car(args).value.integer;
-				break;
-			default:
-				return BAMBOO_ERROR_UNKNOWN;
-			}
-		} else if (car(args).type == ATOM_TYPE_FLOAT) {
-			// Float argument. Check if we should change our atom type first.
-			if (num.type == ATOM_TYPE_INTEGER) {
-				num.type = ATOM_TYPE_FLOAT;
-				num.value.dfloat = (long double)num.value.integer;
+	// Get the length of the sequence.
+	if (car(args).type == ATOM_TYPE_VECTOR) {
+		len = (*car(args).value.vector)->len;
+	} else {
+		len = bamboo_list_count(car(args));
+	}
+	if (len == 0) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("Can't get the quantiles of an empty sequence"));
+	}
+
+	// Copy the sequence since the selection will shuffle it around.
+	data = (bamboo_float_t *)malloc(len * sizeof(bamboo_float_t));
+	if (data == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+			_T("buffer for the quantiles selection"));
+	}
+	n = 0;
+	err = numiter_init(&iter, car(args));
+	IF_NOT_ERROR(err) {
+		while ((n < len) && numiter_next(&iter, &x, &err))
+			data[n++] = x;
+	}
+	IF_ERROR(err) {
+		free(data);
+		return err;
+	}
+
+	// Go through the requested quantiles.
+	qs = car(cdr(args));
+	if (qs.type != ATOM_TYPE_PAIR)
+		qs = cons(qs, nil);
+	tail = nil;
+	while (!nilp(qs)) {
+		bamboo_float_t q;
+		bamboo_float_t h;
+		bamboo_float_t value;
+		size_t k;
+		size_t i;
+
+		// Get the quantile.
+		if ((qs.type != ATOM_TYPE_PAIR) || !atom_float_val(car(qs), &q) ||
+				!((q >= 0) && (q <= 1))) {
+			free(data);
+			*result = nil;
+			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+				_T("Quantiles must be numerics between 0 and 1"));
+		}
+
+		// Select the element just below the quantile.
+		h = (bamboo_float_t)(n - 1) * q;
+		k = (size_t)h;
+		value = select_nth(data, n, k);
+
+		// Linearly interpolate with the smallest element above it.
+		if ((h > (bamboo_float_t)k) && ((k + 1) < n)) {
+			bamboo_float_t next = data[k + 1];
+
+			for (i = k + 2; i < n; i++) {
+				if (data[i] < next)
+					next = data[i];
 			}
 
-			// Sum it up.
-			num.value.dfloat += car(args).value.dfloat;
+			value += (h - (bamboo_float_t)k) * (next - value);
+		}
+
+		// Append it to the result list.
+		if (car(cdr(args)).type != ATOM_TYPE_PAIR) {
+			*result = bamboo_float(value);
+		} else if (nilp(tail)) {
+			*result = cons(bamboo_float(value), nil);
+			tail = *result;
 		} else {
-			// Non-numeric argument.
-			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-				_T("Invalid type of argument. This function only accepts ")
-				_T("numerics"));
+			cdr(tail) = cons(bamboo_float(value), nil);
+			tail = cdr(tail);
 		}
 
-		// Go to the next argument.
-		args = cdr(args);
+		qs = cdr(qs);
 	}
 
-	// Return the result atom.
-	*result = num;
+	free(data);
 	return BAMBOO_OK;
 }
 
-// (- nums...) -> num
-bamboo_error_t builtin_subtract(atom_t args, atom_t *result) {
-	atom_t num;
-	bool first = true;
-
-	// Initialize the result atom.
-	num.type = ATOM_TYPE_INTEGER;
-	num.value.integer = 0;
+// (cumulative-sum seq) -> seq
+bamboo_error_t builtin_cumulative_sum(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	atom_t list;
+	atom_t tail;
+	atom_t acc;
 
 	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) < 2) {
+	*result = nil;
+	if (bamboo_list_count(args) != 1) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects at least 2 arguments"));
+			_T("This function expects a single argument"));
 	}
 
-	// Iterate through the arguments subtracting them.
-	while (!nilp(args)) {
-		if (car(args).type == ATOM_TYPE_INTEGER) {
-			// Integer argument.
-			if (first) {
-				// First iteration, so let's assign the first value first.
-				num.type = ATOM_TYPE_INTEGER;
-				num.value.integer = car(args).value.integer;
-				first = false;
-
-				goto next;
-			}
-
-			switch (num.type) {
-			case ATOM_TYPE_INTEGER:
-				num.value.integer -= car(args).value.integer;
+	// Numeric vectors produce a vector of the same type.
+	if (car(args).type == ATOM_TYPE_VECTOR) {
+		const vector_t *src = *car(args).value.vector;
+		vector_t *dst;
+		double fsum = 0;
+		int64_t isum = 0;
+		size_t i;
+
+		*result = bamboo_vector(src->type, src->len);
+		dst = *result->value.vector;
+		for (i = 0; i < src->len; i++) {
+			switch (src->type) {
+			case VECTOR_TYPE_F64:
+				fsum += src->data.f64[i];
+				dst->data.f64[i] = fsum;
 				break;
-			case ATOM_TYPE_FLOAT:
-				num.value.dfloat -= car(args).value.integer;
+			case VECTOR_TYPE_I64:
+				isum += src->data.i64[i];
+				dst->data.i64[i] = isum;
+				break;
+			case VECTOR_TYPE_F32:
+				fsum += src->data.f32[i];
+				dst->data.f32[i] = (float)fsum;
 				break;
-			default:
-				return BAMBOO_ERROR_UNKNOWN;
-			}
-		} else if (car(args).type == ATOM_TYPE_FLOAT) {
-			// Float argument.
-			if (first) {
-				// First iteration, so let's assign the first value first.
-				num.type = ATOM_TYPE_FLOAT;
-				num.value.dfloat = car(args).value.dfloat;
-				first = false;
-
-				goto next;
 			}
+		}
 
-			// Check if we should change our atom type first.
-			if (num.type == ATOM_TYPE_INTEGER) {
-				num.type = ATOM_TYPE_FLOAT;
-				num.value.dfloat = (long double)num.value.integer;
-			}
+		return BAMBOO_OK;
+	}
 
-			// Subtract it up.
-			num.value.dfloat -= car(args).value.dfloat;
-		} else {
-			// Non-numeric argument.
+	// Lists keep their exactness.
+	acc = bamboo_int(0);
+	tail = nil;
+	for (list = car(args); !nilp(list); list = cdr(list)) {
+		atom_t cell;
+
+		if (list.type != ATOM_TYPE_PAIR) {
+			*result = nil;
 			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
 				_T("Invalid type of argument. This function only accepts ")
-				_T("numerics"));
+				_T("lists or numeric vectors"));
 		}
 
-next:
-		// Go to the next argument.
-		args = cdr(args);
+		err = numeric_binop(NUMERIC_OP_SUM, acc, car(list), &acc);
+		IF_ERROR(err) {
+			*result = nil;
+			return err;
+		}
+
+		// Append the partial sum to the result list.
+		cell = cons(acc, nil);
+		if (nilp(tail)) {
+			*result = cell;
+		} else {
+			cdr(tail) = cell;
+		}
+		tail = cell;
 	}
 
-	// Return the result atom.
-	*result = num;
 	return BAMBOO_OK;
 }
 
-// (* nums...) -> num
-bamboo_error_t builtin_multiply(atom_t args, atom_t *result) {
-	atom_t num;
-	bool first = true;
+/**
+ * Checks if an atom should come before another one when sorting.
+ *
+ * @param  ctx Sorting context.
+ * @param  a   Atom that could come first.
+ * @param  b   Atom that could come last.
+ * @return     TRUE if A should come before B. FALSE if it shouldn't or if the
+ *             comparator raised an error, which is stored in the context.
+ */
+bool sort_less(sort_ctx_t *ctx, atom_t a, atom_t b) {
+	atom_t res;
 
-	// Initialize the result atom.
-	num.type = ATOM_TYPE_INTEGER;
-	num.value.integer = 0;
+	// Stop calling the comparator once it has failed.
+	IF_ERROR(ctx->err)
+		return false;
 
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) < 2) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects at least 2 arguments"));
+	// Compare the numbers directly or call the comparator function.
+	if (ctx->fast) {
+		ctx->err = numeric_binop(ctx->op, a, b, &res);
+	} else {
+		ctx->err = apply(ctx->less, cons(a, cons(b, nil)), &res);
 	}
+	IF_ERROR(ctx->err)
+		return false;
 
-	// Iterate through the arguments multiplying them.
-	while (!nilp(args)) {
-		if (car(args).type == ATOM_TYPE_INTEGER) {
-			// Integer argument.
-			if (first) {
-				// First iteration, so let's assign the first value first.
-				num.type = ATOM_TYPE_INTEGER;
-				num.value.integer = car(args).value.integer;
-				first = false;
-
-				goto next;
+	return atom_boolean_val(res);
+}
+
+/**
+ * Sets up a sorting context for a given comparator function.
+ *
+ * @param  ctx  Sorting context to be initialized.
+ * @param  less Comparator function that checks if an element should come
+ *              before another one.
+ * @return      BAMBOO_OK if the comparator can be used.
+ */
+bamboo_error_t sort_ctx_init(sort_ctx_t *ctx, atom_t less) {
+	ctx->less = less;
+	ctx->err = BAMBOO_OK;
+	ctx->fast = false;
+	ctx->op = NUMERIC_OP_LT;
+
+	// Check if we can actually call the comparator.
+	if ((less.type != ATOM_TYPE_BUILTIN) && (less.type != ATOM_TYPE_CLOSURE)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Comparator must be either a built-in or a closure"));
+	}
+
+	// Check if it's one of the numeric comparisons we can do ourselves.
+	if (less.type == ATOM_TYPE_BUILTIN) {
+		if (less.value.builtin == builtin_lt) {
+			ctx->fast = true;
+			ctx->op = NUMERIC_OP_LT;
+		} else if (less.value.builtin == builtin_gt) {
+			ctx->fast = true;
+			ctx->op = NUMERIC_OP_GT;
+		}
+	}
+
+	return BAMBOO_OK;
+}
+
+/**
+ * Stable merge of two adjacent sorted runs of list cells.
+ *
+ * @param ctx   Sorting context.
+ * @param cells Array of list cells.
+ * @param tmp   Scratch array with room for at least mid - lo cells.
+ * @param lo    Index of the first cell of the left run.
+ * @param mid   Index of the first cell of the right run.
+ * @param hi    Index just past the last cell of the right run.
+ */
+void sort_merge_cells(sort_ctx_t *ctx, atom_t *cells, atom_t *tmp, size_t lo,
+					  size_t mid, size_t hi) {
+	size_t i = 0;
+	size_t j = mid;
+	size_t out = lo;
+	size_t len = mid - lo;
+
+	// Move the left run out of the way.
+	memcpy(tmp, cells + lo, len * sizeof(atom_t));
+
+	// Only take from the right run when it's strictly less to keep it stable.
+	while ((i < len) && (j < hi)) {
+		if (sort_less(ctx, car(cells[j]), car(tmp[i]))) {
+			cells[out++] = cells[j++];
+		} else {
+			cells[out++] = tmp[i++];
+		}
+	}
+
+	// Put back whatever is left of the left run.
+	while (i < len)
+		cells[out++] = tmp[i++];
+}
+
+/**
+ * Sorts an array of list cells by their values using a natural merge sort,
+ * which takes advantage of any runs that are already in order.
+ *
+ * @param  ctx   Sorting context.
+ * @param  cells Array of list cells to be sorted.
+ * @param  len   Number of cells in the array.
+ * @return       BAMBOO_OK if the sort was successful.
+ */
+bamboo_error_t sort_list_cells(sort_ctx_t *ctx, atom_t *cells, size_t len) {
+	size_t *runs;
+	atom_t *tmp;
+	size_t nruns;
+	size_t i;
+
+	// Allocate our scratch space.
+	runs = (size_t *)malloc((len + 1) * sizeof(size_t));
+	tmp = (atom_t *)malloc(len * sizeof(atom_t));
+	if ((runs == NULL) || (tmp == NULL)) {
+		free(runs);
+		free(tmp);
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+			_T("scratch space for sorting"));
+	}
+
+	// Split the cells into runs, reversing the strictly descending ones.
+	nruns = 0;
+	i = 0;
+	while (i < len) {
+		size_t start = i++;
+
+		if ((i < len) && sort_less(ctx, car(cells[i]), car(cells[i - 1]))) {
+			size_t a;
+			size_t b;
+
+			while ((i < len) &&
+					sort_less(ctx, car(cells[i]), car(cells[i - 1]))) {
+				i++;
 			}
 
-			switch (num.type) {
-			case ATOM_TYPE_INTEGER:
-				num.value.integer *= car(args).value.integer;
-				break;
-			case ATOM_TYPE_FLOAT:
-				num.value.dfloat *= car(args).value.integer;
-				break;
-			default:
-				return BAMBOO_ERROR_UNKNOWN;
+			for (a = start, b = i - 1; a < b; a++, b--) {
+				atom_t swp = cells[a];
+				cells[a] = cells[b];
+				cells[b] = swp;
 			}
-		} else if (car(args).type == ATOM_TYPE_FLOAT) {
-			// Float argument.
-			if (first) {
-				// First iteration, so let's assign the first value first.
-				num.type = ATOM_TYPE_FLOAT;
-				num.value.dfloat = car(args).value.dfloat;
-				first = false;
-
-				goto next;
+		} else {
+			while ((i < len) &&
+					!sort_less(ctx, car(cells[i]), car(cells[i - 1]))) {
+				i++;
 			}
+		}
+
+		runs[nruns++] = start;
+	}
+	runs[nruns] = len;
+
+	// Merge adjacent runs until we only have one left.
+	while (nruns > 1) {
+		size_t merged = 0;
 
-			// Check if we should change our atom type first.
-			if (num.type == ATOM_TYPE_INTEGER) {
-				num.type = ATOM_TYPE_FLOAT;
-				num.value.dfloat = (long double)num.value.integer;
+		for (i = 0; i < nruns; i += 2) {
+			if ((i + 1) < nruns) {
+				sort_merge_cells(ctx, cells, tmp, runs[i], runs[i + 1],
+					runs[i + 2]);
 			}
 
-			// Multiply it up.
-			num.value.dfloat *= car(args).value.dfloat;
-		} else {
-			// Non-numeric argument.
-			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-				_T("Invalid type of argument. This function only accepts ")
-				_T("numerics"));
+			runs[merged++] = runs[i];
 		}
 
-next:
-		// Go to the next argument.
-		args = cdr(args);
+		runs[merged] = len;
+		nruns = merged;
 	}
 
-	// Return the result atom.
-	*result = num;
-	return BAMBOO_OK;
+	free(runs);
+	free(tmp);
+
+	return ctx->err;
 }
 
-// (/ nums...) -> num
-bamboo_error_t builtin_divide(atom_t args, atom_t *result) {
-	atom_t num;
-	bool first = true;
+/**
+ * Checks if an element of a numeric vector should come before another one.
+ *
+ * @param  ctx Sorting context.
+ * @param  vec Vector being sorted.
+ * @param  i   Index of the element that could come first.
+ * @param  j   Index of the element that could come last.
+ * @return     TRUE if the element at I should come before the one at J.
+ */
+bool sort_vector_less(sort_ctx_t *ctx, const vector_t *vec, size_t i,
+					  size_t j) {
+	// Compare the raw numbers if we are using a numeric comparison.
+	if (ctx->fast) {
+		switch (vec->type) {
+		case VECTOR_TYPE_F64:
+			return (ctx->op == NUMERIC_OP_LT) ?
+				(vec->data.f64[i] < vec->data.f64[j]) :
+				(vec->data.f64[i] > vec->data.f64[j]);
+		case VECTOR_TYPE_I64:
+			return (ctx->op == NUMERIC_OP_LT) ?
+				(vec->data.i64[i] < vec->data.i64[j]) :
+				(vec->data.i64[i] > vec->data.i64[j]);
+		case VECTOR_TYPE_F32:
+			return (ctx->op == NUMERIC_OP_LT) ?
+				(vec->data.f32[i] < vec->data.f32[j]) :
+				(vec->data.f32[i] > vec->data.f32[j]);
+		}
+	}
 
-	// Initialize the result atom.
-	num.type = ATOM_TYPE_FLOAT;
-	num.value.dfloat = (long double)0;
+	return sort_less(ctx, vector_elem(vec, i), vector_elem(vec, j));
+}
 
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) < 2) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects at least 2 arguments"));
+/**
+ * Swaps two elements of a numeric vector.
+ *
+ * @param vec Vector to have its elements swapped.
+ * @param i   Index of the first element.
+ * @param j   Index of the second element.
+ */
+void sort_vector_swap(vector_t *vec, size_t i, size_t j) {
+	switch (vec->type) {
+	case VECTOR_TYPE_F64: {
+		double tmp = vec->data.f64[i];
+		vec->data.f64[i] = vec->data.f64[j];
+		vec->data.f64[j] = tmp;
+		break;
+	}
+	case VECTOR_TYPE_I64: {
+		int64_t tmp = vec->data.i64[i];
+		vec->data.i64[i] = vec->data.i64[j];
+		vec->data.i64[j] = tmp;
+		break;
+	}
+	case VECTOR_TYPE_F32: {
+		float tmp = vec->data.f32[i];
+		vec->data.f32[i] = vec->data.f32[j];
+		vec->data.f32[j] = tmp;
+		break;
+	}
 	}
+}
 
-	// Iterate through the arguments dividing them.
-	while (!nilp(args)) {
-		if (car(args).type == ATOM_TYPE_INTEGER) {
-			// Integer argument.
-			if (first) {
-				// First iteration, so let's assign the first value first.
-				num.value.dfloat = (long double)car(args).value.integer;
-				first = false;
-
-				goto next;
-			}
+/**
+ * Sorts a range of a numeric vector in place using heapsort. Used by the
+ * introsort when quicksort starts to go quadratic.
+ *
+ * @param ctx Sorting context.
+ * @param vec Vector to be sorted.
+ * @param lo  Index of the first element of the range.
+ * @param hi  Index just past the last element of the range.
+ */
+void sort_vector_heap(sort_ctx_t *ctx, vector_t *vec, size_t lo, size_t hi) {
+	size_t len = hi - lo;
+	size_t start;
+	size_t end;
 
-			num.value.dfloat /= (long double)car(args).value.integer;
-		} else if (car(args).type == ATOM_TYPE_FLOAT) {
-			// Float argument.
-			if (first) {
-				// First iteration, so let's assign the first value first.
-				num.value.dfloat = car(args).value.dfloat;
-				first = false;
+	// Build the heap and then pop its root until it's empty.
+	for (start = len / 2, end = len; end > 1;) {
+		size_t root;
 
-				goto next;
-			}
+		if (start > 0) {
+			start--;
+		} else {
+			end--;
+			sort_vector_swap(vec, lo, lo + end);
+		}
 
-			// Check if we should change our atom type first.
-			if (num.type == ATOM_TYPE_INTEGER) {
-				num.type = ATOM_TYPE_FLOAT;
-				num.value.dfloat = (long double)num.value.integer;
+		// Sift the root down.
+		root = start;
+		while (((root * 2) + 1) < end) {
+			size_t child = (root * 2) + 1;
+
+			if (((child + 1) < end) &&
+					sort_vector_less(ctx, vec, lo + child, lo + child + 1)) {
+				child++;
 			}
+			if (!sort_vector_less(ctx, vec, lo + root, lo + child))
+				break;
 
-			// Divide it up.
-			num.value.dfloat /= car(args).value.dfloat;
-		} else {
-			// Non-numeric argument.
-			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-				_T("Invalid type of argument. This function only accepts ")
-				_T("numerics"));
+			sort_vector_swap(vec, lo + root, lo + child);
+			root = child;
 		}
-
-next:
-		// Go to the next argument.
-		args = cdr(args);
 	}
-
-	// Return the result atom.
-	*result = num;
-	return BAMBOO_OK;
 }
 
-// (expt x y) -> num
-bamboo_error_t builtin_expt(atom_t args, atom_t *result) {
-	atom_t nx;
-	atom_t ny;
+/**
+ * Sorts a range of a numeric vector in place using introsort.
+ *
+ * @param ctx   Sorting context.
+ * @param vec   Vector to be sorted.
+ * @param lo    Index of the first element of the range.
+ * @param hi    Index just past the last element of the range.
+ * @param depth How many more times we can partition before giving up on
+ *              quicksort and falling back to heapsort.
+ */
+void sort_vector_intro(sort_ctx_t *ctx, vector_t *vec, size_t lo, size_t hi,
+					   uint8_t depth) {
+	size_t i;
+	size_t j;
 
-	// Check if we have the right number of arguments.
-	*result = nil;
-	if (bamboo_list_count(args) != 2) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 2 arguments"));
-	}
+	while ((hi - lo) > SORT_INSERTION_THRESHOLD) {
+		size_t mid = lo + ((hi - lo) / 2);
 
-	// Get the X argument.
-	nx = car(args);
-	if (nx.type == ATOM_TYPE_INTEGER) {
-		// Looks like we need to convert this to a float atom first.
-		nx.type = ATOM_TYPE_FLOAT;
-		nx.value.dfloat = (long double)nx.value.integer;
-	} else if (nx.type != ATOM_TYPE_FLOAT) {
-		// Doesn't look like a numeric to me...
-		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-			_T("Invalid type of argument. This function only accepts ")
-			_T("numerics"));
+		// Looks like we are going quadratic.
+		if (depth-- == 0) {
+			sort_vector_heap(ctx, vec, lo, hi);
+			return;
+		}
+
+		// Put the median of the first, middle and last elements in front.
+		if (sort_vector_less(ctx, vec, mid, lo))
+			sort_vector_swap(vec, mid, lo);
+		if (sort_vector_less(ctx, vec, hi - 1, mid)) {
+			sort_vector_swap(vec, hi - 1, mid);
+			if (sort_vector_less(ctx, vec, mid, lo))
+				sort_vector_swap(vec, mid, lo);
+		}
+		sort_vector_swap(vec, lo, mid);
+
+		// Partition the range around the pivot.
+		i = lo + 1;
+		j = hi - 1;
+		for (;;) {
+			while ((i <= j) && sort_vector_less(ctx, vec, i, lo))
+				i++;
+			while ((i <= j) && sort_vector_less(ctx, vec, lo, j))
+				j--;
+			if (i >= j)
+				break;
+
+			sort_vector_swap(vec, i++, j--);
+		}
+		sort_vector_swap(vec, lo, j);
+
+		// Recurse into the smaller side and loop over the bigger one.
+		if ((j - lo) < (hi - j)) {
+			sort_vector_intro(ctx, vec, lo, j, depth);
+			lo = j + 1;
+		} else {
+			sort_vector_intro(ctx, vec, j + 1, hi, depth);
+			hi = j;
+		}
 	}
 
-	// Get the Y argument.
-	ny = car(cdr(args));
-	if (ny.type == ATOM_TYPE_INTEGER) {
-		// Looks like we need to convert this to a float atom first.
-		ny.type = ATOM_TYPE_FLOAT;
-		ny.value.dfloat = (long double)ny.value.integer;
-	} else if (ny.type != ATOM_TYPE_FLOAT) {
-		// Doesn't look like a numeric to me...
-		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-			_T("Invalid type of argument. This function only accepts ")
-			_T("numerics"));
+	// Finish small ranges with an insertion sort.
+	for (i = lo + 1; i < hi; i++) {
+		for (j = i; (j > lo) && sort_vector_less(ctx, vec, j, j - 1); j--)
+			sort_vector_swap(vec, j, j - 1);
 	}
+}
 
-	// Set the result atom.
-	result->type = ATOM_TYPE_FLOAT;
-	result->value.dfloat = powl(nx.value.dfloat, ny.value.dfloat);
+/**
+ * Sorts a numeric vector in place.
+ *
+ * @param  ctx Sorting context.
+ * @param  vec Vector to be sorted.
+ * @return     BAMBOO_OK if the sort was successful.
+ */
+bamboo_error_t sort_vector(sort_ctx_t *ctx, vector_t *vec) {
+	uint8_t depth = 0;
+	size_t len;
 
-	return BAMBOO_OK;
+	// Limit the recursion depth to twice the logarithm of the length.
+	for (len = vec->len; len > 1; len >>= 1)
+		depth += 2;
+
+	sort_vector_intro(ctx, vec, 0, vec->len, depth);
+	return ctx->err;
 }
 
-// (mod x y) -> num
-bamboo_error_t builtin_modulo(atom_t args, atom_t *result) {
-	*result = nil;
+/**
+ * Sorts a list or a numeric vector using a comparator function.
+ *
+ * @param  args     Arguments passed to the built-in: the sequence and the
+ *                  comparator.
+ * @param  in_place Should we reuse the sequence's storage instead of creating
+ *                  a new one?
+ * @param  result   Sorted sequence.
+ * @return          BAMBOO_OK if the sort was successful.
+ */
+bamboo_error_t sort_seq(atom_t args, bool in_place, atom_t *result) {
+	bamboo_error_t err;
+	sort_ctx_t ctx;
+	atom_t *cells;
+	atom_t seq;
+	atom_t list;
+	size_t len;
+	size_t i;
 
 	// Check if we have the right number of arguments.
+	*result = nil;
 	if (bamboo_list_count(args) != 2) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 2 arguments"));
+			_T("This function expects a sequence and a comparator"));
 	}
+	seq = car(args);
+	err = sort_ctx_init(&ctx, car(cdr(args)));
+	IF_ERROR(err)
+		return err;
 
-	// Perform the calculation.
-	if (car(args).type == ATOM_TYPE_INTEGER) {
-		// X is an integer.
-		result->type = ATOM_TYPE_FLOAT;
+	// Numeric vectors are sorted with an introsort.
+	if (seq.type == ATOM_TYPE_VECTOR) {
+		const vector_t *src = *seq.value.vector;
+		vector_t copy;
+		size_t size;
+
+		// Sorting in place is straightforward.
+		if (in_place) {
+			if (gc_frozen_p(seq)) {
+				return bamboo_error(BAMBOO_ERROR_READ_ONLY,
+					_T("Can't sort a read-only vector in place"));
+			}
 
-		// Actually calculate the modulo.
-		if (car(cdr(args)).type == ATOM_TYPE_INTEGER) {
-			// Both are integer.
-			result->value.dfloat = fmodl((long double)car(args).value.integer,
-				(long double)car(cdr(args)).value.integer);
-		} else if (car(cdr(args)).type == ATOM_TYPE_FLOAT) {
-			// Y is float, so we need to make sure the function returns a float.
-			result->value.dfloat = fmodl((long double)result->value.integer,
-				car(cdr(args)).value.dfloat);
+			err = sort_vector(&ctx, *seq.value.vector);
+			IF_NOT_ERROR(err)
+				*result = seq;
+			return err;
 		}
 
-		return BAMBOO_OK;
-	} else if (car(args).type == ATOM_TYPE_FLOAT) {
-		// X is an float.
-		result->type = ATOM_TYPE_FLOAT;
-
-		// Actually calculate the modulo.
-		if (car(cdr(args)).type == ATOM_TYPE_FLOAT) {
-			// Both are floats.
-			result->value.dfloat = fmodl(car(args).value.dfloat,
-				car(cdr(args)).value.dfloat);
-		} else if (car(cdr(args)).type == ATOM_TYPE_INTEGER) {
-			// Y is an integer.
-			result->value.dfloat = fmodl(car(args).value.dfloat,
-				(long double)car(cdr(args)).value.integer);
+		// Sort a copy that's out of reach of the garbage collector.
+		copy = *src;
+		size = src->len * vector_elem_size(src->type);
+		copy.data.raw = malloc((size > 0) ? size : 1);
+		if (copy.data.raw == NULL) {
+			return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+				_T("scratch space for sorting"));
+		}
+		memcpy(copy.data.raw, src->data.raw, size);
+		err = sort_vector(&ctx, &copy);
+		IF_NOT_ERROR(err) {
+			*result = bamboo_vector(copy.type, copy.len);
+			memcpy((*result->value.vector)->data.raw, copy.data.raw, size);
 		}
 
-		return BAMBOO_OK;
+		free(copy.data.raw);
+		return err;
 	}
 
-	// Doesn't look like a numeric to me...
-	return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-		_T("Invalid type of argument. This function only accepts ")
-		_T("numerics"));
-}
+	// Check if we are dealing with a proper list.
+	len = 0;
+	for (list = seq; !nilp(list); list = cdr(list)) {
+		if (list.type != ATOM_TYPE_PAIR) {
+			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+				_T("Invalid type of argument. This function only accepts ")
+				_T("lists or numeric vectors"));
+		}
+		if (in_place && gc_frozen_p(list)) {
+			return bamboo_error(BAMBOO_ERROR_READ_ONLY,
+				_T("Can't sort a read-only list in place"));
+		}
 
-// (floor x) -> int
-bamboo_error_t builtin_floor(atom_t args, atom_t *result) {
-	*result = nil;
+		// Only compare numbers directly if they all are numbers.
+		if (!INTEGRAL_P(car(list)) && (car(list).type != ATOM_TYPE_FLOAT))
+			ctx.fast = false;
 
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects a single argument"));
+		len++;
 	}
-
-	// Round the number.
-	result->type = ATOM_TYPE_INTEGER;
-	if (car(args).type == ATOM_TYPE_INTEGER) {
-		// Number is an integer.
-		result->value.integer = car(args).value.integer;
-		return BAMBOO_OK;
-	} else if (car(args).type == ATOM_TYPE_FLOAT) {
-		// Number is an float.
-		result->value.integer = (int64_t)floorl(car(args).value.dfloat);
+	if (len < 2) {
+		*result = seq;
 		return BAMBOO_OK;
 	}
 
-	// Doesn't look like a numeric to me...
-	*result = nil;
-	return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-		_T("Invalid type of argument. This function only accepts ")
-		_T("numerics"));
-}
-
-// (round x) -> int
-bamboo_error_t builtin_round(atom_t args, atom_t *result) {
-	*result = nil;
-
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects a single argument"));
+	// Gather up the cells of the list.
+	cells = (atom_t *)malloc(len * sizeof(atom_t));
+	if (cells == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
+			_T("scratch space for sorting"));
+	}
+	for (i = 0, list = seq; i < len; i++, list = cdr(list))
+		cells[i] = list;
+
+	// Sort the cells without touching the list, since the comparator may
+	// still look at it.
+	err = sort_list_cells(&ctx, cells, len);
+	IF_ERROR(err) {
+		free(cells);
+		return err;
 	}
 
-	// Round the number.
-	result->type = ATOM_TYPE_INTEGER;
-	if (car(args).type == ATOM_TYPE_INTEGER) {
-		// Number is an integer.
-		result->value.integer = car(args).value.integer;
-		return BAMBOO_OK;
-	} else if (car(args).type == ATOM_TYPE_FLOAT) {
-		// Number is an float.
-		result->value.integer = (int64_t)roundl(car(args).value.dfloat);
-		return BAMBOO_OK;
+	// Relink the original cells or build a brand new list.
+	if (in_place) {
+		for (i = 0; i < (len - 1); i++)
+			cdr(cells[i]) = cells[i + 1];
+		cdr(cells[len - 1]) = nil;
+		*result = cells[0];
+	} else {
+		*result = nil;
+		for (i = len; i > 0; i--)
+			*result = cons(car(cells[i - 1]), *result);
 	}
 
-	// Doesn't look like a numeric to me...
-	*result = nil;
-	return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-		_T("Invalid type of argument. This function only accepts ")
-		_T("numerics"));
+	free(cells);
+	return BAMBOO_OK;
 }
 
-// (ceil x) -> int
-bamboo_error_t builtin_ceil(atom_t args, atom_t *result) {
-	*result = nil;
-
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects a single argument"));
-	}
-
-	// Round the number.
-	result->type = ATOM_TYPE_INTEGER;
-	if (car(args).type == ATOM_TYPE_INTEGER) {
-		// Number is an integer.
-		result->value.integer = car(args).value.integer;
-		return BAMBOO_OK;
-	} else if (car(args).type == ATOM_TYPE_FLOAT) {
-		// Number is an float.
-		result->value.integer = (int64_t)ceill(car(args).value.dfloat);
-		return BAMBOO_OK;
-	}
+// (sort seq less?) -> seq
+bamboo_error_t builtin_sort(atom_t args, atom_t *result) {
+	return sort_seq(args, false, result);
+}
 
-	// Doesn't look like a numeric to me...
-	*result = nil;
-	return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-		_T("Invalid type of argument. This function only accepts ")
-		_T("numerics"));
+// (sort! seq less?) -> seq
+bamboo_error_t builtin_sort_in_place(atom_t args, atom_t *result) {
+	return sort_seq(args, true, result);
 }
 
-// (not bool) -> bool
-bamboo_error_t builtin_not(atom_t args, atom_t *result) {
+// (serialize expr) -> string
+bamboo_error_t builtin_serialize(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	string_t *string;
+	uint8_t *buf;
+	size_t len;
+	size_t i;
+
 	// Check if we have the right number of arguments.
+	*result = nil;
 	if (bamboo_list_count(args) != 1) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects exactly 1 argument"));
+			_T("This function expects 1 argument"));
 	}
 
-	// Populate the result atom.
-	result->type = ATOM_TYPE_BOOLEAN;
-	result->value.boolean = !atom_boolean_val(car(args));
+	// Serialize the expression.
+	err = bamboo_serialize(car(args), &buf, &len);
+	IF_ERROR(err)
+		return err;
+
+	// Store each byte as a character of the resulting string.
+	string = string_alloc(len);
+	if (string == NULL) {
+		free(buf);
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+			_T("Can't allocate serialized string"));
+	}
+	for (i = 0; i < len; i++)
+		((TCHAR *)string->chars)[i] = (TCHAR)buf[i];
+	free(buf);
 
+	*result = string_atom(string);
 	return BAMBOO_OK;
 }
 
-// (and bool...) -> bool
-bamboo_error_t builtin_and(atom_t args, atom_t *result) {
-	atom_t prev_atom;
+// (deserialize str) -> expr
+bamboo_error_t builtin_deserialize(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	const string_t *string;
+	uint8_t *buf;
+	size_t i;
 
 	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) < 2) {
+	*result = nil;
+	if (bamboo_list_count(args) != 1) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects at least 2 arguments"));
+			_T("This function expects 1 argument"));
 	}
 
-	// Iterate through the arguments checking them.
-	prev_atom = car(args);
-	args = cdr(args);
-	while (!nilp(args)) {
-		// We only need a single false value.
-		if (atom_boolean_val(prev_atom) != atom_boolean_val(car(args))) {
-			*result = bamboo_boolean(false);
-			return BAMBOO_OK;
-		}
-
-		// Go to the next argument.
-		prev_atom = car(args);
-		args = cdr(args);
+	// Check the argument type.
+	if (car(args).type != ATOM_TYPE_STRING) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("This function only accepts strings"));
 	}
+	string = *car(args).value.str;
 
-	// Looks like they were all true all along.
-	*result = bamboo_boolean(true);
-	return BAMBOO_OK;
-}
-
-// (or bool...) -> bool
-bamboo_error_t builtin_or(atom_t args, atom_t *result) {
-	atom_t prev_atom;
-
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) < 2) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects at least 2 arguments"));
+	// Narrow strings already are the bytes we're looking for.
+	if (sizeof(TCHAR) == 1) {
+		return bamboo_deserialize((const uint8_t *)string->chars, string->len,
+			result);
 	}
 
-	// Iterate through the arguments checking them.
-	prev_atom = car(args);
-	args = cdr(args);
-	while (!nilp(args)) {
-		// We only need a single true value.
-		if (atom_boolean_val(prev_atom) || atom_boolean_val(car(args))) {
-			*result = bamboo_boolean(true);
-			return BAMBOO_OK;
+	// Turn each character back into a byte.
+	buf = (uint8_t *)malloc(string->len + 1);
+	if (buf == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+			_T("Can't allocate deserialization buffer"));
+	}
+	for (i = 0; i < string->len; i++) {
+		if ((string->chars[i] < 0) || (string->chars[i] > 0xFF)) {
+			free(buf);
+			return bamboo_error(BAMBOO_ERROR_SYNTAX,
+				_T("Serialized strings may only contain bytes"));
 		}
-
-		// Go to the next argument.
-		prev_atom = car(args);
-		args = cdr(args);
+		buf[i] = (uint8_t)string->chars[i];
 	}
 
-	// Looks like they were all false all along.
-	*result = bamboo_boolean(false);
-	return BAMBOO_OK;
+	err = bamboo_deserialize(buf, string->len, result);
+	free(buf);
+
+	return err;
 }
 
-// (= nums...) -> bool
-bamboo_error_t builtin_numeq(atom_t args, atom_t *result) {
-	atom_t prev_num;
+// (pmap func list [workers]) -> list
+bamboo_error_t builtin_pmap(atom_t args, atom_t *result) {
+	size_t argc;
+	atom_t workers;
 
 	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) < 2) {
+	*result = nil;
+	argc = bamboo_list_count(args);
+	if ((argc < 2) || (argc > 3)) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects at least 2 arguments"));
+			_T("This function expects a function, a list and optionally the ")
+			_T("number of workers"));
 	}
 
-	// Iterate through the arguments checking them.
-	prev_num = car(args);
-	args = cdr(args);
-	while (!nilp(args)) {
-		if (car(args).type == ATOM_TYPE_INTEGER) {
-			if (prev_num.type == ATOM_TYPE_INTEGER) {
-				// int == int.
-				if (prev_num.value.integer == car(args).value.integer)
-					goto next;
-			} else {
-				// float == int.
-				if (prev_num.value.dfloat == (long double)car(args).value.integer)
-					goto next;
-			}
-
-			*result = bamboo_boolean(false);
-			return BAMBOO_OK;
-		} else if (car(args).type == ATOM_TYPE_FLOAT) {
-			if (prev_num.type == ATOM_TYPE_INTEGER) {
-				// float == int.
-				if ((long double)prev_num.value.integer == car(args).value.dfloat)
-					goto next;
-			} else {
-				// float == float.
-				if (prev_num.value.dfloat == car(args).value.dfloat)
-					goto next;
-			}
-
-			*result = bamboo_boolean(false);
-				return BAMBOO_OK;
-		} else {
-			// Non-numeric argument.
+	// Check the number of workers.
+	workers = bamboo_int(0);
+	if (argc == 3) {
+		workers = car(cdr(cdr(args)));
+		if ((workers.type != ATOM_TYPE_INTEGER) ||
+				(workers.value.integer < 0)) {
 			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-				_T("Invalid type of argument. This function only accepts ")
-				_T("numerics"));
+				_T("Number of workers must be a non-negative integer"));
 		}
+	}
 
-next:
-		// Go to the next argument.
-		prev_num = car(args);
-		args = cdr(args);
+	return bamboo_pmap(car(args), car(cdr(args)),
+		(size_t)workers.value.integer, result);
+}
+
+// (spawn func arg ...) -> nil
+bamboo_error_t builtin_spawn(atom_t args, atom_t *result) {
+	task_t *task;
+	atom_t func;
+	atom_t rev;
+
+	// Check if we have a function to run.
+	*result = nil;
+	if (nilp(args)) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects at least 1 argument"));
+	}
+	func = car(args);
+	if ((func.type != ATOM_TYPE_CLOSURE) && (func.type != ATOM_TYPE_BUILTIN)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Argument 0 should be a function"));
 	}
 
-	// Looks like they were all equal all along.
-	*result = bamboo_boolean(true);
+	// Allocate the task.
+	task = (task_t *)calloc(1, sizeof(task_t));
+	if (task == NULL) {
+		return bamboo_error(BAMBOO_ERROR_ALLOCATION,
+			_T("Can't allocate task"));
+	}
+	task->spawned = true;
+	task->id = ++bamboo_ctx->task_ids;
+	task->next_task = bamboo_ctx->tasks;
+	if (bamboo_ctx->tasks != NULL)
+		bamboo_ctx->tasks->prev_task = task;
+	bamboo_ctx->tasks = task;
+
+	// Start it off as a call to the function that has just had its arguments
+	// evaluated, which are kept in reverse order.
+	rev = nil;
+	for (args = cdr(args); !nilp(args); args = cdr(args))
+		rev = cons(car(args), rev);
+	task->stack = new_stack_frame(nil, nil, nil);
+	bamboo_list_set(task->stack, STACK_EVAL_ARGS_INDEX, rev);
+	task_ready(task, func);
+
 	return BAMBOO_OK;
 }
 
-// (< nums...) -> bool
-bamboo_error_t builtin_lt(atom_t args, atom_t *result) {
-	atom_t prev_num;
-
+// (yield) -> nil
+bamboo_error_t builtin_yield(atom_t args, atom_t *result) {
 	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) < 2) {
+	*result = nil;
+	if (!nilp(args)) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects at least 2 arguments"));
+			_T("This function doesn't take any arguments"));
 	}
 
-	// Iterate through the arguments checking them.
-	prev_num = car(args);
-	args = cdr(args);
-	while (!nilp(args)) {
-		if (car(args).type == ATOM_TYPE_INTEGER) {
-			if (prev_num.type == ATOM_TYPE_INTEGER) {
-				// int == int.
-				if (prev_num.value.integer < car(args).value.integer)
-					goto next;
-			} else {
-				// float == int.
-				if (prev_num.value.dfloat < (long double)car(args).value.integer)
-					goto next;
-			}
+	// Just carry on if there's nobody else to run.
+	if ((bamboo_ctx->run_head == NULL) || !task_can_wait())
+		return BAMBOO_OK;
 
-			*result = bamboo_boolean(false);
-			return BAMBOO_OK;
-		} else if (car(args).type == ATOM_TYPE_FLOAT) {
-			if (prev_num.type == ATOM_TYPE_INTEGER) {
-				// float == int.
-				if ((long double)prev_num.value.integer < car(args).value.dfloat)
-					goto next;
-			} else {
-				// float == float.
-				if (prev_num.value.dfloat < car(args).value.dfloat)
-					goto next;
-			}
+	bamboo_ctx->task_wait.status = TASK_READY;
+	return BAMBOO_SUSPENDED;
+}
 
-			*result = bamboo_boolean(false);
-				return BAMBOO_OK;
-		} else {
-			// Non-numeric argument.
-			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-				_T("Invalid type of argument. This function only accepts ")
-				_T("numerics"));
-		}
+// (make-channel [capacity]) -> channel
+bamboo_error_t builtin_make_channel(atom_t args, atom_t *result) {
+	size_t argc;
+	atom_t capacity;
 
-next:
-		// Go to the next argument.
-		prev_num = car(args);
-		args = cdr(args);
+	// Check if we have the right number of arguments.
+	*result = nil;
+	argc = bamboo_list_count(args);
+	if (argc > 1) {
+		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
+			_T("This function expects at most 1 argument"));
 	}
 
-	// Looks like they were all equal all along.
-	*result = bamboo_boolean(true);
+	// Check the capacity.
+	capacity = (argc == 1) ? car(args) : bamboo_int(0);
+	if ((capacity.type != ATOM_TYPE_INTEGER) ||
+			(capacity.value.integer < 0)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Capacity must be a non-negative integer"));
+	}
+
+	*result = channel_new(capacity.value.integer);
 	return BAMBOO_OK;
 }
 
-// (> nums...) -> bool
-bamboo_error_t builtin_gt(atom_t args, atom_t *result) {
-	atom_t prev_num;
+// (channel-send chan value) -> value
+bamboo_error_t builtin_channel_send(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	task_t *task;
+	atom_t channel;
+	atom_t value;
 
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) < 2) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects at least 2 arguments"));
-	}
+	// Check the arguments.
+	*result = nil;
+	err = channel_arg(args, 2, &channel);
+	IF_ERROR(err)
+		return err;
+	value = car(cdr(args));
+	*result = value;
 
-	// Iterate through the arguments checking them.
-	prev_num = car(args);
-	args = cdr(args);
-	while (!nilp(args)) {
-		if (car(args).type == ATOM_TYPE_INTEGER) {
-			if (prev_num.type == ATOM_TYPE_INTEGER) {
-				// int == int.
-				if (prev_num.value.integer > car(args).value.integer)
-					goto next;
-			} else {
-				// float == int.
-				if (prev_num.value.dfloat > (long double)car(args).value.integer)
-					goto next;
-			}
+	// Hand it straight to a task that's waiting for it.
+	task = channel_waiter(channel, TASK_RECEIVING);
+	if (task != NULL) {
+		channel_unwait(channel, task);
+		task_ready(task, value);
 
-			*result = bamboo_boolean(false);
-			return BAMBOO_OK;
-		} else if (car(args).type == ATOM_TYPE_FLOAT) {
-			if (prev_num.type == ATOM_TYPE_INTEGER) {
-				// float == int.
-				if ((long double)prev_num.value.integer > car(args).value.dfloat)
-					goto next;
-			} else {
-				// float == float.
-				if (prev_num.value.dfloat > car(args).value.dfloat)
-					goto next;
-			}
+		return BAMBOO_OK;
+	}
 
-			*result = bamboo_boolean(false);
-				return BAMBOO_OK;
-		} else {
-			// Non-numeric argument.
-			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-				_T("Invalid type of argument. This function only accepts ")
-				_T("numerics"));
-		}
+	// Hold on to it if there's still room.
+	if (bamboo_list_ref(channel, CHANNEL_COUNT_INDEX).value.integer <
+			bamboo_list_ref(channel, CHANNEL_CAPACITY_INDEX).value.integer) {
+		channel_push(channel, value);
+		return BAMBOO_OK;
+	}
 
-next:
-		// Go to the next argument.
-		prev_num = car(args);
-		args = cdr(args);
+	// Wait for someone to take it.
+	if (!task_can_wait()) {
+		return bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Channel is full and ")
+			_T("this evaluation can't wait for it"));
 	}
+	bamboo_ctx->task_wait.status = TASK_SENDING;
+	bamboo_ctx->task_wait.channel = channel;
+	bamboo_ctx->task_wait.value = value;
 
-	// Looks like they were all equal all along.
-	*result = bamboo_boolean(true);
-	return BAMBOO_OK;
+	return BAMBOO_SUSPENDED;
 }
 
-// (eq? a b) -> boolean
-bamboo_error_t builtin_eq(atom_t args, atom_t *result) {
-	atom_t a;
-	atom_t b;
+// (channel-recv chan) -> value
+bamboo_error_t builtin_channel_recv(atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	task_t *task;
+	atom_t channel;
 
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 2) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 2 arguments"));
+	// Check the arguments.
+	*result = nil;
+	err = channel_arg(args, 1, &channel);
+	IF_ERROR(err)
+		return err;
+
+	// Take the oldest value that's being held.
+	task = channel_waiter(channel, TASK_SENDING);
+	if (bamboo_list_ref(channel, CHANNEL_COUNT_INDEX).value.integer > 0) {
+		*result = channel_pop(channel);
+
+		// Make room for a task that was waiting to send something.
+		if (task != NULL) {
+			channel_unwait(channel, task);
+			channel_push(channel, task->value);
+			task_ready(task, task->value);
+		}
+
+		return BAMBOO_OK;
 	}
 
-	// Get the two atoms to be tested.
-	a = car(args);
-	b = car(cdr(args));
+	// Take it straight from a task that's waiting to send it.
+	if (task != NULL) {
+		channel_unwait(channel, task);
+		*result = task->value;
+		task_ready(task, task->value);
 
-	// If the types are different then it's instantly different.
-	if (a.type != b.type) {
-		*result = bamboo_boolean(false);
 		return BAMBOO_OK;
 	}
 
-	// Check for more equality.
-	switch (a.type) {
-	case ATOM_TYPE_NIL:
-		*result = bamboo_boolean(true);
-		break;
-	case ATOM_TYPE_PAIR:
-	case ATOM_TYPE_CLOSURE:
-	case ATOM_TYPE_MACRO:
-		*result = bamboo_boolean(a.value.pair == b.value.pair);
-		break;
-	case ATOM_TYPE_SYMBOL:
-		*result = bamboo_boolean(*a.value.symbol == *b.value.symbol);
-		break;
-	case ATOM_TYPE_STRING:
-		*result = bamboo_boolean(_tcscmp(*a.value.str, *b.value.str) == 0);
-		break;
-	case ATOM_TYPE_BOOLEAN:
-		*result = bamboo_boolean(a.value.boolean == b.value.boolean);
-		break;
-	case ATOM_TYPE_INTEGER:
-		*result = bamboo_boolean(a.value.integer == b.value.integer);
-		break;
-	case ATOM_TYPE_FLOAT:
-		*result = bamboo_boolean(a.value.dfloat == b.value.dfloat);
-		break;
-	case ATOM_TYPE_BUILTIN:
-		*result = bamboo_boolean(a.value.builtin == b.value.builtin);
-		break;
+	// Wait for someone to send something.
+	if (!task_can_wait()) {
+		return bamboo_error(BAMBOO_ERROR_UNKNOWN, _T("Channel is empty and ")
+			_T("this evaluation can't wait for it"));
 	}
+	bamboo_ctx->task_wait.status = TASK_RECEIVING;
+	bamboo_ctx->task_wait.channel = channel;
+	bamboo_ctx->task_wait.value = nil;
 
-	return BAMBOO_OK;
+	return BAMBOO_SUSPENDED;
 }
 
-// (nil? atom) -> boolean
-bamboo_error_t builtin_nilp(atom_t args, atom_t *result) {
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 1 argument"));
-	}
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                          Miscellaneous Utilities                           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
 
-	*result = bamboo_boolean(car(args).type == ATOM_TYPE_NIL);
-	return BAMBOO_OK;
+/**
+ * Gets the boolean value of a given atom.
+ *
+ * @param  atom Atom to get its boolean value.
+ * @return      TRUE if the atom is of type boolean and is true, or if its any
+ *              other type of atom. FALSE only for a false boolean atom.
+ */
+bool atom_boolean_val(atom_t atom) {
+	// All non-boolean atoms are true.
+	if (atom.type != ATOM_TYPE_BOOLEAN)
+		return true;
+
+	return atom.value.boolean;
 }
 
-// (pair? atom) -> boolean
-bamboo_error_t builtin_pairp(atom_t args, atom_t *result) {
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 1 argument"));
+/**
+ * Gets the value of a numeric atom as a double.
+ *
+ * @param  atom Atom to get its numeric value.
+ * @param  num  Pointer to where the value will be stored.
+ * @return      TRUE if the atom was a numeric.
+ */
+bool atom_numeric_val(atom_t atom, double *num) {
+	switch (atom.type) {
+	case ATOM_TYPE_INTEGER:
+		*num = (double)atom.value.integer;
+		return true;
+	case ATOM_TYPE_FLOAT:
+		*num = (double)atom.value.dfloat;
+		return true;
+	case ATOM_TYPE_BIGNUM:
+		*num = (double)bignum_to_float(*atom.value.bignum);
+		return true;
+	default:
+		return false;
 	}
-
-	*result = bamboo_boolean(car(args).type == ATOM_TYPE_PAIR);
-	return BAMBOO_OK;
 }
 
-// (symbol? atom) -> boolean
-bamboo_error_t builtin_symbolp(atom_t args, atom_t *result) {
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 1 argument"));
+/**
+ * Gets the value of a numeric atom as a float.
+ *
+ * @param  atom Atom to get its numeric value.
+ * @param  num  Pointer to where the value will be stored.
+ * @return      TRUE if the atom was a numeric.
+ */
+bool atom_float_val(atom_t atom, bamboo_float_t *num) {
+	switch (atom.type) {
+	case ATOM_TYPE_INTEGER:
+		*num = (bamboo_float_t)atom.value.integer;
+		return true;
+	case ATOM_TYPE_FLOAT:
+		*num = atom.value.dfloat;
+		return true;
+	case ATOM_TYPE_BIGNUM:
+		*num = bignum_to_float(*atom.value.bignum);
+		return true;
+	default:
+		return false;
 	}
-
-	*result = bamboo_boolean(car(args).type == ATOM_TYPE_SYMBOL);
-	return BAMBOO_OK;
 }
 
-// (integer? atom) -> boolean
-bamboo_error_t builtin_integerp(atom_t args, atom_t *result) {
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 1 argument"));
+/**
+ * Performs a binary arithmetic or comparison operation on two numeric atoms.
+ * Integers are kept as integers, getting promoted to big integers when they
+ * overflow, unless one of the operands is a float, in which case both get
+ * promoted to floats.
+ *
+ * @param  op     Operation to be performed.
+ * @param  a      Left hand side operand.
+ * @param  b      Right hand side operand.
+ * @param  result Pointer to the resulting number or boolean atom.
+ * @return        BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t numeric_binop(numeric_op_t op, atom_t a, atom_t b,
+							 atom_t *result) {
+	bamboo_float_t fa;
+	bamboo_float_t fb;
+
+	// Both are integers, so let's keep them that way.
+	if ((a.type == ATOM_TYPE_INTEGER) && (b.type == ATOM_TYPE_INTEGER)) {
+		int64_t ia = a.value.integer;
+		int64_t ib = b.value.integer;
+		int64_t ir;
+
+		switch (op) {
+		case NUMERIC_OP_SUM:
+			if (INT_ADD_OVERFLOW(ia, ib, &ir))
+				return bignum_binop(op, a, b, result);
+			*result = bamboo_int(ir);
+			break;
+		case NUMERIC_OP_SUBTRACT:
+			if (INT_SUB_OVERFLOW(ia, ib, &ir))
+				return bignum_binop(op, a, b, result);
+			*result = bamboo_int(ir);
+			break;
+		case NUMERIC_OP_MULTIPLY:
+			if (INT_MUL_OVERFLOW(ia, ib, &ir))
+				return bignum_binop(op, a, b, result);
+			*result = bamboo_int(ir);
+			break;
+		case NUMERIC_OP_EQ:
+			*result = bamboo_boolean(ia == ib);
+			break;
+		case NUMERIC_OP_LT:
+			*result = bamboo_boolean(ia < ib);
+			break;
+		case NUMERIC_OP_GT:
+			*result = bamboo_boolean(ia > ib);
+			break;
+		}
+
+		return BAMBOO_OK;
 	}
 
-	*result = bamboo_boolean(car(args).type == ATOM_TYPE_INTEGER);
-	return BAMBOO_OK;
-}
+	// Big integers must be handled without losing any precision.
+	if (INTEGRAL_P(a) && INTEGRAL_P(b))
+		return bignum_binop(op, a, b, result);
 
-// (float? atom) -> boolean
-bamboo_error_t builtin_floatp(atom_t args, atom_t *result) {
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 1 argument"));
+	// Promote the operands to floats.
+	if (!atom_float_val(a, &fa) || !atom_float_val(b, &fb)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts ")
+			_T("numerics"));
 	}
 
-	*result = bamboo_boolean(car(args).type == ATOM_TYPE_FLOAT);
-	return BAMBOO_OK;
-}
-
-// (numeric? atom) -> boolean
-bamboo_error_t builtin_numericp(atom_t args, atom_t *result) {
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 1 argument"));
+	switch (op) {
+	case NUMERIC_OP_SUM:
+		*result = bamboo_float(fa + fb);
+		break;
+	case NUMERIC_OP_SUBTRACT:
+		*result = bamboo_float(fa - fb);
+		break;
+	case NUMERIC_OP_MULTIPLY:
+		*result = bamboo_float(fa * fb);
+		break;
+	case NUMERIC_OP_EQ:
+		*result = bamboo_boolean(fa == fb);
+		break;
+	case NUMERIC_OP_LT:
+		*result = bamboo_boolean(fa < fb);
+		break;
+	case NUMERIC_OP_GT:
+		*result = bamboo_boolean(fa > fb);
+		break;
 	}
 
-	*result = bamboo_boolean((car(args).type == ATOM_TYPE_INTEGER) ||
-		(car(args).type == ATOM_TYPE_FLOAT));
 	return BAMBOO_OK;
 }
 
-// (boolean? atom) -> boolean
-bamboo_error_t builtin_booleanp(atom_t args, atom_t *result) {
+/**
+ * Folds a list of numbers from left to right using an arithmetic operation.
+ *
+ * @param  op     Arithmetic operation to be performed.
+ * @param  args   List of numbers with at least 2 elements.
+ * @param  result Pointer to the resulting number atom.
+ * @return        BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t numeric_fold(numeric_op_t op, atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	atom_t num;
+
 	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
+	if (nilp(args) || nilp(cdr(args))) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 1 argument"));
+			_T("This function expects at least 2 arguments"));
 	}
 
-	*result = bamboo_boolean(car(args).type == ATOM_TYPE_BOOLEAN);
-	return BAMBOO_OK;
-}
+	// Iterate through the arguments accumulating them.
+	num = car(args);
+	args = cdr(args);
+	while (!nilp(args)) {
+		err = numeric_binop(op, num, car(args), &num);
+		IF_ERROR(err)
+			return err;
 
-// (builtin? atom) -> boolean
-bamboo_error_t builtin_builtinp(atom_t args, atom_t *result) {
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 1 argument"));
+		args = cdr(args);
 	}
 
-	*result = bamboo_boolean(car(args).type == ATOM_TYPE_BUILTIN);
+	// Return the result atom.
+	*result = num;
 	return BAMBOO_OK;
 }
 
-// (closure? atom) -> boolean
-bamboo_error_t builtin_closurep(atom_t args, atom_t *result) {
+/**
+ * Checks if a comparison holds for each consecutive pair of numbers in a list.
+ *
+ * @param  op     Comparison operation to be performed.
+ * @param  args   List of numbers with at least 2 elements.
+ * @param  result Pointer to the resulting boolean atom.
+ * @return        BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t numeric_compare_chain(numeric_op_t op, atom_t args,
+									 atom_t *result) {
+	bamboo_error_t err;
+	atom_t prev_num;
+
 	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
+	if (nilp(args) || nilp(cdr(args))) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 1 argument"));
+			_T("This function expects at least 2 arguments"));
 	}
 
-	*result = bamboo_boolean(car(args).type == ATOM_TYPE_CLOSURE);
-	return BAMBOO_OK;
-}
+	// Iterate through the arguments checking them.
+	prev_num = car(args);
+	args = cdr(args);
+	while (!nilp(args)) {
+		err = numeric_binop(op, prev_num, car(args), result);
+		IF_ERROR(err)
+			return err;
 
-// (macro? atom) -> boolean
-bamboo_error_t builtin_macrop(atom_t args, atom_t *result) {
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 1) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects 1 argument"));
+		// We only need a single false comparison.
+		if (!result->value.boolean)
+			return BAMBOO_OK;
+
+		// Go to the next argument.
+		prev_num = car(args);
+		args = cdr(args);
 	}
 
-	*result = bamboo_boolean(car(args).type == ATOM_TYPE_MACRO);
+	// Looks like they all held up all along.
+	*result = bamboo_boolean(true);
 	return BAMBOO_OK;
 }
 
-// (display any...) -> string
-bamboo_error_t builtin_display(atom_t args, atom_t *result) {
-	bamboo_error_t err;
-
-	// Use the concat function to help us out here.
-	err = builtin_concat(args, result);
-	IF_ERROR(err)
-		return err;
-
-	// Print the concatenated string.
-	putstr(*result->value.str);
-	putstr(LINEBREAK);
+/**
+ * Gets the absolute value of a numeric atom.
+ *
+ * @param  atom   Numeric atom.
+ * @param  result Pointer to the resulting numeric atom.
+ * @return        BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t number_abs(atom_t atom, atom_t *result) {
+	switch (atom.type) {
+	case ATOM_TYPE_INTEGER:
+		// Negating the smallest integer overflows, so let the subtraction
+		// handle the promotion for us.
+		if (atom.value.integer < 0)
+			return numeric_binop(NUMERIC_OP_SUBTRACT, bamboo_int(0), atom,
+				result);
+		break;
+	case ATOM_TYPE_BIGNUM:
+		if ((*atom.value.bignum)->negative)
+			return numeric_binop(NUMERIC_OP_SUBTRACT, bamboo_int(0), atom,
+				result);
+		break;
+	case ATOM_TYPE_FLOAT:
+		atom.value.dfloat = FLOAT_FABS(atom.value.dfloat);
+		break;
+	default:
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts ")
+			_T("numerics"));
+	}
 
+	*result = atom;
 	return BAMBOO_OK;
 }
 
-// (concat any...) -> string
-bamboo_error_t builtin_concat(atom_t args, atom_t *result) {
-	size_t buflen = 0;
-	size_t tmplen = 0;
-	TCHAR *tmpbuf = NULL;
-	TCHAR *buf = NULL;
+/**
+ * Finds the number in a list that wins every comparison against the others.
+ * If any of the numbers is a float the result will also be a float.
+ *
+ * @param  op     Comparison operation that the winner must satisfy.
+ * @param  args   List of numbers with at least 1 element.
+ * @param  result Pointer to the resulting number atom.
+ * @return        BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t numeric_extreme(numeric_op_t op, atom_t args, atom_t *result) {
+	bamboo_error_t err;
+	bool inexact;
+	atom_t cmp;
 
 	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) < 1) {
+	if (nilp(args)) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
 			_T("This function expects at least 1 argument"));
 	}
 
-	// Get a clean slate.
-	buf = (TCHAR *)malloc(sizeof(TCHAR));
-	if (buf == NULL) {
-		*result = nil;
-		return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-			_T("new string to begin concatenation"));
-	}
-	buf[0] = _T('\0');
-
-	// Iterate through the arguments printing them them.
+	// Go through the arguments comparing them.
+	*result = car(args);
+	inexact = result->type == ATOM_TYPE_FLOAT;
+	args = cdr(args);
 	while (!nilp(args)) {
-		switch (car(args).type) {
-		case ATOM_TYPE_STRING:
-			// Get the argument string length.
-			tmpbuf = *car(args).value.str;
-			tmplen = _tcslen(tmpbuf);
-			buflen += tmplen;
-
-			// Reallocate the string to fit the new concatenated string.
-			buf = (TCHAR *)realloc(buf, (buflen + 1) * sizeof(TCHAR));
-			if (buf == NULL) {
-				*result = nil;
-				return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-					_T("new string to concatenate string atom"));
-			}
-
-			// Actually concatenate the strings.
-			_tcscat(buf, tmpbuf);
-			break;
-		case ATOM_TYPE_NIL:
-			break;
-		case ATOM_TYPE_SYMBOL:
-			// Get the argument string length.
-			tmplen = _tcslen(*car(args).value.symbol);
-			buflen += tmplen;
-
-			// Reallocate the string to fit the new concatenated string.
-			buf = (TCHAR *)realloc(buf, (buflen + 1) * sizeof(TCHAR));
-			if (buf == NULL) {
-				*result = nil;
-				return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-					_T("new string to concatenate symbol atom"));
-			}
-
-			// Actually concatenate the strings.
-			_tcscat(buf, *car(args).value.symbol);
-			break;
-		case ATOM_TYPE_INTEGER:
-			// Get the length of the string we'll need to concatenate this number.
-#if defined(_MSC_VER) && (_MSC_VER <= 1400)
-			tmplen = I64_MAX_DIGITS;
-#else
-			tmplen = _sntprintf(NULL, 0, _T("%lld"), car(args).value.integer);
-#endif  // _MSC_VER
-			tmpbuf = (TCHAR *)malloc((tmplen + 1) * sizeof(TCHAR));
-			if (tmpbuf == NULL) {
-				*result = nil;
-				return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-					_T("string to display integer atom"));
-			}
-#if defined(_MSC_VER) && (_MSC_VER <= 1400)
-			_sntprintf(tmpbuf, tmplen + 1, _T("%I64d"), car(args).value.integer);
-#else
-			_sntprintf(tmpbuf, tmplen + 1, _T("%lld"), car(args).value.integer);
-#endif  // _MSC_VER
-
-			// Reallocate the string to fit the new concatenated string.
-			buflen += tmplen;
-			buf = (TCHAR *)realloc(buf, (buflen + 1) * sizeof(TCHAR));
-			if (buf == NULL) {
-				*result = nil;
-				return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-					_T("new string to concatenate integer atom"));
-			}
-
-			// Actually concatenate the strings and free our temporary string.
-			_tcscat(buf, tmpbuf);
-			free(tmpbuf);
-			break;
-		case ATOM_TYPE_FLOAT:
-			// Get the length of the string we'll need to concatenate this number.
-#if defined(_MSC_VER) && (_MSC_VER <= 1400)
-			tmplen = LONGDOUBLE_MAX_DIGITS;
-#else
-			tmplen = _sntprintf(NULL, 0, _T("%Lg"), car(args).value.dfloat);
-#endif  // _MSC_VER
-			tmpbuf = (TCHAR *)malloc((tmplen + 1) * sizeof(TCHAR));
-			if (tmpbuf == NULL) {
-				*result = nil;
-				return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-					_T("string to display float atom"));
-			}
-			_sntprintf(tmpbuf, tmplen + 1, _T("%Lg"), car(args).value.dfloat);
-
-			// Reallocate the string to fit the new concatenated string.
-			buflen += tmplen;
-			buf = (TCHAR *)realloc(buf, (buflen + 1) * sizeof(TCHAR));
-			if (buf == NULL) {
-				*result = nil;
-				return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-					_T("new string to concatenate float atom"));
-			}
-
-			// Actually concatenate the strings and free our temporary string.
-			_tcscat(buf, tmpbuf);
-			free(tmpbuf);
-			break;
-		case ATOM_TYPE_BOOLEAN:
-			// Determine the string needed to concatenate depending on value.
-			if (car(args).value.boolean) {
-				tmpbuf = _tcsdup(_T("TRUE"));
-				tmplen = 4;
-			} else {
-				tmpbuf = _tcsdup(_T("FALSE"));
-				tmplen = 5;
-			}
-
-			// Reallocate the string to fit the new concatenated string.
-			buflen += tmplen;
-			buf = (TCHAR *)realloc(buf, (buflen + 1) * sizeof(TCHAR));
-			if (buf == NULL) {
-
-				*result = nil;
-				return bamboo_error(BAMBOO_ERROR_ALLOCATION, _T("Can't allocate ")
-					_T("new string to concatenate boolean atom"));
-			}
+		err = numeric_binop(op, car(args), *result, &cmp);
+		IF_ERROR(err)
+			return err;
 
-			// Actually concatenate the strings and free our temporary string.
-			_tcscat(buf, tmpbuf);
-			free(tmpbuf);
-			break;
-		default:
-			*result = nil;
-			return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
-				_T("Don't know how to display this type of atom"));
-		}
+		if (cmp.value.boolean)
+			*result = car(args);
+		inexact |= car(args).type == ATOM_TYPE_FLOAT;
 
-		// Go to the next argument.
 		args = cdr(args);
 	}
 
-	// Build the string atom to return and free our building buffer.
-	*result = bamboo_string(buf);
-	free(buf);
+	// Make sure a single argument is also checked for its type.
+	if (!INTEGRAL_P(*result) && (result->type != ATOM_TYPE_FLOAT)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts ")
+			_T("numerics"));
+	}
 
-	return BAMBOO_OK;
-}
+	// Inexactness is contagious.
+	if (inexact && (result->type != ATOM_TYPE_FLOAT)) {
+		bamboo_float_t num;
 
-// (newline) -> nil
-bamboo_error_t builtin_newline(atom_t args, atom_t *result) {
-	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 0) {
-		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects no arguments"));
+		(void)atom_float_val(*result, &num);
+		*result = bamboo_float(num);
 	}
 
-	// Print the newline string.
-	putstr(LINEBREAK);
-
-	*result = nil;
 	return BAMBOO_OK;
 }
 
-// (display-env) -> nil
-bamboo_error_t builtin_display_env(atom_t args, atom_t *result) {
-	env_t current;
+/**
+ * Applies a floating-point math function to a single numeric argument.
+ *
+ * @param  args   Arguments list with a single numeric atom.
+ * @param  func   Math function to be applied.
+ * @param  result Pointer to the resulting float atom.
+ * @return        BAMBOO_OK if the operation was successful.
+ */
+bamboo_error_t float_func(atom_t args, float_func_t func, atom_t *result) {
+	bamboo_float_t num;
 
 	// Check if we have the right number of arguments.
-	if (bamboo_list_count(args) != 0) {
+	*result = nil;
+	if (nilp(args) || !nilp(cdr(args))) {
 		return bamboo_error(BAMBOO_ERROR_ARGUMENTS,
-			_T("This function expects no arguments"));
+			_T("This function expects a single argument"));
 	}
 
-	// Grab our root environment.
-	current = cdr(*bamboo_root_env);
-
-	// Iterate over the symbols in the environment filtering out built-ins.
-	putstr(_T("symbol\t\tvalue") LINEBREAK);
-	while (!nilp(current)) {
-		atom_t item = car(current);
-
-		// Filter out any built-ins.
-		if (cdr(item).type == ATOM_TYPE_BUILTIN)
-			goto next_item;
-
-		// Print out the symbol name and its value.
-		_tprintf(SPEC_STR _T("\t\t"), *car(item).value.symbol);
-		bamboo_print_expr(cdr(item));
-		putstr(LINEBREAK);
+	// Get the argument as a float.
+	if (!atom_float_val(car(args), &num)) {
+		return bamboo_error(BAMBOO_ERROR_WRONG_TYPE,
+			_T("Invalid type of argument. This function only accepts ")
+			_T("numerics"));
+	}
 
-next_item:
-		// Go to the next item.
-		current = cdr(current);
+	// Apply the function.
+	switch (func) {
+	case FLOAT_FUNC_IDENTITY:
+		break;
+	case FLOAT_FUNC_SQRT:
+		num = FLOAT_SQRT(num);
+		break;
+	case FLOAT_FUNC_EXP:
+		num = FLOAT_EXP(num);
+		break;
+	case FLOAT_FUNC_LOG:
+		num = FLOAT_LOG(num);
+		break;
+	case FLOAT_FUNC_SIN:
+		num = FLOAT_SIN(num);
+		break;
+	case FLOAT_FUNC_COS:
+		num = FLOAT_COS(num);
+		break;
+	case FLOAT_FUNC_ATAN:
+		num = FLOAT_ATAN(num);
+		break;
 	}
 
-	*result = nil;
+	*result = bamboo_float(num);
 	return BAMBOO_OK;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-//                                                                            //
-//                          Miscellaneous Utilities                           //
-//                                                                            //
-////////////////////////////////////////////////////////////////////////////////
-
-/**
- * Gets the boolean value of a given atom.
- *
- * @param  atom Atom to get its boolean value.
- * @return      TRUE if the atom is of type boolean and is true, or if its any
- *              other type of atom. FALSE only for a false boolean atom.
- */
-bool atom_boolean_val(atom_t atom) {
-	// All non-boolean atoms are true.
-	if (atom.type != ATOM_TYPE_BOOLEAN)
-		return true;
-
-	return atom.value.boolean;
-}
-
 /**
  * Prints a string to stdout. Just like puts but without the newline.
  *
@@ -3615,6 +14292,12 @@ bool atom_boolean_val(atom_t atom) {
 void putstr(const TCHAR *str) {
 	const TCHAR *tmp = str;
 
+	// Are we capturing the output into a string?
+	if (bamboo_ctx->output_capture != NULL) {
+		strbuf_append(bamboo_ctx->output_capture, str, _tcslen(str));
+		return;
+	}
+
 	while (*tmp)
 		_puttchar(*tmp++);
 }
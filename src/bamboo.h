@@ -12,8 +12,10 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 /* Library export prefix definition. */
 #ifdef LIBRARY_EXPORTS
@@ -116,6 +118,7 @@ extern "C" {
 		#define _puttc     putc
 		#define _fputts    fputs
 		#define _gettchar  getchar
+		#define _tfopen    fopen
 
 		// String operations.
 		#define _tcscmp   strcmp
@@ -161,6 +164,7 @@ extern "C" {
 
 // Parser return values.
 typedef enum {
+	BAMBOO_SUSPENDED       = -6,
 	BAMBOO_PAREN_QUOTE_END = -5,
 	BAMBOO_PAREN_END       = -4,
 	BAMBOO_QUOTE_END       = -3,
@@ -175,6 +179,8 @@ typedef enum {
 	BAMBOO_ERROR_NUM_OVERFLOW,
 	BAMBOO_ERROR_NUM_UNDERFLOW,
 	BAMBOO_ERROR_ALLOCATION,
+	BAMBOO_ERROR_READ_ONLY,
+	BAMBOO_ERROR_DEADLOCK,
 	BAMBOO_ERROR_UNKNOWN
 } bamboo_error_t;
 
@@ -190,30 +196,104 @@ typedef enum {
 	ATOM_TYPE_BUILTIN,
 	ATOM_TYPE_CLOSURE,
 	ATOM_TYPE_MACRO,
-	ATOM_TYPE_POINTER
+	ATOM_TYPE_POINTER,
+	ATOM_TYPE_VECTOR,
+	ATOM_TYPE_BIGNUM,
+	ATOM_TYPE_AUTOLOAD,
+	ATOM_TYPE_CHANNEL
 } atom_type_t;
 
+// Homogeneous numeric vector element types.
+typedef enum {
+	VECTOR_TYPE_F64,
+	VECTOR_TYPE_I64,
+	VECTOR_TYPE_F32
+} vector_type_t;
+
+// Floating-point type used to store float atoms. Defining BAMBOO_USE_DOUBLE
+// trades the extra precision of long double for much faster arithmetic on
+// platforms where long double is emulated or handled by the x87 FPU.
+#ifdef BAMBOO_USE_DOUBLE
+	typedef double bamboo_float_t;
+#else
+	typedef long double bamboo_float_t;
+#endif  // BAMBOO_USE_DOUBLE
+
 // Atom structures typedefs.
 typedef struct pair_s pair_t;
 typedef struct atom_s atom_t;
 typedef atom_t env_t;
 
+// Homogeneous numeric vector structure. Elements are stored unboxed and
+// contiguous right after the header.
+typedef struct {
+	vector_type_t type;
+	size_t len;
+	union {
+		double *f64;
+		int64_t *i64;
+		float *f32;
+		void *raw;
+	} data;
+} vector_t;
+
+// Arbitrary-precision integer structure. The magnitude is stored as
+// little-endian 32-bit limbs right after the header.
+typedef struct {
+	bool negative;
+	size_t len;
+	uint32_t *limbs;
+} bignum_t;
+
+// Immutable counted string structure. Characters are either owned by the
+// string, stored right after the header or in a separate buffer, or are a
+// view into the characters of a parent string. Owned characters are always
+// terminated, views aren't necessarily.
+typedef struct string_s string_t;
+struct string_s {
+	const TCHAR *chars;
+	size_t len;
+	uint32_t hash;
+	string_t **parent;
+	TCHAR *buf;
+};
+
 // Built-in function prototype typedef.
 // Template: bamboo_error_t func_builtin(atom_t args, atom_t *result);
 typedef bamboo_error_t (*builtin_func_t)(atom_t, atom_t*);
 
+// Interpreter context holding the heap, symbol table, root environment and
+// error state.
+typedef struct bamboo_ctx_s bamboo_ctx_t;
+
+// Incremental parser that accepts its input in chunks.
+typedef struct bamboo_parser_s bamboo_parser_t;
+
+// Evaluation that can be run a few steps at a time.
+typedef struct bamboo_eval_s bamboo_eval_t;
+
+// Callback that receives complete top-level forms from the incremental parser.
+// Template: bamboo_error_t func_form(atom_t form, void *arg);
+typedef bamboo_error_t (*bamboo_form_func_t)(atom_t, void*);
+
+// Callback that loads the definition of a symbol bound to an autoload stub.
+// Template: bamboo_error_t func_autoload(env_t env, atom_t symbol, void *arg);
+typedef bamboo_error_t (*bamboo_autoload_func_t)(atom_t, atom_t, void*);
+
 // Atom structure.
 struct atom_s {
 	atom_type_t type;
 	union {
 		pair_t *pair;
 		TCHAR **symbol;
-		TCHAR **str;
+		string_t **str;
 		int64_t integer;
-		long double dfloat;
+		bamboo_float_t dfloat;
 		bool boolean;
 		builtin_func_t builtin;
 		void *pointer;
+		vector_t **vector;
+		bignum_t **bignum;
 	} value;
 };
 
@@ -237,36 +317,90 @@ BAMBOO_API bamboo_error_t apply(atom_t func, atom_t args, atom_t *result);
 BAMBOO_API bamboo_error_t bamboo_init(env_t *env);
 BAMBOO_API bamboo_error_t bamboo_destroy(env_t *env);
 
+// Interpreter contexts.
+BAMBOO_API bamboo_error_t bamboo_ctx_new(bamboo_ctx_t **ctx);
+BAMBOO_API void bamboo_ctx_free(bamboo_ctx_t *ctx);
+BAMBOO_API bamboo_ctx_t *bamboo_ctx_current(void);
+BAMBOO_API bamboo_ctx_t *bamboo_ctx_switch(bamboo_ctx_t *ctx);
+
 // Environment.
 BAMBOO_API env_t bamboo_env_new(env_t parent);
 BAMBOO_API bamboo_error_t bamboo_env_get(env_t env, atom_t symbol, atom_t *atom);
 BAMBOO_API bamboo_error_t bamboo_env_set(env_t env, atom_t symbol, atom_t value);
 BAMBOO_API bamboo_error_t bamboo_env_set_builtin(env_t env, const TCHAR *name,
 												 builtin_func_t func);
+BAMBOO_API bamboo_error_t bamboo_env_set_autoload(env_t env, atom_t symbol,
+												  void *arg);
+BAMBOO_API void bamboo_set_autoload_handler(bamboo_autoload_func_t func);
 BAMBOO_API env_t *bamboo_get_root_env(void);
+BAMBOO_API bamboo_error_t bamboo_env_freeze(env_t base);
+BAMBOO_API bamboo_error_t bamboo_env_thaw(void);
+BAMBOO_API bamboo_error_t bamboo_env_fork(env_t base, env_t *env);
+BAMBOO_API void bamboo_env_discard(env_t env);
 
 // Primitive creation.
 BAMBOO_API atom_t bamboo_int(int64_t num);
-BAMBOO_API atom_t bamboo_float(long double num);
+BAMBOO_API atom_t bamboo_float(bamboo_float_t num);
 BAMBOO_API atom_t bamboo_symbol(const TCHAR *name);
 BAMBOO_API atom_t bamboo_boolean(bool value);
 BAMBOO_API atom_t bamboo_string(const TCHAR *str);
+BAMBOO_API const TCHAR *bamboo_string_cstr(atom_t atom);
 BAMBOO_API atom_t bamboo_builtin(builtin_func_t func);
 BAMBOO_API bamboo_error_t bamboo_closure(env_t env, atom_t args, atom_t body,
 										 atom_t *result);
 BAMBOO_API atom_t bamboo_pointer(void *pointer);
+BAMBOO_API atom_t bamboo_vector(vector_type_t type, size_t len);
 
 // Parsing and evaluation.
 BAMBOO_API bamboo_error_t bamboo_parse_expr(const TCHAR *input, const TCHAR **end,
 											atom_t *atom);
 BAMBOO_API bamboo_error_t bamboo_eval_expr(atom_t expr, env_t env, atom_t *result);
+BAMBOO_API bamboo_error_t bamboo_eval_begin(atom_t expr, env_t env,
+											bamboo_eval_t **state);
+BAMBOO_API bamboo_error_t bamboo_eval_step(bamboo_eval_t *state,
+										   size_t max_steps);
+BAMBOO_API bamboo_error_t bamboo_eval_step_timed(bamboo_eval_t *state,
+												 uint32_t timeout);
+BAMBOO_API bamboo_error_t bamboo_eval_finish(bamboo_eval_t *state,
+											 atom_t *result);
+BAMBOO_API bamboo_error_t bamboo_scan_form(const TCHAR *input,
+										   const TCHAR **start,
+										   const TCHAR **end, atom_t *name);
+
+// Incremental parsing.
+BAMBOO_API bamboo_error_t bamboo_parser_new(bamboo_parser_t **parser);
+BAMBOO_API bamboo_error_t bamboo_parser_feed(bamboo_parser_t *parser,
+											 const TCHAR *chunk,
+											 const TCHAR **end,
+											 bamboo_form_func_t func,
+											 void *arg);
+BAMBOO_API bamboo_error_t bamboo_parser_finish(bamboo_parser_t *parser,
+											   bamboo_form_func_t func,
+											   void *arg);
+BAMBOO_API bool bamboo_parser_pending(const bamboo_parser_t *parser);
+BAMBOO_API void bamboo_parser_reset(bamboo_parser_t *parser);
+BAMBOO_API void bamboo_parser_free(bamboo_parser_t *parser);
+
+// Heap images.
+BAMBOO_API bamboo_error_t bamboo_image_save(env_t env, const TCHAR *path);
+BAMBOO_API bamboo_error_t bamboo_image_load(env_t *env, const TCHAR *path);
+
+// Serialization.
+BAMBOO_API bamboo_error_t bamboo_serialize(atom_t expr, uint8_t **buf,
+										   size_t *len);
+BAMBOO_API bamboo_error_t bamboo_deserialize(const uint8_t *buf, size_t len,
+											 atom_t *expr);
+
+// Parallel map.
+BAMBOO_API bamboo_error_t bamboo_pmap(atom_t func, atom_t list, size_t workers,
+									  atom_t *result);
 
 // Error handling.
 BAMBOO_API const TCHAR *bamboo_error_detail(void);
 BAMBOO_API bamboo_error_t bamboo_error(bamboo_error_t err, const TCHAR *msg);
 
 // List manipulation.
-BAMBOO_API uint16_t bamboo_list_count(atom_t list);
+BAMBOO_API size_t bamboo_list_count(atom_t list);
 BAMBOO_API atom_t bamboo_list_ref(atom_t list, uint16_t index);
 BAMBOO_API void bamboo_list_set(atom_t list, uint16_t index, atom_t value);
 BAMBOO_API void bamboo_list_reverse(atom_t *list);
@@ -276,6 +410,7 @@ BAMBOO_API void bamboo_error_type_str(TCHAR **buf, bamboo_error_t err);
 BAMBOO_API void bamboo_print_error(bamboo_error_t err);
 BAMBOO_API void bamboo_expr_str(TCHAR **buf, atom_t atom);
 BAMBOO_API void bamboo_print_expr(atom_t atom);
+BAMBOO_API void bamboo_fprint_expr(FILE *fh, atom_t atom);
 BAMBOO_API void bamboo_print_tokens(const TCHAR *str);
 
 #ifdef __cplusplus
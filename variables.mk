@@ -6,6 +6,7 @@
 # Environment
 PLATFORM     := $(shell uname -s)
 USE_PLOTTING := gnuplot
+#USE_DOUBLE  := 1
 
 # Tools
 CC    = gcc
@@ -23,14 +24,19 @@ ifeq ($(PLATFORM), Darwin)
 endif
 
 # Flags
-CFLAGS  = -Wall -Wno-psabi
-LDFLAGS = -lm
+CFLAGS  = -Wall -Wno-psabi -pthread
+LDFLAGS = -lm -pthread
 
 # Enable plotting.
 ifdef USE_PLOTTING
 	CFLAGS += -DUSE_PLOTTING
 endif
 
+# Use double instead of long double for floating-point atoms.
+ifdef USE_DOUBLE
+	CFLAGS += -DBAMBOO_USE_DOUBLE
+endif
+
 # Enable Unicode on Windows platforms.
 ifeq ($(PLATFORM), Windows)
 	CFLAGS += -DUNICODE